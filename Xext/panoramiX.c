@@ -111,6 +111,9 @@ static DevPrivateKeyRec PanoramiXGCKeyRec;
 static DevPrivateKeyRec PanoramiXScreenKeyRec;
 
 #define PanoramiXScreenKey (&PanoramiXScreenKeyRec)
+static DevPrivateKeyRec XineramaWindowKeyRec;
+
+#define XineramaWindowKey (&XineramaWindowKeyRec)
 
 typedef struct {
     DDXPointRec clipOrg;
@@ -144,9 +147,16 @@ static const GCFuncs XineramaGCFuncs = {
     pGCPriv->wrapFuncs = (pGC)->funcs;\
     (pGC)->funcs = &XineramaGCFuncs;
 
+static void XineramaWindowPosition(CallbackListPtr *pcbl, ScreenPtr pScreen,
+                                   XorgScreenWindowPositionParamRec *param);
+static void XineramaWindowDestroy(CallbackListPtr *pcbl, ScreenPtr pScreen,
+                                  WindowPtr pWin);
+
 static void XineramaCloseScreen(CallbackListPtr *pcbl, ScreenPtr pScreen, void *unsused)
 {
     dixScreenUnhookClose(pScreen, XineramaCloseScreen);
+    dixScreenUnhookWindowPosition(pScreen, XineramaWindowPosition);
+    dixScreenUnhookWindowDestroy(pScreen, XineramaWindowDestroy);
 
     PanoramiXScreenPtr pScreenPriv = (PanoramiXScreenPtr)
         dixLookupPrivate(&pScreen->devPrivates, PanoramiXScreenKey);
@@ -322,6 +332,107 @@ XineramaDeleteResource(void *data, XID id)
     return 1;
 }
 
+/* Whether the window, border included, overlaps its screen */
+static Bool
+XineramaWindowOnScreen(WindowPtr pWin)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    int bw = wBorderWidth(pWin);
+
+    return pWin->drawable.x - bw < pScreen->width &&
+        pWin->drawable.x + (int) pWin->drawable.width + bw > 0 &&
+        pWin->drawable.y - bw < pScreen->height &&
+        pWin->drawable.y + (int) pWin->drawable.height + bw > 0;
+}
+
+static void
+XineramaUpdateWindowScreens(XineramaWindowLinks *links, WindowPtr pWin)
+{
+    unsigned int bit = 1U << pWin->drawable.pScreen->myNum;
+
+    if (XineramaWindowOnScreen(pWin))
+        links->screens |= bit;
+    else
+        links->screens &= ~bit;
+}
+
+/*
+ * Points @win at its window on every screen, so that requests don't have
+ * to look them up, and starts tracking which screens they overlap.  The
+ * links are dropped when either side goes away.
+ */
+void
+XineramaLinkWindow(PanoramiXRes *win)
+{
+    XineramaWindowLinks *links;
+
+    /* Only window resources need these, so they don't live in the union */
+    links = calloc(1, sizeof(XineramaWindowLinks) +
+                   PanoramiXNumScreens * sizeof(WindowPtr));
+    if (!links)
+        return;
+    links->screens = ~0U;
+    win->u.win.links = links;
+
+    XINERAMA_FOR_EACH_SCREEN_FORWARD({
+        WindowPtr pWin;
+
+        if (dixLookupResourceByType((void **) &pWin,
+                                    win->info[walkScreenIdx].id,
+                                    X11_RESTYPE_WINDOW, NULL,
+                                    DixUnknownAccess) != Success)
+            continue;
+
+        links->windows[walkScreenIdx] = pWin;
+        dixSetPrivate(&pWin->devPrivates, XineramaWindowKey, win);
+        XineramaUpdateWindowScreens(links, pWin);
+    });
+}
+
+static int
+XineramaDeleteWindow(void *data, XID id)
+{
+    PanoramiXRes *win = data;
+    XineramaWindowLinks *links = win->u.win.links;
+
+    if (links) {
+        XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            WindowPtr pWin = links->windows[walkScreenIdx];
+
+            if (pWin)
+                dixSetPrivate(&pWin->devPrivates, XineramaWindowKey, NULL);
+        });
+        free(links);
+    }
+
+    free(win);
+    return 1;
+}
+
+static void
+XineramaWindowPosition(CallbackListPtr *pcbl, ScreenPtr pScreen,
+                       XorgScreenWindowPositionParamRec *param)
+{
+    PanoramiXRes *win = dixLookupPrivate(&param->window->devPrivates,
+                                         XineramaWindowKey);
+
+    if (win)
+        XineramaUpdateWindowScreens(win->u.win.links, param->window);
+}
+
+static void
+XineramaWindowDestroy(CallbackListPtr *pcbl, ScreenPtr pScreen,
+                      WindowPtr pWin)
+{
+    PanoramiXRes *win = dixLookupPrivate(&pWin->devPrivates,
+                                         XineramaWindowKey);
+
+    if (win) {
+        win->u.win.links->windows[pScreen->myNum] = NULL;
+        dixSetPrivate(&pWin->devPrivates, XineramaWindowKey, NULL);
+    }
+}
+
 typedef struct {
     int screen;
     int id;
@@ -347,6 +458,17 @@ PanoramiXFindIDByScrnum(RESTYPE type, XID id, int screen)
         return val;
     }
 
+    /* Linked windows point back at their resource */
+    if (type == XRT_WINDOW) {
+        WindowPtr pWin;
+
+        if (dixLookupResourceByType((void **) &pWin, id, X11_RESTYPE_WINDOW,
+                                    NULL, DixUnknownAccess) == Success &&
+            pWin->drawable.pScreen->myNum == screen &&
+            (val = dixLookupPrivate(&pWin->devPrivates, XineramaWindowKey)))
+            return val;
+    }
+
     data.screen = screen;
     data.id = id;
 
@@ -441,6 +563,11 @@ PanoramiXExtensionInit(void)
         return;
     }
 
+    if (!dixRegisterPrivateKey(&XineramaWindowKeyRec, PRIVATE_WINDOW, 0)) {
+        noPanoramiXExtension = TRUE;
+        return;
+    }
+
     PanoramiXNumScreens = screenInfo.numScreens;
     if (PanoramiXNumScreens == 1) {     /* Only 1 screen        */
         noPanoramiXExtension = TRUE;
@@ -469,13 +596,15 @@ PanoramiXExtensionInit(void)
             }
 
             dixScreenHookClose(walkScreen, XineramaCloseScreen);
+            dixScreenHookWindowPosition(walkScreen, XineramaWindowPosition);
+            dixScreenHookWindowDestroy(walkScreen, XineramaWindowDestroy);
 
             pScreenPriv->CreateGC = masterScreen->CreateGC;
             walkScreen->CreateGC = XineramaCreateGC;
         });
 
         XRC_DRAWABLE = CreateNewResourceClass();
-        XRT_WINDOW = CreateNewResourceType(XineramaDeleteResource,
+        XRT_WINDOW = CreateNewResourceType(XineramaDeleteWindow,
                                            "XineramaWindow");
         if (XRT_WINDOW)
             XRT_WINDOW |= XRC_DRAWABLE;
@@ -820,7 +949,8 @@ PanoramiXConsolidate(void)
         defmap->info[walkScreenIdx].id = walkScreen->defColormap;
     });
 
-    AddResource(root->info[0].id, XRT_WINDOW, root);
+    if (AddResource(root->info[0].id, XRT_WINDOW, root))
+        XineramaLinkWindow(root);
     AddResource(saver->info[0].id, XRT_WINDOW, saver);
     AddResource(defmap->info[0].id, XRT_COLORMAP, defmap);
 }
@@ -44,11 +44,19 @@ Equipment Corporation.
 
 #include "gcstruct.h"
 #include "dixstruct.h"
+#include "window.h"
 
 typedef struct _PanoramiXInfo {
     XID id;
 } PanoramiXInfo;
 
+/* Screens a window overlaps, and the window on each of them, kept up to
+ * date by XineramaLinkWindow() */
+typedef struct _XineramaWindowLinks {
+    unsigned int screens;
+    WindowPtr windows[];
+} XineramaWindowLinks;
+
 typedef struct {
     PanoramiXInfo info[MAXSCREENS];
     RESTYPE type;
@@ -57,6 +65,7 @@ typedef struct {
             char visibility;
             char class;
             char root;
+            XineramaWindowLinks *links;
         } win;
         struct {
             Bool shared;
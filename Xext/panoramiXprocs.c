@@ -54,6 +54,78 @@ Equipment Corporation.
 #define INPUTONLY_LEGAL_MASK (CWWinGravity | CWEventMask | \
                               CWDontPropagate | CWOverrideRedirect | CWCursor )
 
+/*
+ * Whether a drawing request on @draw can change anything on screen @j,
+ * for requests that only draw within @box (in request coordinates, or
+ * NULL if that isn't known).  Screen 0 always gets the request, so that
+ * errors are reported no matter which screens the drawable is on.
+ *
+ * Pixmaps exist on every screen and are always drawn to.  Windows are
+ * skipped on the screens where they have nothing visible: they're either
+ * unmapped, entirely off that screen or covered there.  Both are known
+ * from the links kept by XineramaLinkWindow(), without any lookup.
+ * Windows without links are looked up.
+ */
+static Bool
+XineramaDrawableOnScreen(PanoramiXRes *draw, int j, Bool isRoot,
+                         const xRectangle *box)
+{
+    WindowPtr pWin;
+    BoxPtr extents;
+    int x, y;
+
+    if (j == 0 || draw->type != XRT_WINDOW)
+        return TRUE;
+
+    if (draw->u.win.links) {
+        if (!(draw->u.win.links->screens & (1U << j)))
+            return FALSE;
+        pWin = draw->u.win.links->windows[j];
+        if (!pWin)
+            return TRUE;
+    }
+    /* Only peeking at the clip, the request does the real lookup */
+    else if (dixLookupResourceByType((void **) &pWin, draw->info[j].id,
+                                     X11_RESTYPE_WINDOW, NULL,
+                                     DixUnknownAccess) != Success)
+        return TRUE;
+
+    if (!pWin->viewable || !RegionNotEmpty(&pWin->borderClip))
+        return FALSE;
+    if (!box)
+        return TRUE;
+
+    x = pWin->drawable.x + box->x;
+    y = pWin->drawable.y + box->y;
+    if (isRoot) {
+        x -= screenInfo.screens[j]->x;
+        y -= screenInfo.screens[j]->y;
+    }
+
+    extents = RegionExtents(&pWin->borderClip);
+    return x < extents->x2 && x + box->width > extents->x1 &&
+        y < extents->y2 && y + box->height > extents->y1;
+}
+
+/* Bounding box of a list of rectangles, clamped to the coordinate range */
+static void
+XineramaRectsExtents(const xRectangle *rects, int nrects, xRectangle *box)
+{
+    int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+
+    for (; nrects--; rects++) {
+        x1 = min(x1, rects->x);
+        y1 = min(y1, rects->y);
+        x2 = max(x2, rects->x + rects->width);
+        y2 = max(y2, rects->y + rects->height);
+    }
+
+    box->x = x1;
+    box->y = y1;
+    box->width = min(max(x2 - x1, 0), MAXSHORT);
+    box->height = min(max(y2 - y1, 0), MAXSHORT);
+}
+
 int
 PanoramiXCreateWindow(ClientPtr client)
 {
@@ -157,8 +229,10 @@ PanoramiXCreateWindow(ClientPtr client)
             break;
     });
 
-    if (result == Success)
-        AddResource(newWin->info[0].id, XRT_WINDOW, newWin);
+    if (result == Success) {
+        if (AddResource(newWin->info[0].id, XRT_WINDOW, newWin))
+            XineramaLinkWindow(newWin);
+    }
     else
         free(newWin);
 
@@ -1426,6 +1500,9 @@ PanoramiXPolyPoint(ClientPtr client)
         memcpy((char *) origPts, (char *) &stuff[1], npoint * sizeof(xPoint));
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+                continue;
+
             if (walkScreenIdx)
                 memcpy(&stuff[1], origPts, npoint * sizeof(xPoint));
 
@@ -1493,6 +1570,9 @@ PanoramiXPolyLine(ClientPtr client)
         memcpy((char *) origPts, (char *) &stuff[1], npoint * sizeof(xPoint));
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+                continue;
+
             if (walkScreenIdx)
                 memcpy(&stuff[1], origPts, npoint * sizeof(xPoint));
 
@@ -1564,6 +1644,9 @@ PanoramiXPolySegment(ClientPtr client)
         memcpy((char *) origSegs, (char *) &stuff[1], nsegs * sizeof(xSegment));
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+                continue;
+
             if (walkScreenIdx) /* skip on screen #0 */
                 memcpy(&stuff[1], origSegs, nsegs * sizeof(xSegment));
 
@@ -1635,6 +1718,9 @@ PanoramiXPolyRectangle(ClientPtr client)
                nrects * sizeof(xRectangle));
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+                continue;
+
             if (walkScreenIdx) /* skip on screen #0 */
                 memcpy(&stuff[1], origRecs, nrects * sizeof(xRectangle));
 
@@ -1703,6 +1789,9 @@ PanoramiXPolyArc(ClientPtr client)
         memcpy((char *) origArcs, (char *) &stuff[1], narcs * sizeof(xArc));
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+                continue;
+
             if (walkScreenIdx) /* skip screen #0 */
                 memcpy(&stuff[1], origArcs, narcs * sizeof(xArc));
 
@@ -1768,6 +1857,9 @@ PanoramiXFillPoly(ClientPtr client)
                count * sizeof(DDXPointRec));
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+                continue;
+
             if (walkScreenIdx) /* skip screen #0 */
                 memcpy(&stuff[1], locPts, count * sizeof(DDXPointRec));
 
@@ -1806,6 +1898,7 @@ PanoramiXPolyFillRectangle(ClientPtr client)
 {
     int result, things, i;
     PanoramiXRes *gc, *draw;
+    xRectangle box;
     Bool isRoot;
     REQUEST(xPolyFillRectangleReq);
 
@@ -1836,8 +1929,12 @@ PanoramiXPolyFillRectangle(ClientPtr client)
             return BadAlloc;
         memcpy((char *) origRects, (char *) &stuff[1],
                things * sizeof(xRectangle));
+        XineramaRectsExtents(origRects, things, &box);
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, &box))
+                continue;
+
             if (walkScreenIdx) /* skip screen #0 */
                 memcpy(&stuff[1], origRects, things * sizeof(xRectangle));
 
@@ -1906,6 +2003,9 @@ PanoramiXPolyFillArc(ClientPtr client)
         memcpy((char *) origArcs, (char *) &stuff[1], narcs * sizeof(xArc));
 
         XINERAMA_FOR_EACH_SCREEN_FORWARD({
+            if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+                continue;
+
             if (walkScreenIdx) /* skip screen #0 */
                 memcpy(&stuff[1], origArcs, narcs * sizeof(xArc));
 
@@ -1941,6 +2041,7 @@ int
 PanoramiXPutImage(ClientPtr client)
 {
     PanoramiXRes *gc, *draw;
+    xRectangle box;
     Bool isRoot;
     int result, orig_x, orig_y;
 
@@ -1965,8 +2066,15 @@ PanoramiXPutImage(ClientPtr client)
 
     orig_x = stuff->dstX;
     orig_y = stuff->dstY;
+    box.x = orig_x;
+    box.y = orig_y;
+    box.width = stuff->width;
+    box.height = stuff->height;
 
     XINERAMA_FOR_EACH_SCREEN_BACKWARD({
+        if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, &box))
+            continue;
+
         if (isRoot) {
             stuff->dstX = orig_x - walkScreen->x;
             stuff->dstY = orig_y - walkScreen->y;
@@ -2146,11 +2254,32 @@ PanoramiXGetImage(ClientPtr client)
    at the GlyphBlt level.  That is, loading the font and getting
    the glyphs should only happen once */
 
+/*
+ * Whether a PolyText item list has font shifts.  These change the font of
+ * the GC, so the request must run on every screen, or the GCs of the
+ * skipped ones would keep the old font.
+ */
+static Bool
+XineramaTextShiftsFont(const unsigned char *pElt, const unsigned char *endReq,
+                       int itemSize)
+{
+    /* Items are a length and a delta byte followed by the string, or
+     * FontChange followed by a font ID
+     */
+    while (endReq - pElt > 2) {
+        if (*pElt == FontChange)
+            return TRUE;
+        pElt += 2 + *pElt * itemSize;
+    }
+
+    return FALSE;
+}
+
 int
 PanoramiXPolyText8(ClientPtr client)
 {
     PanoramiXRes *gc, *draw;
-    Bool isRoot;
+    Bool isRoot, shiftsFont;
     int result;
     int orig_x, orig_y;
 
@@ -2172,11 +2301,18 @@ PanoramiXPolyText8(ClientPtr client)
         return result;
 
     isRoot = IS_ROOT_DRAWABLE(draw);
+    shiftsFont = XineramaTextShiftsFont((unsigned char *) &stuff[1],
+                                        (unsigned char *) stuff +
+                                        (client->req_len << 2), 1);
 
     orig_x = stuff->x;
     orig_y = stuff->y;
 
     XINERAMA_FOR_EACH_SCREEN_BACKWARD({
+        if (!shiftsFont &&
+            !XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+            continue;
+
         stuff->drawable = draw->info[walkScreenIdx].id;
         stuff->gc = gc->info[walkScreenIdx].id;
         if (isRoot) {
@@ -2195,7 +2331,7 @@ int
 PanoramiXPolyText16(ClientPtr client)
 {
     PanoramiXRes *gc, *draw;
-    Bool isRoot;
+    Bool isRoot, shiftsFont;
     int result;
     int orig_x, orig_y;
 
@@ -2217,11 +2353,18 @@ PanoramiXPolyText16(ClientPtr client)
         return result;
 
     isRoot = IS_ROOT_DRAWABLE(draw);
+    shiftsFont = XineramaTextShiftsFont((unsigned char *) &stuff[1],
+                                        (unsigned char *) stuff +
+                                        (client->req_len << 2), 2);
 
     orig_x = stuff->x;
     orig_y = stuff->y;
 
     XINERAMA_FOR_EACH_SCREEN_BACKWARD({
+        if (!shiftsFont &&
+            !XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+            continue;
+
         stuff->drawable = draw->info[walkScreenIdx].id;
         stuff->gc = gc->info[walkScreenIdx].id;
         if (isRoot) {
@@ -2267,6 +2410,9 @@ PanoramiXImageText8(ClientPtr client)
     orig_y = stuff->y;
 
     XINERAMA_FOR_EACH_SCREEN_BACKWARD({
+        if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+            continue;
+
         stuff->drawable = draw->info[walkScreenIdx].id;
         stuff->gc = gc->info[walkScreenIdx].id;
         if (isRoot) {
@@ -2312,6 +2458,9 @@ PanoramiXImageText16(ClientPtr client)
     orig_y = stuff->y;
 
     XINERAMA_FOR_EACH_SCREEN_BACKWARD({
+        if (!XineramaDrawableOnScreen(draw, walkScreenIdx, isRoot, NULL))
+            continue;
+
         stuff->drawable = draw->info[walkScreenIdx].id;
         stuff->gc = gc->info[walkScreenIdx].id;
         if (isRoot) {
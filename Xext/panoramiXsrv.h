@@ -19,6 +19,7 @@ Bool PanoramiXCreateConnectionBlock(void);
 PanoramiXRes *PanoramiXFindIDByScrnum(RESTYPE, XID, int);
 Bool XineramaRegisterConnectionBlockCallback(void (*func) (void));
 int XineramaDeleteResource(void *, XID);
+void XineramaLinkWindow(PanoramiXRes *win);
 
 /* only exported for Nvidia legacy. This really shouldn't be used by drivers */
 extern _X_EXPORT RESTYPE XRC_DRAWABLE;
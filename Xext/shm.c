@@ -416,6 +416,8 @@ ShmDetachSegment(void *value, /* must conform to DeleteType */
 
     if (--shmdesc->refcnt)
         return TRUE;
+    if (shmdesc->pixmap)
+        FreeScratchPixmapHeader(shmdesc->pixmap);
 #if SHM_FD_PASSING
     if (shmdesc->is_fd) {
         if (shmdesc->busfault)
@@ -446,6 +448,52 @@ ProcShmDetach(ClientPtr client)
     return Success;
 }
 
+/*
+ * Pixmap header over the image at @offset in the segment.  Clients
+ * usually put every frame from the same place, so the header is kept
+ * with the segment and only changed when the image does.
+ */
+static PixmapPtr
+ShmGetSegmentPixmap(ShmDescPtr shmdesc, ScreenPtr pScreen,
+                    unsigned long offset, int w, int h, int depth)
+{
+    PixmapPtr pPixmap = shmdesc->pixmap;
+    int bpp = BitsPerPixel(depth);
+    int devKind = PixmapBytePad(w, depth);
+    char *data = shmdesc->addr + offset;
+
+    if (pPixmap && (pPixmap->drawable.pScreen != pScreen ||
+                    pPixmap->drawable.depth != depth)) {
+        FreeScratchPixmapHeader(pPixmap);
+        pPixmap = shmdesc->pixmap = NULL;
+    }
+
+    if (!pPixmap) {
+        pPixmap = GetScratchPixmapHeader(pScreen, w, h, depth, bpp,
+                                         devKind, data);
+        if (!pPixmap)
+            return NULL;
+        shmdesc->pixmap = pPixmap;
+        shmdesc->pixmapOffset = offset;
+        return pPixmap;
+    }
+
+    if (shmdesc->pixmapOffset != offset ||
+        pPixmap->drawable.width != w || pPixmap->drawable.height != h) {
+        if (!(*pScreen->ModifyPixmapHeader) (pPixmap, w, h, depth, bpp,
+                                             devKind, data)) {
+            FreeScratchPixmapHeader(pPixmap);
+            shmdesc->pixmap = NULL;
+            return NULL;
+        }
+        shmdesc->pixmapOffset = offset;
+    }
+
+    /* The client has changed the contents behind our back */
+    pPixmap->drawable.serialNumber = NEXT_SERIAL_NUMBER;
+    return pPixmap;
+}
+
 /*
  * If the given request doesn't exactly match PutImage's constraints,
  * wrap the image in a scratch pixmap header and let CopyArea sort it out.
@@ -454,19 +502,18 @@ static void
 doShmPutImage(DrawablePtr dst, GCPtr pGC,
               int depth, unsigned int format,
               int w, int h, int sx, int sy, int sw, int sh, int dx, int dy,
-              char *data)
+              ShmDescPtr shmdesc, unsigned long offset)
 {
     PixmapPtr pPixmap;
+    char *data = shmdesc->addr + offset;
 
     if (format == ZPixmap || (format == XYPixmap && depth == 1)) {
-        pPixmap = GetScratchPixmapHeader(dst->pScreen, w, h, depth,
-                                         BitsPerPixel(depth),
-                                         PixmapBytePad(w, depth), data);
+        pPixmap = ShmGetSegmentPixmap(shmdesc, dst->pScreen, offset,
+                                      w, h, depth);
         if (!pPixmap)
             return;
         (void) pGC->ops->CopyArea((DrawablePtr) pPixmap, dst, pGC,
                                   sx, sy, sw, sh, dx, dy);
-        FreeScratchPixmapHeader(pPixmap);
     }
     else {
         GCPtr putGC = GetScratchGC(depth, dst->pScreen);
@@ -575,7 +622,7 @@ ShmPutImage(ClientPtr client, xShmPutImageReq *stuff)
                       stuff->totalWidth, stuff->totalHeight,
                       stuff->srcX, stuff->srcY,
                       stuff->srcWidth, stuff->srcHeight,
-                      stuff->dstX, stuff->dstY, shmdesc->addr + stuff->offset);
+                      stuff->dstX, stuff->dstY, shmdesc, stuff->offset);
 
     if (stuff->sendEvent) {
         xShmCompletionEvent ev = {
@@ -664,6 +711,17 @@ ShmGetImage(ClientPtr client, xShmGetImageReq *stuff)
         /* nothing to do */
     }
     else if (stuff->format == ZPixmap) {
+        /* Capturing clients shouldn't hold up everybody else while the
+         * screen reads the image back, so let it do that asynchronously
+         * and run the request again once the image is ready.
+         */
+        if (!dixScreenRaisePrepareGetImage(client, pDraw, stuff->x, stuff->y,
+                                           stuff->width, stuff->height,
+                                           stuff->format, stuff->planeMask)) {
+            ResetCurrentRequest(client);
+            client->sequence--;
+            return Success;
+        }
         (*pDraw->pScreen->GetImage) (pDraw, stuff->x, stuff->y,
                                      stuff->width, stuff->height,
                                      stuff->format, stuff->planeMask,
@@ -72,6 +72,9 @@ typedef struct _ShmDesc {
     struct busfault *busfault;
     XID resource;
 #endif
+    /* Header over part of the segment, kept for ShmPutImage */
+    PixmapPtr pixmap;
+    unsigned long pixmapOffset;
 } ShmDescRec, *ShmDescPtr;
 
 #ifdef SHM_FD_PASSING
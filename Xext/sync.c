@@ -134,9 +134,183 @@ SyncCheckWarnIsCounter(const SyncObject * pSync, const char *warning)
     return TRUE;
 }
 
-/*  Each counter maintains a simple linked list of triggers that are
- *  interested in the counter.  The two functions below are used to
- *  delete and add triggers on this list.
+/*
+ * Counter triggers are kept in one array per test type, sorted by their
+ * test value. A counter change only visits the triggers whose test value
+ * lies in the range that can fire for the old and new counter value, and
+ * the brackets of a system counter are the test values next to the
+ * counter value.
+ */
+
+/* Triggers collected by SyncChangeCounter() that haven't fired yet */
+typedef struct _SyncTriggerFiring {
+    SyncTrigger **triggers;
+    int num;
+    struct _SyncTriggerFiring *next;
+} SyncTriggerFiring;
+
+/* index of the first trigger with a test value >= value */
+static int
+SyncTriggerLowerBound(const SyncTriggerArray * array, int64_t value)
+{
+    int lo = 0, hi = array->num;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (array->entries[mid].test_value < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* index of the first trigger with a test value > value */
+static int
+SyncTriggerUpperBound(const SyncTriggerArray * array, int64_t value)
+{
+    int lo = 0, hi = array->num;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (array->entries[mid].test_value <= value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void
+SyncSortTrigger(SyncCounter * pCounter, SyncTrigger * pTrigger)
+{
+    SyncTriggerArray *array;
+    int i;
+
+    /* invalid test types are rejected by SyncInitTrigger */
+    if (pTrigger->test_type >= SYNC_NUM_TEST_TYPES)
+        return;
+
+    array = &pCounter->triggers[pTrigger->test_type];
+    if (array->num == array->size) {
+        int size = array->size ? array->size * 2 : 8;
+
+        /* Failure is not an option, it's succeed or burst! */
+        array->entries = XNFreallocarray(array->entries, size,
+                                         sizeof(*array->entries));
+        array->size = size;
+    }
+
+    i = SyncTriggerUpperBound(array, pTrigger->test_value);
+    memmove(&array->entries[i + 1], &array->entries[i],
+            (array->num - i) * sizeof(*array->entries));
+    array->entries[i].test_value = pTrigger->test_value;
+    array->entries[i].pTrigger = pTrigger;
+    array->num++;
+
+    pTrigger->sorted = TRUE;
+    pTrigger->sorted_type = pTrigger->test_type;
+    pTrigger->sorted_value = pTrigger->test_value;
+}
+
+static void
+SyncUnsortTrigger(SyncCounter * pCounter, SyncTrigger * pTrigger)
+{
+    SyncTriggerArray *array;
+    int i;
+
+    if (!pTrigger->sorted)
+        return;
+
+    array = &pCounter->triggers[pTrigger->sorted_type];
+    for (i = SyncTriggerLowerBound(array, pTrigger->sorted_value);
+         i < array->num && array->entries[i].test_value == pTrigger->sorted_value;
+         i++) {
+        if (array->entries[i].pTrigger == pTrigger) {
+            memmove(&array->entries[i], &array->entries[i + 1],
+                    (array->num - i - 1) * sizeof(*array->entries));
+            array->num--;
+            break;
+        }
+    }
+
+    pTrigger->sorted = FALSE;
+}
+
+/*
+ * The range of triggers of the given test type that may fire when the
+ * counter changes from oldval to newval.
+ */
+static void
+SyncTriggerRange(SyncCounter * pCounter, int type, int64_t oldval,
+                 int64_t newval, int *first, int *last)
+{
+    SyncTriggerArray *array = &pCounter->triggers[type];
+
+    *first = *last = 0;
+    switch (type) {
+    case XSyncPositiveTransition:
+        if (newval > oldval) {
+            *first = SyncTriggerUpperBound(array, oldval);
+            *last = SyncTriggerUpperBound(array, newval);
+        }
+        break;
+    case XSyncNegativeTransition:
+        if (newval < oldval) {
+            *first = SyncTriggerLowerBound(array, newval);
+            *last = SyncTriggerLowerBound(array, oldval);
+        }
+        break;
+    case XSyncPositiveComparison:
+        *last = SyncTriggerUpperBound(array, newval);
+        break;
+    case XSyncNegativeComparison:
+        *first = SyncTriggerLowerBound(array, newval);
+        *last = array->num;
+        break;
+    }
+}
+
+/* Whether any trigger is true after the counter changed from oldval */
+static Bool
+SyncAnyTriggerTrue(SyncCounter * pCounter, int64_t oldval)
+{
+    for (int type = 0; type < SYNC_NUM_TEST_TYPES; type++) {
+        SyncTriggerEntry *entries = pCounter->triggers[type].entries;
+        int first, last;
+
+        SyncTriggerRange(pCounter, type, oldval, pCounter->value,
+                         &first, &last);
+        for (int i = first; i < last; i++) {
+            if ((*entries[i].pTrigger->CheckTrigger) (entries[i].pTrigger,
+                                                      oldval))
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* The test type or test value of a trigger on a counter changed */
+static void
+SyncResortTrigger(SyncTrigger * pTrigger)
+{
+    SyncCounter *pCounter = (SyncCounter *) pTrigger->pSync;
+
+    if (!pCounter || pCounter->sync.type != SYNC_COUNTER || !pTrigger->sorted)
+        return;
+
+    if (pTrigger->sorted_type == pTrigger->test_type &&
+        pTrigger->sorted_value == pTrigger->test_value)
+        return;
+
+    SyncUnsortTrigger(pCounter, pTrigger);
+    SyncSortTrigger(pCounter, pTrigger);
+}
+
+/*
+ * Delete a trigger from its sync object.
  */
 void
 SyncDeleteTriggerFromSyncObject(SyncTrigger * pTrigger)
@@ -150,26 +324,20 @@ SyncDeleteTriggerFromSyncObject(SyncTrigger * pTrigger)
     if (!pTrigger->pSync)
         return;
 
-    pPrev = NULL;
-    pCur = pTrigger->pSync->pTriglist;
-
-    while (pCur) {
-        if (pCur->pTrigger == pTrigger) {
-            if (pPrev)
-                pPrev->next = pCur->next;
-            else
-                pTrigger->pSync->pTriglist = pCur->next;
+    if (SYNC_COUNTER == pTrigger->pSync->type) {
+        SyncTriggerFiring *firing;
 
-            free(pCur);
-            break;
-        }
+        pCounter = (SyncCounter *) pTrigger->pSync;
 
-        pPrev = pCur;
-        pCur = pCur->next;
-    }
+        SyncUnsortTrigger(pCounter, pTrigger);
 
-    if (SYNC_COUNTER == pTrigger->pSync->type) {
-        pCounter = (SyncCounter *) pTrigger->pSync;
+        /* a trigger deleted by another trigger firing must not fire */
+        for (firing = pCounter->firing; firing; firing = firing->next) {
+            for (int i = 0; i < firing->num; i++) {
+                if (firing->triggers[i] == pTrigger)
+                    firing->triggers[i] = NULL;
+            }
+        }
 
         if (IsSystemCounter(pCounter))
             SyncComputeBracketValues(pCounter);
@@ -177,6 +345,24 @@ SyncDeleteTriggerFromSyncObject(SyncTrigger * pTrigger)
     else if (SYNC_FENCE == pTrigger->pSync->type) {
         SyncFence *pFence = (SyncFence *) pTrigger->pSync;
 
+        pPrev = NULL;
+        pCur = pTrigger->pSync->pTriglist;
+
+        while (pCur) {
+            if (pCur->pTrigger == pTrigger) {
+                if (pPrev)
+                    pPrev->next = pCur->next;
+                else
+                    pTrigger->pSync->pTriglist = pCur->next;
+
+                free(pCur);
+                break;
+            }
+
+            pPrev = pCur;
+            pCur = pCur->next;
+        }
+
         pFence->funcs.DeleteTrigger(pTrigger);
     }
 }
@@ -190,28 +376,34 @@ SyncAddTriggerToSyncObject(SyncTrigger * pTrigger)
     if (!pTrigger->pSync)
         return Success;
 
-    /* don't do anything if it's already there */
-    for (pCur = pTrigger->pSync->pTriglist; pCur; pCur = pCur->next) {
-        if (pCur->pTrigger == pTrigger)
-            return Success;
-    }
-
-    /* Failure is not an option, it's succeed or burst! */
-    pCur = XNFalloc(sizeof(SyncTriggerList));
-
-    pCur->pTrigger = pTrigger;
-    pCur->next = pTrigger->pSync->pTriglist;
-    pTrigger->pSync->pTriglist = pCur;
-
     if (SYNC_COUNTER == pTrigger->pSync->type) {
         pCounter = (SyncCounter *) pTrigger->pSync;
 
+        /* don't do anything if it's already there */
+        if (pTrigger->sorted)
+            return Success;
+
+        SyncSortTrigger(pCounter, pTrigger);
+
         if (IsSystemCounter(pCounter))
             SyncComputeBracketValues(pCounter);
     }
     else if (SYNC_FENCE == pTrigger->pSync->type) {
         SyncFence *pFence = (SyncFence *) pTrigger->pSync;
 
+        /* don't do anything if it's already there */
+        for (pCur = pTrigger->pSync->pTriglist; pCur; pCur = pCur->next) {
+            if (pCur->pTrigger == pTrigger)
+                return Success;
+        }
+
+        /* Failure is not an option, it's succeed or burst! */
+        pCur = XNFalloc(sizeof(SyncTriggerList));
+
+        pCur->pTrigger = pTrigger;
+        pCur->next = pTrigger->pSync->pTriglist;
+        pTrigger->pSync->pTriglist = pCur;
+
         pFence->funcs.AddTrigger(pTrigger);
     }
 
@@ -436,8 +628,10 @@ SyncInitTrigger(ClientPtr client, SyncTrigger * pTrigger, XID syncObject,
     if (newSyncObject) {
         SyncAddTriggerToSyncObject(pTrigger);
     }
-    else if (pCounter && IsSystemCounter(pCounter)) {
-        SyncComputeBracketValues(pCounter);
+    else if (pCounter) {
+        SyncResortTrigger(pTrigger);
+        if (IsSystemCounter(pCounter))
+            SyncComputeBracketValues(pCounter);
     }
 
     return Success;
@@ -627,6 +821,7 @@ SyncAlarmTriggerFired(SyncTrigger * pTrigger)
      */
     SyncSendAlarmNotifyEvents(pAlarm);
     pTrigger->test_value = new_test_value;
+    SyncResortTrigger(pTrigger);
 }
 
 /*  This function is called when an Await unblocks, either as a result
@@ -738,18 +933,46 @@ SyncUpdateCounter(SyncCounter *pCounter, int64_t newval)
 void
 SyncChangeCounter(SyncCounter * pCounter, int64_t newval)
 {
-    SyncTriggerList *ptl, *pnext;
+    SyncTrigger *stack_triggers[32];
+    SyncTriggerFiring firing = { .triggers = stack_triggers };
+    int first[SYNC_NUM_TEST_TYPES], last[SYNC_NUM_TEST_TYPES];
     int64_t oldval;
+    int type, num = 0;
 
     oldval = SyncUpdateCounter(pCounter, newval);
 
-    /* run through triggers to see if any become true */
-    for (ptl = pCounter->sync.pTriglist; ptl; ptl = pnext) {
-        pnext = ptl->next;
-        if ((*ptl->pTrigger->CheckTrigger) (ptl->pTrigger, oldval))
-            (*ptl->pTrigger->TriggerFired) (ptl->pTrigger);
+    /* find the triggers that may become true */
+    for (type = 0; type < SYNC_NUM_TEST_TYPES; type++) {
+        SyncTriggerRange(pCounter, type, oldval, newval,
+                         &first[type], &last[type]);
+        num += last[type] - first[type];
+    }
+
+    if (num > ARRAY_SIZE(stack_triggers))
+        firing.triggers = XNFcallocarray(num, sizeof(*firing.triggers));
+
+    for (type = 0; type < SYNC_NUM_TEST_TYPES; type++) {
+        for (int i = first[type]; i < last[type]; i++)
+            firing.triggers[firing.num++] =
+                pCounter->triggers[type].entries[i].pTrigger;
     }
 
+    /* Firing a trigger may add, move or delete other triggers, so fire
+     * from the collected list. Deleted triggers are removed from it. */
+    firing.next = pCounter->firing;
+    pCounter->firing = &firing;
+
+    for (int i = 0; i < firing.num; i++) {
+        SyncTrigger *pTrigger = firing.triggers[i];
+
+        if (pTrigger && (*pTrigger->CheckTrigger) (pTrigger, oldval))
+            (*pTrigger->TriggerFired) (pTrigger);
+    }
+
+    pCounter->firing = firing.next;
+    if (firing.triggers != stack_triggers)
+        free(firing.triggers);
+
     if (IsSystemCounter(pCounter)) {
         SyncComputeBracketValues(pCounter);
     }
@@ -1055,8 +1278,6 @@ SyncDestroySystemCounter(void *pSysCounter)
 static void
 SyncComputeBracketValues(SyncCounter * pCounter)
 {
-    SyncTriggerList *pCur;
-    SyncTrigger *pTrigger;
     SysCounterInfo *psci;
     int64_t *pnewgtval = NULL;
     int64_t *pnewltval = NULL;
@@ -1073,73 +1294,49 @@ SyncComputeBracketValues(SyncCounter * pCounter)
     psci->bracket_greater = LLONG_MAX;
     psci->bracket_less = LLONG_MIN;
 
-    for (pCur = pCounter->sync.pTriglist; pCur; pCur = pCur->next) {
-        pTrigger = pCur->pTrigger;
+    for (int type = 0; type < SYNC_NUM_TEST_TYPES; type++) {
+        SyncTriggerArray *array = &pCounter->triggers[type];
+        int greater, less;
 
-        if (pTrigger->test_type == XSyncPositiveComparison &&
-            ct != XSyncCounterNeverIncreases) {
-            if (pCounter->value < pTrigger->test_value &&
-                pTrigger->test_value < psci->bracket_greater) {
-                psci->bracket_greater = pTrigger->test_value;
-                pnewgtval = &psci->bracket_greater;
-            }
-            else if (pCounter->value > pTrigger->test_value &&
-                     pTrigger->test_value > psci->bracket_less) {
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
-        }
-        else if (pTrigger->test_type == XSyncNegativeComparison &&
-                 ct != XSyncCounterNeverDecreases) {
-            if (pCounter->value > pTrigger->test_value &&
-                pTrigger->test_value > psci->bracket_less) {
-                psci->bracket_less = pTrigger->test_value;
-                pnewltval = &psci->bracket_less;
-            }
-            else if (pCounter->value < pTrigger->test_value &&
-                     pTrigger->test_value < psci->bracket_greater) {
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
+        switch (type) {
+        case XSyncPositiveComparison:
+        case XSyncNegativeTransition:
+            if (ct == XSyncCounterNeverIncreases)
+                continue;
+            break;
+        case XSyncNegativeComparison:
+        case XSyncPositiveTransition:
+            if (ct == XSyncCounterNeverDecreases)
+                continue;
+            break;
         }
-        else if (pTrigger->test_type == XSyncNegativeTransition &&
-                 ct != XSyncCounterNeverIncreases) {
-            if (pCounter->value >= pTrigger->test_value &&
-                pTrigger->test_value > psci->bracket_less) {
-                    /*
-                     * If the value is exactly equal to our threshold, we want one
-                     * more event in the negative direction to ensure we pick up
-                     * when the value is less than this threshold.
-                     */
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
-            else if (pCounter->value < pTrigger->test_value &&
-                     pTrigger->test_value < psci->bracket_greater) {
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
+
+        /*
+         * If the value is exactly equal to the threshold of a transition,
+         * we want one more event in the direction of the transition to
+         * ensure we pick up when the value crosses this threshold.
+         */
+        if (type == XSyncPositiveTransition)
+            greater = SyncTriggerLowerBound(array, pCounter->value);
+        else
+            greater = SyncTriggerUpperBound(array, pCounter->value);
+
+        if (type == XSyncNegativeTransition)
+            less = SyncTriggerUpperBound(array, pCounter->value) - 1;
+        else
+            less = SyncTriggerLowerBound(array, pCounter->value) - 1;
+
+        if (greater < array->num &&
+            array->entries[greater].test_value < psci->bracket_greater) {
+            psci->bracket_greater = array->entries[greater].test_value;
+            pnewgtval = &psci->bracket_greater;
         }
-        else if (pTrigger->test_type == XSyncPositiveTransition &&
-                 ct != XSyncCounterNeverDecreases) {
-            if (pCounter->value <= pTrigger->test_value &&
-                pTrigger->test_value < psci->bracket_greater) {
-                    /*
-                     * If the value is exactly equal to our threshold, we
-                     * want one more event in the positive direction to
-                     * ensure we pick up when the value *exceeds* this
-                     * threshold.
-                     */
-                    psci->bracket_greater = pTrigger->test_value;
-                    pnewgtval = &psci->bracket_greater;
-            }
-            else if (pCounter->value > pTrigger->test_value &&
-                     pTrigger->test_value > psci->bracket_less) {
-                    psci->bracket_less = pTrigger->test_value;
-                    pnewltval = &psci->bracket_less;
-            }
+        if (less >= 0 &&
+            array->entries[less].test_value > psci->bracket_less) {
+            psci->bracket_less = array->entries[less].test_value;
+            pnewltval = &psci->bracket_less;
         }
-    }                           /* end for each trigger */
+    }
 
     (*psci->BracketValues) ((void *) pCounter, pnewltval, pnewgtval);
 
@@ -1182,13 +1379,18 @@ FreeCounter(void *env, XID id)
     pCounter->sync.beingDestroyed = TRUE;
 
     if (pCounter->sync.initialized) {
-        SyncTriggerList *ptl, *pnext;
-
         /* tell all the counter's triggers that counter has been destroyed */
-        for (ptl = pCounter->sync.pTriglist; ptl; ptl = pnext) {
-            (*ptl->pTrigger->CounterDestroyed) (ptl->pTrigger);
-            pnext = ptl->next;
-            free(ptl); /* destroy the trigger list as we go */
+        for (int type = 0; type < SYNC_NUM_TEST_TYPES; type++) {
+            SyncTriggerArray triggers = pCounter->triggers[type];
+
+            memset(&pCounter->triggers[type], 0, sizeof(triggers));
+            for (int i = 0; i < triggers.num; i++) {
+                SyncTrigger *pTrigger = triggers.entries[i].pTrigger;
+
+                pTrigger->sorted = FALSE;
+                (*pTrigger->CounterDestroyed) (pTrigger);
+            }
+            free(triggers.entries);
         }
         if (IsSystemCounter(pCounter)) {
             xorg_list_del(&pCounter->pSysCounterInfo->entry);
@@ -2433,8 +2635,6 @@ IdleTimeBlockHandler(void *pCounter, void *wt)
     int64_t *less = priv->value_less;
     int64_t *greater = priv->value_greater;
     int64_t idle, old_idle;
-    SyncTriggerList *list = counter->sync.pTriglist;
-    SyncTrigger *trig;
 
     if (!less && !greater)
         return;
@@ -2461,13 +2661,8 @@ IdleTimeBlockHandler(void *pCounter, void *wt)
          * immediately so we can reschedule.
          */
 
-        for (list = counter->sync.pTriglist; list; list = list->next) {
-            trig = list->pTrigger;
-            if (trig->CheckTrigger(trig, old_idle)) {
-                AdjustWaitForDelay(wt, 0);
-                break;
-            }
-        }
+        if (SyncAnyTriggerTrue(counter, old_idle))
+            AdjustWaitForDelay(wt, 0);
         /*
          * We've been called exactly on the idle time, but we have a
          * NegativeTransition trigger which requires a transition from an
@@ -2488,15 +2683,8 @@ IdleTimeBlockHandler(void *pCounter, void *wt)
         if (idle < *greater) {
             AdjustWaitForDelay(wt, *greater - idle);
         }
-        else {
-            for (list = counter->sync.pTriglist; list;
-                 list = list->next) {
-                trig = list->pTrigger;
-                if (trig->CheckTrigger(trig, old_idle)) {
-                    AdjustWaitForDelay(wt, 0);
-                    break;
-                }
-            }
+        else if (SyncAnyTriggerTrue(counter, old_idle)) {
+            AdjustWaitForDelay(wt, 0);
         }
     }
 
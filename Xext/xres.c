@@ -225,14 +225,6 @@ ProcXResQueryClients(ClientPtr client)
     return X_SEND_REPLY_WITH_RPCBUF(client, reply, rpcbuf);
 }
 
-static void
-ResFindAllRes(void *value, XID id, RESTYPE type, void *cdata)
-{
-    int *counts = (int *) cdata;
-
-    counts[(type & TypeMask) - 1]++;
-}
-
 static CARD32
 resourceTypeAtom(int i)
 {
@@ -266,29 +258,23 @@ ProcXResQueryClientResources(ClientPtr client)
         return BadValue;
     }
 
-    int *counts = calloc(lastResourceType + 1, sizeof(int));
-    if (!counts)
-        return BadAlloc;
-
-    FindAllClientResources(resClient, ResFindAllRes, counts);
-
     x_rpcbuf_t rpcbuf = { .swapped = client->swapped, .err_clear = TRUE };
 
     int num_types = 0;
-    for (int i = 0; i <= lastResourceType; i++) {
+    for (int i = 1; i <= lastResourceType; i++) {
+        unsigned int count = GetClientResourceTypeCount(resClient, i);
+
         /* dont report currently unused resource types */
-        if (!(counts[i]))
+        if (!count)
             continue;
 
         /* write xXResType */
-        x_rpcbuf_write_CARD32(&rpcbuf, resourceTypeAtom(i + 1));
-        x_rpcbuf_write_CARD32(&rpcbuf, counts[i]);
+        x_rpcbuf_write_CARD32(&rpcbuf, resourceTypeAtom(i));
+        x_rpcbuf_write_CARD32(&rpcbuf, count);
 
         num_types++;
     }
 
-    free(counts);
-
     xXResQueryClientResourcesReply reply = {
         .num_types = num_types
     };
@@ -300,17 +286,6 @@ ProcXResQueryClientResources(ClientPtr client)
     return X_SEND_REPLY_WITH_RPCBUF(client, reply, rpcbuf);
 }
 
-static void
-ResFindResourcePixmaps(void *value, XID id, RESTYPE type, void *cdata)
-{
-    SizeType sizeFunc = GetResourceTypeSizeFunc(type);
-    ResourceSizeRec size = { 0, 0, 0 };
-    unsigned long *bytes = cdata;
-
-    sizeFunc(value, id, &size);
-    *bytes += size.pixmapRefSize;
-}
-
 static int
 ProcXResQueryClientPixmapBytes(ClientPtr client)
 {
@@ -326,8 +301,8 @@ ProcXResQueryClientPixmapBytes(ClientPtr client)
     }
 
     unsigned long bytes = 0;
-    FindAllClientResources(owner, ResFindResourcePixmaps,
-                           (void *) (&bytes));
+    for (int i = 1; i <= lastResourceType; i++)
+        bytes += GetClientResourceTypePixmapBytes(owner, i);
 
     xXResQueryClientPixmapBytesReply reply = {
         .bytes = bytes,
@@ -781,6 +756,11 @@ ConstructClientResourceBytes(ClientPtr aboutClient,
         if (spec->resource) {
             /* these specs are handled elsewhere */
         } else if (spec->type) {
+            /* don't walk the resources of clients without any of this type */
+            if (!GetClientResourceTypeCount(aboutClient ? aboutClient
+                                                        : serverClient,
+                                            spec->type))
+                continue;
             ctx->resType = spec->type;
             FindClientResourcesByType(aboutClient, spec->type,
                                       AddResourceSizeValueWithResType, ctx);
@@ -70,6 +70,15 @@ Bool noTestExtensions = FALSE;
  */
 static InternalEvent *xtest_evlist;
 
+/* Devices whose sprite needs to catch up with fake motion.  Redrawing the
+ * cursor after every event is a waste when clients send thousands of
+ * them, so this is done once before the server goes to sleep.
+ */
+static Bool xtest_sprite_pending[MAXDEVICES];
+static Bool xtest_sprite_handler;
+
+static CARD8 xtest_major_opcode;
+
 /**
  * xtestpointer
  * is the virtual pointer for XTest. It is the first slave
@@ -178,6 +187,79 @@ XTestDeviceSendEvents(DeviceIntPtr dev,
         mieqProcessDeviceEvent(dev, &xtest_evlist[i], miPointerGetScreen(inputInfo.pointer));
 }
 
+static void
+XTestSpriteBlockHandler(void *data, void *timeout)
+{
+    DeviceIntPtr dev;
+
+    for (dev = inputInfo.devices; dev; dev = dev->next) {
+        if (xtest_sprite_pending[dev->id])
+            miPointerUpdateSprite(dev);
+    }
+    memset(xtest_sprite_pending, 0, sizeof(xtest_sprite_pending));
+
+    RemoveBlockAndWakeupHandlers(XTestSpriteBlockHandler,
+                                 (ServerWakeupHandlerProcPtr) NoopDDA, NULL);
+    xtest_sprite_handler = FALSE;
+}
+
+static void
+XTestQueueSpriteUpdate(DeviceIntPtr dev)
+{
+    if (!xtest_sprite_handler) {
+        if (!RegisterBlockAndWakeupHandlers(XTestSpriteBlockHandler,
+                                            (ServerWakeupHandlerProcPtr) NoopDDA,
+                                            NULL)) {
+            miPointerUpdateSprite(dev);
+            return;
+        }
+        xtest_sprite_handler = TRUE;
+    }
+    xtest_sprite_pending[dev->id] = TRUE;
+}
+
+/*
+ * Whether an absolute core motion is followed by another one from the
+ * same client, already read in full, to the same root window and
+ * without a delay.  Automation pipelines long runs of motion, and the
+ * pointer would pass through all but the last of them with nothing
+ * else happening in between, so only the last one is sent.  The next
+ * request is only seen if it came in with this one, so a run is never
+ * held back waiting for more input.
+ */
+static Bool
+XTestMotionSuperseded(ClientPtr client, const xEvent *ev)
+{
+    const xReq *next;
+    const xEvent *nextEv;
+    CARD32 root;
+    int len;
+
+    next = PeekNextRequest(client, &len);
+    if (!next || len != sz_xXTestFakeInputReq ||
+        next->reqType != xtest_major_opcode || next->data != X_XTestFakeInput)
+        return FALSE;
+
+    nextEv = (const xEvent *) &next[1];
+    root = nextEv->u.keyButtonPointer.root;
+    if (client->swapped)
+        swapl(&root);
+
+    return (nextEv->u.u.type & 0177) == MotionNotify &&
+        nextEv->u.u.detail == xFalse &&
+        nextEv->u.keyButtonPointer.time == 0 &&
+        root == ev->u.keyButtonPointer.root;
+}
+
+/*
+ * One request fakes one input event.  The extra xEvents in a request are
+ * the deviceValuator events of that same event, so a batch can't be
+ * told apart by length.  A delay is honoured by putting the client to
+ * sleep and executing the whole request again, with the time zeroed.
+ * A batch would need to remember which of its events were already
+ * sent.  FakeInput has no reply, so clients batch by pipelining
+ * requests, without any round trips.
+ */
 static int
 ProcXTestFakeInput(ClientPtr client)
 {
@@ -427,6 +509,9 @@ ProcXTestFakeInput(ClientPtr client)
 
         /* FIXME: Xinerama! */
 
+        if (!extension && ev->u.u.detail == xFalse &&
+            XTestMotionSuperseded(client, ev))
+            return Success;
         break;
     case ButtonPress:
     case ButtonRelease:
@@ -448,7 +533,7 @@ ProcXTestFakeInput(ClientPtr client)
         (*dev->sendEventsProc) (dev, type, ev->u.u.detail, flags, &mask);
 
     if (need_ptr_update)
-        miPointerUpdateSprite(dev);
+        XTestQueueSpriteUpdate(dev);
     return Success;
 }
 
@@ -636,14 +721,22 @@ XTestExtensionTearDown(ExtensionEntry * e)
 {
     FreeEventList(xtest_evlist, GetMaximumEventsNum());
     xtest_evlist = NULL;
+
+    /* The block handlers are gone with the server generation */
+    memset(xtest_sprite_pending, 0, sizeof(xtest_sprite_pending));
+    xtest_sprite_handler = FALSE;
 }
 
 void
 XTestExtensionInit(void)
 {
-    AddExtension(XTestExtensionName, 0, 0,
-                 ProcXTestDispatch, ProcXTestDispatch,
-                 XTestExtensionTearDown, StandardMinorOpcode);
+    ExtensionEntry *extEntry;
+
+    extEntry = AddExtension(XTestExtensionName, 0, 0,
+                            ProcXTestDispatch, ProcXTestDispatch,
+                            XTestExtensionTearDown, StandardMinorOpcode);
+    if (extEntry)
+        xtest_major_opcode = extEntry->base;
 
     xtest_evlist = InitEventList(GetMaximumEventsNum());
 }
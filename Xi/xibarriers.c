@@ -72,7 +72,10 @@ static DevPrivateKeyRec BarrierScreenPrivateKeyRec;
 typedef struct PointerBarrierClient *PointerBarrierClientPtr;
 
 struct PointerBarrierDevice {
+    struct PointerBarrierClient *barrier;
     struct xorg_list entry;
+    /* entry in the screen's list of barriers currently hit */
+    struct xorg_list hit_entry;
     int deviceid;
     Time last_timestamp;
     int barrier_event_id;
@@ -97,6 +100,9 @@ struct PointerBarrierClient {
 
 typedef struct _BarrierScreen {
     struct xorg_list barriers;
+    struct PointerBarrierIndex index;
+    /* PointerBarrierDevices with hit set, for any master device */
+    struct xorg_list hits;
 } BarrierScreenRec, *BarrierScreenPtr;
 
 #define GetBarrierScreen(s) ((BarrierScreenPtr)dixLookupPrivate(&(s)->devPrivates, BarrierScreenPrivateKey))
@@ -115,6 +121,7 @@ static struct PointerBarrierDevice *AllocBarrierDevice(void)
     pbd->hit = FALSE;
     pbd->seen = FALSE;
     xorg_list_init(&pbd->entry);
+    xorg_list_init(&pbd->hit_entry);
 
     return pbd;
 }
@@ -195,6 +202,155 @@ barrier_is_blocking_direction(const struct PointerBarrier * barrier,
     return (barrier->directions & direction) != direction;
 }
 
+static int
+barrier_index_key(const struct PointerBarrier *barrier)
+{
+    return barrier_is_vertical(barrier) ? barrier->x1 : barrier->y1;
+}
+
+/**
+ * @return The index of the first barrier in the sorted array whose key is
+ * greater than or equal to (or, if upper is TRUE, greater than) v.
+ */
+static int
+barrier_index_bound(struct PointerBarrier **barriers, int num, int v,
+                    BOOL upper)
+{
+    int lo = 0, hi = num;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int key = barrier_index_key(barriers[mid]);
+
+        if (key < v || (upper && key == v))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/**
+ * Add the barrier to the index. The caller must hold the input lock if the
+ * index is in use by the input thread.
+ *
+ * @return FALSE on allocation failure, the index is unchanged in that case.
+ */
+BOOL
+barrier_index_insert(struct PointerBarrierIndex *index,
+                     struct PointerBarrier *barrier)
+{
+    struct PointerBarrier ***barriers;
+    int *num, *size;
+    int pos;
+
+    if (barrier_is_vertical(barrier)) {
+        barriers = &index->vertical;
+        num = &index->num_vertical;
+        size = &index->size_vertical;
+    }
+    else {
+        barriers = &index->horizontal;
+        num = &index->num_horizontal;
+        size = &index->size_horizontal;
+    }
+
+    if (*num == *size) {
+        int new_size = *size ? *size * 2 : 16;
+        struct PointerBarrier **tmp;
+
+        tmp = reallocarray(*barriers, new_size, sizeof(*tmp));
+        if (!tmp)
+            return FALSE;
+        *barriers = tmp;
+        *size = new_size;
+    }
+
+    pos = barrier_index_bound(*barriers, *num, barrier_index_key(barrier),
+                              TRUE);
+    memmove(&(*barriers)[pos + 1], &(*barriers)[pos],
+            (*num - pos) * sizeof(**barriers));
+    (*barriers)[pos] = barrier;
+    (*num)++;
+
+    return TRUE;
+}
+
+/**
+ * Remove the barrier from the index. The caller must hold the input lock
+ * if the index is in use by the input thread.
+ */
+void
+barrier_index_remove(struct PointerBarrierIndex *index,
+                     struct PointerBarrier *barrier)
+{
+    struct PointerBarrier **barriers;
+    int *num;
+    int pos;
+
+    if (barrier_is_vertical(barrier)) {
+        barriers = index->vertical;
+        num = &index->num_vertical;
+    }
+    else {
+        barriers = index->horizontal;
+        num = &index->num_horizontal;
+    }
+
+    for (pos = barrier_index_bound(barriers, *num, barrier_index_key(barrier),
+                                   FALSE);
+         pos < *num; pos++) {
+        if (barriers[pos] == barrier) {
+            memmove(&barriers[pos], &barriers[pos + 1],
+                    (*num - pos - 1) * sizeof(*barriers));
+            (*num)--;
+            return;
+        }
+    }
+}
+
+void
+barrier_index_fini(struct PointerBarrierIndex *index)
+{
+    free(index->vertical);
+    free(index->horizontal);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * Look up the barriers that a movement from v1 to v2 along one axis may
+ * cross, i.e. the vertical barriers with x1 within [v1, v2] for movement
+ * along the x axis or the horizontal barriers with y1 within [v1, v2] for
+ * movement along the y axis. The order of v1 and v2 does not matter.
+ *
+ * @param[out] candidates Set to the first candidate barrier
+ * @return The number of candidate barriers
+ */
+int
+barrier_index_lookup(const struct PointerBarrierIndex *index, BOOL vertical,
+                     int v1, int v2, struct PointerBarrier ***candidates)
+{
+    struct PointerBarrier **barriers;
+    int num;
+    int first, last;
+
+    if (vertical) {
+        barriers = index->vertical;
+        num = index->num_vertical;
+    }
+    else {
+        barriers = index->horizontal;
+        num = index->num_horizontal;
+    }
+
+    first = barrier_index_bound(barriers, num, min(v1, v2), FALSE);
+    last = barrier_index_bound(barriers, num, max(v1, v2), TRUE);
+
+    *candidates = barriers + first;
+    return last - first;
+}
+
 static BOOL
 inside_segment(int v, int v1, int v2)
 {
@@ -333,31 +489,53 @@ barrier_find_nearest(BarrierScreenPtr cs, DeviceIntPtr dev,
                      int dir,
                      int x1, int y1, int x2, int y2)
 {
-    struct PointerBarrierClient *c, *nearest = NULL;
+    struct PointerBarrierClient *nearest = NULL;
     double min_distance = INT_MAX;      /* can't get higher than that in X anyway */
+    int axis;
 
-    xorg_list_for_each_entry(c, &cs->barriers, entry) {
-        struct PointerBarrier *b = &c->barrier;
-        struct PointerBarrierDevice *pbd;
-        double distance;
+    /* Vertical barriers can only block movement along the x axis and
+     * horizontal barriers only along the y axis, so only look at the
+     * barriers within the extents of the movement on that axis. */
+    for (axis = 0; axis < 2; axis++) {
+        BOOL vertical = (axis == 0);
+        struct PointerBarrier **candidates;
+        int i, n;
 
-        pbd = GetBarrierDevice(c, dev->id);
-        if (!pbd)
+        if (vertical && !(dir & (BarrierPositiveX | BarrierNegativeX)))
             continue;
-
-        if (pbd->seen)
+        if (!vertical && !(dir & (BarrierPositiveY | BarrierNegativeY)))
             continue;
 
-        if (!barrier_is_blocking_direction(b, dir))
-            continue;
+        n = barrier_index_lookup(&cs->index, vertical,
+                                 vertical ? x1 : y1, vertical ? x2 : y2,
+                                 &candidates);
 
-        if (!barrier_blocks_device(c, dev))
-            continue;
+        for (i = 0; i < n; i++) {
+            struct PointerBarrier *b = candidates[i];
+            struct PointerBarrierClient *c;
+            struct PointerBarrierDevice *pbd;
+            double distance;
+
+            c = container_of(b, struct PointerBarrierClient, barrier);
+
+            pbd = GetBarrierDevice(c, dev->id);
+            if (!pbd)
+                continue;
 
-        if (barrier_is_blocking(b, x1, y1, x2, y2, &distance)) {
-            if (min_distance > distance) {
-                min_distance = distance;
-                nearest = c;
+            if (pbd->seen)
+                continue;
+
+            if (!barrier_is_blocking_direction(b, dir))
+                continue;
+
+            if (!barrier_blocks_device(c, dev))
+                continue;
+
+            if (barrier_is_blocking(b, x1, y1, x2, y2, &distance)) {
+                if (min_distance > distance) {
+                    min_distance = distance;
+                    nearest = c;
+                }
             }
         }
     }
@@ -405,6 +583,7 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
     int dir;
     struct PointerBarrier *nearest = NULL;
     PointerBarrierClientPtr c;
+    struct PointerBarrierDevice *pbd, *tmp;
     Time ms = GetTimeInMillis();
     BarrierEvent ev = {
         .header = ET_Internal,
@@ -444,7 +623,6 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
 
     while (dir != 0) {
         int new_sequence;
-        struct PointerBarrierDevice *pbd;
 
         c = barrier_find_nearest(cs, master, dir, current_x, current_y, x, y);
         if (!c)
@@ -457,6 +635,8 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
             continue;
 
         new_sequence = !pbd->hit;
+        if (new_sequence)
+            xorg_list_append(&pbd->hit_entry, &cs->hits);
 
         pbd->seen = TRUE;
         pbd->hit = TRUE;
@@ -491,22 +671,21 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
         *nevents += 1;
     }
 
-    xorg_list_for_each_entry(c, &cs->barriers, entry) {
-        struct PointerBarrierDevice *pbd;
+    /* Only barriers that have been hit can be seen or left */
+    xorg_list_for_each_entry_safe(pbd, tmp, &cs->hits, hit_entry) {
         int flags = 0;
 
-        pbd = GetBarrierDevice(c, master->id);
-        if (!pbd)
+        if (pbd->deviceid != master->id)
             continue;
 
+        c = pbd->barrier;
         pbd->seen = FALSE;
-        if (!pbd->hit)
-            continue;
 
         if (barrier_inside_hit_box(&c->barrier, x, y))
             continue;
 
         pbd->hit = FALSE;
+        xorg_list_del(&pbd->hit_entry);
 
         ev.type = ET_BarrierLeave;
 
@@ -621,6 +800,7 @@ CreatePointerBarrierClient(ClientPtr client,
             err = BadAlloc;
             goto error;
         }
+        pbd->barrier = ret;
         pbd->deviceid = dev->id;
 
         input_lock();
@@ -641,6 +821,11 @@ CreatePointerBarrierClient(ClientPtr client,
     if (barrier_is_vertical(&ret->barrier))
         ret->barrier.directions &= ~(BarrierPositiveY | BarrierNegativeY);
     input_lock();
+    if (!barrier_index_insert(&cs->index, &ret->barrier)) {
+        input_unlock();
+        err = BadAlloc;
+        goto error;
+    }
     xorg_list_add(&ret->entry, &cs->barriers);
     input_unlock();
 
@@ -657,15 +842,17 @@ static int
 BarrierFreeBarrier(void *data, XID id)
 {
     struct PointerBarrierClient *c;
+    struct PointerBarrierDevice *pbd;
     Time ms = GetTimeInMillis();
     DeviceIntPtr dev = NULL;
     ScreenPtr screen;
+    BarrierScreenPtr cs;
 
     c = container_of(data, struct PointerBarrierClient, barrier);
     screen = c->screen;
+    cs = GetBarrierScreen(screen);
 
     for (dev = inputInfo.devices; dev; dev = dev->next) {
-        struct PointerBarrierDevice *pbd;
         int root_x, root_y;
         BarrierEvent ev = {
             .header = ET_Internal,
@@ -710,6 +897,9 @@ BarrierFreeBarrier(void *data, XID id)
 
     input_lock();
     xorg_list_del(&c->entry);
+    barrier_index_remove(&cs->index, &c->barrier);
+    xorg_list_for_each_entry(pbd, &c->per_device, entry)
+        xorg_list_del(&pbd->hit_entry);
     input_unlock();
 
     FreePointerBarrierClient(c);
@@ -728,6 +918,7 @@ static void add_master_func(void *res, XID id, void *devid)
     struct PointerBarrierDevice *pbd = AllocBarrierDevice();
     if (!pbd)
         return;
+    pbd->barrier = barrier;
     pbd->deviceid = *deviceid;
 
     input_lock();
@@ -779,6 +970,7 @@ static void remove_master_func(void *res, XID id, void *devid)
 
     input_lock();
     xorg_list_del(&pbd->entry);
+    xorg_list_del(&pbd->hit_entry);
     input_unlock();
     free(pbd);
 }
@@ -946,6 +1138,7 @@ XIBarrierInit(void)
         if (!cs)
             return FALSE;
         xorg_list_init(&cs->barriers);
+        xorg_list_init(&cs->hits);
         SetBarrierScreen(walkScreen, cs);
     }
 
@@ -962,6 +1155,7 @@ XIBarrierReset(void)
     for (i = 0; i < screenInfo.numScreens; i++) {
         ScreenPtr walkScreen = screenInfo.screens[i];
         BarrierScreenPtr cs = GetBarrierScreen(walkScreen);
+        barrier_index_fini(&cs->index);
         free(cs);
         SetBarrierScreen(walkScreen, NULL);
     }
@@ -10,6 +10,21 @@ struct PointerBarrier {
     CARD32 directions;
 };
 
+/**
+ * Per-screen segment index of barriers. Vertical barriers are kept sorted
+ * by their x coordinate, horizontal barriers by their y coordinate, so a
+ * movement vector only needs to test the barriers whose fixed coordinate
+ * lies within the vector's extent on that axis.
+ */
+struct PointerBarrierIndex {
+    struct PointerBarrier **vertical;   /* sorted by x1 */
+    int num_vertical;
+    int size_vertical;
+    struct PointerBarrier **horizontal; /* sorted by y1 */
+    int num_horizontal;
+    int size_horizontal;
+};
+
 int
 barrier_get_direction(int, int, int, int);
 BOOL
@@ -21,6 +36,18 @@ void
 barrier_clamp_to_barrier(struct PointerBarrier *barrier, int dir, int *x,
                              int *y);
 
+BOOL
+barrier_index_insert(struct PointerBarrierIndex *index,
+                     struct PointerBarrier *barrier);
+void
+barrier_index_remove(struct PointerBarrierIndex *index,
+                     struct PointerBarrier *barrier);
+void
+barrier_index_fini(struct PointerBarrierIndex *index);
+int
+barrier_index_lookup(const struct PointerBarrierIndex *index, BOOL vertical,
+                     int v1, int v2, struct PointerBarrier ***candidates);
+
 #include <xfixesint.h>
 
 int
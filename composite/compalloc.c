@@ -43,6 +43,7 @@
 
 #include <dix-config.h>
 
+#include "composite/compositeext_priv.h"
 #include "dix/resource_priv.h"
 #include "os/bug_priv.h"
 
@@ -198,6 +199,9 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
         cw->damageRegistered = FALSE;
         cw->damaged = FALSE;
         cw->pOldPixmap = NullPixmap;
+        cw->pScanoutSaved = NullPixmap;
+        cw->pixmapWidth = 0;
+        cw->pixmapHeight = 0;
         dixSetPrivate(&pWin->devPrivates, CompWindowPrivateKey, cw);
     }
     ccw->next = cw->clients;
@@ -212,6 +216,7 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
             DamageUnregister(cw->damage);
             cw->damageRegistered = FALSE;
         }
+        compRestoreScanout(pWin);
         cw->update = CompositeRedirectManual;
     }
     else if (cw->update == CompositeRedirectAutomatic && !cw->damageRegistered) {
@@ -219,7 +224,7 @@ compRedirectWindow(ClientPtr pClient, WindowPtr pWin, int update)
             anyMarked = compMarkWindows(pWin, &pLayerWin);
     }
 
-    if (!compCheckRedirect(pWin)) {
+    if (!compCheckRedirect(pWin, FALSE)) {
         FreeResource(ccw->id, X11_RESTYPE_NONE);
         status = BadAlloc;
     }
@@ -286,6 +291,7 @@ compFreeClientWindow(WindowPtr pWin, XID id)
         anyMarked = compMarkWindows(pWin, &pLayerWin);
 
         if (pWin->redirectDraw != RedirectDrawNone) {
+            compRestoreScanout(pWin);
             pPixmap = (*pScreen->GetWindowPixmap) (pWin);
             compSetParentPixmap(pWin);
         }
@@ -529,15 +535,125 @@ compUnredirectOneSubwindow(WindowPtr pParent, WindowPtr pWin)
     return Success;
 }
 
+/*
+ * Backing pixmaps get about a quarter of headroom, in steps of 64 pixels
+ */
+static int
+compPixmapSizeClass(int n)
+{
+    return min((n + n / 4 + 63) & ~63, MAXSHORT);
+}
+
+static int
+compFindBackgroundNone(WindowPtr pWin, void *data)
+{
+    Bool *found = data;
+
+    if (!pWin->mapped)
+        return WT_DONTWALKCHILDREN;
+    if (pWin->backgroundState == None) {
+        *found = TRUE;
+        return WT_STOPWALKING;
+    }
+    return WT_WALKCHILDREN;
+}
+
+/*
+ * Whether exposing the window, as mapping or growing it does, leaves
+ * parts of it that no background paints
+ */
+static Bool
+compExposeLeavesUnpainted(WindowPtr pWin)
+{
+    Bool found = FALSE;
+    WindowPtr pChild;
+
+    if (pWin->backgroundState != BackgroundPixel &&
+        pWin->backgroundState != BackgroundPixmap)
+        return TRUE;
+
+    /* ParentRelative inferiors paint the background they inherit, those
+     * with background None paint nothing
+     */
+    for (pChild = pWin->firstChild; pChild && !found; pChild = pChild->nextSib)
+        TraverseTree(pChild, compFindBackgroundNone, &found);
+
+    return found;
+}
+
+/*
+ * Whether the window pixmap can be reshaped to w x h in place: its
+ * storage must be large enough without wasting more than three quarters
+ * of it, and nobody else may hold on to it, as they'd see its size change.
+ * Growing also uncovers stale bits, which are only hidden if the window
+ * and all its inferiors paint a background when exposed.
+ */
+static Bool
+compPixmapFits(WindowPtr pWin, PixmapPtr pPixmap, int w, int h)
+{
+    CompWindowPtr cw = GetCompWindow(pWin);
+
+    if (pPixmap->refcnt != 1 ||
+        w > cw->pixmapWidth || h > cw->pixmapHeight ||
+        (uint64_t) w * h * 4 < (uint64_t) cw->pixmapWidth * cw->pixmapHeight)
+        return FALSE;
+
+    return (w <= pPixmap->drawable.width && h <= pPixmap->drawable.height) ||
+        !compExposeLeavesUnpainted(pWin);
+}
+
+/*
+ * Pixmaps in system memory are allocated with the headroom of their size
+ * class and then trimmed to the window size, so that resizing the window
+ * a little can keep using the same pixmap.  Other pixmaps (like those of
+ * accelerated drivers) can't be reshaped, and are allocated exactly.
+ */
 static PixmapPtr
-compNewPixmap(WindowPtr pWin, int x, int y, int w, int h)
+compCreateBackingPixmap(WindowPtr pWin, int w, int h)
 {
     ScreenPtr pScreen = pWin->drawable.pScreen;
-    WindowPtr pParent = pWin->parent;
+    CompScreenPtr cs = GetCompScreen(pScreen);
+    CompWindowPtr cw = GetCompWindow(pWin);
+    int cap_w = compPixmapSizeClass(w);
+    int cap_h = compPixmapSizeClass(h);
     PixmapPtr pPixmap;
 
+    if (!cs->noPixmapHeadroom &&
+        pScreen->ModifyPixmapHeader == miModifyPixmapHeader &&
+        (cap_w != w || cap_h != h)) {
+        pPixmap = (*pScreen->CreatePixmap) (pScreen, cap_w, cap_h,
+                                            pWin->drawable.depth,
+                                            CREATE_PIXMAP_USAGE_BACKING_PIXMAP);
+        if (pPixmap && pPixmap->devPrivate.ptr) {
+            (*pScreen->ModifyPixmapHeader) (pPixmap, w, h, 0, 0, 0, NULL);
+            cw->pixmapWidth = cap_w;
+            cw->pixmapHeight = cap_h;
+            return pPixmap;
+        }
+        if (pPixmap) {
+            /* Not in memory, and it won't be for the next one either */
+            dixDestroyPixmap(pPixmap, 0);
+            cs->noPixmapHeadroom = TRUE;
+        }
+    }
+
     pPixmap = (*pScreen->CreatePixmap) (pScreen, w, h, pWin->drawable.depth,
                                         CREATE_PIXMAP_USAGE_BACKING_PIXMAP);
+    if (pPixmap) {
+        cw->pixmapWidth = 0;
+        cw->pixmapHeight = 0;
+    }
+    return pPixmap;
+}
+
+static PixmapPtr
+compNewPixmap(WindowPtr pWin, int x, int y, int w, int h, Bool copy)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    WindowPtr pParent = pWin->parent;
+    PixmapPtr pPixmap;
+
+    pPixmap = compCreateBackingPixmap(pWin, w, h);
 
     if (!pPixmap)
         return 0;
@@ -545,6 +661,9 @@ compNewPixmap(WindowPtr pWin, int x, int y, int w, int h)
     pPixmap->screen_x = x;
     pPixmap->screen_y = y;
 
+    if (!copy)
+        return pPixmap;
+
     if (pParent->drawable.depth == pWin->drawable.depth) {
         GCPtr pGC = GetScratchGC(pWin->drawable.depth, pScreen);
 
@@ -599,14 +718,21 @@ compNewPixmap(WindowPtr pWin, int x, int y, int w, int h)
 }
 
 Bool
-compAllocPixmap(WindowPtr pWin)
+compAllocPixmap(WindowPtr pWin, Bool mapping)
 {
     int bw = (int) pWin->borderWidth;
     int x = pWin->drawable.x - bw;
     int y = pWin->drawable.y - bw;
     int w = pWin->drawable.width + (bw << 1);
     int h = pWin->drawable.height + (bw << 1);
-    PixmapPtr pPixmap = compNewPixmap(pWin, x, y, w, h);
+    /*
+     * The parent contents stand in for what the window would show until
+     * it's painted.  A window being mapped gets all of it exposed, which
+     * paints over them, unless it or one of its mapped inferiors has
+     * background None.
+     */
+    Bool copy = !mapping || compExposeLeavesUnpainted(pWin);
+    PixmapPtr pPixmap = compNewPixmap(pWin, x, y, w, h, copy);
     CompWindowPtr cw = GetCompWindow(pWin);
     Bool status;
 
@@ -664,22 +790,24 @@ compSetParentPixmap(WindowPtr pWin)
 }
 
 /*
- * Make sure the pixmap is the right size and offset.  Allocate a new
- * pixmap to change size, adjust origin to change offset, leaving the
- * old pixmap in cw->pOldPixmap so bits can be recovered
+ * Make sure the pixmap is the right size and offset.  Reshape the pixmap
+ * or allocate a new one to change size, adjust origin to change offset,
+ * leaving a replaced pixmap in cw->pOldPixmap so bits can be recovered
  */
 Bool
 compReallocPixmap(WindowPtr pWin, int draw_x, int draw_y,
                   unsigned int w, unsigned int h, int bw)
 {
     ScreenPtr pScreen = pWin->drawable.pScreen;
-    PixmapPtr pOld = (*pScreen->GetWindowPixmap) (pWin);
+    PixmapPtr pOld;
     PixmapPtr pNew;
     CompWindowPtr cw = GetCompWindow(pWin);
     int pix_x, pix_y;
     int pix_w, pix_h;
 
     assert(cw);
+    compRestoreScanout(pWin);
+    pOld = (*pScreen->GetWindowPixmap) (pWin);
     assert(pWin->redirectDraw != RedirectDrawNone);
     cw->oldx = pOld->screen_x;
     cw->oldy = pOld->screen_y;
@@ -688,11 +816,24 @@ compReallocPixmap(WindowPtr pWin, int draw_x, int draw_y,
     pix_w = w + (bw << 1);
     pix_h = h + (bw << 1);
     if (pix_w != pOld->drawable.width || pix_h != pOld->drawable.height) {
-        pNew = compNewPixmap(pWin, pix_x, pix_y, pix_w, pix_h);
-        if (!pNew)
-            return FALSE;
-        cw->pOldPixmap = pOld;
-        compSetPixmap(pWin, pNew, bw);
+        if (compPixmapFits(pWin, pOld, pix_w, pix_h)) {
+            /*
+             * Reshape it instead.  The bits stay where they were, which
+             * CopyWindow sorts out just like for moves.
+             */
+            (*pScreen->ModifyPixmapHeader) (pOld, pix_w, pix_h,
+                                            0, 0, 0, NULL);
+            pOld->drawable.serialNumber = NEXT_SERIAL_NUMBER;
+            pNew = pOld;
+            cw->pOldPixmap = 0;
+        }
+        else {
+            pNew = compNewPixmap(pWin, pix_x, pix_y, pix_w, pix_h, TRUE);
+            if (!pNew)
+                return FALSE;
+            cw->pOldPixmap = pOld;
+            compSetPixmap(pWin, pNew, bw);
+        }
     }
     else {
         pNew = pOld;
@@ -702,3 +843,113 @@ compReallocPixmap(WindowPtr pWin, int draw_x, int draw_y,
     pNew->screen_y = pix_y;
     return TRUE;
 }
+
+CallbackListPtr CompositeScanoutRestoreCallback;
+
+/*
+ * Direct scanout.  An automatically redirected top-level window which
+ * covers the whole screen, with nothing on top of it, is copied to the
+ * screen unchanged; Present may then flip a pixmap into it instead.
+ * The flipped pixmap takes the place of the window pixmap, so rendering
+ * and Damage keep reaching the window (and anyone watching it) while the
+ * automatic update has nothing left to copy.  Manually redirected
+ * windows are shown however the compositing manager likes, so those
+ * are left alone.
+ */
+Bool
+CompositeCanScanoutWindow(WindowPtr pWin)
+{
+    CompWindowPtr cw = GetCompWindow(pWin);
+    WindowPtr pParent = pWin->parent;
+    PixmapPtr pPixmap;
+
+    if (!cw || pWin->redirectDraw != RedirectDrawAutomatic)
+        return FALSE;
+
+    if (!pParent || pParent->parent || pWin->borderWidth ||
+        pWin->drawable.depth != pParent->drawable.depth)
+        return FALSE;
+
+    /*
+     * A named window pixmap (NameWindowPixmap) has to keep receiving
+     * the window contents, so it must not be swapped out for a flip.
+     */
+    pPixmap = cw->pScanoutSaved ? cw->pScanoutSaved :
+        (*pWin->drawable.pScreen->GetWindowPixmap) (pWin);
+    if (pPixmap->refcnt > 1)
+        return FALSE;
+
+    return RegionEqual(&cw->borderClip, &pParent->winSize);
+}
+
+/*
+ * Puts the window's own pixmap back, with the contents of the pixmap
+ * last shown in its place.  Returns FALSE if the window wasn't in
+ * direct scanout.
+ */
+static Bool
+compRestoreScanoutPixmap(WindowPtr pWin)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    CompWindowPtr cw = GetCompWindow(pWin);
+    PixmapPtr pScanout, pPixmap;
+    GCPtr pGC;
+
+    if (!cw || !cw->pScanoutSaved)
+        return FALSE;
+
+    pScanout = (*pScreen->GetWindowPixmap) (pWin);
+    pPixmap = cw->pScanoutSaved;
+    cw->pScanoutSaved = NullPixmap;
+
+    pGC = GetScratchGC(pPixmap->drawable.depth, pScreen);
+    if (pGC) {
+        ValidateGC(&pPixmap->drawable, pGC);
+        (void) (*pGC->ops->CopyArea) (&pScanout->drawable,
+                                      &pPixmap->drawable, pGC, 0, 0,
+                                      min(pScanout->drawable.width,
+                                          pPixmap->drawable.width),
+                                      min(pScanout->drawable.height,
+                                          pPixmap->drawable.height),
+                                      0, 0);
+        FreeScratchGC(pGC);
+    }
+
+    compSetPixmap(pWin, pPixmap, pWin->borderWidth);
+    return TRUE;
+}
+
+/*
+ * Shows @pPixmap in the window, keeping its own pixmap aside.  A NULL
+ * pixmap ends direct scanout again.
+ */
+void
+CompositeSetScanoutPixmap(WindowPtr pWin, PixmapPtr pPixmap)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    CompWindowPtr cw = GetCompWindow(pWin);
+
+    if (!pPixmap) {
+        compRestoreScanoutPixmap(pWin);
+        return;
+    }
+
+    if (!cw || pWin->redirectDraw == RedirectDrawNone)
+        return;
+
+    if (!cw->pScanoutSaved)
+        cw->pScanoutSaved = (*pScreen->GetWindowPixmap) (pWin);
+    compSetPixmap(pWin, pPixmap, pWin->borderWidth);
+}
+
+/*
+ * Ends direct scanout before anything else here touches the window
+ * pixmap.  Present still takes the window for flipped, so it is told
+ * to stop flipping it.
+ */
+void
+compRestoreScanout(WindowPtr pWin)
+{
+    if (compRestoreScanoutPixmap(pWin))
+        CallCallbacks(&CompositeScanoutRestoreCallback, pWin);
+}
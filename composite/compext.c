@@ -226,6 +226,9 @@ SingleCompositeNameWindowPixmap(ClientPtr client, xCompositeNameWindowPixmapReq
     if (!cw)
         return BadMatch;
 
+    /* Name the window's own pixmap, not one Present flipped into it */
+    compRestoreScanout(pWin);
+
     PixmapPtr pPixmap = pScreen->GetWindowPixmap(pWin);
     if (!pPixmap)
         return BadMatch;
@@ -742,6 +745,7 @@ ProcCompositeNameWindowPixmap(ClientPtr client)
             return BadMatch;
         }
 
+        compRestoreScanout(pWin);
         pPixmap = (*pWin->drawable.pScreen->GetWindowPixmap) (pWin);
         if (!pPixmap) {
             free(newPix);
@@ -844,7 +848,8 @@ ProcCompositeGetOverlayWindow(ClientPtr client)
             overlayWin->info[walkScreenIdx].id = cs->pOverlayWin->drawable.id;
         });
 
-        AddResource(overlayWin->info[0].id, XRT_WINDOW, overlayWin);
+        if (AddResource(overlayWin->info[0].id, XRT_WINDOW, overlayWin))
+            XineramaLinkWindow(overlayWin);
     }
 
     cs = GetCompScreen(dixGetMasterScreen());
@@ -96,6 +96,9 @@ typedef struct _CompWindow {
     int oldx;
     int oldy;
     PixmapPtr pOldPixmap;
+    PixmapPtr pScanoutSaved;    /* own pixmap during direct scanout */
+    int pixmapWidth;            /* storage size of the pixmap, or 0 */
+    int pixmapHeight;
     int borderClipX, borderClipY;
 } CompWindowRec, *CompWindowPtr;
 
@@ -155,6 +158,7 @@ typedef struct _CompScreen {
     ChangeWindowAttributesProcPtr ChangeWindowAttributes;
 
     Bool pendingScreenUpdate;
+    Bool noPixmapHeadroom;
 
     int numAlternateVisuals;
     VisualID *alternateVisuals;
@@ -219,7 +223,7 @@ int
  compUnredirectOneSubwindow(WindowPtr pParent, WindowPtr pWin);
 
 Bool
- compAllocPixmap(WindowPtr pWin);
+ compAllocPixmap(WindowPtr pWin, Bool mapping);
 
 void
  compSetParentPixmap(WindowPtr pWin);
@@ -234,6 +238,9 @@ compReallocPixmap(WindowPtr pWin, int x, int y,
 
 void compMarkAncestors(WindowPtr pWin);
 
+void
+ compRestoreScanout(WindowPtr pWin);
+
 /*
  * compinit.c
  */
@@ -275,7 +282,7 @@ void
  compSetPixmap(WindowPtr pWin, PixmapPtr pPixmap, int bw);
 
 Bool
- compCheckRedirect(WindowPtr pWin);
+ compCheckRedirect(WindowPtr pWin, Bool mapping);
 
 void compWindowPosition(CallbackListPtr *pcbl,
                         ScreenPtr pScreen,
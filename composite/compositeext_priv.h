@@ -8,10 +8,22 @@
 
 #include <X11/X.h>
 
+#include "pixmap.h"
 #include "screenint.h"
+#include "window.h"
 
 Bool CompositeIsImplicitRedirectException(ScreenPtr pScreen,
                                           XID parentVisual,
                                           XID winVisual);
 
+/* Direct scanout of redirected windows, for Present flips */
+Bool CompositeCanScanoutWindow(WindowPtr pWin);
+void CompositeSetScanoutPixmap(WindowPtr pWin, PixmapPtr pPixmap);
+
+/*
+ * Called with the window when Composite ends direct scanout on its own,
+ * e.g. to name, reallocate or unredirect the window pixmap.
+ */
+extern CallbackListPtr CompositeScanoutRestoreCallback;
+
 #endif /* _XSERVER_COMPOSITEEXT_PRIV_H_ */
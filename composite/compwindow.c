@@ -153,7 +153,7 @@ compSetPixmap(WindowPtr pWindow, PixmapPtr pPixmap, int bw)
 }
 
 Bool
-compCheckRedirect(WindowPtr pWin)
+compCheckRedirect(WindowPtr pWin, Bool mapping)
 {
     CompWindowPtr cw = GetCompWindow(pWin);
     CompScreenPtr cs = GetCompScreen(pWin->drawable.pScreen);
@@ -171,11 +171,13 @@ compCheckRedirect(WindowPtr pWin)
 
     if (should != (pWin->redirectDraw != RedirectDrawNone)) {
         if (should)
-            return compAllocPixmap(pWin);
+            return compAllocPixmap(pWin, mapping);
         else {
             ScreenPtr pScreen = pWin->drawable.pScreen;
-            PixmapPtr pPixmap = (*pScreen->GetWindowPixmap) (pWin);
+            PixmapPtr pPixmap;
 
+            compRestoreScanout(pWin);
+            pPixmap = (*pScreen->GetWindowPixmap) (pWin);
             compSetParentPixmap(pWin);
             compRestoreWindow(pWin, pPixmap);
             dixDestroyPixmap(pPixmap, 0);
@@ -228,7 +230,7 @@ void compWindowPosition(CallbackListPtr *pcbl, ScreenPtr pScreen, XorgScreenWind
     /*
      * "Shouldn't need this as all possible places should be wrapped
      *
-     compCheckRedirect (pWin);
+     compCheckRedirect (pWin, FALSE);
      */
 #ifdef COMPOSITE_DEBUG
     if ((pWin->redirectDraw != RedirectDrawNone) !=
@@ -260,7 +262,7 @@ compRealizeWindow(WindowPtr pWin)
     Bool ret = TRUE;
 
     pScreen->RealizeWindow = cs->RealizeWindow;
-    compCheckRedirect(pWin);
+    compCheckRedirect(pWin, TRUE);
     if (!(*pScreen->RealizeWindow) (pWin))
         ret = FALSE;
     cs->RealizeWindow = pScreen->RealizeWindow;
@@ -277,7 +279,7 @@ compUnrealizeWindow(WindowPtr pWin)
     Bool ret = TRUE;
 
     pScreen->UnrealizeWindow = cs->UnrealizeWindow;
-    compCheckRedirect(pWin);
+    compCheckRedirect(pWin, FALSE);
     if (!(*pScreen->UnrealizeWindow) (pWin))
         ret = FALSE;
     cs->UnrealizeWindow = pScreen->UnrealizeWindow;
@@ -449,7 +451,7 @@ compReparentWindow(WindowPtr pWin, WindowPtr pPriorParent)
      * Allocate any necessary redirect pixmap
      * (this actually should never be true; pWin is always unmapped)
      */
-    compCheckRedirect(pWin);
+    compCheckRedirect(pWin, FALSE);
 
     /*
      * Reset pixmap pointers as appropriate
@@ -595,8 +597,10 @@ void compWindowDestroy(CallbackListPtr *pcbl, ScreenPtr pScreen, WindowPtr pWin)
         FreeResource(csw->clients->id, X11_RESTYPE_NONE);
 
     if (pWin->redirectDraw != RedirectDrawNone) {
-        PixmapPtr pPixmap = (*pScreen->GetWindowPixmap) (pWin);
+        PixmapPtr pPixmap;
 
+        compRestoreScanout(pWin);
+        pPixmap = (*pScreen->GetWindowPixmap) (pWin);
         compSetParentPixmap(pWin);
         dixDestroyPixmap(pPixmap, 0);
     }
@@ -653,6 +657,16 @@ compWindowUpdateAutomatic(WindowPtr pWin)
     ScreenPtr pScreen = pWin->drawable.pScreen;
     WindowPtr pParent = pWin->parent;
     PixmapPtr pSrcPixmap = (*pScreen->GetWindowPixmap) (pWin);
+
+    /*
+     * During direct scanout the window shares its pixmap with the
+     * parent, so there is nothing to copy
+     */
+    if (pSrcPixmap == (*pScreen->GetWindowPixmap) (pParent)) {
+        DamageEmpty(cw->damage);
+        return;
+    }
+
     PictFormatPtr pSrcFormat = PictureWindowFormat(pWin);
     PictFormatPtr pDstFormat = PictureWindowFormat(pWin->parent);
     int error;
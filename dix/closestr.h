@@ -67,6 +67,9 @@ typedef struct _LFWIstate {
     void *private;
 } LFWIstateRec, *LFWIstatePtr;
 
+/* Replies being recorded for the font list cache, in dixfonts.c */
+typedef struct _FontListCacheEntry *FontListCacheEntryPtr;
+
 typedef struct _LFWIclosure {
     ClientPtr client;
     int num_fpes;
@@ -78,6 +81,7 @@ typedef struct _LFWIclosure {
     int savedNumFonts;
     Bool haveSaved;
     char *savedName;
+    FontListCacheEntryPtr cacheEntry;
 } LFWIclosureRec;
 
 /* ListFonts */
@@ -92,6 +96,7 @@ typedef struct _LFclosure {
     Bool haveSaved;
     char *savedName;
     int savedNameLen;
+    FontListCacheEntryPtr cacheEntry;
 } LFclosureRec;
 
 /* PolyText */
@@ -839,6 +839,7 @@ FreeDeviceClass(int type, void **class)
             free((*t)->touches[i].sprite.spriteTrace);
             free((*t)->touches[i].listeners);
             free((*t)->touches[i].valuators);
+            free((*t)->touches[i].history);
         }
 
         free((*t)->touches);
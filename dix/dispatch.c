@@ -109,6 +109,7 @@ Equipment Corporation.
 #include "dix/input_priv.h"
 #include "dix/gc_priv.h"
 #include "dix/registry_priv.h"
+#include "dix/reqstats_priv.h"
 #include "dix/resource_priv.h"
 #include "dix/screenint_priv.h"
 #include "dix/selection_priv.h"
@@ -543,10 +544,17 @@ Dispatch(void)
                 else {
                     result = XaceHookDispatch(client, client->majorOp);
                     if (result == Success) {
+                        CARD64 start = 0;
+
+                        if (dixRequestStatsEnabled)
+                            start = GetTimeInMicros();
                         currentClient = client;
                         result =
                             (*client->requestVector[client->majorOp]) (client);
                         currentClient = NULL;
+                        if (dixRequestStatsEnabled)
+                            dixRequestStatsAdd(client,
+                                               GetTimeInMicros() - start);
                     }
                 }
                 if (!SmartScheduleSignalEnable)
@@ -2221,6 +2229,18 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
                                        IncludeInferiors);
     }
 
+    /* The screen may prefer to fetch the image asynchronously.  In that
+     * case the client has been put to sleep, and we run the request
+     * again once the image is ready.
+     */
+    if (linesPerBuf &&
+        !dixScreenRaisePrepareGetImage(client, pDraw, x, y, width, height,
+                                       format, planemask)) {
+        ResetCurrentRequest(client);
+        client->sequence--;
+        return Success;
+    }
+
     x_rpcbuf_t rpcbuf = { .swapped = client->swapped, .err_clear = TRUE };
 
     if (linesPerBuf == 0) {
@@ -3546,6 +3566,7 @@ CloseDownClient(ClientPtr client)
         TouchListenerGone(client->clientAsMask);
         GestureListenerGone(client->clientAsMask);
         FreeClientResources(client);
+        dixRequestStatsClientGone(client);
         /* Disable client ID tracking. This must be done after
          * ClientStateCallback. */
         ReleaseClientIds(client);
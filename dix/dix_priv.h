@@ -91,6 +91,7 @@ void ProcessWorkQueue(void);
 void ProcessWorkQueueZombies(void);
 
 void CloseDownClient(ClientPtr client);
+_X_EXPORT // exported for libglamoregl
 ClientPtr GetCurrentClient(void);
 void InitClient(ClientPtr client, int i, void *ospriv);
 
@@ -369,6 +370,22 @@ void dixScreenRaisePixmapDestroy(PixmapPtr pPixmap);
  */
 Bool dixScreenRaiseCreateResources(ScreenPtr pScreen);
 
+/*
+ * @brief call screen's GetImage preparation hooks
+ * @see dixScreenHookPrepareGetImage
+ * @param client the client whose GetImage request is being processed
+ * @param pDraw the drawable to fetch the image from
+ * @return FALSE if a hook put the client to sleep until the image is ready
+ *
+ * Should only be called by DoGetImage() and MIT-SHM's ShmGetImage().
+ * Always returns TRUE for swapped clients.  When FALSE is returned, the
+ * caller must reset the current request so that it's run again once the
+ * client is woken up.
+ */
+Bool dixScreenRaisePrepareGetImage(ClientPtr client, DrawablePtr pDraw,
+                                   int x, int y, int w, int h,
+                                   unsigned int format, unsigned long planemask);
+
 /*
  * @brief mark event ID as critical
  * @param event the event to add to the critical events bitmap
@@ -443,6 +460,7 @@ typedef Bool (*ClientSleepProcPtr) (ClientPtr client, void *closure);
  * @param func  called when client wakes up
  * @param closure   data passed to the callback function
  */
+_X_EXPORT // exported for libglamoregl
 Bool ClientSleep(ClientPtr pClient, ClientSleepProcPtr func, void *closure)
     _X_ATTRIBUTE_NONNULL_ARG(1,2);
 
@@ -452,6 +470,7 @@ Bool ClientSleep(ClientPtr pClient, ClientSleepProcPtr func, void *closure)
  * @param pClient   the client to signal to
  * @return TRUE on success
  */
+_X_EXPORT // exported for libglamoregl
 Bool dixClientSignal(ClientPtr pClient)
     _X_ATTRIBUTE_NONNULL_ARG(1);
 
@@ -475,6 +494,7 @@ int ClientSignalAll(ClientPtr pClient, ClientSleepProcPtr func, void *closure)
  *
  * @param pClient pointer to client structure
  */
+_X_EXPORT // exported for libglamoregl
 void ClientWakeup(ClientPtr pclient)
     _X_ATTRIBUTE_NONNULL_ARG(1);
 
@@ -61,6 +61,7 @@ Equipment Corporation.
 #include "dix/gc_priv.h"
 #include "dix/rpcbuf_priv.h"
 #include "dix/screenint_priv.h"
+#include "include/list.h"
 #include "include/swaprep.h"
 #include "os/auth.h"
 #include "os/log_priv.h"
@@ -95,6 +96,40 @@ static int size_slept_fpes = 0;
 static FontPathElementPtr *slept_fpes = (FontPathElementPtr *) 0;
 static xfont2_pattern_cache_ptr patternCache;
 
+/*
+ * Replies to ListFonts and ListFontsWithInfo, so that applications
+ * listing fonts at startup don't make the server walk the font path and
+ * open every matching font again.  The fonts in a directory are only
+ * rescanned when the font path is set, even to the same value, which
+ * empties the cache.  Lists from font servers are never cached.
+ */
+#define FONT_LIST_CACHE_ENTRIES 64
+#define FONT_LIST_CACHE_MAX_SIZE (8 * 1024 * 1024)
+
+typedef struct _FontListCacheEntry {
+    struct xorg_list list;
+    CARD8 reqType;
+    int max_names;
+    int patlen;
+    char pattern[XLFDMAXFONTNAMELEN];
+    /* ListFonts: the names as sent.  ListFontsWithInfo: a
+     * FontListCacheReplyRec, the unswapped reply and the padded name for
+     * each font. */
+    int count;
+    size_t size;
+    size_t alloc;
+    char *data;
+} FontListCacheEntryRec;
+
+typedef struct {
+    int length;
+    int namelen;
+} FontListCacheReplyRec;
+
+static struct xorg_list font_list_cache = { &font_list_cache, &font_list_cache };
+static int font_list_cache_entries;
+static size_t font_list_cache_size;
+
 static int
 FontToXError(int err)
 {
@@ -548,6 +583,132 @@ QueryFont(FontPtr pFont, xQueryFontReply * pReply, int nProtoCCIStructs)
     return;
 }
 
+static void
+FontListCacheFree(FontListCacheEntryPtr entry)
+{
+    if (!entry)
+        return;
+    free(entry->data);
+    free(entry);
+}
+
+static void
+FontListCacheRemove(FontListCacheEntryPtr entry)
+{
+    xorg_list_del(&entry->list);
+    font_list_cache_entries--;
+    font_list_cache_size -= entry->size;
+    FontListCacheFree(entry);
+}
+
+static void
+EmptyFontListCache(void)
+{
+    FontListCacheEntryPtr entry, tmp;
+
+    xorg_list_for_each_entry_safe(entry, tmp, &font_list_cache, list)
+        FontListCacheRemove(entry);
+}
+
+static FontListCacheEntryPtr
+FontListCacheFind(CARD8 reqType, unsigned char *pattern, int patlen,
+                  int max_names)
+{
+    FontListCacheEntryPtr entry;
+
+    xorg_list_for_each_entry(entry, &font_list_cache, list) {
+        if (entry->reqType == reqType && entry->max_names == max_names &&
+            entry->patlen == patlen &&
+            !memcmp(entry->pattern, pattern, patlen)) {
+            /* Most recently used first */
+            xorg_list_del(&entry->list);
+            xorg_list_add(&entry->list, &font_list_cache);
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * A new entry to record the reply in, or NULL if it can't be cached.
+ * Only font directories and the built-in fonts are cached.
+ */
+static FontListCacheEntryPtr
+FontListCacheStart(CARD8 reqType, unsigned char *pattern, int patlen,
+                   int max_names)
+{
+    FontListCacheEntryPtr entry;
+
+    for (int i = 0; i < num_fpes; i++) {
+        const char *name = font_path_elements[i]->name;
+
+        if (name[0] != '/' && strcmp(name, "built-ins") != 0)
+            return NULL;
+    }
+
+    entry = calloc(1, sizeof(*entry));
+    if (!entry)
+        return NULL;
+
+    entry->reqType = reqType;
+    entry->max_names = max_names;
+    entry->patlen = patlen;
+    memcpy(entry->pattern, pattern, patlen);
+    return entry;
+}
+
+/* Gives up on the entry if the reply gets too large to keep */
+static void
+FontListCacheAppend(FontListCacheEntryPtr *pEntry, const void *data,
+                    size_t size)
+{
+    FontListCacheEntryPtr entry = *pEntry;
+
+    if (!entry || !size)
+        return;
+
+    if (entry->size + size > entry->alloc) {
+        size_t alloc = max(entry->alloc * 2, 4096);
+        char *grown;
+
+        while (alloc < entry->size + size)
+            alloc *= 2;
+        grown = alloc <= FONT_LIST_CACHE_MAX_SIZE ?
+            realloc(entry->data, alloc) : NULL;
+        if (!grown) {
+            FontListCacheFree(entry);
+            *pEntry = NULL;
+            return;
+        }
+        entry->data = grown;
+        entry->alloc = alloc;
+    }
+
+    memcpy(entry->data + entry->size, data, size);
+    entry->size += size;
+}
+
+static void
+FontListCacheInsert(FontListCacheEntryPtr *pEntry)
+{
+    FontListCacheEntryPtr entry = *pEntry;
+
+    if (!entry)
+        return;
+    *pEntry = NULL;
+
+    while (!xorg_list_is_empty(&font_list_cache) &&
+           (font_list_cache_entries >= FONT_LIST_CACHE_ENTRIES ||
+            font_list_cache_size + entry->size > FONT_LIST_CACHE_MAX_SIZE))
+        FontListCacheRemove(xorg_list_last_entry(&font_list_cache,
+                                                 FontListCacheEntryRec, list));
+
+    xorg_list_add(&entry->list, &font_list_cache);
+    font_list_cache_entries++;
+    font_list_cache_size += entry->size;
+}
+
 static Bool
 doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
 {
@@ -558,6 +719,12 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
     int namelen, resolvedlen;
     int aliascount = 0;
 
+    /* Back from waiting for a font server */
+    if (ClientIsAsleep(client)) {
+        FontListCacheFree(c->cacheEntry);
+        c->cacheEntry = NULL;
+    }
+
     if (client->clientGone) {
         if (c->current.current_fpe < c->num_fpes) {
             fpe = c->fpe_list[c->current.current_fpe];
@@ -742,9 +909,13 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
         if (names->length[i] > 255)
             rep.nFonts--;
         else {
+            CARD8 len = names->length[i];
+
             /* write a pascal string */
-            x_rpcbuf_write_CARD8(&rpcbuf, names->length[i]);
+            x_rpcbuf_write_CARD8(&rpcbuf, len);
             x_rpcbuf_write_CARD8s(&rpcbuf, (CARD8*)names->names[i], names->length[i]);
+            FontListCacheAppend(&c->cacheEntry, &len, 1);
+            FontListCacheAppend(&c->cacheEntry, names->names[i], len);
         }
     }
 
@@ -753,6 +924,11 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
         goto bail;
     }
 
+    if (c->cacheEntry) {
+        c->cacheEntry->count = rep.nFonts;
+        FontListCacheInsert(&c->cacheEntry);
+    }
+
     if (client->swapped) {
         swaps(&rep.nFonts);
     }
@@ -765,18 +941,39 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
         FreeFPE(c->fpe_list[i]);
     free(c->fpe_list);
     free(c->savedName);
+    FontListCacheFree(c->cacheEntry);
     xfont2_free_font_names(names);
     free(c);
     free(resolved);
     return TRUE;
 }
 
+static int
+SendCachedListFonts(ClientPtr client, FontListCacheEntryPtr entry)
+{
+    xListFontsReply rep = {
+        .nFonts = entry->count,
+    };
+
+    x_rpcbuf_t rpcbuf = { .swapped = client->swapped, .err_clear = TRUE };
+    x_rpcbuf_write_CARD8s(&rpcbuf, (CARD8 *) entry->data, entry->size);
+    if (rpcbuf.error)
+        return BadAlloc;
+
+    if (client->swapped) {
+        swaps(&rep.nFonts);
+    }
+
+    return X_SEND_REPLY_WITH_RPCBUF(client, rep, rpcbuf);
+}
+
 int
 ListFonts(ClientPtr client, unsigned char *pattern, unsigned length,
           unsigned max_names)
 {
     int access;
     LFclosurePtr c;
+    FontListCacheEntryPtr entry;
 
     /*
      * The right error to return here would be BadName, however the
@@ -791,6 +988,9 @@ ListFonts(ClientPtr client, unsigned char *pattern, unsigned length,
     if (access != Success)
         return access;
 
+    if ((entry = FontListCacheFind(X_ListFonts, pattern, length, max_names)))
+        return SendCachedListFonts(client, entry);
+
     if (!(c = calloc(1, sizeof *c)))
         return BadAlloc;
     c->fpe_list = calloc(num_fpes, sizeof(FontPathElementPtr));
@@ -818,10 +1018,80 @@ ListFonts(ClientPtr client, unsigned char *pattern, unsigned length,
     c->current.private = 0;
     c->haveSaved = FALSE;
     c->savedName = 0;
+    c->cacheEntry = FontListCacheStart(X_ListFonts, pattern, length, max_names);
     doListFontsAndAliases(client, c);
     return Success;
 }
 
+/* Sends one of the replies to ListFontsWithInfo, swapping it in place */
+static void
+WriteListFontsWithInfoReply(ClientPtr client, xListFontsWithInfoReply *reply,
+                            int length, const char *name, int namelen)
+{
+    reply->sequenceNumber = client->sequence;
+    if (client->swapped) {
+        swaps(&reply->sequenceNumber);
+        swapl(&reply->length);
+        unsigned nprops = reply->nFontProps;
+
+        /* from SwapInfo() */
+        swaps(&reply->minCharOrByte2);
+        swaps(&reply->maxCharOrByte2);
+        swaps(&reply->defaultChar);
+        swaps(&reply->nFontProps);
+        swaps(&reply->fontAscent);
+        swaps(&reply->fontDescent);
+        swapl(&reply->nReplies);
+
+        /* from SwapCharInfo */
+        swaps(&reply->minBounds.leftSideBearing);
+        swaps(&reply->minBounds.rightSideBearing);
+        swaps(&reply->minBounds.characterWidth);
+        swaps(&reply->minBounds.ascent);
+        swaps(&reply->minBounds.descent);
+        swaps(&reply->minBounds.attributes);
+
+        /* from SwapCharInfo */
+        swaps(&reply->maxBounds.leftSideBearing);
+        swaps(&reply->maxBounds.rightSideBearing);
+        swaps(&reply->maxBounds.characterWidth);
+        swaps(&reply->maxBounds.ascent);
+        swaps(&reply->maxBounds.descent);
+        swaps(&reply->maxBounds.attributes);
+
+        char *pby = (char *) &reply[1];
+        /* Font properties are an atom and either an int32 or a CARD32, so
+         * they are always 2 4 byte values */
+        for (unsigned i = 0; i < nprops; i++) {
+            swapl((int *) pby);
+            pby += 4;
+            swapl((int *) pby);
+            pby += 4;
+        }
+    }
+    WriteToClient(client, length, reply);
+    WriteToClient(client, namelen, name);
+}
+
+static void
+FontListCacheAppendReply(FontListCacheEntryPtr *pEntry,
+                         const xListFontsWithInfoReply *reply, int length,
+                         const char *name, int namelen)
+{
+    static const char pad[4];
+    FontListCacheReplyRec header = {
+        .length = length,
+        .namelen = namelen,
+    };
+
+    FontListCacheAppend(pEntry, &header, sizeof(header));
+    FontListCacheAppend(pEntry, reply, length);
+    FontListCacheAppend(pEntry, name, namelen);
+    FontListCacheAppend(pEntry, pad, pad_to_int32(namelen) - namelen);
+    if (*pEntry)
+        (*pEntry)->count++;
+}
+
 static int
 doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
 {
@@ -836,6 +1106,12 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
     xFontProp *pFP;
     int aliascount = 0;
 
+    /* Back from waiting for a font server */
+    if (ClientIsAsleep(client)) {
+        FontListCacheFree(c->cacheEntry);
+        c->cacheEntry = NULL;
+    }
+
     if (client->clientGone) {
         if (c->current.current_fpe < c->num_fpes) {
             fpe = c->fpe_list[c->current.current_fpe];
@@ -964,7 +1240,6 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
             reply->length =
                 X_REPLY_HEADER_UNITS(xListFontsWithInfoReply)
                 + bytes_to_int32(pFontInfo->nprops*sizeof(xFontProp)+namelen);
-            reply->sequenceNumber = client->sequence;
             reply->nameLength = namelen;
             reply->minBounds = pFontInfo->ink_minbounds;
             reply->maxBounds = pFontInfo->ink_maxbounds;
@@ -985,48 +1260,9 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
                 pFP->value = pFontInfo->props[i].value;
                 pFP++;
             }
-            if (client->swapped) {
-                swaps(&reply->sequenceNumber);
-                swapl(&reply->length);
-                unsigned nprops = reply->nFontProps;
-
-                /* from SwapInfo() */
-                swaps(&reply->minCharOrByte2);
-                swaps(&reply->maxCharOrByte2);
-                swaps(&reply->defaultChar);
-                swaps(&reply->nFontProps);
-                swaps(&reply->fontAscent);
-                swaps(&reply->fontDescent);
-                swapl(&reply->nReplies);
-
-                /* from SwapCharInfo */
-                swaps(&reply->minBounds.leftSideBearing);
-                swaps(&reply->minBounds.rightSideBearing);
-                swaps(&reply->minBounds.characterWidth);
-                swaps(&reply->minBounds.ascent);
-                swaps(&reply->minBounds.descent);
-                swaps(&reply->minBounds.attributes);
-
-                /* from SwapCharInfo */
-                swaps(&reply->maxBounds.leftSideBearing);
-                swaps(&reply->maxBounds.rightSideBearing);
-                swaps(&reply->maxBounds.characterWidth);
-                swaps(&reply->maxBounds.ascent);
-                swaps(&reply->maxBounds.descent);
-                swaps(&reply->maxBounds.attributes);
-
-                char *pby = (char *) &reply[1];
-                /* Font properties are an atom and either an int32 or a CARD32, so
-                 * they are always 2 4 byte values */
-                for (unsigned i = 0; i < nprops; i++) {
-                    swapl((int *) pby);
-                    pby += 4;
-                    swapl((int *) pby);
-                    pby += 4;
-                }
-            }
-            WriteToClient(client, length, reply);
-            WriteToClient(client, namelen, name);
+            FontListCacheAppendReply(&c->cacheEntry, reply, length,
+                                     name, namelen);
+            WriteListFontsWithInfoReply(client, reply, length, name, namelen);
             if (pFontInfo == &fontInfo) {
                 free(fontInfo.props);
                 free(fontInfo.isStringProp);
@@ -1035,6 +1271,9 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
         }
     }
  finish: ;
+    if (err == Successful)
+        FontListCacheInsert(&c->cacheEntry);
+
     /* finish it the replies series sending an empty reply */
     xListFontsWithInfoReply rep = { 0 };
     X_SEND_REPLY_SIMPLE(client, rep);
@@ -1045,16 +1284,57 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
     free(c->reply);
     free(c->fpe_list);
     free(c->savedName);
+    FontListCacheFree(c->cacheEntry);
     free(c);
     return TRUE;
 }
 
+static int
+SendCachedListFontsWithInfo(ClientPtr client, FontListCacheEntryPtr entry)
+{
+    xListFontsWithInfoReply *reply = NULL;
+    char *data = entry->data;
+    int size = 0;
+
+    for (int i = 0; i < entry->count; i++) {
+        FontListCacheReplyRec header;
+
+        memcpy(&header, data, sizeof(header));
+        data += sizeof(header);
+
+        /* The reply is swapped in place, keep the cached one as it is */
+        if (header.length > size) {
+            xListFontsWithInfoReply *grown = realloc(reply, header.length);
+
+            if (!grown) {
+                free(reply);
+                return BadAlloc;
+            }
+            reply = grown;
+            size = header.length;
+        }
+        memcpy(reply, data, header.length);
+        data += header.length;
+
+        WriteListFontsWithInfoReply(client, reply, header.length,
+                                    data, header.namelen);
+        data += pad_to_int32(header.namelen);
+    }
+    free(reply);
+
+    /* finish it the replies series sending an empty reply */
+    xListFontsWithInfoReply rep = { 0 };
+    X_SEND_REPLY_SIMPLE(client, rep);
+    return Success;
+}
+
 int
 StartListFontsWithInfo(ClientPtr client, int length, unsigned char *pattern,
                        int max_names)
 {
     int access;
     LFWIclosurePtr c;
+    FontListCacheEntryPtr entry;
 
     /*
      * The right error to return here would be BadName, however the
@@ -1069,6 +1349,10 @@ StartListFontsWithInfo(ClientPtr client, int length, unsigned char *pattern,
     if (access != Success)
         return access;
 
+    if ((entry = FontListCacheFind(X_ListFontsWithInfo, pattern, length,
+                                   max_names)))
+        return SendCachedListFontsWithInfo(client, entry);
+
     if (!(c = calloc(1, sizeof *c)))
         goto badAlloc;
     c->fpe_list = calloc(num_fpes, sizeof(FontPathElementPtr));
@@ -1093,6 +1377,8 @@ StartListFontsWithInfo(ClientPtr client, int length, unsigned char *pattern,
     c->savedNumFonts = 0;
     c->haveSaved = FALSE;
     c->savedName = 0;
+    c->cacheEntry = FontListCacheStart(X_ListFontsWithInfo, pattern, length,
+                                       max_names);
     doListFontsWithInfo(client, c);
     return Success;
  badAlloc:
@@ -1673,6 +1959,7 @@ SetFontPathElements(int npaths, unsigned char *paths, int *bad, Bool persist)
     font_path_elements = fplist;
     if (patternCache)
         xfont2_empty_font_pattern_cache(patternCache);
+    EmptyFontListCache();
     num_fpes = valid_paths;
 
     return Success;
@@ -1895,6 +2182,7 @@ FreeFonts(void)
         xfont2_free_font_pattern_cache(patternCache);
         patternCache = 0;
     }
+    EmptyFontListCache();
     FreeFontPath(font_path_elements, num_fpes, TRUE);
     font_path_elements = 0;
     num_fpes = 0;
@@ -54,6 +54,7 @@ SOFTWARE.
 #include "include/cursor.h"
 #include "include/input.h"
 #include "include/inputstr.h"
+#include "include/eventstr.h"
 
 typedef struct _DDXTouchPointInfo {
     uint32_t client_id;         /* touch ID as seen in client events */
@@ -173,6 +174,30 @@ TouchPointInfoPtr TouchBeginTouch(DeviceIntPtr dev,
                                   Bool emulate_pointer);
 TouchPointInfoPtr TouchFindByClientID(DeviceIntPtr dev, uint32_t client_id);
 void TouchEndTouch(DeviceIntPtr dev, TouchPointInfoPtr ti);
+/**
+ * Event history of a touchpoint, replayed to the next listener when the
+ * owner rejects the touch. The first event is stored in full, all
+ * following TouchUpdate events are stored delta-encoded: only the axis
+ * values that changed from the previous event are kept.
+ *
+ * The history is allocated once per touchpoint and reused for each touch
+ * sequence, recording only starts with TouchEventHistoryAllocate().
+ */
+typedef struct _TouchHistory {
+    Bool recording;             /* events are being stored */
+    size_t elements;            /* number of events, including first */
+    DeviceEvent first;          /* first event, usually the TouchBegin */
+    /* encoder state: axis values after and before the last update */
+    uint8_t known[(MAX_VALUATORS + 7) / 8];
+    double values[MAX_VALUATORS];
+    uint8_t base_known[(MAX_VALUATORS + 7) / 8];
+    double base[MAX_VALUATORS];
+    size_t last;                /* offset of the last update in updates */
+    size_t used;                /* bytes used in updates */
+    size_t size;                /* bytes allocated for updates */
+    unsigned char updates[];    /* TouchHistoryUpdate + changed values */
+} TouchHistoryRec, *TouchHistoryPtr;
+
 Bool TouchEventHistoryAllocate(TouchPointInfoPtr ti);
 void TouchEventHistoryFree(TouchPointInfoPtr ti);
 void TouchEventHistoryPush(TouchPointInfoPtr ti, const DeviceEvent *ev);
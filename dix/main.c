@@ -92,6 +92,7 @@ Equipment Corporation.
 #include "dix/input_priv.h"
 #include "dix/gc_priv.h"
 #include "dix/registry_priv.h"
+#include "dix/reqstats_priv.h"
 #include "dix/selection_priv.h"
 #include "os/audit.h"
 #include "os/auth.h"
@@ -295,6 +296,7 @@ dix_main(int argc, char *argv[], char *envp[])
         if (screenIsSaved == SCREEN_SAVER_ON)
             dixSaveScreens(serverClient, SCREEN_SAVER_OFF, ScreenSaverReset);
         FreeScreenSaverTimer();
+        dixResetRequestStats();
         CloseDownExtensions();
 
 #ifdef XINERAMA
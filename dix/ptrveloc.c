@@ -434,6 +434,7 @@ InitTrackers(DeviceVelocityPtr vel, int ntracker)
     free(vel->tracker);
     vel->tracker = (MotionTrackerPtr) calloc(ntracker, sizeof(MotionTracker));
     vel->num_tracker = ntracker;
+    vel->cur_tracker = 0;
 }
 
 enum directions {
@@ -555,22 +556,35 @@ GetDirection(int dx, int dy)
 #define TRACKER_INDEX(s, d) (((s)->num_tracker + (s)->cur_tracker - (d)) % (s)->num_tracker)
 #define TRACKER(s, d) &(s)->tracker[TRACKER_INDEX(s,d)]
 
+/* the accumulated position is rebased to 0/0 once it exceeds this, so
+ * the deltas derived from it don't lose precision */
+#define TRACKER_REBASE_LIMIT 65536.0
+
 /**
- * Add the delta motion to each tracker, then reset the latest tracker to
- * 0/0 and set it as the current one.
+ * Advance the accumulated position by the delta motion and start a new
+ * tracker at that position, making it the current one.
  */
 static inline void
 FeedTrackers(DeviceVelocityPtr vel, double dx, double dy, int cur_t)
 {
+    double x = vel->tracker[vel->cur_tracker].x + dx;
+    double y = vel->tracker[vel->cur_tracker].y + dy;
     int n;
 
-    for (n = 0; n < vel->num_tracker; n++) {
-        vel->tracker[n].dx += dx;
-        vel->tracker[n].dy += dy;
+    if (fabs(x) > TRACKER_REBASE_LIMIT || fabs(y) > TRACKER_REBASE_LIMIT) {
+        for (n = 0; n < vel->num_tracker; n++) {
+            vel->tracker[n].x -= x;
+            vel->tracker[n].y -= y;
+        }
+        x = 0.0;
+        y = 0.0;
     }
-    n = (vel->cur_tracker + 1) % vel->num_tracker;
-    vel->tracker[n].dx = 0.0;
-    vel->tracker[n].dy = 0.0;
+
+    n = vel->cur_tracker + 1;
+    if (n == vel->num_tracker)
+        n = 0;
+    vel->tracker[n].x = x;
+    vel->tracker[n].y = y;
     vel->tracker[n].time = cur_t;
     vel->tracker[n].dir = GetDirection(dx, dy);
     DebugAccelF("motion [dx: %f dy: %f dir:%d diff: %d]\n",
@@ -579,15 +593,20 @@ FeedTrackers(DeviceVelocityPtr vel, double dx, double dy, int cur_t)
     vel->cur_tracker = n;
 }
 
+#undef TRACKER_REBASE_LIMIT
+
 /**
  * calc velocity for given tracker, with
  * velocity scaling.
  * This assumes linear motion.
  */
 static double
-CalcTracker(const MotionTracker * tracker, int cur_t)
+CalcTracker(const MotionTracker * tracker, const MotionTracker * current,
+            int cur_t)
 {
-    double dist = sqrt(tracker->dx * tracker->dx + tracker->dy * tracker->dy);
+    double dx = current->x - tracker->x;
+    double dy = current->y - tracker->y;
+    double dist = sqrt(dx * dx + dy * dy);
     int dtime = cur_t - tracker->time;
 
     if (dtime > 0)
@@ -611,6 +630,7 @@ QueryTrackers(DeviceVelocityPtr vel, int cur_t)
     /* initial velocity: a low-offset, valid velocity */
     double initial_velocity = 0, result = 0, velocity_diff;
     double velocity_factor = vel->corr_mul * vel->const_acceleration;   /* premultiply */
+    const MotionTracker *current = TRACKER(vel, 0);
 
     /* loop from current to older data */
     for (offset = 1; offset < vel->num_tracker; offset++) {
@@ -640,7 +660,8 @@ QueryTrackers(DeviceVelocityPtr vel, int cur_t)
             break;
         }
 
-        tracker_velocity = CalcTracker(tracker, cur_t) * velocity_factor;
+        tracker_velocity = CalcTracker(tracker, current, cur_t) *
+                           velocity_factor;
 
         if ((initial_velocity == 0 || offset <= vel->initial_range) &&
             tracker_velocity != 0) {
@@ -676,8 +697,8 @@ QueryTrackers(DeviceVelocityPtr vel, int cur_t)
         MotionTracker *tracker = TRACKER(vel, used_offset);
 
         DebugAccelF("result: offset %i [dx: %f dy: %f diff: %i]\n",
-                    used_offset, tracker->dx, tracker->dy,
-                    cur_t - tracker->time);
+                    used_offset, current->x - tracker->x,
+                    current->y - tracker->y, cur_t - tracker->time);
 #endif
     }
     return result;
@@ -690,7 +711,8 @@ QueryTrackers(DeviceVelocityPtr vel, int cur_t)
  * Perform velocity approximation based on 2D 'mickeys' (mouse motion delta).
  * return true if non-visible state reset is suggested
  */
-static BOOL ProcessVelocityData2D(DeviceVelocityPtr vel, double dx, double dy, int time)
+BOOL
+ProcessVelocityData2D(DeviceVelocityPtr vel, double dx, double dy, int time)
 {
     double velocity;
 
@@ -976,6 +998,10 @@ NoProfile(DeviceIntPtr dev,
     return 1.0;
 }
 
+/* profiles registered by drivers, see RegisterAccelerationProfile() */
+static PointerAccelerationProfileFunc
+registeredProfiles[AccelProfileRegisteredMax];
+
 static PointerAccelerationProfileFunc
 GetAccelerationProfile(DeviceVelocityPtr vel, int profile_num)
 {
@@ -999,6 +1025,9 @@ GetAccelerationProfile(DeviceVelocityPtr vel, int profile_num)
     case AccelProfileNone:
         return NoProfile;
     default:
+        if (profile_num >= AccelProfileRegisteredFirst &&
+            profile_num < AccelProfileRegisteredFirst + AccelProfileRegisteredMax)
+            return registeredProfiles[profile_num - AccelProfileRegisteredFirst];
         return NULL;
     }
 }
@@ -1052,6 +1081,90 @@ SetDeviceSpecificAccelerationProfile(DeviceVelocityPtr vel,
         vel->deviceSpecificProfile = profile;
 }
 
+/**
+ * Register an acceleration profile at runtime, making it selectable on
+ * all devices using the predictable scheme (e.g. through the profile
+ * property) by the number returned in profile_num.
+ *
+ * Unlike the device-specific profile, a registered profile is shared by
+ * all devices. It should not rely on profile-private data.
+ *
+ * @return FALSE if no more profiles can be registered.
+ */
+Bool
+RegisterAccelerationProfile(PointerAccelerationProfileFunc profile,
+                            int *profile_num)
+{
+    int i;
+
+    BUG_RETURN_VAL(!profile, FALSE);
+
+    for (i = 0; i < AccelProfileRegisteredMax; i++) {
+        if (!registeredProfiles[i]) {
+            registeredProfiles[i] = profile;
+            *profile_num = AccelProfileRegisteredFirst + i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+ResetRegisteredProfile(DeviceIntPtr dev, int profile_num)
+{
+    for (; dev; dev = dev->next) {
+        DeviceVelocityPtr vel = GetDevicePredictableAccelData(dev);
+
+        if (vel && vel->statistics.profile_number == profile_num)
+            SetAccelerationProfile(vel, AccelProfileClassic);
+    }
+}
+
+/* Tell clients about the devices ResetRegisteredProfile() reset */
+static void
+ResetRegisteredProfileProperty(DeviceIntPtr dev, int profile_num)
+{
+    Atom prop = XIGetKnownProperty(ACCEL_PROP_PROFILE_NUMBER);
+    int profile = AccelProfileClassic;
+
+    for (; dev; dev = dev->next) {
+        XIPropertyValuePtr val;
+
+        if (!GetDevicePredictableAccelData(dev) ||
+            XIGetDeviceProperty(dev, prop, &val) != Success ||
+            val->format != 32 || val->size != 1 ||
+            *(int *) val->data != profile_num)
+            continue;
+
+        XIChangeDeviceProperty(dev, prop, XA_INTEGER, 32,
+                               PropModeReplace, 1, &profile, TRUE);
+    }
+}
+
+/**
+ * Remove a profile registered with RegisterAccelerationProfile(). Devices
+ * currently using it fall back to the classic profile, and their profile
+ * property says so.
+ */
+void
+UnregisterAccelerationProfile(int profile_num)
+{
+    int i = profile_num - AccelProfileRegisteredFirst;
+
+    if (i < 0 || i >= AccelProfileRegisteredMax)
+        return;
+
+    input_lock();
+    ResetRegisteredProfile(inputInfo.devices, profile_num);
+    ResetRegisteredProfile(inputInfo.off_devices, profile_num);
+    registeredProfiles[i] = NULL;
+    input_unlock();
+
+    ResetRegisteredProfileProperty(inputInfo.devices, profile_num);
+    ResetRegisteredProfileProperty(inputInfo.off_devices, profile_num);
+}
+
 /**
  * Use this function to obtain a DeviceVelocityPtr for a device. Will return NULL if
  * the predictable acceleration scheme is not in effect.
@@ -1104,7 +1217,20 @@ acceleratePointerPredictable(DeviceIntPtr dev, ValuatorMask *val, CARD32 evtime)
         dy = valuator_mask_get_double(val, 1);
     }
 
-    if (dx != 0.0 || dy != 0.0) {
+    if (velocitydata->statistics.profile_number == AccelProfileNone) {
+        /* Flat profile, e.g. for devices accelerated by the driver: the
+         * acceleration is always 1, so the velocity estimate is never
+         * used and only the constant deceleration remains. */
+        if (dev->ptrfeed && dev->ptrfeed->ctrl.num) {
+            if (dx != 0.0)
+                valuator_mask_set_double(val, 0,
+                                         dx * velocitydata->const_acceleration);
+            if (dy != 0.0)
+                valuator_mask_set_double(val, 1,
+                                         dy * velocitydata->const_acceleration);
+        }
+    }
+    else if (dx != 0.0 || dy != 0.0) {
         /* reset non-visible state? */
         if (ProcessVelocityData2D(velocitydata, dx, dy, evtime)) {
             soften = FALSE;
@@ -16,10 +16,14 @@ struct _DeviceVelocityRec;
 /**
  * a motion history, with just enough information to
  * calc mean velocity and decide which motion was along
- * a more or less straight line
+ * a more or less straight line.
+ *
+ * Trackers store the accumulated position of the device at their time of
+ * creation, the delta since then is the difference to the current (newest)
+ * tracker. This way, feeding a motion only touches a single tracker.
  */
 struct _MotionTracker {
-    double dx, dy;              /* accumulated delta for each axis */
+    double x, y;                /* accumulated position at creation */
     int time;                   /* time of creation */
     int dir;                    /* initial direction bitfield */
 };
@@ -47,4 +51,7 @@ void acceleratePointerLightweight(DeviceIntPtr dev, ValuatorMask *val,
 
 void InitTrackers(DeviceVelocityPtr vel, int ntracker);
 
+BOOL ProcessVelocityData2D(DeviceVelocityPtr vel, double dx, double dy,
+                           int time);
+
 #endif /* _XSERVER_POINTERVELOCITY_PRIV_H */
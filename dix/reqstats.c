@@ -0,0 +1,267 @@
+/* SPDX-License-Identifier: MIT OR X11
+ */
+
+#include <dix-config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dix/registry_priv.h"
+#include "dix/reqstats_priv.h"
+#include "os/client_priv.h"
+#include "os/log_priv.h"
+
+#include "dixstruct.h"
+#include "extnsionst.h"
+#include "misc.h"
+
+/* Latency buckets: below 1us, then one per power of two up to ~4s */
+#define REQ_STATS_BUCKETS 24
+
+typedef struct {
+    CARD64 count;
+    CARD64 usecs;
+    CARD32 hist[REQ_STATS_BUCKETS];
+} ReqStatsRec, *ReqStatsPtr;
+
+typedef struct {
+    CARD64 count[256];
+    CARD64 usecs[256];
+} ReqStatsClientRec, *ReqStatsClientPtr;
+
+Bool dixRequestStatsEnabled = FALSE;
+
+/* Allocated on first use: one entry for core requests, one per minor
+ * opcode for extensions
+ */
+static ReqStatsPtr reqStats[256];
+static ReqStatsClientPtr clientStats[MAXCLIENTS];
+
+static int
+ReqStatsBucket(CARD64 usecs)
+{
+    int bucket;
+
+    for (bucket = 0; usecs && bucket < REQ_STATS_BUCKETS - 1; bucket++)
+        usecs >>= 1;
+
+    return bucket;
+}
+
+void
+dixRequestStatsAdd(ClientPtr client, CARD64 usecs)
+{
+    int major = client->majorOp;
+    int minor = major < EXTENSION_BASE ? 0 : client->minorOp & 0xff;
+    ReqStatsClientPtr cs;
+    ReqStatsPtr rs;
+
+    if (!reqStats[major]) {
+        reqStats[major] = calloc(major < EXTENSION_BASE ? 1 : 256,
+                                 sizeof(ReqStatsRec));
+        if (!reqStats[major])
+            return;
+    }
+
+    rs = &reqStats[major][minor];
+    rs->count++;
+    rs->usecs += usecs;
+    rs->hist[ReqStatsBucket(usecs)]++;
+
+    if (client->clientGone)
+        return;
+
+    cs = clientStats[client->index];
+    if (!cs) {
+        cs = clientStats[client->index] = calloc(1, sizeof(*cs));
+        if (!cs)
+            return;
+    }
+    cs->count[major]++;
+    cs->usecs[major] += usecs;
+}
+
+void
+dixRequestStatsClientGone(ClientPtr client)
+{
+    free(clientStats[client->index]);
+    clientStats[client->index] = NULL;
+}
+
+/* Upper bound of the bucket holding the given fraction of requests */
+static CARD64
+ReqStatsPercentile(ReqStatsPtr rs, int percent)
+{
+    CARD64 want = (rs->count * percent + 99) / 100;
+    CARD64 seen = 0;
+    int bucket;
+
+    for (bucket = 0; bucket < REQ_STATS_BUCKETS - 1; bucket++) {
+        seen += rs->hist[bucket];
+        if (seen >= want)
+            break;
+    }
+
+    return (CARD64) 1 << bucket;
+}
+
+Bool
+dixGetRequestStats(int major, int minor, CARD64 *count, CARD64 *usecs,
+                   CARD64 *p50, CARD64 *p99)
+{
+    ReqStatsPtr rs;
+
+    if (major < 0 || major > 255 || !reqStats[major])
+        return FALSE;
+    if (minor < 0 || minor > (major < EXTENSION_BASE ? 0 : 255))
+        return FALSE;
+
+    rs = &reqStats[major][minor];
+    if (!rs->count)
+        return FALSE;
+
+    *count = rs->count;
+    *usecs = rs->usecs;
+    *p50 = ReqStatsPercentile(rs, 50);
+    *p99 = ReqStatsPercentile(rs, 99);
+    return TRUE;
+}
+
+Bool
+dixGetClientRequestStats(ClientPtr client, int major,
+                         CARD64 *count, CARD64 *usecs)
+{
+    ReqStatsClientPtr cs = clientStats[client->index];
+
+    if (!cs || major < 0 || major > 255 || !cs->count[major])
+        return FALSE;
+
+    *count = cs->count[major];
+    *usecs = cs->usecs[major];
+    return TRUE;
+}
+
+typedef struct {
+    int major;
+    int minor;
+    CARD64 usecs;
+} ReqStatsEntry;
+
+static int
+ReqStatsCompare(const void *a, const void *b)
+{
+    const ReqStatsEntry *ea = a, *eb = b;
+
+    if (ea->usecs != eb->usecs)
+        return ea->usecs < eb->usecs ? 1 : -1;
+    return 0;
+}
+
+static const char *
+ReqStatsName(int major, int minor)
+{
+    return major < EXTENSION_BASE ? LookupMajorName(major)
+                                  : LookupRequestName(major, minor);
+}
+
+static void
+PrintClientStats(int index)
+{
+    ReqStatsClientPtr cs = clientStats[index];
+    ClientPtr client = clients[index];
+    const char *cmd = client ? GetClientCmdName(client) : NULL;
+    int top[3] = { -1, -1, -1 };
+    CARD64 count = 0, usecs = 0;
+    int major, i;
+
+    for (major = 0; major < 256; major++) {
+        if (!cs->count[major])
+            continue;
+        count += cs->count[major];
+        usecs += cs->usecs[major];
+
+        for (i = 0; i < 3; i++) {
+            if (top[i] < 0 || cs->usecs[major] > cs->usecs[top[i]]) {
+                memmove(&top[i + 1], &top[i], (2 - i) * sizeof(int));
+                top[i] = major;
+                break;
+            }
+        }
+    }
+
+    LogMessageVerb(X_NONE, 0, "  client %d (%s): %llu requests, %llu us\n",
+                   index, cmd ? cmd : "unknown",
+                   (unsigned long long) count, (unsigned long long) usecs);
+    for (i = 0; i < 3 && top[i] >= 0; i++)
+        LogMessageVerb(X_NONE, 0, "    %s: %llu requests, %llu us\n",
+                       LookupMajorName(top[i]),
+                       (unsigned long long) cs->count[top[i]],
+                       (unsigned long long) cs->usecs[top[i]]);
+}
+
+void
+dixPrintRequestStats(void)
+{
+    ReqStatsEntry *entries;
+    int nentries = 0, major, minor, i;
+
+    if (!dixRequestStatsEnabled)
+        return;
+
+    entries = calloc(EXTENSION_BASE + (256 - EXTENSION_BASE) * 256,
+                     sizeof(*entries));
+    if (!entries)
+        return;
+
+    for (major = 0; major < 256; major++) {
+        int nminor = major < EXTENSION_BASE ? 1 : 256;
+
+        if (!reqStats[major])
+            continue;
+        for (minor = 0; minor < nminor; minor++) {
+            if (!reqStats[major][minor].count)
+                continue;
+            entries[nentries].major = major;
+            entries[nentries].minor = minor;
+            entries[nentries].usecs = reqStats[major][minor].usecs;
+            nentries++;
+        }
+    }
+    qsort(entries, nentries, sizeof(*entries), ReqStatsCompare);
+
+    LogMessage(X_INFO, "Request statistics (count, total us, average us, "
+               "p50 and p99 below us):\n");
+    for (i = 0; i < nentries; i++) {
+        ReqStatsPtr rs = &reqStats[entries[i].major][entries[i].minor];
+
+        LogMessageVerb(X_NONE, 0, "  %s (%d.%d): %llu %llu %llu %llu %llu\n",
+                       ReqStatsName(entries[i].major, entries[i].minor),
+                       entries[i].major, entries[i].minor,
+                       (unsigned long long) rs->count,
+                       (unsigned long long) rs->usecs,
+                       (unsigned long long) (rs->usecs / rs->count),
+                       (unsigned long long) ReqStatsPercentile(rs, 50),
+                       (unsigned long long) ReqStatsPercentile(rs, 99));
+    }
+    free(entries);
+
+    LogMessage(X_INFO, "Request statistics per client:\n");
+    for (i = 0; i < MAXCLIENTS; i++) {
+        if (clientStats[i])
+            PrintClientStats(i);
+    }
+    LogMessage(X_INFO, "End of request statistics\n");
+}
+
+void
+dixResetRequestStats(void)
+{
+    int i;
+
+    dixPrintRequestStats();
+
+    for (i = 0; i < 256; i++) {
+        free(reqStats[i]);
+        reqStats[i] = NULL;
+    }
+}
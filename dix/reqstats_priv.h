@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: MIT OR X11
+ */
+#ifndef _XSERVER_DIX_REQSTATS_PRIV_H
+#define _XSERVER_DIX_REQSTATS_PRIV_H
+
+#include <X11/Xdefs.h>
+#include <X11/Xmd.h>
+
+#include "include/dix.h"
+
+/*
+ * Request statistics (-reqstats): count, time and a latency histogram
+ * for every request opcode, and count and time per client and major
+ * opcode.  They are printed to the log on demand and at server reset.
+ */
+extern Bool dixRequestStatsEnabled;
+
+/*
+ * @brief account for a request that has just been processed
+ *
+ * @param client the client that sent the request
+ * @param usecs the time it took, in microseconds
+ *
+ * Should only be called by Dispatch().
+ */
+void dixRequestStatsAdd(ClientPtr client, CARD64 usecs);
+
+/*
+ * @brief forget a client's statistics when it goes away
+ */
+void dixRequestStatsClientGone(ClientPtr client);
+
+/*
+ * @brief look up the statistics of one request
+ *
+ * @param major major opcode
+ * @param minor minor opcode, 0 for core requests
+ * @param count returns how often the request was processed
+ * @param usecs returns the total time spent in it, in microseconds
+ * @param p50 returns the upper bound of the median latency
+ * @param p99 returns the upper bound of the 99th percentile latency
+ * @return FALSE if the request wasn't processed since the last reset
+ */
+Bool dixGetRequestStats(int major, int minor, CARD64 *count, CARD64 *usecs,
+                        CARD64 *p50, CARD64 *p99);
+
+/*
+ * @brief look up how often a client sent requests with a major opcode
+ *
+ * @return FALSE if the client didn't send any
+ */
+Bool dixGetClientRequestStats(ClientPtr client, int major,
+                              CARD64 *count, CARD64 *usecs);
+
+/*
+ * @brief print the request statistics to the log
+ *
+ * Requests are listed by the total time spent in them, followed by the
+ * clients and the requests each of them spent the most time in.
+ */
+void dixPrintRequestStats(void);
+
+/*
+ * @brief print the request statistics and start over
+ *
+ * Called at server reset, since extension opcodes can change.
+ */
+void dixResetRequestStats(void);
+
+#endif /* _XSERVER_DIX_REQSTATS_PRIV_H */
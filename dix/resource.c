@@ -165,6 +165,7 @@ typedef struct _Resource {
     XID id;
     RESTYPE type;
     void *value;
+    unsigned long pixmapBytes;  /* pixmapRefSize when it was added */
 } ResourceRec, *ResourcePtr;
 
 typedef struct _ClientResource {
@@ -174,6 +175,9 @@ typedef struct _ClientResource {
     int hashsize;               /* log(2)(buckets) */
     XID fakeID;
     XID endFakeID;
+    unsigned int *typeCounts;   /* resources of each type, by type & TypeMask */
+    unsigned long *typePixmapBytes; /* and their pixmap bytes */
+    int numTypeCounts;
 } ClientResourceRec;
 
 RESTYPE lastResourceType;
@@ -661,6 +665,11 @@ InitClientResources(ClientPtr client)
     clientTable[i].buckets = INITBUCKETS;
     clientTable[i].elements = 0;
     clientTable[i].hashsize = INITHASHSIZE;
+    free(clientTable[i].typeCounts);
+    clientTable[i].typeCounts = NULL;
+    free(clientTable[i].typePixmapBytes);
+    clientTable[i].typePixmapBytes = NULL;
+    clientTable[i].numTypeCounts = 0;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
@@ -810,6 +819,70 @@ FakeClientID(int client)
     return id;
 }
 
+/*
+ * Make room to count resources of the given type
+ */
+static Bool
+GrowTypeCounts(ClientResourceRec *rrec, RESTYPE type)
+{
+    int num = lastResourceType + 1;
+    unsigned int *counts;
+    unsigned long *bytes;
+
+    if ((type & TypeMask) < rrec->numTypeCounts)
+        return TRUE;
+
+    counts = reallocarray(rrec->typeCounts, num, sizeof(*counts));
+    if (!counts)
+        return FALSE;
+    rrec->typeCounts = counts;
+    bytes = reallocarray(rrec->typePixmapBytes, num, sizeof(*bytes));
+    if (!bytes)
+        return FALSE;
+    rrec->typePixmapBytes = bytes;
+
+    memset(counts + rrec->numTypeCounts, 0,
+           (num - rrec->numTypeCounts) * sizeof(*counts));
+    memset(bytes + rrec->numTypeCounts, 0,
+           (num - rrec->numTypeCounts) * sizeof(*bytes));
+    rrec->numTypeCounts = num;
+    return TRUE;
+}
+
+/*
+ * Add the pixmap bytes of a resource to its client's total for the type,
+ * as its size function reports them now
+ */
+static void
+AccountResourceBytes(ClientResourceRec *rrec, ResourcePtr res)
+{
+    ResourceSizeRec size = { 0, 0, 0 };
+
+    resourceTypes[res->type & TypeMask].sizeFunc(res->value, res->id, &size);
+    res->pixmapBytes = size.pixmapRefSize;
+    rrec->typePixmapBytes[res->type & TypeMask] += res->pixmapBytes;
+}
+
+unsigned int
+GetClientResourceTypeCount(ClientPtr client, RESTYPE type)
+{
+    ClientResourceRec *rrec = &clientTable[client->index];
+
+    if ((type & TypeMask) >= rrec->numTypeCounts)
+        return 0;
+    return rrec->typeCounts[type & TypeMask];
+}
+
+unsigned long
+GetClientResourceTypePixmapBytes(ClientPtr client, RESTYPE type)
+{
+    ClientResourceRec *rrec = &clientTable[client->index];
+
+    if ((type & TypeMask) >= rrec->numTypeCounts)
+        return 0;
+    return rrec->typePixmapBytes[type & TypeMask];
+}
+
 Bool
 AddResource(XID id, RESTYPE type, void *value)
 {
@@ -831,7 +904,8 @@ AddResource(XID id, RESTYPE type, void *value)
         RebuildTable(client);
     head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
     ResourcePtr res = calloc(1, sizeof(ResourceRec));
-    if (!res) {
+    if (!res || !GrowTypeCounts(rrec, type)) {
+        free(res);
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
         return FALSE;
     }
@@ -841,6 +915,8 @@ AddResource(XID id, RESTYPE type, void *value)
     res->value = value;
     *head = res;
     rrec->elements++;
+    rrec->typeCounts[type & TypeMask]++;
+    AccountResourceBytes(rrec, res);
     CallResourceStateCallback(ResourceStateAdding, res);
     return TRUE;
 }
@@ -889,6 +965,11 @@ RebuildTable(int client)
 static void
 doFreeResource(ResourcePtr res, Bool skip)
 {
+    ClientResourceRec *rrec = &clientTable[dixClientIdForXID(res->id)];
+
+    rrec->typeCounts[res->type & TypeMask]--;
+    rrec->typePixmapBytes[res->type & TypeMask] -= res->pixmapBytes;
+
     CallResourceStateCallback(ResourceStateFreeing, res);
 
     if (!skip)
@@ -978,7 +1059,10 @@ ChangeResourceValue(XID id, RESTYPE rtype, void *value)
         for (ResourcePtr res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
             res; res = res->next)
             if ((res->id == id) && (res->type == rtype)) {
+                clientTable[cid].typePixmapBytes[rtype & TypeMask] -=
+                    res->pixmapBytes;
                 res->value = value;
+                AccountResourceBytes(&clientTable[cid], res);
                 return TRUE;
             }
     }
@@ -1156,6 +1240,11 @@ FreeClientResources(ClientPtr client)
     free(clientTable[client->index].resources);
     clientTable[client->index].resources = NULL;
     clientTable[client->index].buckets = 0;
+    free(clientTable[client->index].typeCounts);
+    clientTable[client->index].typeCounts = NULL;
+    free(clientTable[client->index].typePixmapBytes);
+    clientTable[client->index].typePixmapBytes = NULL;
+    clientTable[client->index].numTypeCounts = 0;
 }
 
 void
@@ -156,4 +156,28 @@ void GetXIDRange(int client,
                  XID *minp,
                  XID *maxp);
 
+/*
+ * @brief number of resources of a type owned by a client
+ *
+ * Maintained as resources are added and freed, so this is cheap.
+ *
+ * @param client the client owning the resources
+ * @param type the resource type
+ * @return number of resources of that type
+ */
+unsigned int GetClientResourceTypeCount(ClientPtr client, RESTYPE type);
+
+/*
+ * @brief pixmap bytes of the resources of a type owned by a client
+ *
+ * The sum of the pixmapRefSize the type's size function gave for each
+ * resource when it was added, or when its value was last changed.
+ * Maintained as resources come and go, so this is cheap.
+ *
+ * @param client the client owning the resources
+ * @param type the resource type
+ * @return pixmap bytes of that type
+ */
+unsigned long GetClientResourceTypePixmapBytes(ClientPtr client, RESTYPE type);
+
 #endif /* _XSERVER_DIX_RESOURCE_PRIV_H */
@@ -25,5 +25,6 @@ void dixFreeScreen(ScreenPtr pScreen)
     DeleteCallbackList(&pScreen->hookClose);
     DeleteCallbackList(&pScreen->hookPostClose);
     DeleteCallbackList(&pScreen->hookPixmapDestroy);
+    DeleteCallbackList(&pScreen->hookPrepareGetImage);
     free(pScreen);
 }
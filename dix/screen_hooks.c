@@ -32,6 +32,8 @@ DECLARE_HOOK_PROC(PostClose, hookPostClose, XorgScreenCloseProcPtr)
 DECLARE_HOOK_PROC(PixmapDestroy, hookPixmapDestroy, XorgScreenPixmapDestroyProcPtr)
 DECLARE_HOOK_PROC(PostCreateResources, hookPostCreateResources,
                   XorgScreenPostCreateResourcesProcPtr)
+DECLARE_HOOK_PROC(PrepareGetImage, hookPrepareGetImage,
+                  XorgScreenPrepareGetImageProcPtr)
 
 int dixScreenRaiseWindowDestroy(WindowPtr pWin)
 {
@@ -100,3 +102,29 @@ Bool dixScreenRaiseCreateResources(ScreenPtr pScreen)
     CallCallbacks(&pScreen->hookPostCreateResources, &ret);
     return ret;
 }
+
+Bool dixScreenRaisePrepareGetImage(ClientPtr client, DrawablePtr pDraw,
+                                   int x, int y, int w, int h,
+                                   unsigned int format, unsigned long planemask)
+{
+    ScreenPtr pScreen = pDraw->pScreen;
+
+    /* Restarted requests from swapped clients would be swapped again */
+    if (!pScreen->hookPrepareGetImage || client->swapped)
+        return TRUE;
+
+    XorgScreenPrepareGetImageParamRec param = {
+        .client = client,
+        .drawable = pDraw,
+        .x = x,
+        .y = y,
+        .width = w,
+        .height = h,
+        .format = format,
+        .planemask = planemask,
+        .ready = TRUE,
+    };
+
+    CallCallbacks(&pScreen->hookPrepareGetImage, &param);
+    return param.ready;
+}
@@ -24,6 +24,7 @@
 #include <X11/Xfuncproto.h>
 
 #include "include/callback.h" /* CallbackListPtr */
+#include "include/dix.h" /* ClientPtr */
 #include "include/pixmap.h" /* PixmapPtr */
 #include "include/screenint.h" /* ScreenPtr */
 #include "include/window.h" /* WindowPtr */
@@ -249,4 +250,53 @@ _X_EXPORT
 void dixScreenUnhookPostCreateResources(ScreenPtr pScreen,
                                         XorgScreenPostCreateResourcesProcPtr func);
 
+typedef struct {
+    ClientPtr client;
+    DrawablePtr drawable;
+    int x;
+    int y;
+    int width;
+    int height;
+    unsigned int format;
+    unsigned long planemask;
+    Bool ready;
+} XorgScreenPrepareGetImageParamRec;
+
+/* prototype of GetImage preparation handler */
+typedef void (*XorgScreenPrepareGetImageProcPtr)(CallbackListPtr *pcbl,
+                                                 ScreenPtr pScreen,
+                                                 XorgScreenPrepareGetImageParamRec *param);
+
+/**
+ * @brief register a GetImage preparation hook on the given screen
+ *
+ * @param pScreen pointer to the screen to register the hook into
+ * @param func pointer to the hook function
+ *
+ * This hook is called before a client's GetImage or ShmGetImage request
+ * fetches the image through pScreen->GetImage().  A hook that can't deliver the
+ * image without blocking may start fetching it asynchronously, put the
+ * client to sleep and clear param->ready.  The request is then restarted
+ * once the hook wakes the client up again.
+ *
+ * NOTE: only exported for libglamoregl, not supposed to be used by drivers.
+ **/
+_X_EXPORT
+void dixScreenHookPrepareGetImage(ScreenPtr pScreen,
+                                  XorgScreenPrepareGetImageProcPtr func);
+
+/**
+ * @brief unregister a GetImage preparation hook on the given screen
+ *
+ * @param pScreen pointer to the screen to unregister the hook from
+ * @param func pointer to the hook function
+ *
+ * @see dixScreenHookPrepareGetImage
+ *
+ * NOTE: only exported for libglamoregl, not supposed to be used by drivers.
+ **/
+_X_EXPORT
+void dixScreenUnhookPrepareGetImage(ScreenPtr pScreen,
+                                    XorgScreenPrepareGetImageProcPtr func);
+
 #endif /* DIX_SCREEN_HOOKS_H */
@@ -46,6 +46,35 @@
 
 #define TOUCH_HISTORY_SIZE 100
 
+/**
+ * A delta-encoded TouchUpdate in the touch history. It is followed by
+ * num_changed axis values for the axes set in changed, all other axes in
+ * mask have the same value as in the previous event.
+ */
+typedef struct _TouchHistoryUpdate {
+    Time time;
+    uint32_t flags;
+    Window root;
+    int16_t root_x;
+    int16_t root_y;
+    float root_x_frac;
+    float root_y_frac;
+    uint8_t mask[(MAX_VALUATORS + 7) / 8];
+    uint8_t mode[(MAX_VALUATORS + 7) / 8];
+    uint8_t changed[(MAX_VALUATORS + 7) / 8];
+    uint8_t num_changed;
+} TouchHistoryUpdate;
+
+#define TOUCH_HISTORY_UPDATE_SIZE(n) \
+    (sizeof(TouchHistoryUpdate) + (n) * sizeof(double))
+
+/* Enough for a full history of updates with up to four changed axes each.
+ * Updates with more axes fill the buffer earlier, it's only the number of
+ * stored events that goes down in that case. */
+#define TOUCH_HISTORY_BYTES \
+    (TOUCH_HISTORY_SIZE * TOUCH_HISTORY_UPDATE_SIZE(4) + \
+     TOUCH_HISTORY_UPDATE_SIZE(MAX_VALUATORS))
+
 Bool touchEmulatePointer = TRUE;
 
 /**
@@ -223,6 +252,18 @@ TouchInitTouchPoint(TouchClassPtr t, ValuatorClassPtr v, int index)
     }
     ti->sprite.spriteTraceSize = 32;
 
+    /* max one grab per window plus the bottom-most event selection, plus
+     * any active grab, see TouchBuildSprite() */
+    ti->listeners = calloc(ti->sprite.spriteTraceSize + 2,
+                           sizeof(*ti->listeners));
+    if (!ti->listeners) {
+        free(ti->sprite.spriteTrace);
+        ti->sprite.spriteTrace = NULL;
+        valuator_mask_free(&ti->valuators);
+        return FALSE;
+    }
+    ti->listeners_size = ti->sprite.spriteTraceSize + 2;
+
     ScreenPtr masterScreen = dixGetMasterScreen();
 
     ti->sprite.spriteTrace[0] = masterScreen->root;
@@ -254,10 +295,9 @@ TouchFreeTouchPoint(DeviceIntPtr device, int index)
     ti->sprite.spriteTrace = NULL;
     free(ti->listeners);
     ti->listeners = NULL;
+    ti->listeners_size = 0;
     free(ti->history);
     ti->history = NULL;
-    ti->history_size = 0;
-    ti->history_elements = 0;
 }
 
 /**
@@ -296,6 +336,7 @@ TouchBeginTouch(DeviceIntPtr dev, int sourceid, uint32_t touchid,
     TouchClassPtr t = dev->touch;
     TouchPointInfoPtr ti;
     void *tmp;
+    size_t size;
 
     if (!t)
         return NULL;
@@ -320,13 +361,25 @@ TouchBeginTouch(DeviceIntPtr dev, int sourceid, uint32_t touchid,
         }
     }
 
-    /* If we get here, then we've run out of touches: enlarge dev->touch and
-     * try again. */
-    tmp = reallocarray(t->touches, t->num_touches + 1, sizeof(*ti));
+    /* If we get here, then we've run out of touches: enlarge dev->touch
+     * sufficiently so we don't need to do it often and try again. */
+    size = t->num_touches + t->num_touches / 2 + 1;
+    if (size > USHRT_MAX)
+        return NULL;
+
+    tmp = reallocarray(t->touches, size, sizeof(*ti));
     if (tmp) {
+        int first = t->num_touches;
+
         t->touches = tmp;
-        t->num_touches++;
-        if (TouchInitTouchPoint(t, dev->valuator, t->num_touches - 1))
+        t->num_touches = size;
+        for (int i = first; i < size; i++) {
+            if (!TouchInitTouchPoint(t, dev->valuator, i)) {
+                t->num_touches = i;
+                break;
+            }
+        }
+        if (t->num_touches > first)
             goto try_find_touch;
     }
 
@@ -358,8 +411,6 @@ TouchEndTouch(DeviceIntPtr dev, TouchPointInfoPtr ti)
     ti->active = FALSE;
     ti->pending_finish = FALSE;
     ti->sprite.spriteTraceGood = 0;
-    free(ti->listeners);
-    ti->listeners = NULL;
     ti->num_listeners = 0;
     ti->num_grabs = 0;
     ti->client_id = 0;
@@ -370,32 +421,65 @@ TouchEndTouch(DeviceIntPtr dev, TouchPointInfoPtr ti)
 }
 
 /**
- * Allocate the event history for this touch pointer. Calling this on a
- * touchpoint that already has an event history does nothing but counts as
- * as success.
+ * Start recording the event history for this touch point. The storage is
+ * allocated on first use and kept for the following touch sequences on
+ * this touch point. Calling this on a touchpoint that already records its
+ * event history does nothing but counts as success.
  *
  * @return TRUE on success, FALSE on allocation errors
  */
 Bool
 TouchEventHistoryAllocate(TouchPointInfoPtr ti)
 {
-    if (ti->history)
-        return TRUE;
+    TouchHistoryPtr history = ti->history;
+
+    if (!history) {
+        history = calloc(1, sizeof(*history) + TOUCH_HISTORY_BYTES);
+        if (!history)
+            return FALSE;
+        history->size = TOUCH_HISTORY_BYTES;
+        ti->history = history;
+    }
+
+    if (!history->recording) {
+        history->recording = TRUE;
+        history->elements = 0;
+        history->used = 0;
+        history->last = 0;
+    }
 
-    ti->history = calloc(TOUCH_HISTORY_SIZE, sizeof(*ti->history));
-    ti->history_elements = 0;
-    if (ti->history)
-        ti->history_size = TOUCH_HISTORY_SIZE;
-    return ti->history != NULL;
+    return TRUE;
 }
 
+/**
+ * Stop recording and discard the event history. The storage itself is
+ * kept for the next touch sequence and freed in TouchFreeTouchPoint().
+ */
 void
 TouchEventHistoryFree(TouchPointInfoPtr ti)
 {
-    free(ti->history);
-    ti->history = NULL;
-    ti->history_size = 0;
-    ti->history_elements = 0;
+    if (!ti->history)
+        return;
+
+    ti->history->recording = FALSE;
+    ti->history->elements = 0;
+    ti->history->used = 0;
+    ti->history->last = 0;
+}
+
+/**
+ * Apply the valuator values of ev to the axis state.
+ */
+static void
+TouchHistoryApplyValuators(uint8_t *known, double *values,
+                           const DeviceEvent *ev)
+{
+    for (int i = 0; i < MAX_VALUATORS; i++) {
+        if (BitIsOn(ev->valuators.mask, i)) {
+            SetBit(known, i);
+            values[i] = ev->valuators.data[i];
+        }
+    }
 }
 
 /**
@@ -405,17 +489,25 @@ TouchEventHistoryFree(TouchPointInfoPtr ti)
  * If more than one TouchBegin is pushed onto the stack, the push is
  * ignored, calling this function multiple times for the TouchBegin is
  * valid.
+ *
+ * This does not allocate, once the history is full the most recent update
+ * is merged with the new event.
  */
 void
 TouchEventHistoryPush(TouchPointInfoPtr ti, const DeviceEvent *ev)
 {
-    if (!ti->history)
+    TouchHistoryPtr history = ti->history;
+    TouchHistoryUpdate update;
+    unsigned char *data;
+    Bool merge;
+
+    if (!history || !history->recording)
         return;
 
     switch (ev->type) {
     case ET_TouchBegin:
         /* don't store the same touchbegin twice */
-        if (ti->history_elements > 0)
+        if (history->elements > 0)
             return;
         break;
     case ET_TouchUpdate:
@@ -430,42 +522,142 @@ TouchEventHistoryPush(TouchPointInfoPtr ti, const DeviceEvent *ev)
     if (ev->flags & (TOUCH_CLIENT_ID | TOUCH_REPLAYING))
         return;
 
-    ti->history[ti->history_elements++] = *ev;
-    /* FIXME: proper overflow fixes */
-    if (ti->history_elements > ti->history_size - 1) {
-        ti->history_elements = ti->history_size - 1;
-        DebugF("source device %d: history size %zu overflowing for touch %u\n",
-               ti->sourceid, ti->history_size, ti->client_id);
+    if (history->elements == 0) {
+        history->first = *ev;
+        history->elements = 1;
+        memset(history->known, 0, sizeof(history->known));
+        TouchHistoryApplyValuators(history->known, history->values, ev);
+        return;
+    }
+
+    merge = history->elements > 1 &&
+            (history->elements >= TOUCH_HISTORY_SIZE - 1 ||
+             history->used + TOUCH_HISTORY_UPDATE_SIZE(MAX_VALUATORS) >
+             history->size);
+
+    if (merge) {
+        DebugF("source device %d: history size %d overflowing for touch %u\n",
+               ti->sourceid, TOUCH_HISTORY_SIZE, ti->client_id);
     }
+    else {
+        /* the new update is encoded against the state after the last one */
+        memcpy(history->base_known, history->known, sizeof(history->known));
+        memcpy(history->base, history->values, sizeof(history->values));
+        history->last = history->used;
+        history->elements++;
+    }
+
+    TouchHistoryApplyValuators(history->known, history->values, ev);
+
+    memset(&update, 0, sizeof(update));
+    update.time = ev->time;
+    update.flags = ev->flags;
+    update.root = ev->root;
+    update.root_x = ev->root_x;
+    update.root_y = ev->root_y;
+    update.root_x_frac = ev->root_x_frac;
+    update.root_y_frac = ev->root_y_frac;
+    memcpy(update.mask, ev->valuators.mask, sizeof(update.mask));
+    memcpy(update.mode, ev->valuators.mode, sizeof(update.mode));
+    if (merge) {
+        TouchHistoryUpdate *prev =
+            (TouchHistoryUpdate*)(history->updates + history->last);
+
+        /* keep the axes only the merged event had */
+        for (int i = 0; i < ARRAY_SIZE(update.mask); i++)
+            update.mask[i] |= prev->mask[i];
+    }
+
+    data = history->updates + history->last + sizeof(update);
+    for (int i = 0; i < MAX_VALUATORS; i++) {
+        if (!BitIsOn(history->known, i))
+            continue;
+        if (BitIsOn(history->base_known, i) &&
+            history->base[i] == history->values[i])
+            continue;
+
+        SetBit(update.changed, i);
+        memcpy(data, &history->values[i], sizeof(double));
+        data += sizeof(double);
+        update.num_changed++;
+    }
+
+    memcpy(history->updates + history->last, &update, sizeof(update));
+    history->used = history->last + TOUCH_HISTORY_UPDATE_SIZE(update.num_changed);
 }
 
 void
 TouchEventHistoryReplay(TouchPointInfoPtr ti, DeviceIntPtr dev, XID resource)
 {
-    if (!ti->history)
+    TouchHistoryPtr history = ti->history;
+    DeviceEvent ev;
+    uint8_t known[(MAX_VALUATORS + 7) / 8] = { 0 };
+    double values[MAX_VALUATORS];
+    size_t offset = 0;
+
+    if (!history || !history->recording || history->elements == 0)
         return;
 
-    DeliverDeviceClassesChangedEvent(ti->sourceid, ti->history[0].time);
-
-    for (int i = 0; i < ti->history_elements; i++) {
-        DeviceEvent *ev = &ti->history[i];
-
-        ev->flags |= TOUCH_REPLAYING;
-        ev->resource = resource;
-        /* FIXME:
-           We're replaying ti->history which contains the TouchBegin +
-           all TouchUpdates for ti. This needs to be passed on to the next
-           listener. If that is a touch listener, everything is dandy.
-           If the TouchBegin however triggers a sync passive grab, the
-           TouchUpdate events must be sent to EnqueueEvent so the events end
-           up in syncEvents.pending to be forwarded correctly in a
-           subsequent ComputeFreeze().
-
-           However, if we just send them to EnqueueEvent the sync'ing device
-           prevents handling of touch events for ownership listeners who
-           want the events right here, right now.
-         */
-        dev->public.processInputProc((InternalEvent*)ev, dev);
+    DeliverDeviceClassesChangedEvent(ti->sourceid, history->first.time);
+
+    TouchHistoryApplyValuators(known, values, &history->first);
+
+    ev = history->first;
+    ev.flags |= TOUCH_REPLAYING;
+    ev.resource = resource;
+    /* FIXME:
+       We're replaying ti->history which contains the TouchBegin +
+       all TouchUpdates for ti. This needs to be passed on to the next
+       listener. If that is a touch listener, everything is dandy.
+       If the TouchBegin however triggers a sync passive grab, the
+       TouchUpdate events must be sent to EnqueueEvent so the events end
+       up in syncEvents.pending to be forwarded correctly in a
+       subsequent ComputeFreeze().
+
+       However, if we just send them to EnqueueEvent the sync'ing device
+       prevents handling of touch events for ownership listeners who
+       want the events right here, right now.
+     */
+    dev->public.processInputProc((InternalEvent*)&ev, dev);
+
+    /* Processing may end the touch and with it the history, so check
+     * after every event */
+    for (int i = 1; history->recording && i < history->elements &&
+                    offset < history->used; i++) {
+        TouchHistoryUpdate update;
+        const unsigned char *data;
+
+        memcpy(&update, history->updates + offset, sizeof(update));
+        data = history->updates + offset + sizeof(update);
+        offset += TOUCH_HISTORY_UPDATE_SIZE(update.num_changed);
+
+        for (int j = 0; j < MAX_VALUATORS; j++) {
+            if (BitIsOn(update.changed, j)) {
+                SetBit(known, j);
+                memcpy(&values[j], data, sizeof(double));
+                data += sizeof(double);
+            }
+        }
+
+        ev = history->first;
+        ev.type = ET_TouchUpdate;
+        ev.time = update.time;
+        ev.flags = update.flags | TOUCH_REPLAYING;
+        ev.resource = resource;
+        ev.root = update.root;
+        ev.root_x = update.root_x;
+        ev.root_y = update.root_y;
+        ev.root_x_frac = update.root_x_frac;
+        ev.root_y_frac = update.root_y_frac;
+        memcpy(ev.valuators.mask, update.mask, sizeof(update.mask));
+        memcpy(ev.valuators.mode, update.mode, sizeof(update.mode));
+        memset(ev.valuators.data, 0, sizeof(ev.valuators.data));
+        for (int j = 0; j < MAX_VALUATORS; j++) {
+            if (BitIsOn(update.mask, j) && BitIsOn(known, j))
+                ev.valuators.data[j] = values[j];
+        }
+
+        dev->public.processInputProc((InternalEvent*)&ev, dev);
     }
 }
 
@@ -517,12 +709,22 @@ TouchBuildSprite(DeviceIntPtr sourcedev, TouchPointInfoPtr ti,
         return FALSE;
 
     /* Mark which grabs/event selections we're delivering to: max one grab per
-     * window plus the bottom-most event selection, plus any active grab. */
-    ti->listeners = calloc(sprite->spriteTraceGood + 2, sizeof(*ti->listeners));
-    if (!ti->listeners) {
-        sprite->spriteTraceGood = 0;
-        return FALSE;
+     * window plus the bottom-most event selection, plus any active grab.
+     * The listeners are kept between touches, only grow them for deeper
+     * window traces. */
+    if (sprite->spriteTraceGood + 2 > ti->listeners_size) {
+        TouchListener *tmp;
+
+        tmp = reallocarray(ti->listeners, sprite->spriteTraceGood + 2,
+                           sizeof(*ti->listeners));
+        if (!tmp) {
+            sprite->spriteTraceGood = 0;
+            return FALSE;
+        }
+        ti->listeners = tmp;
+        ti->listeners_size = sprite->spriteTraceGood + 2;
     }
+    memset(ti->listeners, 0, ti->listeners_size * sizeof(*ti->listeners));
     ti->num_listeners = 0;
 
     return TRUE;
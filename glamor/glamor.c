@@ -40,6 +40,7 @@
 #include "os/bug_priv.h"
 
 #include "glamor_priv.h"
+#include "glamor_transfer.h"
 #include "mipict.h"
 
 DevPrivateKeyRec glamor_screen_private_key;
@@ -120,7 +121,7 @@ glamor_set_pixmap_texture(PixmapPtr pixmap, unsigned int tex)
 
     if (pixmap_priv->fbo) {
         fbo = glamor_pixmap_detach_fbo(pixmap_priv);
-        glamor_destroy_fbo(glamor_priv, fbo);
+        glamor_release_fbo(glamor_priv, fbo);
     }
 
     fbo = glamor_create_fbo_from_tex(glamor_priv, pixmap,
@@ -292,6 +293,7 @@ _glamor_block_handler(ScreenPtr screen, void *timeout)
     glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
 
     glamor_flush(glamor_priv);
+    glamor_transfer_block_handler(screen, timeout);
 
     screen->BlockHandler = glamor_priv->saved_procs.block_handler;
     screen->BlockHandler(screen, timeout);
@@ -618,6 +620,7 @@ glamor_setup_formats(ScreenPtr screen)
 
 static void glamor_pixmap_destroy(CallbackListPtr *pcbl, ScreenPtr pScreen, PixmapPtr pPixmap)
 {
+    glamor_transfer_pixmap_destroy(pPixmap);
     glamor_pixmap_destroy_fbo(pPixmap);
 }
 
@@ -768,8 +771,17 @@ glamor_init(ScreenPtr screen, unsigned int flags)
     glamor_priv->has_map_buffer_range =
         epoxy_has_gl_extension("GL_ARB_map_buffer_range") ||
         epoxy_has_gl_extension("GL_EXT_map_buffer_range");
+    glamor_priv->has_sync =
+        epoxy_gl_version() >= (glamor_priv->is_gles ? 30 : 32) ||
+        epoxy_has_gl_extension("GL_ARB_sync");
+    /* The persistently mapped VBO ring relies on fences for reuse. */
     glamor_priv->has_buffer_storage =
-        epoxy_has_gl_extension("GL_ARB_buffer_storage");
+        epoxy_has_gl_extension("GL_ARB_buffer_storage") &&
+        glamor_priv->has_sync;
+    /* Pixel buffer objects are core in GL 2.1 and GLES 3.0 */
+    glamor_priv->has_pbo =
+        (!glamor_priv->is_gles || gl_version >= 30) &&
+        glamor_priv->has_map_buffer_range;
     glamor_priv->has_mesa_tile_raster_order =
         epoxy_has_gl_extension("GL_MESA_tile_raster_order");
     glamor_priv->has_nv_texture_barrier =
@@ -829,6 +841,9 @@ glamor_init(ScreenPtr screen, unsigned int flags)
 
     glamor_set_debug_level(&glamor_debug_level);
 
+    glamor_fbo_pool_init(glamor_priv);
+    glamor_program_cache_init(screen);
+
     if (!glamor_font_init(screen))
         goto fail;
 
@@ -881,6 +896,7 @@ glamor_init(ScreenPtr screen, unsigned int flags)
     ps->Glyphs = glamor_composite_glyphs;
 
     glamor_init_vbo(screen);
+    glamor_init_transfer(screen);
 
     glamor_priv->enable_gradient_shader = TRUE;
 
@@ -891,6 +907,10 @@ glamor_init(ScreenPtr screen, unsigned int flags)
         glamor_priv->enable_gradient_shader = FALSE;
     }
 
+    /* Opt-in, as it costs startup time when the program cache is cold */
+    if (getenv("GLAMOR_PRECOMPILE_SHADERS"))
+        glamor_precompile_composite_shaders(screen);
+
     glamor_pixmap_init(screen);
     glamor_sync_init(screen);
 
@@ -902,6 +922,7 @@ glamor_init(ScreenPtr screen, unsigned int flags)
     return TRUE;
 
 fail:
+    free(glamor_priv->program_cache_dir);
     free(glamor_priv);
     glamor_set_screen_private(screen, NULL);
     return FALSE;
@@ -913,6 +934,8 @@ glamor_release_screen_priv(ScreenPtr screen)
     glamor_screen_private *glamor_priv;
 
     glamor_priv = glamor_get_screen_private(screen);
+    glamor_fbo_pool_fini(glamor_priv);
+    glamor_program_cache_fini(screen);
     glamor_fini_vbo(screen);
     glamor_pixmap_fini(screen);
     free(glamor_priv);
@@ -927,6 +950,7 @@ static void glamor_close_screen(CallbackListPtr *pcbl, ScreenPtr screen, void *u
 
     glamor_priv = glamor_get_screen_private(screen);
     glamor_sync_close(screen);
+    glamor_fini_transfer(screen);
     glamor_composite_glyphs_fini(screen);
     glamor_set_glvnd_vendor(screen, NULL);
 
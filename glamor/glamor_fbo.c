@@ -28,11 +28,153 @@
 #include <dix-config.h>
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "glamor/glamor_priv.h"
 #include "os/bug_priv.h"
 
+/** Default memory limit of the FBO pool, in bytes.
+ *
+ * Can be changed with the GLAMOR_FBO_POOL_MB environment variable, 0
+ * disables the pool.
+ */
+#define GLAMOR_FBO_POOL_SIZE    (32 * 1024 * 1024)
+
+/** Most FBOs the pool holds on to, whatever their size */
+#define GLAMOR_FBO_POOL_COUNT   256
+
+/** Pixmap sizes are rounded up to this for picking a pool bucket */
+#define GLAMOR_FBO_POOL_ROUND   32
+
+static unsigned int
+glamor_fbo_pool_bucket(const struct glamor_format *f, int w, int h)
+{
+    unsigned int wc = (w + GLAMOR_FBO_POOL_ROUND - 1) / GLAMOR_FBO_POOL_ROUND;
+    unsigned int hc = (h + GLAMOR_FBO_POOL_ROUND - 1) / GLAMOR_FBO_POOL_ROUND;
+
+    return (wc * 31 + hc * 7 + f->depth) % GLAMOR_FBO_POOL_BUCKETS;
+}
+
+static void
+glamor_fbo_pool_remove(glamor_screen_private *glamor_priv,
+                       glamor_pixmap_fbo *fbo)
+{
+    xorg_list_del(&fbo->pool_link);
+    xorg_list_del(&fbo->lru_link);
+    glamor_priv->fbo_pool.size -= fbo->size;
+    glamor_priv->fbo_pool.count--;
+}
+
+/* Drop the least recently released FBOs until @size more bytes fit */
+static void
+glamor_fbo_pool_evict(glamor_screen_private *glamor_priv, size_t size)
+{
+    while (!xorg_list_is_empty(&glamor_priv->fbo_pool.lru) &&
+           (glamor_priv->fbo_pool.size + size > glamor_priv->fbo_pool.max_size ||
+            glamor_priv->fbo_pool.count >= GLAMOR_FBO_POOL_COUNT)) {
+        glamor_pixmap_fbo *fbo =
+            xorg_list_first_entry(&glamor_priv->fbo_pool.lru,
+                                  glamor_pixmap_fbo, lru_link);
+
+        glamor_fbo_pool_remove(glamor_priv, fbo);
+        glamor_priv->fbo_pool.evictions++;
+        glamor_destroy_fbo(glamor_priv, fbo);
+    }
+}
+
+/*
+ * Look for a released FBO of exactly this size and format.  Its old
+ * contents are cleared, as they may belong to another client.
+ */
+static glamor_pixmap_fbo *
+glamor_fbo_pool_get(glamor_screen_private *glamor_priv,
+                    const struct glamor_format *f, int w, int h)
+{
+    struct xorg_list *bucket;
+    glamor_pixmap_fbo *fbo;
+
+    if (!glamor_priv->fbo_pool.max_size)
+        return NULL;
+
+    bucket = &glamor_priv->fbo_pool.buckets[glamor_fbo_pool_bucket(f, w, h)];
+    xorg_list_for_each_entry(fbo, bucket, pool_link) {
+        if (fbo->format == f && fbo->width == w && fbo->height == h) {
+            glamor_fbo_pool_remove(glamor_priv, fbo);
+            glamor_priv->fbo_pool.hits++;
+
+            glamor_make_current(glamor_priv);
+            glBindTexture(GL_TEXTURE_2D, fbo->tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glamor_pixmap_clear_fbo(glamor_priv, fbo, f);
+            return fbo;
+        }
+    }
+
+    glamor_priv->fbo_pool.misses++;
+    return NULL;
+}
+
+/**
+ * Gives up an FBO that is no longer attached to a pixmap.  Textures
+ * allocated by glamor_create_fbo() are kept around for reuse while they
+ * fit within the pool limits, anything else is destroyed.
+ */
+void
+glamor_release_fbo(glamor_screen_private *glamor_priv,
+                   glamor_pixmap_fbo *fbo)
+{
+    struct xorg_list *bucket;
+
+    /* Only pool FBOs we can clear on reuse */
+    if (!fbo->format || !fbo->fb ||
+        fbo->size > glamor_priv->fbo_pool.max_size / 8) {
+        glamor_destroy_fbo(glamor_priv, fbo);
+        return;
+    }
+
+    glamor_fbo_pool_evict(glamor_priv, fbo->size);
+
+    bucket = &glamor_priv->fbo_pool.buckets[glamor_fbo_pool_bucket(fbo->format,
+                                                                   fbo->width,
+                                                                   fbo->height)];
+    xorg_list_add(&fbo->pool_link, bucket);
+    xorg_list_append(&fbo->lru_link, &glamor_priv->fbo_pool.lru);
+    glamor_priv->fbo_pool.size += fbo->size;
+    glamor_priv->fbo_pool.count++;
+}
+
+void
+glamor_fbo_pool_init(glamor_screen_private *glamor_priv)
+{
+    const char *env = getenv("GLAMOR_FBO_POOL_MB");
+    unsigned int mb;
+    int i;
+
+    for (i = 0; i < GLAMOR_FBO_POOL_BUCKETS; i++)
+        xorg_list_init(&glamor_priv->fbo_pool.buckets[i]);
+    xorg_list_init(&glamor_priv->fbo_pool.lru);
+
+    glamor_priv->fbo_pool.max_size = GLAMOR_FBO_POOL_SIZE;
+    if (env && sscanf(env, "%u", &mb) == 1)
+        glamor_priv->fbo_pool.max_size = (size_t) mb * 1024 * 1024;
+}
+
+void
+glamor_fbo_pool_fini(glamor_screen_private *glamor_priv)
+{
+    LogMessageVerb(X_INFO, 3,
+                   "glamor%d: FBO pool %u hits, %u misses, %u evictions\n",
+                   glamor_priv->screen->myNum,
+                   glamor_priv->fbo_pool.hits,
+                   glamor_priv->fbo_pool.misses,
+                   glamor_priv->fbo_pool.evictions);
+
+    glamor_priv->fbo_pool.max_size = 0;
+    glamor_fbo_pool_evict(glamor_priv, 0);
+}
+
 void
 glamor_destroy_fbo(glamor_screen_private *glamor_priv,
                    glamor_pixmap_fbo *fbo)
@@ -160,13 +302,37 @@ glamor_pixmap_fbo *
 glamor_create_fbo(glamor_screen_private *glamor_priv,
                   PixmapPtr pixmap, int w, int h, int flag)
 {
-    GLint tex = _glamor_create_tex(glamor_priv, pixmap, w, h);
+    const struct glamor_format *f = glamor_format_for_pixmap(pixmap);
+    glamor_pixmap_fbo *fbo;
+    GLint tex;
+
+    fbo = glamor_fbo_pool_get(glamor_priv, f, w, h);
+    if (fbo)
+        return fbo;
+
+    tex = _glamor_create_tex(glamor_priv, pixmap, w, h);
+    if (!tex && glamor_priv->fbo_pool.count) {
+        /* Give the pool's memory back to the GL and try again */
+        size_t max_size = glamor_priv->fbo_pool.max_size;
+
+        glamor_priv->fbo_pool.max_size = 0;
+        glamor_fbo_pool_evict(glamor_priv, 0);
+        glamor_priv->fbo_pool.max_size = max_size;
+
+        tex = _glamor_create_tex(glamor_priv, pixmap, w, h);
+    }
 
     if (!tex) /* Texture creation failed due to GL_OUT_OF_MEMORY */
         return NULL;
 
-    return glamor_create_fbo_from_tex(glamor_priv, pixmap, w, h,
-                                      tex, flag);
+    fbo = glamor_create_fbo_from_tex(glamor_priv, pixmap, w, h,
+                                     tex, flag);
+    if (fbo) {
+        fbo->format = f;
+        fbo->size = (size_t) w * h * (PIXMAN_FORMAT_BPP(f->render_format) / 8);
+    }
+
+    return fbo;
 }
 
 /**
@@ -316,14 +482,14 @@ glamor_pixmap_destroy_fbo(PixmapPtr pixmap)
         BUG_RETURN(!priv);
 
         for (i = 0; i < priv->block_wcnt * priv->block_hcnt; i++)
-            glamor_destroy_fbo(glamor_priv, priv->fbo_array[i]);
+            glamor_release_fbo(glamor_priv, priv->fbo_array[i]);
         free(priv->fbo_array);
         priv->fbo_array = NULL;
     }
     else {
         fbo = glamor_pixmap_detach_fbo(priv);
         if (fbo)
-            glamor_destroy_fbo(glamor_priv, fbo);
+            glamor_release_fbo(glamor_priv, fbo);
     }
 }
 
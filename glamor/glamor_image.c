@@ -120,15 +120,18 @@ glamor_get_image_gl(DrawablePtr drawable, int x, int y, int w, int h,
     if (format != ZPixmap)
         goto bail;
 
-    glamor_get_drawable_deltas(drawable, pixmap, &off_x, &off_y);
-    box.x1 = x;
-    box.x2 = x + w;
-    box.y1 = y;
-    box.y2 = y + h;
-    glamor_download_boxes(drawable, &box, 1,
-                          drawable->x + off_x, drawable->y + off_y,
-                          -x, -y,
-                          (uint8_t *) d, byte_stride);
+    /* Restarted GetImage requests find their image already read back */
+    if (!glamor_get_image_readback(drawable, x, y, w, h, d)) {
+        glamor_get_drawable_deltas(drawable, pixmap, &off_x, &off_y);
+        box.x1 = x;
+        box.x2 = x + w;
+        box.y1 = y;
+        box.y2 = y + h;
+        glamor_download_boxes(drawable, &box, 1,
+                              drawable->x + off_x, drawable->y + off_y,
+                              -x, -y,
+                              (uint8_t *) d, byte_stride);
+    }
 
     if (!glamor_pm_is_solid(glamor_drawable_effective_depth(drawable), plane_mask)) {
         FbStip pm = fbReplicatePixel(plane_mask, drawable->bitsPerPixel);
@@ -180,6 +180,12 @@ struct glamor_pixmap_private;
 
 #define GLAMOR_COMPOSITE_VBO_VERT_CNT (64*1024)
 
+/** Number of hash buckets of the FBO pool. */
+#define GLAMOR_FBO_POOL_BUCKETS 64
+
+/** Number of fenced segments in the ARB_buffer_storage VBO ring. */
+#define GLAMOR_VBO_SEGMENTS 4
+
 struct glamor_format {
     /** X Server's "depth" value */
     int depth;
@@ -234,12 +240,15 @@ typedef struct glamor_screen_private {
     Bool has_fbo_blit;
     Bool has_map_buffer_range;
     Bool has_buffer_storage;
+    Bool has_sync;
+    Bool has_pbo;
     Bool has_khr_debug;
     Bool has_mesa_tile_raster_order;
     Bool has_nv_texture_barrier;
     Bool has_pack_subimage;
     Bool has_unpack_subimage;
     Bool has_rw_pbo;
+    Bool has_program_binary_hint;
     Bool use_quads;
     Bool has_dual_blend;
     Bool has_clear_texture;
@@ -313,6 +322,45 @@ typedef struct glamor_screen_private {
      */
     char *vb;
     int vb_stride;
+    /**
+     * Fences guarding reuse of each segment of the ARB_buffer_storage
+     * VBO ring, and the next segment to be fenced.
+     */
+    GLsync vbo_fences[GLAMOR_VBO_SEGMENTS];
+    int vbo_fence_next;
+    /** Whether we had to wait for the GPU during the current lap. */
+    Bool vbo_stalled;
+    struct {
+        uint64_t bytes;
+        unsigned int wraps;
+        unsigned int stalls;
+    } vbo_stats;
+
+    /** Streaming pixel unpack buffer for glamor_upload_boxes(). */
+    GLuint upload_pbo;
+    size_t upload_pbo_offset;
+    size_t upload_pbo_size;
+    /** GetImage readbacks in flight, see glamor_transfer.c */
+    struct xorg_list readbacks;
+
+    /** Released FBOs kept for reuse, see glamor_fbo.c */
+    struct {
+        struct xorg_list buckets[GLAMOR_FBO_POOL_BUCKETS];
+        /** Least recently released first */
+        struct xorg_list lru;
+        size_t size;
+        size_t max_size;
+        int count;
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int evictions;
+    } fbo_pool;
+
+    /** On-disk program binary cache, see glamor_program_cache.c */
+    char *program_cache_dir;
+    uint64_t program_cache_driver;
+    unsigned int program_cache_hits;
+    unsigned int program_cache_misses;
 
     /** Cached index buffer for translating GL_QUADS to triangles. */
     GLuint ib;
@@ -373,6 +421,14 @@ typedef struct glamor_pixmap_fbo {
     int width; /**< width in pixels */
     int height; /**< height in pixels */
     Bool is_red;
+    /**
+     * Format of textures allocated by glamor_create_fbo(), which may be
+     * reused through the FBO pool.  NULL for textures from elsewhere.
+     */
+    const struct glamor_format *format;
+    size_t size; /**< texture size in bytes, for the pool limits */
+    struct xorg_list pool_link; /**< entry in the pool bucket */
+    struct xorg_list lru_link; /**< entry in the pool LRU list */
 } glamor_pixmap_fbo;
 
 typedef struct glamor_pixmap_clipped_regions {
@@ -624,6 +680,10 @@ glamor_pixmap_fbo *glamor_create_fbo(glamor_screen_private *glamor_priv,
                                      PixmapPtr pixmap, int w, int h, int flag);
 void glamor_destroy_fbo(glamor_screen_private *glamor_priv,
                         glamor_pixmap_fbo *fbo);
+void glamor_release_fbo(glamor_screen_private *glamor_priv,
+                        glamor_pixmap_fbo *fbo);
+void glamor_fbo_pool_init(glamor_screen_private *glamor_priv);
+void glamor_fbo_pool_fini(glamor_screen_private *glamor_priv);
 void glamor_pixmap_destroy_fbo(PixmapPtr pixmap);
 Bool glamor_pixmap_fbo_fixup(ScreenPtr screen, PixmapPtr pixmap);
 void glamor_pixmap_clear_fbo(glamor_screen_private *glamor_priv, glamor_pixmap_fbo *fbo,
@@ -712,6 +772,7 @@ void glamor_composite(CARD8 op,
 void glamor_composite_rects(CARD8 op,
                             PicturePtr pDst,
                             xRenderColor *color, int nRect, xRectangle *rects);
+void glamor_precompile_composite_shaders(ScreenPtr screen);
 
 /* glamor_trapezoid.c */
 void glamor_trapezoids(CARD8 op,
@@ -744,6 +805,14 @@ void glamor_triangles(CARD8 op,
 void glamor_pixmap_init(ScreenPtr screen);
 void glamor_pixmap_fini(ScreenPtr screen);
 
+/* glamor_program_cache.c */
+Bool glamor_program_cache_load(glamor_screen_private *glamor_priv, GLuint prog,
+                               const char *vs, const char *fs);
+void glamor_program_cache_store(glamor_screen_private *glamor_priv, GLuint prog,
+                                const char *vs, const char *fs);
+void glamor_program_cache_init(ScreenPtr screen);
+void glamor_program_cache_fini(ScreenPtr screen);
+
 /* glamor_vbo.c */
 
 void glamor_init_vbo(ScreenPtr screen);
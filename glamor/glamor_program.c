@@ -358,27 +358,33 @@ glamor_build_program(ScreenPtr          screen,
     prog->fill_use = fill->use;
     prog->fill_use_render = fill->use_render;
 
-    vs_prog = glamor_compile_glsl_prog(GL_VERTEX_SHADER, vs_prog_string);
-    fs_prog = glamor_compile_glsl_prog(GL_FRAGMENT_SHADER, fs_prog_string);
-    glAttachShader(prog->prog, vs_prog);
-    glDeleteShader(vs_prog);
-    glAttachShader(prog->prog, fs_prog);
-    glDeleteShader(fs_prog);
-    glBindAttribLocation(prog->prog, GLAMOR_VERTEX_POS, "primitive");
-
-    if (prim->source_name) {
+    if (!glamor_program_cache_load(glamor_priv, prog->prog,
+                                   vs_prog_string, fs_prog_string)) {
+        vs_prog = glamor_compile_glsl_prog(GL_VERTEX_SHADER, vs_prog_string);
+        fs_prog = glamor_compile_glsl_prog(GL_FRAGMENT_SHADER, fs_prog_string);
+        glAttachShader(prog->prog, vs_prog);
+        glDeleteShader(vs_prog);
+        glAttachShader(prog->prog, fs_prog);
+        glDeleteShader(fs_prog);
+        glBindAttribLocation(prog->prog, GLAMOR_VERTEX_POS, "primitive");
+
+        if (prim->source_name) {
 #if DBG
-        ErrorF("Bind GLAMOR_VERTEX_SOURCE to %s\n", prim->source_name);
+            ErrorF("Bind GLAMOR_VERTEX_SOURCE to %s\n", prim->source_name);
 #endif
-        glBindAttribLocation(prog->prog, GLAMOR_VERTEX_SOURCE, prim->source_name);
-    }
-    if (prog->alpha == glamor_program_alpha_dual_blend) {
-        glBindFragDataLocationIndexed(prog->prog, 0, 0, "color0");
-        glBindFragDataLocationIndexed(prog->prog, 0, 1, "color1");
-    }
+            glBindAttribLocation(prog->prog, GLAMOR_VERTEX_SOURCE, prim->source_name);
+        }
+        if (prog->alpha == glamor_program_alpha_dual_blend) {
+            glBindFragDataLocationIndexed(prog->prog, 0, 0, "color0");
+            glBindFragDataLocationIndexed(prog->prog, 0, 1, "color1");
+        }
 
-    if (!glamor_link_glsl_prog(screen, prog->prog, "%s_%s", prim->name, fill->name))
-        goto fail;
+        if (!glamor_link_glsl_prog(screen, prog->prog, "%s_%s", prim->name, fill->name))
+            goto fail;
+
+        glamor_program_cache_store(glamor_priv, prog->prog,
+                                   vs_prog_string, fs_prog_string);
+    }
 
     prog->matrix_uniform = glamor_get_uniform(prog, glamor_program_location_none, "v_matrix");
     prog->fg_uniform = glamor_get_uniform(prog, glamor_program_location_fg, "fg");
@@ -0,0 +1,363 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * @file glamor_program_cache.c
+ *
+ * On-disk cache of linked GL program binaries, so that glamor doesn't
+ * have to compile every shader again on each server start.
+ *
+ * Entries are named after a hash of the GL vendor, renderer and version
+ * strings and the complete shader sources.  The cache lives in
+ * $GLAMOR_SHADER_CACHE_DIR, or $XDG_CACHE_HOME/xorg/glamor (falling back
+ * to ~/.cache/xorg/glamor).  Setting GLAMOR_SHADER_CACHE_DIR to an empty
+ * string disables it.  A setuid server never uses the cache, the
+ * directory and the binaries in it would be under the caller's control.
+ */
+#include <dix-config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "glamor_priv.h"
+
+#define GLAMOR_PROGRAM_CACHE_MAGIC "GLMRPRG1"
+
+/** Larger files aren't ours, or are broken */
+#define GLAMOR_PROGRAM_CACHE_MAX_BINARY (16 * 1024 * 1024)
+
+struct glamor_program_cache_header {
+    char        magic[8];
+    uint64_t    key;
+    uint32_t    format;
+    uint32_t    length;
+};
+
+/* 64-bit FNV-1a */
+static uint64_t
+glamor_program_cache_hash(uint64_t hash, const char *str)
+{
+    if (!str)
+        str = "";
+
+    for (; *str; str++) {
+        hash ^= (unsigned char) *str;
+        hash *= 0x100000001b3ull;
+    }
+    /* Separate consecutive strings */
+    hash ^= 0xff;
+    hash *= 0x100000001b3ull;
+
+    return hash;
+}
+
+static uint64_t
+glamor_program_cache_key(glamor_screen_private *glamor_priv,
+                         const char *vs, const char *fs)
+{
+    uint64_t key = glamor_priv->program_cache_driver;
+
+    key = glamor_program_cache_hash(key, vs);
+    key = glamor_program_cache_hash(key, fs);
+
+    return key;
+}
+
+static char *
+glamor_program_cache_path(glamor_screen_private *glamor_priv, uint64_t key,
+                          const char *suffix)
+{
+    char *path;
+
+    if (asprintf(&path, "%s/%016llx%s", glamor_priv->program_cache_dir,
+                 (unsigned long long) key, suffix) < 0)
+        return NULL;
+    return path;
+}
+
+static Bool
+glamor_program_cache_read(int fd, void *data, size_t size)
+{
+    while (size) {
+        ssize_t ret = read(fd, data, size);
+
+        if (ret <= 0) {
+            if (ret < 0 && errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        data = (char *) data + ret;
+        size -= ret;
+    }
+    return TRUE;
+}
+
+static Bool
+glamor_program_cache_write(int fd, const void *data, size_t size)
+{
+    while (size) {
+        ssize_t ret = write(fd, data, size);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        data = (const char *) data + ret;
+        size -= ret;
+    }
+    return TRUE;
+}
+
+/**
+ * Tries to load @prog from the cache, instead of compiling @vs and @fs
+ * and linking them.  Returns TRUE if @prog is linked and ready to use.
+ *
+ * On a miss, @prog is prepared for glamor_program_cache_store() after
+ * the caller links it.
+ */
+Bool
+glamor_program_cache_load(glamor_screen_private *glamor_priv, GLuint prog,
+                          const char *vs, const char *fs)
+{
+    struct glamor_program_cache_header header;
+    uint64_t key;
+    struct stat st;
+    char *path;
+    void *data = NULL;
+    GLint ok = 0;
+    int fd;
+
+    if (!glamor_priv->program_cache_dir)
+        return FALSE;
+
+    key = glamor_program_cache_key(glamor_priv, vs, fs);
+    path = glamor_program_cache_path(glamor_priv, key, ".bin");
+    if (!path)
+        return FALSE;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        goto miss;
+
+    if (fstat(fd, &st) < 0 ||
+        !glamor_program_cache_read(fd, &header, sizeof(header)) ||
+        memcmp(header.magic, GLAMOR_PROGRAM_CACHE_MAGIC, sizeof(header.magic)) ||
+        header.key != key ||
+        header.length > GLAMOR_PROGRAM_CACHE_MAX_BINARY ||
+        st.st_size != (off_t) (sizeof(header) + header.length))
+        goto stale;
+
+    data = malloc(header.length);
+    if (!data || !glamor_program_cache_read(fd, data, header.length))
+        goto stale;
+
+    glProgramBinary(prog, header.format, data, header.length);
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (!ok)
+        goto stale;
+
+    free(data);
+    close(fd);
+    free(path);
+    glamor_priv->program_cache_hits++;
+    return TRUE;
+
+stale:
+    /* Most likely written by a different build of the driver */
+    unlink(path);
+    free(data);
+    close(fd);
+miss:
+    free(path);
+    glamor_priv->program_cache_misses++;
+    if (glamor_priv->has_program_binary_hint)
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    return FALSE;
+}
+
+/**
+ * Writes the binary of @prog, freshly linked from @vs and @fs, to the
+ * cache.  Entries are written to a temporary file first so that other
+ * servers never see partial ones.
+ */
+void
+glamor_program_cache_store(glamor_screen_private *glamor_priv, GLuint prog,
+                           const char *vs, const char *fs)
+{
+    struct glamor_program_cache_header header;
+    GLint length = 0;
+    GLenum format;
+    uint64_t key;
+    char *path = NULL, *tmp = NULL, suffix[32];
+    void *data = NULL;
+    Bool written;
+    int fd;
+
+    if (!glamor_priv->program_cache_dir)
+        return;
+
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0 || length > GLAMOR_PROGRAM_CACHE_MAX_BINARY)
+        return;
+
+    data = malloc(length);
+    if (!data)
+        return;
+
+    glGetProgramBinary(prog, length, &length, &format, data);
+    if (length <= 0)
+        goto out;
+
+    key = glamor_program_cache_key(glamor_priv, vs, fs);
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int) getpid());
+    path = glamor_program_cache_path(glamor_priv, key, ".bin");
+    tmp = glamor_program_cache_path(glamor_priv, key, suffix);
+    if (!path || !tmp)
+        goto out;
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        goto out;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GLAMOR_PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.key = key;
+    header.format = format;
+    header.length = length;
+
+    written = glamor_program_cache_write(fd, &header, sizeof(header)) &&
+        glamor_program_cache_write(fd, data, length);
+    if (close(fd) < 0)
+        written = FALSE;
+    if (!written || rename(tmp, path) < 0)
+        unlink(tmp);
+
+out:
+    free(tmp);
+    free(path);
+    free(data);
+}
+
+static Bool
+glamor_program_cache_mkdir(char *path)
+{
+    char *p;
+
+    for (p = path + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+            *p = '/';
+            return FALSE;
+        }
+        *p = '/';
+    }
+
+    return mkdir(path, 0700) == 0 || errno == EEXIST;
+}
+
+void
+glamor_program_cache_init(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    const char *dir;
+    const char *base;
+    GLint formats = 0;
+    uint64_t driver = 0xcbf29ce484222325ull;
+    int gl_version = epoxy_gl_version();
+    char *path = NULL;
+
+    /* Don't let the environment pick the cache directory if we're setuid. */
+    if (PrivsElevated())
+        return;
+
+    if (glamor_priv->is_gles) {
+        if (gl_version < 30 &&
+            !epoxy_has_gl_extension("GL_OES_get_program_binary"))
+            return;
+        glamor_priv->has_program_binary_hint = gl_version >= 30;
+    } else {
+        if (gl_version < 41 &&
+            !epoxy_has_gl_extension("GL_ARB_get_program_binary"))
+            return;
+        glamor_priv->has_program_binary_hint = TRUE;
+    }
+
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return;
+
+    dir = getenv("GLAMOR_SHADER_CACHE_DIR");
+    if (dir) {
+        if (!*dir)
+            return;
+        path = strdup(dir);
+    } else if ((base = getenv("XDG_CACHE_HOME")) && *base) {
+        if (asprintf(&path, "%s/xorg/glamor", base) < 0)
+            path = NULL;
+    } else if ((base = getenv("HOME")) && *base) {
+        if (asprintf(&path, "%s/.cache/xorg/glamor", base) < 0)
+            path = NULL;
+    }
+
+    if (!path)
+        return;
+
+    if (!glamor_program_cache_mkdir(path)) {
+        LogMessageVerb(X_WARNING, 0,
+                       "glamor%d: Can't create shader cache %s: %s\n",
+                       screen->myNum, path, strerror(errno));
+        free(path);
+        return;
+    }
+
+    driver = glamor_program_cache_hash(driver, (const char *) glGetString(GL_VENDOR));
+    driver = glamor_program_cache_hash(driver, (const char *) glGetString(GL_RENDERER));
+    driver = glamor_program_cache_hash(driver, (const char *) glGetString(GL_VERSION));
+
+    glamor_priv->program_cache_dir = path;
+    glamor_priv->program_cache_driver = driver;
+}
+
+void
+glamor_program_cache_fini(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+
+    if (!glamor_priv->program_cache_dir)
+        return;
+
+    LogMessageVerb(X_INFO, 3,
+                   "glamor%d: shader cache %s: %u hits, %u misses\n",
+                   screen->myNum, glamor_priv->program_cache_dir,
+                   glamor_priv->program_cache_hits,
+                   glamor_priv->program_cache_misses);
+
+    free(glamor_priv->program_cache_dir);
+    glamor_priv->program_cache_dir = NULL;
+}
@@ -64,8 +64,8 @@ static struct blendinfo composite_op_info[] = {
 };
 
 #define RepeatFix			10
-static GLuint
-glamor_create_composite_fs(glamor_screen_private *glamor_priv, struct shader_key *key, Bool enable_rel_sampler)
+static char *
+glamor_composite_fs_source(glamor_screen_private *glamor_priv, struct shader_key *key, Bool enable_rel_sampler)
 {
     const char *repeat_define =
         "#define RepeatNone               	      0\n"
@@ -262,7 +262,6 @@ glamor_create_composite_fs(glamor_screen_private *glamor_priv, struct shader_key
           "#version 120\n" GLAMOR_COMPAT_DEFINES_FS;
     const char *header_es = glamor_priv->glsl_version > 100 ? "#version 300 es\n" : "#version 100\n" GLAMOR_COMPAT_DEFINES_FS;
     const char *dest_swizzle;
-    GLuint prog;
 
     switch (key->source) {
     case SHADER_SOURCE_SOLID:
@@ -343,14 +342,11 @@ glamor_create_composite_fs(glamor_screen_private *glamor_priv, struct shader_key
                 enable_rel_sampler ? rel_sampler : stub_rel_sampler,
                 source_fetch, mask_fetch, dest_swizzle, in);
 
-    prog = glamor_compile_glsl_prog(GL_FRAGMENT_SHADER, source);
-    free(source);
-
-    return prog;
+    return source;
 }
 
-static GLuint
-glamor_create_composite_vs(glamor_screen_private* priv, struct shader_key *key)
+static char *
+glamor_composite_vs_source(glamor_screen_private* priv, struct shader_key *key)
 {
     const char *main_opening =
         "in vec4 v_position;\n"
@@ -371,7 +367,6 @@ glamor_create_composite_vs(glamor_screen_private* priv, struct shader_key *key)
     const char *version = priv->glsl_version > 120 ? "#version 130\n" : "#version 120\n";
     const char *defines = priv->glsl_version > 120 ? "": GLAMOR_COMPAT_DEFINES_VS;
     char *source;
-    GLuint prog;
 
     if (key->source != SHADER_SOURCE_SOLID)
         source_coords_setup = source_coords;
@@ -392,30 +387,27 @@ glamor_create_composite_vs(glamor_screen_private* priv, struct shader_key *key)
                 version, defines, main_opening, source_coords_setup,
                 mask_coords_setup, main_closing);
 
-    prog = glamor_compile_glsl_prog(GL_VERTEX_SHADER, source);
-    free(source);
-
-    return prog;
+    return source;
 }
 
-static void
-glamor_create_composite_shader(ScreenPtr screen, struct shader_key *key,
-                               glamor_composite_shader *shader)
+static Bool
+glamor_link_composite_program(ScreenPtr screen, struct shader_key *key,
+                              GLuint prog,
+                              const char *vs_source, const char *fs_source)
 {
-    GLuint vs, fs, prog;
-    GLint source_sampler_uniform_location, mask_sampler_uniform_location;
     glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
-    Bool enable_rel_sampler = TRUE;
+    GLuint vs, fs;
+    char *source;
 
-    glamor_make_current(glamor_priv);
-    vs = glamor_create_composite_vs(glamor_priv, key);
+    vs = glamor_compile_glsl_prog(GL_VERTEX_SHADER, vs_source);
     if (vs == 0)
-        return;
-    fs = glamor_create_composite_fs(glamor_priv, key, enable_rel_sampler);
-    if (fs == 0)
-        return;
+        return FALSE;
+    fs = glamor_compile_glsl_prog(GL_FRAGMENT_SHADER, fs_source);
+    if (fs == 0) {
+        glDeleteShader(vs);
+        return FALSE;
+    }
 
-    prog = glCreateProgram();
     glAttachShader(prog, vs);
     glAttachShader(prog, fs);
     glDeleteShader(vs);
@@ -432,20 +424,55 @@ glamor_create_composite_shader(ScreenPtr screen, struct shader_key *key,
 
     if (!glamor_link_glsl_prog(screen, prog, "composite")) {
         /* Failed to link the shader, try again without rel_sampler. */
-        enable_rel_sampler = FALSE;
         glDetachShader(prog, fs);
-        fs = glamor_create_composite_fs(glamor_priv, key, enable_rel_sampler);
+        source = glamor_composite_fs_source(glamor_priv, key, FALSE);
+        fs = glamor_compile_glsl_prog(GL_FRAGMENT_SHADER, source);
+        free(source);
         if (fs == 0)
-            return;
+            return FALSE;
         glAttachShader(prog, fs);
         glDeleteShader(fs);
 
-        if (!glamor_link_glsl_prog(screen, prog, "composite")) {
+        return glamor_link_glsl_prog(screen, prog, "composite");
+    }
+
+    return TRUE;
+}
+
+static void
+glamor_create_composite_shader(ScreenPtr screen, struct shader_key *key,
+                               glamor_composite_shader *shader)
+{
+    GLuint prog;
+    GLint source_sampler_uniform_location, mask_sampler_uniform_location;
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    char *vs_source, *fs_source;
+
+    glamor_make_current(glamor_priv);
+    vs_source = glamor_composite_vs_source(glamor_priv, key);
+    fs_source = glamor_composite_fs_source(glamor_priv, key, TRUE);
+
+    /* Cached under the preferred sources, even if linking needed the
+     * fallback without rel_sampler.
+     */
+    prog = glCreateProgram();
+    if (!glamor_program_cache_load(glamor_priv, prog, vs_source, fs_source)) {
+        if (glamor_link_composite_program(screen, key, prog,
+                                          vs_source, fs_source)) {
+            glamor_program_cache_store(glamor_priv, prog,
+                                       vs_source, fs_source);
+        } else {
             glDeleteProgram(prog);
-            return;
+            prog = 0;
         }
     }
 
+    free(vs_source);
+    free(fs_source);
+
+    if (prog == 0)
+        return;
+
     shader->prog = prog;
 
     glUseProgram(prog);
@@ -492,6 +519,44 @@ glamor_lookup_composite_shader(ScreenPtr screen, struct
     return shader;
 }
 
+/**
+ * Builds the common composite shaders up front, so that the first
+ * Render requests don't stall on the compiler.  With a warm program
+ * cache, this is mostly a matter of loading binaries.
+ */
+void
+glamor_precompile_composite_shaders(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    struct shader_key key = {
+        .dest_swizzle = SHADER_DEST_SWIZZLE_DEFAULT,
+    };
+
+    for (key.source = 0; key.source < SHADER_SOURCE_COUNT; key.source++) {
+        for (key.mask = 0; key.mask < SHADER_MASK_COUNT; key.mask++) {
+            key.in = glamor_program_alpha_normal;
+            glamor_lookup_composite_shader(screen, &key);
+
+            if (key.mask != SHADER_MASK_TEXTURE &&
+                key.mask != SHADER_MASK_TEXTURE_ALPHA)
+                continue;
+
+            /* Component alpha */
+            if (glamor_priv->has_dual_blend) {
+                key.in = glamor_glsl_has_ints(glamor_priv) ?
+                    glamor_program_alpha_dual_blend :
+                    glamor_program_alpha_dual_blend_gles2;
+                glamor_lookup_composite_shader(screen, &key);
+            } else {
+                key.in = glamor_program_alpha_ca_first;
+                glamor_lookup_composite_shader(screen, &key);
+                key.in = glamor_program_alpha_ca_second;
+                glamor_lookup_composite_shader(screen, &key);
+            }
+        }
+    }
+}
+
 static GLenum
 glamor_translate_blend_alpha_to_red(GLenum blend)
 {
@@ -23,11 +23,190 @@
 
 #include <assert.h>
 
+#include "dix/dix_priv.h"
+#include "dix/screen_hooks_priv.h"
 #include "os/bug_priv.h"
 
 #include "glamor_priv.h"
 #include "glamor_transfer.h"
 
+/** Uploads smaller than this are passed straight from client memory. */
+#define GLAMOR_PBO_MIN_UPLOAD   (16 * 1024)
+
+/** Default size of the streaming upload PBO, in bytes. */
+#define GLAMOR_PBO_SIZE         (4 * 1024 * 1024)
+
+/** GetImage requests smaller than this are read back synchronously. */
+#define GLAMOR_READBACK_MIN     (64 * 1024)
+
+/** Longest time between two checks of a readback fence, in ms. */
+#define GLAMOR_READBACK_MAX_POLL        16
+
+/**
+ * A GetImage readback into a pixel pack buffer.  The client sleeps
+ * until the fence signals, and the restarted request then copies the
+ * image out of the mapped buffer.
+ */
+struct glamor_readback {
+    struct xorg_list    link;
+    ClientPtr           client;
+    PixmapPtr           pixmap;
+    /** Area read back, in pixmap coordinates */
+    BoxRec              box;
+    uint32_t            byte_stride;
+    int                 rows_left;
+    GLuint              pbo;
+    /** Pending until the readback is done, NULL afterwards */
+    GLsync              fence;
+    /** When to check the fence next, and the current interval */
+    CARD32              poll_time;
+    CARD32              poll_delay;
+    /** Mapped image once the readback is done, NULL if mapping failed */
+    uint8_t             *map;
+};
+
+static Bool
+glamor_transfer_clip(BoxPtr box, BoxPtr in, int dx, int dy, BoxPtr out)
+{
+    out->x1 = MAX(in->x1 + dx, box->x1);
+    out->x2 = MIN(in->x2 + dx, box->x2);
+    out->y1 = MAX(in->y1 + dy, box->y1);
+    out->y2 = MIN(in->y2 + dy, box->y2);
+
+    return out->x2 > out->x1 && out->y2 > out->y1;
+}
+
+/* Rows are packed in the PBO at GL_UNPACK_ALIGNMENT 4 */
+static inline size_t
+glamor_pbo_stride(int width, int bytes_per_pixel)
+{
+    return ((size_t) width * bytes_per_pixel + 3) & ~3;
+}
+
+/*
+ * Pack all boxes into one mapping of the streaming upload PBO and
+ * source the texture uploads from there, so that we don't wait for
+ * the GL to consume the client's bits.
+ */
+static Bool
+glamor_upload_boxes_pbo(glamor_screen_private *glamor_priv,
+                        glamor_pixmap_private *priv,
+                        const struct glamor_format *f, int bytes_per_pixel,
+                        BoxPtr in_boxes, int in_nbox,
+                        int dx_src, int dy_src,
+                        int dx_dst, int dy_dst,
+                        uint8_t *bits, uint32_t byte_stride,
+                        Bool set_alpha)
+{
+    size_t      size = 0;
+    size_t      offset;
+    uint8_t     *map;
+    BoxRec      r;
+    int         box_index;
+    int         i;
+
+    glamor_pixmap_loop(priv, box_index) {
+        BoxPtr  box = glamor_pixmap_box_at(priv, box_index);
+
+        for (i = 0; i < in_nbox; i++) {
+            if (glamor_transfer_clip(box, &in_boxes[i], dx_dst, dy_dst, &r))
+                size += glamor_pbo_stride(r.x2 - r.x1, bytes_per_pixel) *
+                    (r.y2 - r.y1);
+        }
+    }
+
+    if (size < GLAMOR_PBO_MIN_UPLOAD || size > INT_MAX)
+        return FALSE;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, glamor_priv->upload_pbo);
+
+    if (glamor_priv->upload_pbo_size < glamor_priv->upload_pbo_offset + size) {
+        /* Orphan the old storage, the GL keeps it around until the
+         * uploads sourced from it are done.
+         */
+        glamor_priv->upload_pbo_size = MAX(GLAMOR_PBO_SIZE, size);
+        glamor_priv->upload_pbo_offset = 0;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, glamor_priv->upload_pbo_size,
+                     NULL, GL_STREAM_DRAW);
+    }
+
+    map = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                           glamor_priv->upload_pbo_offset, size,
+                           GL_MAP_WRITE_BIT |
+                           GL_MAP_UNSYNCHRONIZED_BIT |
+                           GL_MAP_INVALIDATE_RANGE_BIT);
+    if (!map) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return FALSE;
+    }
+
+    offset = 0;
+    glamor_pixmap_loop(priv, box_index) {
+        BoxPtr  box = glamor_pixmap_box_at(priv, box_index);
+
+        for (i = 0; i < in_nbox; i++) {
+            size_t      stride;
+            int         w, y;
+            uint8_t     *src, *dst;
+
+            if (!glamor_transfer_clip(box, &in_boxes[i], dx_dst, dy_dst, &r))
+                continue;
+
+            w = r.x2 - r.x1;
+            stride = glamor_pbo_stride(w, bytes_per_pixel);
+            src = bits + (r.y1 - dy_dst + dy_src) * byte_stride +
+                (r.x1 - dx_dst + dx_src) * bytes_per_pixel;
+            dst = map + offset;
+
+            for (y = r.y1; y < r.y2; y++, src += byte_stride, dst += stride) {
+                if (set_alpha) {
+                    uint32_t    *s = (uint32_t *) src;
+                    uint32_t    *d = (uint32_t *) dst;
+                    int         x;
+
+                    /* Make sure any sampling of the alpha channel will return 1.0 */
+                    for (x = 0; x < w; x++)
+                        d[x] = s[x] | 0xff000000;
+                } else {
+                    memcpy(dst, src, w * bytes_per_pixel);
+                }
+            }
+            offset += stride * (r.y2 - r.y1);
+        }
+    }
+
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return FALSE;
+    }
+
+    offset = glamor_priv->upload_pbo_offset;
+    glamor_pixmap_loop(priv, box_index) {
+        BoxPtr                  box = glamor_pixmap_box_at(priv, box_index);
+        glamor_pixmap_fbo       *fbo = glamor_pixmap_fbo_at(priv, box_index);
+
+        glamor_bind_texture(glamor_priv, GL_TEXTURE0, fbo, TRUE);
+
+        for (i = 0; i < in_nbox; i++) {
+            if (!glamor_transfer_clip(box, &in_boxes[i], dx_dst, dy_dst, &r))
+                continue;
+
+            glTexSubImage2D(GL_TEXTURE_2D, 0,
+                            r.x1 - box->x1, r.y1 - box->y1,
+                            r.x2 - r.x1, r.y2 - r.y1,
+                            f->format, f->type,
+                            (void *) (uintptr_t) offset);
+            offset += glamor_pbo_stride(r.x2 - r.x1, bytes_per_pixel) *
+                (r.y2 - r.y1);
+        }
+    }
+
+    glamor_priv->upload_pbo_offset += size;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return TRUE;
+}
+
 /*
  * Write a region of bits into a drawable's backing pixmap
  */
@@ -44,20 +223,30 @@ glamor_upload_boxes(DrawablePtr drawable, BoxPtr in_boxes, int in_nbox,
     int                         box_index;
     const struct glamor_format *f = glamor_format_for_pixmap(pixmap);
     int                         bytes_per_pixel = PIXMAN_FORMAT_BPP(f->render_format) >> 3;
+    Bool                        set_alpha;
     char *tmp_bits = NULL;
 
-    if (glamor_drawable_effective_depth(drawable) == 24 && pixmap->drawable.depth == 32)
-        tmp_bits = XNFalloc(byte_stride * pixmap->drawable.height);
+    BUG_RETURN(!priv);
+
+    set_alpha = glamor_drawable_effective_depth(drawable) == 24 &&
+        pixmap->drawable.depth == 32;
 
     glamor_make_current(glamor_priv);
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
+    if (glamor_priv->has_pbo &&
+        glamor_upload_boxes_pbo(glamor_priv, priv, f, bytes_per_pixel,
+                                in_boxes, in_nbox, dx_src, dy_src,
+                                dx_dst, dy_dst, bits, byte_stride, set_alpha))
+        return;
+
+    if (set_alpha)
+        tmp_bits = XNFalloc(byte_stride * pixmap->drawable.height);
+
     if (glamor_priv->has_unpack_subimage)
         glPixelStorei(GL_UNPACK_ROW_LENGTH, byte_stride / bytes_per_pixel);
 
-    BUG_RETURN(!priv);
-
     glamor_pixmap_loop(priv, box_index) {
         BoxPtr                  box = glamor_pixmap_box_at(priv, box_index);
         glamor_pixmap_fbo       *fbo = glamor_pixmap_fbo_at(priv, box_index);
@@ -139,7 +328,20 @@ glamor_upload_region(DrawablePtr drawable, RegionPtr region,
 }
 
 /*
- * Read stuff from the drawable's backing pixmap FBOs and write to memory
+ * Without bits, the destination is the bound pixel pack buffer and the
+ * offset is passed to the GL as the pointer.
+ */
+static inline void *
+glamor_download_dst(uint8_t *bits, size_t ofs)
+{
+    if (!bits)
+        return (void *) (uintptr_t) ofs;
+    return bits + ofs;
+}
+
+/*
+ * Read stuff from the drawable's backing pixmap FBOs and write to memory,
+ * or to the bound pixel pack buffer if bits is NULL
  */
 void
 glamor_download_boxes(DrawablePtr drawable, BoxPtr in_boxes, int in_nbox,
@@ -190,13 +392,304 @@ glamor_download_boxes(DrawablePtr drawable, BoxPtr in_boxes, int in_nbox,
 
             if (glamor_priv->has_pack_subimage ||
                 x2 - x1 == byte_stride / bytes_per_pixel) {
-                glReadPixels(x1 - box->x1, y1 - box->y1, x2 - x1, y2 - y1, f->format, f->type, bits + ofs);
+                glReadPixels(x1 - box->x1, y1 - box->y1, x2 - x1, y2 - y1, f->format, f->type,
+                             glamor_download_dst(bits, ofs));
             } else {
                 for (; y1 < y2; y1++, ofs += byte_stride)
-                    glReadPixels(x1 - box->x1, y1 - box->y1, x2 - x1, 1, f->format, f->type, bits + ofs);
+                    glReadPixels(x1 - box->x1, y1 - box->y1, x2 - x1, 1, f->format, f->type,
+                                 glamor_download_dst(bits, ofs));
             }
         }
     }
     if (glamor_priv->has_pack_subimage)
         glPixelStorei(GL_PACK_ROW_LENGTH, 0);
 }
+
+static struct glamor_readback *
+glamor_find_readback(glamor_screen_private *glamor_priv, ClientPtr client)
+{
+    struct glamor_readback *rb;
+
+    xorg_list_for_each_entry(rb, &glamor_priv->readbacks, link) {
+        if (rb->client == client)
+            return rb;
+    }
+    return NULL;
+}
+
+static void
+glamor_free_readback(glamor_screen_private *glamor_priv,
+                     struct glamor_readback *rb)
+{
+    glamor_make_current(glamor_priv);
+
+    if (rb->fence)
+        glDeleteSync(rb->fence);
+    if (rb->map) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &rb->pbo);
+
+    xorg_list_del(&rb->link);
+    free(rb);
+}
+
+static Bool
+glamor_readback_wake(ClientPtr client, void *closure)
+{
+    ClientWakeup(client);
+    return TRUE;
+}
+
+/*
+ * Start reading back large ZPixmap GetImage requests into a PBO, and
+ * put the client to sleep instead of stalling the server on the GPU.
+ */
+static void
+glamor_prepare_get_image(CallbackListPtr *pcbl, ScreenPtr screen,
+                         XorgScreenPrepareGetImageParamRec *param)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    DrawablePtr drawable = param->drawable;
+    PixmapPtr pixmap = glamor_get_drawable_pixmap(drawable);
+    glamor_pixmap_private *pixmap_priv = glamor_get_pixmap_private(pixmap);
+    struct glamor_readback *rb;
+    uint32_t byte_stride;
+    BoxRec box;
+    int off_x, off_y;
+
+    if (!param->ready || param->format != ZPixmap)
+        return;
+
+    if (!GLAMOR_PIXMAP_PRIV_HAS_FBO(pixmap_priv))
+        return;
+
+    glamor_get_drawable_deltas(drawable, pixmap, &off_x, &off_y);
+    box.x1 = param->x + drawable->x + off_x;
+    box.y1 = param->y + drawable->y + off_y;
+    box.x2 = box.x1 + param->width;
+    box.y2 = box.y1 + param->height;
+
+    rb = glamor_find_readback(glamor_priv, param->client);
+    if (rb) {
+        /* This is the restarted request, the image is ready for
+         * glamor_get_image() (or needs to be read synchronously if
+         * mapping it failed).
+         */
+        if (!rb->fence && rb->pixmap == pixmap &&
+            rb->box.x1 == box.x1 && rb->box.y1 == box.y1 &&
+            rb->box.x2 == box.x2 && rb->box.y2 == box.y2)
+            return;
+        glamor_free_readback(glamor_priv, rb);
+    }
+
+    byte_stride = PixmapBytePad(param->width, drawable->depth);
+    if ((size_t) byte_stride * param->height < GLAMOR_READBACK_MIN)
+        return;
+
+    rb = calloc(1, sizeof(*rb));
+    if (!rb)
+        return;
+
+    rb->client = param->client;
+    rb->pixmap = pixmap;
+    rb->box = box;
+    rb->byte_stride = byte_stride;
+    rb->rows_left = param->height;
+
+    glamor_make_current(glamor_priv);
+
+    glGenBuffers(1, &rb->pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (size_t) byte_stride * param->height,
+                 NULL, GL_STREAM_READ);
+
+    box.x1 = param->x;
+    box.y1 = param->y;
+    box.x2 = param->x + param->width;
+    box.y2 = param->y + param->height;
+    glamor_download_boxes(drawable, &box, 1,
+                          drawable->x + off_x, drawable->y + off_y,
+                          -param->x, -param->y,
+                          NULL, byte_stride);
+
+    rb->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glFlush();
+
+    rb->poll_delay = 1;
+    rb->poll_time = GetTimeInMillis() + rb->poll_delay;
+
+    xorg_list_add(&rb->link, &glamor_priv->readbacks);
+
+    if (!ClientSleep(param->client, glamor_readback_wake, NULL)) {
+        glamor_free_readback(glamor_priv, rb);
+        return;
+    }
+
+    param->ready = FALSE;
+}
+
+/*
+ * Copy a band of a finished readback into a GetImage reply buffer.
+ * Returns FALSE if there is no readback for this request.
+ */
+Bool
+glamor_get_image_readback(DrawablePtr drawable, int x, int y, int w, int h,
+                          char *d)
+{
+    ScreenPtr screen = drawable->pScreen;
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    PixmapPtr pixmap = glamor_get_drawable_pixmap(drawable);
+    ClientPtr client = GetCurrentClient();
+    struct glamor_readback *rb;
+    int off_x, off_y;
+
+    if (!client || xorg_list_is_empty(&glamor_priv->readbacks))
+        return FALSE;
+
+    rb = glamor_find_readback(glamor_priv, client);
+    if (!rb || rb->fence || rb->pixmap != pixmap)
+        return FALSE;
+
+    if (!rb->map) {
+        glamor_free_readback(glamor_priv, rb);
+        return FALSE;
+    }
+
+    glamor_get_drawable_deltas(drawable, pixmap, &off_x, &off_y);
+    x += drawable->x + off_x;
+    y += drawable->y + off_y;
+    if (x != rb->box.x1 || x + w != rb->box.x2 ||
+        y < rb->box.y1 || y + h > rb->box.y2)
+        return FALSE;
+
+    memcpy(d, rb->map + (size_t) (y - rb->box.y1) * rb->byte_stride,
+           (size_t) h * rb->byte_stride);
+
+    rb->rows_left -= h;
+    if (rb->rows_left <= 0)
+        glamor_free_readback(glamor_priv, rb);
+
+    return TRUE;
+}
+
+/*
+ * Map finished readbacks and wake up their clients.  GL has no way to
+ * wake us up when a fence signals, so fences are polled, at doubling
+ * intervals of up to GLAMOR_READBACK_MAX_POLL ms while a readback is
+ * still in flight.  Other wakeups check them in between for free.
+ */
+void
+glamor_transfer_block_handler(ScreenPtr screen, void *timeout)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    struct glamor_readback *rb;
+    CARD32 now;
+
+    if (xorg_list_is_empty(&glamor_priv->readbacks))
+        return;
+
+    glamor_make_current(glamor_priv);
+    now = GetTimeInMillis();
+
+    xorg_list_for_each_entry(rb, &glamor_priv->readbacks, link) {
+        if (!rb->fence)
+            continue;
+
+        if (glClientWaitSync(rb->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            if ((INT32) (now - rb->poll_time) >= 0) {
+                rb->poll_delay = min(rb->poll_delay * 2,
+                                     GLAMOR_READBACK_MAX_POLL);
+                rb->poll_time = now + rb->poll_delay;
+            }
+            AdjustWaitForDelay(timeout, rb->poll_time - now);
+            continue;
+        }
+
+        glDeleteSync(rb->fence);
+        rb->fence = NULL;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+        rb->map = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                   (size_t) rb->byte_stride *
+                                   (rb->box.y2 - rb->box.y1),
+                                   GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        dixClientSignal(rb->client);
+    }
+}
+
+/* Drop readbacks from a pixmap that is going away */
+void
+glamor_transfer_pixmap_destroy(PixmapPtr pixmap)
+{
+    glamor_screen_private *glamor_priv =
+        glamor_get_screen_private(pixmap->drawable.pScreen);
+    struct glamor_readback *rb, *tmp;
+
+    xorg_list_for_each_entry_safe(rb, tmp, &glamor_priv->readbacks, link) {
+        if (rb->pixmap != pixmap)
+            continue;
+        /* Let the request run again and find out what happened */
+        if (rb->fence)
+            dixClientSignal(rb->client);
+        glamor_free_readback(glamor_priv, rb);
+    }
+}
+
+static void
+glamor_transfer_client_state(CallbackListPtr *pcbl, void *closure, void *data)
+{
+    ScreenPtr screen = closure;
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    NewClientInfoRec *clientinfo = data;
+    struct glamor_readback *rb;
+
+    if (clientinfo->client->clientState != ClientStateGone &&
+        clientinfo->client->clientState != ClientStateRetained)
+        return;
+
+    rb = glamor_find_readback(glamor_priv, clientinfo->client);
+    if (rb)
+        glamor_free_readback(glamor_priv, rb);
+}
+
+void
+glamor_init_transfer(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+
+    xorg_list_init(&glamor_priv->readbacks);
+
+    if (glamor_priv->has_pbo) {
+        glamor_make_current(glamor_priv);
+        glGenBuffers(1, &glamor_priv->upload_pbo);
+    }
+
+    if (glamor_priv->has_pbo && glamor_priv->has_sync &&
+        AddCallback(&ClientStateCallback, glamor_transfer_client_state, screen))
+        dixScreenHookPrepareGetImage(screen, glamor_prepare_get_image);
+}
+
+void
+glamor_fini_transfer(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    struct glamor_readback *rb, *tmp;
+
+    dixScreenUnhookPrepareGetImage(screen, glamor_prepare_get_image);
+    DeleteCallback(&ClientStateCallback, glamor_transfer_client_state, screen);
+
+    xorg_list_for_each_entry_safe(rb, tmp, &glamor_priv->readbacks, link)
+        glamor_free_readback(glamor_priv, rb);
+
+    if (glamor_priv->upload_pbo) {
+        glamor_make_current(glamor_priv);
+        glDeleteBuffers(1, &glamor_priv->upload_pbo);
+        glamor_priv->upload_pbo = 0;
+    }
+}
@@ -40,4 +40,20 @@ glamor_download_boxes(DrawablePtr drawable, BoxPtr in_boxes, int in_nbox,
                       int dx_dst, int dy_dst,
                       uint8_t *bits, uint32_t byte_stride);
 
+Bool
+glamor_get_image_readback(DrawablePtr drawable, int x, int y, int w, int h,
+                          char *d);
+
+void
+glamor_transfer_block_handler(ScreenPtr screen, void *timeout);
+
+void
+glamor_transfer_pixmap_destroy(PixmapPtr pixmap);
+
+void
+glamor_init_transfer(ScreenPtr screen);
+
+void
+glamor_fini_transfer(ScreenPtr screen);
+
 #endif /* _GLAMOR_TRANSFER_H_ */
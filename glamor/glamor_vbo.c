@@ -39,6 +39,127 @@
  */
 #define GLAMOR_VBO_SIZE (512 * 1024)
 
+/** Largest size the ARB_buffer_storage ring grows to on its own.
+ *
+ * Each time we wrap around the ring after having had to wait for the
+ * GPU to release a segment, the ring is doubled up to this size.
+ */
+#define GLAMOR_VBO_MAX_SIZE (8 * 1024 * 1024)
+
+/** How long to block on a segment fence per glClientWaitSync() call. */
+#define GLAMOR_VBO_WAIT_NS (1000 * 1000 * 1000ull)
+
+static int
+glamor_vbo_round_size(unsigned size)
+{
+    const unsigned align = GLAMOR_VBO_SEGMENTS * 4096;
+
+    return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ * Puts a fence behind every segment of the ring below @end that has
+ * been written during this lap and not fenced yet.  All draws reading
+ * from those segments have been queued by the time we move past them.
+ */
+static void
+glamor_vbo_fence_segments(glamor_screen_private *glamor_priv, int end)
+{
+    while (glamor_priv->vbo_fence_next < end) {
+        int i = glamor_priv->vbo_fence_next++;
+
+        if (glamor_priv->vbo_fences[i])
+            glDeleteSync(glamor_priv->vbo_fences[i]);
+        glamor_priv->vbo_fences[i] =
+            glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+/**
+ * Waits until the GPU is done with the previous lap's contents of
+ * segments [@start, @end), so that they can be overwritten.
+ */
+static void
+glamor_vbo_wait_segments(glamor_screen_private *glamor_priv,
+                         int start, int end)
+{
+    int i;
+
+    for (i = start; i < end; i++) {
+        GLsync fence = glamor_priv->vbo_fences[i];
+        GLenum status;
+
+        if (!fence)
+            continue;
+
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            glamor_priv->vbo_stats.stalls++;
+            glamor_priv->vbo_stalled = TRUE;
+            do {
+                status = glClientWaitSync(fence, 0, GLAMOR_VBO_WAIT_NS);
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+
+        glDeleteSync(fence);
+        glamor_priv->vbo_fences[i] = NULL;
+    }
+}
+
+static void
+glamor_vbo_drop_fences(glamor_screen_private *glamor_priv)
+{
+    int i;
+
+    for (i = 0; i < GLAMOR_VBO_SEGMENTS; i++) {
+        if (glamor_priv->vbo_fences[i]) {
+            glDeleteSync(glamor_priv->vbo_fences[i]);
+            glamor_priv->vbo_fences[i] = NULL;
+        }
+    }
+}
+
+/**
+ * Replaces the ARB_buffer_storage ring with a new persistently mapped
+ * buffer of @size bytes.  The old buffer may still be in use by the
+ * GPU, but the GL keeps it alive until it's idle.
+ */
+static Bool
+glamor_vbo_alloc_storage(glamor_screen_private *glamor_priv, int size)
+{
+    glamor_vbo_drop_fences(glamor_priv);
+
+    if (glamor_priv->vbo_size)
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    /* We aren't allowed to resize glBufferStorage() buffers, so we
+     * need to gen a new one.
+     */
+    glDeleteBuffers(1, &glamor_priv->vbo);
+    glGenBuffers(1, &glamor_priv->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, glamor_priv->vbo);
+
+    glamor_priv->vbo_size = 0;
+    glamor_priv->vbo_offset = 0;
+    glamor_priv->vbo_fence_next = 0;
+    glamor_priv->vbo_stalled = FALSE;
+
+    assert(glGetError() == GL_NO_ERROR);
+    glBufferStorage(GL_ARRAY_BUFFER, size, NULL,
+                    GL_MAP_WRITE_BIT |
+                    GL_MAP_PERSISTENT_BIT |
+                    GL_MAP_COHERENT_BIT);
+    if (glGetError() != GL_NO_ERROR)
+        return FALSE;
+
+    glamor_priv->vb = glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                                       GL_MAP_WRITE_BIT |
+                                       GL_MAP_PERSISTENT_BIT |
+                                       GL_MAP_COHERENT_BIT);
+    glamor_priv->vbo_size = size;
+    return TRUE;
+}
+
 /**
  * Returns a pointer to @size bytes of VBO storage, which should be
  * accessed by the GL using vbo_offset within the VBO.
@@ -54,27 +175,32 @@ glamor_get_vbo_space(ScreenPtr screen, unsigned size, char **vbo_offset)
     glBindBuffer(GL_ARRAY_BUFFER, glamor_priv->vbo);
 
     if (glamor_priv->has_buffer_storage) {
-        if (glamor_priv->vbo_size < glamor_priv->vbo_offset + size) {
-            if (glamor_priv->vbo_size)
-                glUnmapBuffer(GL_ARRAY_BUFFER);
+        /* The persistent mapping is split into GLAMOR_VBO_SEGMENTS
+         * segments.  We fence each segment once we've moved past
+         * it, and only wait on that fence when wrapping around to
+         * it again, so the CPU keeps writing while the GPU reads the
+         * rest of the ring.
+         */
+        int seg_size, first;
 
-            if (size > glamor_priv->vbo_size) {
-                glamor_priv->vbo_size = MAX(GLAMOR_VBO_SIZE, size);
+        if (glamor_priv->vbo_size < glamor_priv->vbo_offset + size) {
+            int new_size = glamor_priv->vbo_size;
 
-                /* We aren't allowed to resize glBufferStorage()
-                 * buffers, so we need to gen a new one.
-                 */
-                glDeleteBuffers(1, &glamor_priv->vbo);
-                glGenBuffers(1, &glamor_priv->vbo);
-                glBindBuffer(GL_ARRAY_BUFFER, glamor_priv->vbo);
+            if (glamor_priv->vbo_size)
+                glamor_priv->vbo_stats.wraps++;
 
-                assert(glGetError() == GL_NO_ERROR);
-                glBufferStorage(GL_ARRAY_BUFFER, glamor_priv->vbo_size, NULL,
-                                GL_MAP_WRITE_BIT |
-                                GL_MAP_PERSISTENT_BIT |
-                                GL_MAP_COHERENT_BIT);
+            /* Grow the ring if the last lap caught up with the GPU,
+             * and shrink back after an oversized request.
+             */
+            if (glamor_priv->vbo_stalled)
+                new_size *= 2;
+            new_size = MIN(new_size, GLAMOR_VBO_MAX_SIZE);
+            new_size = MAX(new_size, GLAMOR_VBO_SIZE);
+            if (new_size < size)
+                new_size = glamor_vbo_round_size(size);
 
-                if (glGetError() != GL_NO_ERROR) {
+            if (new_size != glamor_priv->vbo_size) {
+                if (!glamor_vbo_alloc_storage(glamor_priv, new_size)) {
                     /* If the driver failed our coherent mapping, fall
                      * back to the ARB_mbr path.
                      */
@@ -83,16 +209,26 @@ glamor_get_vbo_space(ScreenPtr screen, unsigned size, char **vbo_offset)
 
                     return glamor_get_vbo_space(screen, size, vbo_offset);
                 }
+            } else {
+                seg_size = glamor_priv->vbo_size / GLAMOR_VBO_SEGMENTS;
+                glamor_vbo_fence_segments(glamor_priv,
+                                          (glamor_priv->vbo_offset +
+                                           seg_size - 1) / seg_size);
+                glamor_priv->vbo_offset = 0;
+                glamor_priv->vbo_fence_next = 0;
+                glamor_priv->vbo_stalled = FALSE;
             }
+        }
 
-            glamor_priv->vbo_offset = 0;
-            glamor_priv->vb = glMapBufferRange(GL_ARRAY_BUFFER,
-                                               0, glamor_priv->vbo_size,
-                                               GL_MAP_WRITE_BIT |
-                                               GL_MAP_INVALIDATE_BUFFER_BIT |
-                                               GL_MAP_PERSISTENT_BIT |
-                                               GL_MAP_COHERENT_BIT);
+        seg_size = glamor_priv->vbo_size / GLAMOR_VBO_SEGMENTS;
+        first = glamor_priv->vbo_offset / seg_size;
+        glamor_vbo_fence_segments(glamor_priv, first);
+        if (size) {
+            glamor_vbo_wait_segments(glamor_priv, first,
+                                     (glamor_priv->vbo_offset + size - 1) /
+                                     seg_size + 1);
         }
+
         *vbo_offset = (void *)(uintptr_t)glamor_priv->vbo_offset;
         data = glamor_priv->vb + glamor_priv->vbo_offset;
         glamor_priv->vbo_offset += size;
@@ -139,6 +275,8 @@ glamor_get_vbo_space(ScreenPtr screen, unsigned size, char **vbo_offset)
         data = glamor_priv->vb;
     }
 
+    glamor_priv->vbo_stats.bytes += size;
+
     return data;
 }
 
@@ -186,6 +324,18 @@ glamor_fini_vbo(ScreenPtr screen)
 
     glamor_make_current(glamor_priv);
 
+    LogMessageVerb(X_INFO, 3,
+                   "glamor%d: streamed %llu bytes of vertices, "
+                   "VBO size %d, %u wraps, %u stalls\n",
+                   screen->myNum,
+                   (unsigned long long) glamor_priv->vbo_stats.bytes,
+                   glamor_priv->vbo_size,
+                   glamor_priv->vbo_stats.wraps,
+                   glamor_priv->vbo_stats.stalls);
+
+    if (glamor_priv->has_buffer_storage)
+        glamor_vbo_drop_fences(glamor_priv);
+
     glDeleteVertexArrays(1, &glamor_priv->vao);
     glamor_priv->vao = 0;
     if (!glamor_priv->has_map_buffer_range)
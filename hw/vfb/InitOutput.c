@@ -75,6 +75,7 @@ from The Open Group.
 #include "miline.h"
 #include "glx_extinit.h"
 #include "randrstr.h"
+#include "vfb.h"
 
 #define VFB_DEFAULT_WIDTH      1280
 #define VFB_DEFAULT_HEIGHT     1024
@@ -85,14 +86,6 @@ from The Open Group.
 #define VFB_DEFAULT_NUM_CRTCS     1
 #define XWD_WINDOW_NAME_LEN      60
 
-typedef struct {
-    int width;
-    int height;
-    int x;
-    int y;
-    int numOutputs;
-} vfbCrtcInfo, *vfbCrtcInfoPtr;
-
 typedef struct {
     int width;
     int paddedBytesWidth;
@@ -104,6 +97,7 @@ typedef struct {
     int ncolors;
     int numCrtcs;
     vfbCrtcInfoPtr crtcs;
+    int refresh;
     char *pfbMemory;
     XWDColor *pXWDCmap;
     XWDFileHeader *pXWDHeader;
@@ -132,6 +126,7 @@ static vfbScreenInfo defaultScreenInfo = {
     .blackPixel = VFB_DEFAULT_BLACKPIXEL,
     .whitePixel = VFB_DEFAULT_WHITEPIXEL,
     .lineBias = VFB_DEFAULT_LINEBIAS,
+    .refresh = VFB_DEFAULT_REFRESH,
 };
 
 static Bool vfbPixmapDepths[33];
@@ -301,6 +296,8 @@ ddxUseMsg(void)
 
     ErrorF("-crtcs n               number of CRTCs per screen (default: %d)\n",
            VFB_DEFAULT_NUM_CRTCS);
+    ErrorF("-refresh n             vblank rate of the CRTCs in Hz (default: %d)\n",
+           VFB_DEFAULT_REFRESH);
 }
 
 int
@@ -437,6 +434,23 @@ ddxProcessArgument(int argc, char *argv[], int i)
         return 2;
     }
 
+    if (strcmp(argv[i], "-refresh") == 0) {     /* -refresh n */
+        int refresh;
+
+        CHECK_FOR_REQUIRED_ARGUMENTS(1);
+        refresh = atoi(argv[i + 1]);
+
+        if (refresh < 1 || refresh > 1000) {
+            ErrorF("Invalid refresh rate %d\n", refresh);
+            UseMsg();
+            FatalError("Invalid refresh rate (%d) passed to -refresh\n",
+                       refresh);
+        }
+
+        currentScreen->refresh = refresh;
+        return 2;
+    }
+
     return 0;
 }
 
@@ -779,9 +793,13 @@ static Bool
 vfbCloseScreen(ScreenPtr pScreen)
 {
     vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+    int i;
 
     pScreen->CloseScreen = pvfb->closeScreen;
 
+    for (i = 0; i < pvfb->numCrtcs; i++)
+        vfbPresentCrtcFini(&pvfb->crtcs[i]);
+
     /*
      * fb overwrites miCloseScreen, so do this here
      */
@@ -849,6 +867,7 @@ vfbRRCrtcSet(ScreenPtr pScreen,
         if (mode) {
             pvci->width = mode->mode.width;
             pvci->height = mode->mode.height;
+            vfbPresentCrtcSetMode(pvci, mode);
         }
 
         pvci->x = x;
@@ -909,6 +928,9 @@ vfbRandRInit(ScreenPtr pScreen)
         if (!crtc)
             return FALSE;
 
+        if (!vfbPresentCrtcInit(pvci, pvfb->refresh))
+            return FALSE;
+
         /* Set gamma to avoid xrandr complaints */
         RRCrtcGammaSetSize(crtc, 256);
 
@@ -934,6 +956,13 @@ vfbRandRInit(ScreenPtr pScreen)
             modeInfo.height = pvci->height;
             modeInfo.nameLength = strlen(name);
 
+            /* Blank-free timings, so that clients see the refresh rate */
+            if ((uint64_t) pvci->width * pvci->height * pvfb->refresh <= UINT32_MAX) {
+                modeInfo.hTotal = pvci->width;
+                modeInfo.vTotal = pvci->height;
+                modeInfo.dotClock = pvci->width * pvci->height * pvfb->refresh;
+            }
+
             mode = RRModeGet(&modeInfo, name);
             if (!mode)
                 return FALSE;
@@ -1024,6 +1053,12 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     if (!vfbRandRInit(pScreen))
        return FALSE;
 
+    /* Flipped pixmaps never make it to the framebuffer memory, so only
+     * flip when nobody else can look at it
+     */
+    if (!vfbPresentScreenInit(pScreen, fbmemtype == NORMAL_MEMORY_FB))
+        return FALSE;
+
     pScreen->InstallColormap = vfbInstallColormap;
     pScreen->StoreColors = vfbStoreColors;
 
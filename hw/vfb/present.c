@@ -0,0 +1,270 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Present support for Xvfb.
+ *
+ * Every CRTC has a virtual vblank clock running at the refresh rate of
+ * its mode, so that clients see per-CRTC MSC and UST values just like on
+ * real hardware.  Flips don't have any scanout to reprogram, so they
+ * simply complete at the next vblank (or immediately, for async flips),
+ * which saves Present the full-screen copy it would otherwise do.
+ */
+
+#include <dix-config.h>
+
+#include <X11/X.h>
+
+#include "present.h"
+#include "present/present_timer_priv.h"
+#include "vfb.h"
+
+struct vfbPresentCrtc {
+    /* UST of MSC 0 and the time between vblanks, in microseconds */
+    uint64_t base;
+    uint64_t interval;
+    present_timer_queue_rec events;
+};
+
+static vfbPresentCrtcPtr
+vfbPresentCrtcPriv(RRCrtcPtr crtc)
+{
+    vfbCrtcInfoPtr pvci = crtc->devPrivate;
+
+    return pvci->present;
+}
+
+static uint64_t
+vfbPresentCrtcMsc(vfbPresentCrtcPtr pc, uint64_t ust)
+{
+    return (ust - pc->base) / pc->interval;
+}
+
+static void
+vfbPresentCrtcNow(void *closure, uint64_t *ust, uint64_t *msc)
+{
+    vfbPresentCrtcPtr pc = closure;
+
+    *msc = vfbPresentCrtcMsc(pc, GetTimeInMicros());
+    *ust = pc->base + *msc * pc->interval;
+}
+
+static uint64_t
+vfbPresentCrtcUst(void *closure, uint64_t msc)
+{
+    vfbPresentCrtcPtr pc = closure;
+
+    return pc->base + msc * pc->interval;
+}
+
+/*
+ * The CRTC showing the largest part of the window
+ */
+static RRCrtcPtr
+vfbPresentGetCrtc(WindowPtr pWin)
+{
+    rrScrPrivPtr pScrPriv = rrGetScrPriv(pWin->drawable.pScreen);
+    RRCrtcPtr best = NULL;
+    int64_t bestArea = 0;
+    int i;
+
+    if (!pScrPriv)
+        return NULL;
+
+    for (i = 0; i < pScrPriv->numCrtcs; i++) {
+        RRCrtcPtr crtc = pScrPriv->crtcs[i];
+        int x1, y1, x2, y2;
+        int64_t area;
+
+        if (!crtc->mode)
+            continue;
+
+        x1 = max(pWin->drawable.x, crtc->x);
+        y1 = max(pWin->drawable.y, crtc->y);
+        x2 = min(pWin->drawable.x + pWin->drawable.width,
+                 crtc->x + crtc->mode->mode.width);
+        y2 = min(pWin->drawable.y + pWin->drawable.height,
+                 crtc->y + crtc->mode->mode.height);
+        if (x1 >= x2 || y1 >= y2)
+            continue;
+
+        area = (int64_t) (x2 - x1) * (y2 - y1);
+        if (area > bestArea) {
+            best = crtc;
+            bestArea = area;
+        }
+    }
+
+    return best;
+}
+
+static int
+vfbPresentGetUstMsc(RRCrtcPtr crtc, uint64_t *ust, uint64_t *msc)
+{
+    vfbPresentCrtcNow(vfbPresentCrtcPriv(crtc), ust, msc);
+    return Success;
+}
+
+static int
+vfbPresentQueueVblank(RRCrtcPtr crtc, uint64_t event_id, uint64_t msc)
+{
+    vfbPresentCrtcPtr pc = vfbPresentCrtcPriv(crtc);
+
+    return present_timer_queue_add(&pc->events, event_id, msc);
+}
+
+static void
+vfbPresentAbortVblank(RRCrtcPtr crtc, uint64_t event_id, uint64_t msc)
+{
+    vfbPresentCrtcPtr pc = vfbPresentCrtcPriv(crtc);
+
+    present_timer_queue_abort(&pc->events, event_id);
+}
+
+static Bool
+vfbPresentCheckFlip(RRCrtcPtr crtc, WindowPtr pWin, PixmapPtr pPixmap,
+                    Bool sync_flip)
+{
+    ScreenPtr pScreen = pWin->drawable.pScreen;
+    PixmapPtr pScreenPixmap = pScreen->GetScreenPixmap(pScreen);
+
+    if (!crtc || !crtc->mode)
+        return FALSE;
+
+    return pPixmap->drawable.depth == pScreenPixmap->drawable.depth &&
+        pPixmap->drawable.bitsPerPixel == pScreenPixmap->drawable.bitsPerPixel;
+}
+
+static Bool
+vfbPresentFlip(RRCrtcPtr crtc, uint64_t event_id, uint64_t target_msc,
+               PixmapPtr pPixmap, Bool sync_flip)
+{
+    vfbPresentCrtcPtr pc = vfbPresentCrtcPriv(crtc);
+    uint64_t msc = vfbPresentCrtcMsc(pc, GetTimeInMicros());
+
+    return present_timer_queue_add(&pc->events, event_id,
+                                   sync_flip ? msc + 1 : msc) == Success;
+}
+
+static void
+vfbPresentUnflip(ScreenPtr pScreen, uint64_t event_id)
+{
+    rrScrPrivPtr pScrPriv = rrGetScrPriv(pScreen);
+    vfbPresentCrtcPtr pc = vfbPresentCrtcPriv(pScrPriv->crtcs[0]);
+    uint64_t msc = vfbPresentCrtcMsc(pc, GetTimeInMicros());
+
+    if (present_timer_queue_add(&pc->events, event_id, msc) != Success)
+        present_event_notify(event_id, 0, 0);
+}
+
+static present_screen_info_rec vfbPresentInfo = {
+    .version = PRESENT_SCREEN_INFO_VERSION,
+
+    .get_crtc = vfbPresentGetCrtc,
+    .get_ust_msc = vfbPresentGetUstMsc,
+    .queue_vblank = vfbPresentQueueVblank,
+    .abort_vblank = vfbPresentAbortVblank,
+    .flush = NULL,
+
+    .capabilities = PresentCapabilityNone,
+};
+
+static present_screen_info_rec vfbPresentFlipInfo = {
+    .version = PRESENT_SCREEN_INFO_VERSION,
+
+    .get_crtc = vfbPresentGetCrtc,
+    .get_ust_msc = vfbPresentGetUstMsc,
+    .queue_vblank = vfbPresentQueueVblank,
+    .abort_vblank = vfbPresentAbortVblank,
+    .flush = NULL,
+
+    .capabilities = PresentCapabilityAsync,
+    .check_flip = vfbPresentCheckFlip,
+    .flip = vfbPresentFlip,
+    .unflip = vfbPresentUnflip,
+};
+
+Bool
+vfbPresentScreenInit(ScreenPtr pScreen, Bool flips)
+{
+    /* -fakescreenfps asks for Present's own fake vblanks instead */
+    if (FakeScreenFps)
+        return TRUE;
+
+    return present_screen_init(pScreen, flips ? &vfbPresentFlipInfo
+                                              : &vfbPresentInfo);
+}
+
+Bool
+vfbPresentCrtcInit(vfbCrtcInfoPtr pvci, int refresh)
+{
+    vfbPresentCrtcPtr pc = calloc(1, sizeof(*pc));
+
+    if (!pc)
+        return FALSE;
+
+    pc->base = GetTimeInMicros();
+    pc->interval = 1000000 / refresh;
+    present_timer_queue_init(&pc->events, vfbPresentCrtcNow, vfbPresentCrtcUst,
+                             pc);
+
+    pvci->present = pc;
+    return TRUE;
+}
+
+/*
+ * Follow the refresh rate of a newly set mode, without the MSC going
+ * backwards
+ */
+void
+vfbPresentCrtcSetMode(vfbCrtcInfoPtr pvci, RRModePtr mode)
+{
+    vfbPresentCrtcPtr pc = pvci->present;
+    xRRModeInfo *info = &mode->mode;
+    uint64_t interval, now, msc;
+
+    if (!pc || !info->dotClock || !info->hTotal || !info->vTotal)
+        return;
+
+    interval = (uint64_t) info->hTotal * info->vTotal * 1000000 / info->dotClock;
+    if (!interval || interval == pc->interval)
+        return;
+
+    now = GetTimeInMicros();
+    msc = vfbPresentCrtcMsc(pc, now);
+    pc->base = now - msc * interval;
+    pc->interval = interval;
+
+    present_timer_queue_update(&pc->events);
+}
+
+void
+vfbPresentCrtcFini(vfbCrtcInfoPtr pvci)
+{
+    vfbPresentCrtcPtr pc = pvci->present;
+
+    if (!pc)
+        return;
+
+    present_timer_queue_fini(&pc->events);
+    free(pc);
+    pvci->present = NULL;
+}
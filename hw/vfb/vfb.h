@@ -0,0 +1,47 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef _VFB_H_
+#define _VFB_H_
+
+#include "scrnintstr.h"
+#include "randrstr.h"
+
+#define VFB_DEFAULT_REFRESH      60
+
+typedef struct vfbPresentCrtc vfbPresentCrtcRec, *vfbPresentCrtcPtr;
+
+typedef struct {
+    int width;
+    int height;
+    int x;
+    int y;
+    int numOutputs;
+    vfbPresentCrtcPtr present;
+} vfbCrtcInfo, *vfbCrtcInfoPtr;
+
+/* present.c */
+Bool vfbPresentScreenInit(ScreenPtr pScreen, Bool flips);
+Bool vfbPresentCrtcInit(vfbCrtcInfoPtr pvci, int refresh);
+void vfbPresentCrtcSetMode(vfbCrtcInfoPtr pvci, RRModePtr mode);
+void vfbPresentCrtcFini(vfbCrtcInfoPtr pvci);
+
+#endif /* _VFB_H_ */
@@ -78,11 +78,11 @@
 /* XXX This is a compile-time option that changes abi XXX */
 /* TODO: Remove this toggle in 26.0 */
 #ifdef CONFIG_LEGACY_NVIDIA_PADDING
-#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(28, 1)
+#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(29, 1)
 #else
-#define ABI_VIDEODRV_VERSION    SET_ABI_VERSION(28, 0)
+#define ABI_VIDEODRV_VERSION    SET_ABI_VERSION(29, 0)
 #endif
-#define ABI_XINPUT_VERSION	SET_ABI_VERSION(26, 0)
+#define ABI_XINPUT_VERSION	SET_ABI_VERSION(27, 0)
 #define ABI_EXTENSION_VERSION	SET_ABI_VERSION(11, 0)
 
 /* hack to get both modern and ancient nvidia DDX drivers to work at the same time */
@@ -62,6 +62,7 @@
 #include "dix/inpututils_priv.h"
 #include "dix/ptrveloc_priv.h"
 #include "dix/screenint_priv.h"
+#include "xkb/xkbsrv_priv.h"
 
 #include "xf86_priv.h"
 #include "xf86Priv.h"
@@ -355,6 +356,7 @@ ApplyAutoRepeat(DeviceIntPtr dev)
     LogMessageVerb(X_CONFIG, 1, "AutoRepeat: %ld %ld\n", delay, rate);
     xkbi->desc->ctrls->repeat_delay = delay;
     xkbi->desc->ctrls->repeat_interval = 1000 / rate;
+    XkbKeymapChanged(xkbi);
 }
 
 /***********************************************************************
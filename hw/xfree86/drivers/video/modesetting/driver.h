@@ -87,7 +87,12 @@ typedef void (*ms_drm_abort_proc)(void *data);
  * the kernel, and what to do when it is encountered.
  */
 struct ms_drm_queue {
+    /* All entries, entries with the same seq hash and entries on the same
+     * CRTC, each in the order they were allocated
+     */
     struct xorg_list list;
+    struct xorg_list hash;
+    struct xorg_list crtc_list;
     xf86CrtcPtr crtc;
     uint32_t seq;
     uint64_t msc;
@@ -191,6 +196,11 @@ uint32_t ms_drm_queue_alloc(xf86CrtcPtr crtc,
                             void *data,
                             ms_drm_handler_proc handler,
                             ms_drm_abort_proc abort);
+uint32_t ms_drm_queue_alloc_seq(xf86CrtcPtr crtc,
+                                uint32_t seq,
+                                void *data,
+                                ms_drm_handler_proc handler,
+                                ms_drm_abort_proc abort);
 
 typedef enum ms_queue_flag {
     MS_QUEUE_ABSOLUTE = 0,
@@ -207,6 +217,8 @@ void ms_drm_abort(ScrnInfoPtr scrn,
 void ms_drm_abort_seq(ScrnInfoPtr scrn, uint32_t seq);
 
 Bool ms_drm_queue_is_empty(void);
+Bool ms_drm_queue_flip_pending(ScrnInfoPtr scrn);
+void ms_drm_abort_flips(ScrnInfoPtr scrn);
 
 Bool xf86_crtc_on(xf86CrtcPtr crtc);
 
@@ -256,6 +268,17 @@ Bool ms_do_tearfree_flip(ScreenPtr screen, xf86CrtcPtr crtc);
 
 #endif
 
+/* How long to wait for the kernel to deliver an event we depend on before
+ * giving up on it, so that a lost event can't hang the server.  This only
+ * bounds the wait: retrying a flip on EBUSY, waiting for a TearFree flip
+ * and draining flips before a modeset still block the main loop for up
+ * to this long.  They can't be deferred, the flip result is reported to
+ * the caller right away and RandR modesets complete synchronously.  Flips
+ * still pending before a modeset after this long are aborted.
+ */
+#define MS_DRM_EVENT_TIMEOUT_MS 1000
+
+int ms_flush_drm_events_timeout(ScreenPtr screen, int timeout);
 int ms_flush_drm_events(ScreenPtr screen);
 void ms_drain_drm_events(ScreenPtr screen);
 Bool ms_window_has_variable_refresh(modesettingPtr ms, WindowPtr win);
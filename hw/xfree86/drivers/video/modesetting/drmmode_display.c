@@ -986,6 +986,32 @@ drmmode_crtc_flip(xf86CrtcPtr crtc, uint32_t fb_id, int x, int y,
                            fb_id, flags, data);
 }
 
+/*
+ * Flip all of @crtcs to @fb_id, at their own offsets, in a single atomic
+ * commit so that they all latch the new frame buffer together.  The kernel
+ * sends one event per CRTC, all with the same @data.
+ */
+int
+drmmode_crtcs_flip(ScrnInfoPtr scrn, xf86CrtcPtr *crtcs, int num_crtcs,
+                   uint32_t fb_id, uint32_t flags, void *data)
+{
+    modesettingPtr ms = modesettingPTR(scrn);
+    drmModeAtomicReq *req = drmModeAtomicAlloc();
+    int i, ret = 0;
+
+    if (!req)
+        return 1;
+
+    for (i = 0; i < num_crtcs && ret == 0; i++)
+        ret = plane_add_props(req, crtcs[i], fb_id, crtcs[i]->x, crtcs[i]->y);
+
+    if (ret == 0)
+        ret = drmModeAtomicCommit(ms->fd, req,
+                                  flags | DRM_MODE_ATOMIC_NONBLOCK, data);
+    drmModeAtomicFree(req);
+    return ret;
+}
+
 int
 drmmode_bo_destroy(drmmode_ptr drmmode, drmmode_bo *bo)
 {
@@ -1680,6 +1706,10 @@ static void drmmmode_prepare_modeset(ScrnInfoPtr scrn)
     present_check_flips(pScreen->root);
     ms->drmmode.pending_modeset = FALSE;
 
+    /* Don't modeset over flips whose events haven't been delivered yet,
+     * they'd be lost along with the buffers they reference.  Flips that
+     * never complete are aborted, the modeset goes ahead regardless.
+     */
     ms_drain_drm_events(pScreen);
 }
 
@@ -2802,6 +2832,7 @@ drmmode_crtc_init(ScrnInfoPtr pScrn, drmmode_ptr drmmode, drmModeResPtr mode_res
     drmmode_crtc->vblank_pipe = drmmode_crtc_vblank_pipe(num);
     xorg_list_init(&drmmode_crtc->mode_list);
     xorg_list_init(&drmmode_crtc->tearfree.dri_flip_list);
+    xorg_list_init(&drmmode_crtc->drm_queue);
     drmmode_crtc->next_msc = UINT64_MAX;
 
     /* Setup the fallback cursor immediately. */
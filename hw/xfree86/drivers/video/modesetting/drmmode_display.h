@@ -234,6 +234,8 @@ typedef struct {
     /** @} */
 
     uint64_t next_msc;
+    /* Queued DRM events for this CRTC, oldest first */
+    struct xorg_list drm_queue;
 
     int cursor_width, cursor_height;
 
@@ -352,6 +354,8 @@ void drmmode_copy_damage(xf86CrtcPtr crtc, PixmapPtr dst, RegionPtr damage,
 
 int drmmode_crtc_flip(xf86CrtcPtr crtc, uint32_t fb_id, int x, int y,
                       uint32_t flags, void *data);
+int drmmode_crtcs_flip(ScrnInfoPtr scrn, xf86CrtcPtr *crtcs, int num_crtcs,
+                       uint32_t fb_id, uint32_t flags, void *data);
 
 Bool drmmode_crtc_get_fb_id(xf86CrtcPtr crtc, uint32_t *fb_id, int *x, int *y);
 
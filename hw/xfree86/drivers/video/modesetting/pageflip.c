@@ -36,7 +36,7 @@
  * Returns a negative value on error, 0 if there was nothing to process,
  * or 1 if we handled any events.
  */
-static int
+int
 ms_flush_drm_events_timeout(ScreenPtr screen, int timeout)
 {
     ScrnInfoPtr scrn = xf86ScreenToScrn(screen);
@@ -70,11 +70,28 @@ ms_flush_drm_events(ScreenPtr screen)
     return ms_flush_drm_events_timeout(screen, 0);
 }
 
+/*
+ * Wait for the pending page flips on this screen to complete.  Those
+ * that don't within MS_DRM_EVENT_TIMEOUT_MS are aborted, so that Present
+ * and DRI2 see them as done.  Vblank events aren't waited for, the
+ * kernel sends them when a CRTC is turned off.
+ */
 void
 ms_drain_drm_events(ScreenPtr screen)
 {
-    while (!ms_drm_queue_is_empty())
-        ms_flush_drm_events_timeout(screen, -1);
+    ScrnInfoPtr scrn = xf86ScreenToScrn(screen);
+    CARD32 start = GetTimeInMillis();
+
+    while (ms_drm_queue_flip_pending(scrn)) {
+        int timeout = MS_DRM_EVENT_TIMEOUT_MS - (int) (GetTimeInMillis() - start);
+
+        if (timeout <= 0 || ms_flush_drm_events_timeout(screen, timeout) < 0) {
+            xf86DrvMsg(scrn->scrnIndex, X_WARNING,
+                       "timed out waiting for pending page flips, aborting them\n");
+            ms_drm_abort_flips(scrn);
+            return;
+        }
+    }
 }
 
 #ifdef GLAMOR_HAS_GBM
@@ -192,7 +209,8 @@ do_queue_flip_on_crtc(ScreenPtr screen, xf86CrtcPtr crtc, uint32_t flags,
             /* The failure could be caused by a pending TearFree flip, in which
              * case we should wait until there's a new event and try again.
              */
-            if (!trf->flip_seq || ms_flush_drm_events_timeout(screen, -1) < 0) {
+            if (!trf->flip_seq ||
+                ms_flush_drm_events_timeout(screen, MS_DRM_EVENT_TIMEOUT_MS) <= 0) {
                 ms_drm_abort_seq(crtc->scrn, seq);
                 return TRUE;
             }
@@ -250,6 +268,155 @@ queue_flip_on_crtc(ScreenPtr screen, xf86CrtcPtr crtc,
     return QUEUE_FLIP_SUCCESS;
 }
 
+static Bool
+ms_crtcs_tearfree_pending(xf86CrtcPtr *crtcs, int num_crtcs)
+{
+    int i;
+
+    for (i = 0; i < num_crtcs; i++) {
+        drmmode_crtc_private_ptr drmmode_crtc = crtcs[i]->driver_private;
+
+        if (drmmode_crtc->tearfree.flip_seq)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Flip all enabled CRTCs in one atomic commit.  Each CRTC still gets its
+ * own queue entry, all sharing the sequence number of the commit.
+ */
+static int
+queue_flip_on_crtcs(ScreenPtr screen, struct ms_flipdata *flipdata,
+                    xf86CrtcPtr ref_crtc, uint32_t flags)
+{
+    ScrnInfoPtr scrn = xf86ScreenToScrn(screen);
+    modesettingPtr ms = modesettingPTR(scrn);
+    xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+    struct ms_crtc_pageflip *flip;
+    xf86CrtcPtr *crtcs;
+    uint32_t seq = 0, queued;
+    int i, num_crtcs = 0, status = QUEUE_FLIP_SUCCESS;
+
+    crtcs = calloc(config->num_crtc, sizeof(*crtcs));
+    if (!crtcs)
+        return QUEUE_FLIP_ALLOC_FAILED;
+
+    for (i = 0; i < config->num_crtc; i++) {
+        xf86CrtcPtr crtc = config->crtc[i];
+
+        if (!xf86_crtc_on(crtc))
+            continue;
+
+        flip = calloc(1, sizeof(struct ms_crtc_pageflip));
+        if (flip == NULL) {
+            status = QUEUE_FLIP_ALLOC_FAILED;
+            goto fail;
+        }
+
+        flip->on_reference_crtc = crtc == ref_crtc;
+        flip->flipdata = flipdata;
+
+        queued = ms_drm_queue_alloc_seq(crtc, seq, flip, ms_pageflip_handler,
+                                        ms_pageflip_abort);
+        if (!queued) {
+            free(flip);
+            status = QUEUE_FLIP_QUEUE_ALLOC_FAILED;
+            goto fail;
+        }
+        seq = queued;
+
+        /* take a reference on flipdata for use in flip */
+        flipdata->flip_count++;
+        crtcs[num_crtcs++] = crtc;
+    }
+
+    while (num_crtcs &&
+           drmmode_crtcs_flip(scrn, crtcs, num_crtcs, ms->drmmode.fb_id, flags,
+                              (void *)(long)seq)) {
+        /* Same as for a single CRTC, see do_queue_flip_on_crtc() */
+        if (ms_flush_drm_events(screen) <= 0) {
+            if (!ms_crtcs_tearfree_pending(crtcs, num_crtcs) ||
+                ms_flush_drm_events_timeout(screen, MS_DRM_EVENT_TIMEOUT_MS) <= 0) {
+                status = QUEUE_FLIP_DRM_FLUSH_FAILED;
+                goto fail;
+            }
+        }
+
+        xf86DrvMsg(scrn->scrnIndex, X_WARNING, "flip queue retry\n");
+    }
+
+    free(crtcs);
+    return QUEUE_FLIP_SUCCESS;
+
+fail:
+    if (seq)
+        ms_drm_abort_seq(scrn, seq);
+    free(crtcs);
+    return status;
+}
+
+/*
+ * The flags to flip @crtc with
+ */
+static uint32_t
+ms_pageflip_flags(modesettingPtr ms, xf86CrtcPtr crtc, xf86CrtcPtr ref_crtc,
+                  Bool async)
+{
+    uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+
+    if (ms->drmmode.can_async_flip && async)
+        flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+
+    /*
+     * If this is not the reference crtc used for flip timing and flip event
+     * delivery and timestamping, ie. not the one whose presentation timing
+     * we do really care about, and async flips are possible, and requested
+     * by an xorg.conf option, then we flip this "secondary" crtc without
+     * sync to vblank. This may cause tearing on such "secondary" outputs,
+     * but it will prevent throttling of multi-display flips to the refresh
+     * cycle of any of the secondary crtcs, avoiding periodic slowdowns and
+     * judder caused by unsynchronized outputs. This is especially useful for
+     * outputs in a "clone-mode" or "mirror-mode" configuration.
+     */
+    if (ms->drmmode.can_async_flip && ms->drmmode.async_flip_secondaries &&
+        ref_crtc && crtc != ref_crtc)
+        flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+
+    return flags;
+}
+
+/*
+ * A single atomic commit can only flip all CRTCs the same way
+ */
+static Bool
+ms_pageflip_flags_shared(ScrnInfoPtr scrn, xf86CrtcPtr ref_crtc, Bool async,
+                         uint32_t *flags)
+{
+    modesettingPtr ms = modesettingPTR(scrn);
+    xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(scrn);
+    Bool found = FALSE;
+    int i;
+
+    for (i = 0; i < config->num_crtc; i++) {
+        xf86CrtcPtr crtc = config->crtc[i];
+        uint32_t crtc_flags;
+
+        if (!xf86_crtc_on(crtc))
+            continue;
+
+        crtc_flags = ms_pageflip_flags(ms, crtc, ref_crtc, async);
+        if (found && crtc_flags != *flags)
+            return FALSE;
+
+        *flags = crtc_flags;
+        found = TRUE;
+    }
+
+    return found;
+}
+
 
 #define MS_ASYNC_FLIP_LOG_ENABLE_LOGS_INTERVAL_MS 10000
 #define MS_ASYNC_FLIP_LOG_FREQUENT_LOGS_INTERVAL_MS 1000
@@ -259,6 +426,7 @@ static void
 ms_print_pageflip_error(int screen_index, const char *log_prefix,
                         int crtc_index, int flags, int err)
 {
+    char crtc_name[32];
     /* In certain circumstances we will have a lot of flip errors without a
      * reasonable way to prevent them. In such case we reduce the number of
      * logged messages to at least not fill the error logs.
@@ -286,6 +454,12 @@ ms_print_pageflip_error(int screen_index, const char *log_prefix,
     static int frequent_logs;
     static Bool logs_disabled;
 
+    /* A negative index is for a commit flipping all CRTCs */
+    if (crtc_index < 0)
+        snprintf(crtc_name, sizeof(crtc_name), "all CRTCs");
+    else
+        snprintf(crtc_name, sizeof(crtc_name), "CRTC %d", crtc_index);
+
     if (flags & DRM_MODE_PAGE_FLIP_ASYNC) {
         CARD32 curr_time_ms = GetTimeInMillis();
         int clocks_since_last_log = curr_time_ms - error_last_time_ms;
@@ -308,15 +482,15 @@ ms_print_pageflip_error(int screen_index, const char *log_prefix,
                 logs_disabled = TRUE;
             } else {
                 xf86DrvMsg(screen_index, X_WARNING,
-                           "%s: queue async flip during flip on CRTC %d failed: %s\n",
-                           log_prefix, crtc_index, strerror(err));
+                           "%s: queue async flip during flip on %s failed: %s\n",
+                           log_prefix, crtc_name, strerror(err));
             }
         }
         error_last_time_ms = curr_time_ms;
     } else {
         xf86DrvMsg(screen_index, X_WARNING,
-                   "%s: queue flip during flip on CRTC %d failed: %s\n",
-                   log_prefix, crtc_index, strerror(err));
+                   "%s: queue flip during flip on %s failed: %s\n",
+                   log_prefix, crtc_name, strerror(err));
     }
 }
 
@@ -473,53 +647,60 @@ ms_do_pageflip(ScreenPtr screen,
      *
      * Also, flips queued on disabled or incorrectly configured displays
      * may never complete; this is a configuration error.
+     *
+     * With atomic modesetting, all CRTCs are flipped in a single commit so
+     * they latch the new frame buffer together, unless they need different
+     * flags.
      */
-    for (i = 0; i < config->num_crtc; i++) {
-        enum queue_flip_status flip_status;
-        xf86CrtcPtr crtc = config->crtc[i];
-
-        if (!xf86_crtc_on(crtc))
-            continue;
-
-        flags = DRM_MODE_PAGE_FLIP_EVENT;
-        if (ms->drmmode.can_async_flip && async)
-            flags |= DRM_MODE_PAGE_FLIP_ASYNC;
-
-        /*
-         * If this is not the reference crtc used for flip timing and flip event
-         * delivery and timestamping, ie. not the one whose presentation timing
-         * we do really care about, and async flips are possible, and requested
-         * by an xorg.conf option, then we flip this "secondary" crtc without
-         * sync to vblank. This may cause tearing on such "secondary" outputs,
-         * but it will prevent throttling of multi-display flips to the refresh
-         * cycle of any of the secondary crtcs, avoiding periodic slowdowns and
-         * judder caused by unsynchronized outputs. This is especially useful for
-         * outputs in a "clone-mode" or "mirror-mode" configuration.
-         */
-        if (ms->drmmode.can_async_flip && ms->drmmode.async_flip_secondaries &&
-            ref_crtc && crtc != ref_crtc)
-            flags |= DRM_MODE_PAGE_FLIP_ASYNC;
-
-        flip_status = queue_flip_on_crtc(screen, crtc, flipdata,
-                                         ref_crtc, flags);
-
-        switch (flip_status) {
+    if (ms->atomic_modeset &&
+        ms_pageflip_flags_shared(scrn, ref_crtc, async, &flags)) {
+        switch (queue_flip_on_crtcs(screen, flipdata, ref_crtc, flags)) {
             case QUEUE_FLIP_ALLOC_FAILED:
                 xf86DrvMsg(scrn->scrnIndex, X_WARNING,
-                           "%s: carrier alloc for queue flip on CRTC %d failed.\n",
-                           log_prefix, i);
+                           "%s: carrier alloc for queue flip failed.\n",
+                           log_prefix);
                 goto error_undo;
             case QUEUE_FLIP_QUEUE_ALLOC_FAILED:
                 xf86DrvMsg(scrn->scrnIndex, X_WARNING,
-                           "%s: entry alloc for queue flip on CRTC %d failed.\n",
-                           log_prefix, i);
+                           "%s: entry alloc for queue flip failed.\n",
+                           log_prefix);
                 goto error_undo;
             case QUEUE_FLIP_DRM_FLUSH_FAILED:
-                ms_print_pageflip_error(scrn->scrnIndex, log_prefix, i, flags, errno);
+                ms_print_pageflip_error(scrn->scrnIndex, log_prefix, -1, flags, errno);
                 goto error_undo;
             case QUEUE_FLIP_SUCCESS:
                 break;
         }
+    } else {
+        for (i = 0; i < config->num_crtc; i++) {
+            enum queue_flip_status flip_status;
+            xf86CrtcPtr crtc = config->crtc[i];
+
+            if (!xf86_crtc_on(crtc))
+                continue;
+
+            flags = ms_pageflip_flags(ms, crtc, ref_crtc, async);
+            flip_status = queue_flip_on_crtc(screen, crtc, flipdata,
+                                             ref_crtc, flags);
+
+            switch (flip_status) {
+                case QUEUE_FLIP_ALLOC_FAILED:
+                    xf86DrvMsg(scrn->scrnIndex, X_WARNING,
+                               "%s: carrier alloc for queue flip on CRTC %d failed.\n",
+                               log_prefix, i);
+                    goto error_undo;
+                case QUEUE_FLIP_QUEUE_ALLOC_FAILED:
+                    xf86DrvMsg(scrn->scrnIndex, X_WARNING,
+                               "%s: entry alloc for queue flip on CRTC %d failed.\n",
+                               log_prefix, i);
+                    goto error_undo;
+                case QUEUE_FLIP_DRM_FLUSH_FAILED:
+                    ms_print_pageflip_error(scrn->scrnIndex, log_prefix, i, flags, errno);
+                    goto error_undo;
+                case QUEUE_FLIP_SUCCESS:
+                    break;
+            }
+        }
     }
 
     drmmode_bo_destroy(&ms->drmmode, &new_front_bo);
@@ -49,6 +49,50 @@
 static struct xorg_list ms_drm_queue;
 static uint32_t ms_drm_seq;
 
+/*
+ * The same entries hashed by sequence number, so that events from the
+ * kernel don't need to search the whole queue.  Several entries share a
+ * sequence number when one request covers several CRTCs.
+ */
+#define MS_DRM_QUEUE_HASH_SIZE 64
+static struct xorg_list ms_drm_queue_hash[MS_DRM_QUEUE_HASH_SIZE];
+
+static struct xorg_list *
+ms_drm_queue_bucket(uint32_t seq)
+{
+    return &ms_drm_queue_hash[seq & (MS_DRM_QUEUE_HASH_SIZE - 1)];
+}
+
+/*
+ * Find the entry for @seq on the CRTC with the kernel ID @crtc_id, or on
+ * any CRTC if @crtc_id is 0
+ */
+static struct ms_drm_queue *
+ms_drm_queue_lookup(uint32_t seq, uint32_t crtc_id)
+{
+    drmmode_crtc_private_ptr drmmode_crtc;
+    struct ms_drm_queue *q;
+
+    xorg_list_for_each_entry(q, ms_drm_queue_bucket(seq), hash) {
+        if (q->seq != seq)
+            continue;
+
+        drmmode_crtc = q->crtc->driver_private;
+        if (!crtc_id || drmmode_crtc->mode_crtc->crtc_id == crtc_id)
+            return q;
+    }
+
+    return NULL;
+}
+
+static void
+ms_drm_queue_del(struct ms_drm_queue *q)
+{
+    xorg_list_del(&q->list);
+    xorg_list_del(&q->hash);
+    xorg_list_del(&q->crtc_list);
+}
+
 static void box_intersect(BoxPtr dest, BoxPtr a, BoxPtr b)
 {
     dest->x1 = a->x1 > b->x1 ? a->x1 : b->x1;
@@ -263,32 +307,26 @@ ms_get_kernel_ust_msc(xf86CrtcPtr crtc,
 static void
 ms_drm_set_seq_msc(uint32_t seq, uint64_t msc)
 {
-    struct ms_drm_queue *q;
+    struct ms_drm_queue *q = ms_drm_queue_lookup(seq, 0);
 
-    xorg_list_for_each_entry(q, &ms_drm_queue, list) {
-        if (q->seq == seq) {
-            q->msc = msc;
-            break;
-        }
-    }
+    if (q)
+        q->msc = msc;
 }
 
 static void
 ms_drm_set_seq_queued(uint32_t seq, uint64_t msc)
 {
     drmmode_crtc_private_ptr drmmode_crtc;
-    struct ms_drm_queue *q;
+    struct ms_drm_queue *q = ms_drm_queue_lookup(seq, 0);
 
-    xorg_list_for_each_entry(q, &ms_drm_queue, list) {
-        if (q->seq == seq) {
-            drmmode_crtc = q->crtc->driver_private;
-            if (msc < drmmode_crtc->next_msc)
-                drmmode_crtc->next_msc = msc;
-            q->msc = msc;
-            q->kernel_queued = TRUE;
-            break;
-        }
-    }
+    if (!q)
+        return;
+
+    drmmode_crtc = q->crtc->driver_private;
+    if (msc < drmmode_crtc->next_msc)
+        drmmode_crtc->next_msc = msc;
+    q->msc = msc;
+    q->kernel_queued = TRUE;
 }
 
 static Bool
@@ -368,11 +406,14 @@ ms_queue_vblank(xf86CrtcPtr crtc, ms_queue_flag flags,
             return TRUE;
         }
     check:
-        if (errno != EBUSY) {
+        /* The kernel's event queue is full, so wait for it to deliver some
+         * events and try again, but don't spin if it doesn't
+         */
+        if (errno != EBUSY ||
+            ms_flush_drm_events_timeout(screen, MS_DRM_EVENT_TIMEOUT_MS) <= 0) {
             ms_drm_abort_seq(scrn, seq);
             return FALSE;
         }
-        ms_flush_drm_events(screen);
     }
 }
 
@@ -459,18 +500,36 @@ ms_drm_queue_alloc(xf86CrtcPtr crtc,
                    void *data,
                    ms_drm_handler_proc handler,
                    ms_drm_abort_proc abort)
+{
+    return ms_drm_queue_alloc_seq(crtc, 0, data, handler, abort);
+}
+
+/*
+ * Like ms_drm_queue_alloc(), but reuses @seq if it isn't 0, for requests
+ * that complete on several CRTCs with one event each
+ */
+uint32_t
+ms_drm_queue_alloc_seq(xf86CrtcPtr crtc,
+                       uint32_t seq,
+                       void *data,
+                       ms_drm_handler_proc handler,
+                       ms_drm_abort_proc abort)
 {
     ScreenPtr screen = crtc->randr_crtc->pScreen;
     ScrnInfoPtr scrn = xf86ScreenToScrn(screen);
+    drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
     struct ms_drm_queue *q;
 
     q = calloc(1, sizeof(struct ms_drm_queue));
 
     if (!q)
         return 0;
-    if (!ms_drm_seq)
-        ++ms_drm_seq;
-    q->seq = ms_drm_seq++;
+    if (!seq) {
+        if (!ms_drm_seq)
+            ++ms_drm_seq;
+        seq = ms_drm_seq++;
+    }
+    q->seq = seq;
     q->msc = UINT64_MAX;
     q->scrn = scrn;
     q->crtc = crtc;
@@ -478,8 +537,10 @@ ms_drm_queue_alloc(xf86CrtcPtr crtc,
     q->handler = handler;
     q->abort = abort;
 
-    /* Keep the list formatted in ascending order of sequence number */
+    /* Keep the lists formatted in ascending order of sequence number */
     xorg_list_append(&q->list, &ms_drm_queue);
+    xorg_list_append(&q->hash, ms_drm_queue_bucket(q->seq));
+    xorg_list_append(&q->crtc_list, &drmmode_crtc->drm_queue);
 
     return q->seq;
 }
@@ -500,7 +561,7 @@ ms_drm_abort_one(struct ms_drm_queue *q)
         q->abort(q->data);
         q->aborted = TRUE;
     } else {
-        xorg_list_del(&q->list);
+        ms_drm_queue_del(q);
         q->abort(q->data);
         free(q);
     }
@@ -522,18 +583,16 @@ ms_drm_abort_scrn(ScrnInfoPtr scrn)
 }
 
 /**
- * Abort by drm queue sequence number.
+ * Abort by drm queue sequence number, on all CRTCs sharing it.
  */
 void
 ms_drm_abort_seq(ScrnInfoPtr scrn, uint32_t seq)
 {
     struct ms_drm_queue *q, *tmp;
 
-    xorg_list_for_each_entry_safe(q, tmp, &ms_drm_queue, list) {
-        if (q->seq == seq) {
+    xorg_list_for_each_entry_safe(q, tmp, ms_drm_queue_bucket(seq), hash) {
+        if (q->seq == seq)
             ms_drm_abort_one(q);
-            break;
-        }
     }
 }
 
@@ -557,42 +616,41 @@ ms_drm_abort(ScrnInfoPtr scrn, Bool (*match)(void *data, void *match_data),
 
 /*
  * General DRM kernel handler. Looks for the matching sequence number in the
- * drm event queue and calls the handler for it.
+ * drm event queue and calls the handler for it.  @crtc_id is the kernel ID
+ * of the CRTC the event is for, or 0 if the event doesn't say.
  */
 static void
-ms_drm_sequence_handler(int fd, uint64_t frame, uint64_t ns, Bool is64bit, uint64_t user_data)
+ms_drm_sequence_handler(int fd, uint64_t frame, uint64_t ns, Bool is64bit,
+                        uint32_t crtc_id, uint64_t user_data)
 {
     struct ms_drm_queue *q, *tmp;
     uint32_t seq = (uint32_t) user_data;
-    xf86CrtcPtr crtc = NULL;
+    xf86CrtcPtr crtc;
     drmmode_crtc_private_ptr drmmode_crtc;
     uint64_t msc, next_msc = UINT64_MAX;
 
     /* Handle the seq for this event first in order to get the CRTC */
-    xorg_list_for_each_entry(q, &ms_drm_queue, list) {
-        if (q->seq == seq) {
-            crtc = q->crtc;
-            msc = ms_kernel_msc_to_crtc_msc(crtc, frame, is64bit);
-
-            /* Write the current MSC to this event to ensure its handler runs in
-             * the loop below. This is done because we don't want to run the
-             * handler right now, since we need to ensure all events are handled
-             * in FIFO order with respect to one another. Otherwise, if this
-             * event were handled first just because it was queued to the
-             * kernel, it could run before older events expiring at this MSC.
-             */
-            q->msc = msc;
-            break;
-        }
-    }
-
-    if (!crtc)
+    q = ms_drm_queue_lookup(seq, crtc_id);
+    if (!q)
         return;
 
+    crtc = q->crtc;
+    drmmode_crtc = crtc->driver_private;
+    msc = ms_kernel_msc_to_crtc_msc(crtc, frame, is64bit);
+
+    /* Write the current MSC to this event to ensure its handler runs in
+     * the loop below. This is done because we don't want to run the
+     * handler right now, since we need to ensure all events are handled
+     * in FIFO order with respect to one another. Otherwise, if this
+     * event were handled first just because it was queued to the
+     * kernel, it could run before older events expiring at this MSC.
+     */
+    q->msc = msc;
+
     /* Now run all of the vblank events for this CRTC with an expired MSC */
-    xorg_list_for_each_entry_safe(q, tmp, &ms_drm_queue, list) {
-        if (q->crtc == crtc && q->msc <= msc) {
-            xorg_list_del(&q->list);
+    xorg_list_for_each_entry_safe(q, tmp, &drmmode_crtc->drm_queue, crtc_list) {
+        if (q->msc <= msc) {
+            ms_drm_queue_del(q);
             if (!q->aborted)
                 q->handler(msc, ns / 1000, q->data);
             free(q);
@@ -601,26 +659,23 @@ ms_drm_sequence_handler(int fd, uint64_t frame, uint64_t ns, Bool is64bit, uint6
 
     /* Find this CRTC's next queued MSC and next non-queued MSC to be handled */
     msc = UINT64_MAX;
-    xorg_list_for_each_entry(q, &ms_drm_queue, list) {
-        if (q->crtc == crtc) {
-            if (q->kernel_queued) {
-                if (q->msc < next_msc)
-                    next_msc = q->msc;
-            } else if (q->msc < msc) {
-                msc = q->msc;
-                seq = q->seq;
-            }
+    xorg_list_for_each_entry(q, &drmmode_crtc->drm_queue, crtc_list) {
+        if (q->kernel_queued) {
+            if (q->msc < next_msc)
+                next_msc = q->msc;
+        } else if (q->msc < msc) {
+            msc = q->msc;
+            seq = q->seq;
         }
     }
 
     /* Queue an event if the next queued MSC isn't soon enough */
-    drmmode_crtc = crtc->driver_private;
     drmmode_crtc->next_msc = next_msc;
     if (msc < next_msc && !ms_queue_vblank(crtc, MS_QUEUE_ABSOLUTE, msc, NULL, seq)) {
         xf86DrvMsg(crtc->scrn->scrnIndex, X_WARNING,
                    "failed to queue next vblank event, aborting lost events\n");
-        xorg_list_for_each_entry_safe(q, tmp, &ms_drm_queue, list) {
-            if (q->crtc == crtc && q->msc < next_msc)
+        xorg_list_for_each_entry_safe(q, tmp, &drmmode_crtc->drm_queue, crtc_list) {
+            if (q->msc < next_msc)
                 ms_drm_abort_one(q);
         }
     }
@@ -630,7 +685,7 @@ static void
 ms_drm_sequence_handler_64bit(int fd, uint64_t frame, uint64_t ns, uint64_t user_data)
 {
     /* frame is true 64 bit wrapped into 64 bit */
-    ms_drm_sequence_handler(fd, frame, ns, TRUE, user_data);
+    ms_drm_sequence_handler(fd, frame, ns, TRUE, 0, user_data);
 }
 
 static void
@@ -639,7 +694,18 @@ ms_drm_handler(int fd, uint32_t frame, uint32_t sec, uint32_t usec,
 {
     /* frame is 32 bit wrapped into 64 bit */
     ms_drm_sequence_handler(fd, frame, ((uint64_t) sec * 1000000 + usec) * 1000,
-                            FALSE, (uint32_t) (uintptr_t) user_ptr);
+                            FALSE, 0, (uint32_t) (uintptr_t) user_ptr);
+}
+
+static void
+ms_drm_flip_handler(int fd, uint32_t frame, uint32_t sec, uint32_t usec,
+                    uint32_t crtc_id, void *user_ptr)
+{
+    /* An atomic commit flipping several CRTCs sends one event for each of
+     * them, all with the same sequence number
+     */
+    ms_drm_sequence_handler(fd, frame, ((uint64_t) sec * 1000000 + usec) * 1000,
+                            FALSE, crtc_id, (uint32_t) (uintptr_t) user_ptr);
 }
 
 Bool
@@ -648,17 +714,66 @@ ms_drm_queue_is_empty(void)
     return xorg_list_is_empty(&ms_drm_queue);
 }
 
+/*
+ * Page flips on a screen that are still waiting for their event.
+ * Vblank waits always get a target MSC from ms_queue_vblank(), flips
+ * keep the UINT64_MAX they were allocated with until the event arrives.
+ */
+static Bool
+ms_drm_queue_is_flip(struct ms_drm_queue *q, ScrnInfoPtr scrn)
+{
+    return q->scrn == scrn && q->msc == UINT64_MAX && !q->aborted;
+}
+
+Bool
+ms_drm_queue_flip_pending(ScrnInfoPtr scrn)
+{
+    struct ms_drm_queue *q;
+
+    xorg_list_for_each_entry(q, &ms_drm_queue, list) {
+        if (ms_drm_queue_is_flip(q, scrn))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Give up on the pending page flips of a screen.  Their abort handlers
+ * run now, and the events, should they still come, are dropped.
+ */
+void
+ms_drm_abort_flips(ScrnInfoPtr scrn)
+{
+    struct ms_drm_queue *q, *tmp;
+
+    xorg_list_for_each_entry_safe(q, tmp, &ms_drm_queue, list) {
+        if (ms_drm_queue_is_flip(q, scrn))
+            ms_drm_abort_one(q);
+    }
+}
+
 Bool
 ms_vblank_screen_init(ScreenPtr screen)
 {
     ScrnInfoPtr scrn = xf86ScreenToScrn(screen);
     modesettingPtr ms = modesettingPTR(scrn);
     modesettingEntPtr ms_ent = ms_ent_priv(scrn);
-    xorg_list_init(&ms_drm_queue);
+    int i;
+
+    /* Only once, as aborted events queued in the kernel stay on the queue
+     * across server generations until the kernel delivers them
+     */
+    if (!ms_drm_queue.next) {
+        xorg_list_init(&ms_drm_queue);
+        for (i = 0; i < MS_DRM_QUEUE_HASH_SIZE; i++)
+            xorg_list_init(&ms_drm_queue_hash[i]);
+    }
 
     ms->event_context.version = 4;
     ms->event_context.vblank_handler = ms_drm_handler;
     ms->event_context.page_flip_handler = ms_drm_handler;
+    ms->event_context.page_flip_handler2 = ms_drm_flip_handler;
     ms->event_context.sequence_handler = ms_drm_sequence_handler_64bit;
 
     /* We need to re-register the DRM fd for the synchronisation
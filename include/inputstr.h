@@ -310,12 +310,12 @@ typedef struct _TouchPointInfo {
     ValuatorMask *valuators;    /* last recorded axis values */
     TouchListener *listeners;   /* set of listeners */
     int num_listeners;
+    int listeners_size;         /* allocated listeners, kept between touches */
     int num_grabs;              /* number of open grabs on this touch
                                  * which have not accepted or rejected */
     Bool emulate_pointer;
-    DeviceEvent *history;       /* History of events on this touchpoint */
-    size_t history_elements;    /* Number of current elements in history */
-    size_t history_size;        /* Size of history in elements */
+    struct _TouchHistory *history; /* History of events on this touchpoint,
+                                    * kept between touches */
 } TouchPointInfoRec;
 
 typedef struct _TouchClassRec {
@@ -40,6 +40,10 @@
 #define AccelProfileSmoothLimited 7
 #define AccelProfileLAST AccelProfileSmoothLimited
 
+/* profiles registered at runtime are numbered from here on */
+#define AccelProfileRegisteredFirst (AccelProfileLAST + 1)
+#define AccelProfileRegisteredMax 16
+
 /* fwd */
 struct _DeviceVelocityRec;
 
@@ -88,4 +92,11 @@ extern _X_EXPORT void
 SetDeviceSpecificAccelerationProfile(DeviceVelocityPtr vel,
                                      PointerAccelerationProfileFunc profile);
 
+extern _X_EXPORT Bool
+RegisterAccelerationProfile(PointerAccelerationProfileFunc profile,
+                            int *profile_num);
+
+extern _X_EXPORT void
+UnregisterAccelerationProfile(int profile_num);
+
 #endif                          /* POINTERVELOCITY_H */
@@ -705,6 +705,10 @@ typedef struct _Screen {
     /* additional screen post-close notify hooks (replaces wrapping CloseScreen)
        should NOT be touched outside of DIX core */
     CallbackListPtr hookPostClose;
+
+    /* hooks run before a client's GetImage fetches its image
+       should NOT be touched outside of DIX core */
+    CallbackListPtr hookPrepareGetImage;
 } ScreenRec;
 
 static inline RegionPtr
@@ -143,6 +143,13 @@ typedef struct _XkbSrvInfo {
     XkbSrvCheckRepeatPtr checkRepeat;
 
     char overlay_perkey_state[256/8]; /* bitfield */
+
+    CARD8 *typeLevels;          /* shift level per key type and modifiers,
+                                   see XkbKeyTypeLevel() */
+    int nTypeLevels;
+
+    CARD32 keymapSerial;        /* devices with the same serial have the same
+                                   keymap, 0 if not shared */
 } XkbSrvInfoRec, *XkbSrvInfoPtr;
 
 typedef struct _XkbSrvLedInfo {
@@ -40,17 +40,32 @@
 
 struct _SyncObject {
     ClientPtr client;           /* Owning client. 0 for system counters */
-    struct _SyncTriggerList *pTriglist; /* list of triggers */
+    struct _SyncTriggerList *pTriglist; /* list of triggers, fences only */
     XID id;                     /* resource ID */
     unsigned char type;         /* SYNC_* */
     unsigned char initialized;  /* FALSE if created but not initialized */
     Bool beingDestroyed;        /* in process of going away */
 };
 
+typedef struct _SyncTriggerEntry {
+    int64_t test_value;
+    struct _SyncTrigger *pTrigger;
+} SyncTriggerEntry;
+
+typedef struct _SyncTriggerArray {
+    SyncTriggerEntry *entries;  /* sorted by test_value */
+    int num;
+    int size;
+} SyncTriggerArray;
+
+#define SYNC_NUM_TEST_TYPES     (XSyncNegativeComparison + 1)
+
 typedef struct _SyncCounter {
     SyncObject sync;            /* Common sync object data */
     int64_t value;              /* counter value */
     struct _SysCounterInfo *pSysCounterInfo; /* NULL if not a system counter */
+    SyncTriggerArray triggers[SYNC_NUM_TEST_TYPES]; /* triggers by test type */
+    struct _SyncTriggerFiring *firing; /* triggers being fired */
 } SyncCounter;
 
 struct _SyncFence {
@@ -71,6 +86,9 @@ struct _SyncTrigger {
                          int64_t newval);
     void (*TriggerFired)(struct _SyncTrigger *pTrigger);
     void (*CounterDestroyed)(struct _SyncTrigger *pTrigger);
+    Bool sorted;                /* in the counter's trigger arrays */
+    unsigned int sorted_type;   /* test_type when it was sorted */
+    int64_t sorted_value;       /* test_value when it was sorted */
 };
 
 typedef struct _SyncTriggerList {
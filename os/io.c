@@ -552,6 +552,38 @@ InsertFakeRequest(ClientPtr client, char *data, int count)
     return TRUE;
 }
 
+/*****************************************************************
+ * PeekNextRequest
+ *    Returns the request after the current one, if all of it has been
+ *    read already, and its length in bytes.  It stays in the buffer and
+ *    is not byte swapped.  Big requests are never returned.
+ *
+ **********************/
+
+const void *
+PeekNextRequest(ClientPtr client, int *len)
+{
+    OsCommPtr oc = (OsCommPtr) client->osPrivate;
+    ConnectionInputPtr oci;
+    const xReq *request;
+    int gotnow, needed;
+
+    if (!oc || !(oci = oc->input) || oci->ignoreBytes)
+        return NULL;
+
+    request = (const xReq *) (oci->bufptr + oci->lenLastReq);
+    gotnow = oci->bufcnt + oci->buffer - (const char *) request;
+    if (gotnow < (int) sizeof(xReq))
+        return NULL;
+
+    needed = get_req_len(request, client) << 2;
+    if (!needed || gotnow < needed)
+        return NULL;
+
+    *len = needed;
+    return request;
+}
+
 /*****************************************************************
  * ResetRequestFromClient
  *    Reset to reexecute the current request, and yield.
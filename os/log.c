@@ -92,6 +92,13 @@ OR PERFORMANCE OF THIS SOFTWARE.
 #include <syslog.h>
 #endif
 
+#if INPUTTHREAD
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#endif
+
 #include "dix/dix_priv.h"
 #include "dix/input_priv.h"
 #include "os/audit.h"
@@ -111,6 +118,8 @@ OR PERFORMANCE OF THIS SOFTWARE.
 #pragma clang diagnostic ignored "-Wformat-nonliteral"
 #endif
 
+#define LOG_MSG_BUF_SIZE 1024
+
 /* Default logging parameters. */
 #define DEFAULT_LOG_VERBOSITY		0
 #define DEFAULT_LOG_FILE_VERBOSITY	3
@@ -130,6 +139,9 @@ static char *saveBuffer = NULL;
 static int bufferSize = 0, bufferUnused = 0, bufferPos = 0;
 static Bool needBuffer = TRUE;
 
+/* Set by FatalError(), log directly from then on and never wait */
+static Bool logFatal = FALSE;
+
 #ifdef __APPLE__
 static char __crashreporter_info_buff__[4096] = { 0 };
 
@@ -215,6 +227,501 @@ static inline void doLogSync(void) {
 #endif
 }
 
+#if INPUTTHREAD
+
+/*
+ * Messages from the main and input threads are queued in a ring per
+ * thread and written out by a separate thread, so that verbose logging
+ * doesn't stall either of them on the log file or the terminal.  Each
+ * ring has one producer and one consumer and needs no locks.  When a
+ * ring is full, messages are dropped and counted instead of blocking.
+ * The count is queued in their place as soon as there is room again.
+ * Messages are dropped the same way when a thread logs more than
+ * LOG_RATE_BURST of them faster than LOG_RATE_PER_SEC, so that a flood
+ * can't keep the writer thread and the disk busy.
+ * Errors, warnings and messages logged at any verbosity can use the
+ * last LOG_RING_RESERVE bytes of the ring too, and are written directly
+ * when even these are used up, so they are never dropped.
+ *
+ * Messages from other threads and with -logsync are still written
+ * directly, once the queued ones are out.  Messages from signal handlers
+ * and fatal errors are written directly right away, without waiting.
+ */
+
+#define LOG_RING_SIZE           (256 * 1024)
+#define LOG_RING_RESERVE        (16 * 1024)
+#define LOG_RATE_PER_SEC        1000
+#define LOG_RATE_BURST          5000
+
+#define LOG_RECORD_STDERR       0x1
+#define LOG_RECORD_FILE         0x2
+#define LOG_RECORD_STAMP        0x4
+
+struct log_record {
+    uint32_t len;
+    uint32_t flags;
+    time_t time;
+};
+
+#define LOG_RECORD_SIZE(len) \
+    ((sizeof(struct log_record) + (len) + 7) & ~(size_t) 7)
+
+struct log_ring {
+    char data[LOG_RING_SIZE];
+    size_t head;                /* only written by the producer */
+    size_t tail;                /* only written by the writer thread */
+    unsigned int dropped;       /* only used by the producer */
+    Bool skip_line;             /* the rest of a dropped line goes too */
+    unsigned int tokens;        /* messages allowed before rate limiting */
+    CARD32 token_time;          /* when tokens were last added */
+};
+
+enum {
+    LOG_RING_MAIN,
+    LOG_RING_INPUT,
+    LOG_NUM_RINGS
+};
+
+static struct log_ring *logRings;
+static Bool logThreadRunning;
+static Bool logThreadStop;
+static pthread_t logThread;
+static pthread_t logMainThread;
+static int logWakeRead = -1;
+static int logWakeWrite = -1;
+
+/*
+ * Whether the main thread, the input thread and any other thread are at
+ * the start of a line, so that one doesn't stamp or split the line of
+ * another. -- signal safe
+ */
+static Bool logLineStart[LOG_NUM_RINGS + 1] = { TRUE, TRUE, TRUE };
+
+static Bool *
+LogLineState(void)
+{
+    if (in_input_thread())
+        return &logLineStart[LOG_RING_INPUT];
+    if (__atomic_load_n(&logThreadRunning, __ATOMIC_ACQUIRE) &&
+        !pthread_equal(pthread_self(), logMainThread))
+        return &logLineStart[LOG_NUM_RINGS];
+    return &logLineStart[LOG_RING_MAIN];
+}
+
+static void
+LogRingCopyIn(struct log_ring *ring, size_t pos, const void *data, size_t len)
+{
+    size_t off = pos & (LOG_RING_SIZE - 1);
+    size_t first = min(len, LOG_RING_SIZE - off);
+
+    memcpy(ring->data + off, data, first);
+    memcpy(ring->data, (const char *) data + first, len - first);
+}
+
+static void
+LogRingCopyOut(struct log_ring *ring, size_t pos, void *data, size_t len)
+{
+    size_t off = pos & (LOG_RING_SIZE - 1);
+    size_t first = min(len, LOG_RING_SIZE - off);
+
+    memcpy(data, ring->data + off, first);
+    memcpy((char *) data + first, ring->data, len - first);
+}
+
+/* signal safe */
+static void
+LogWakeWriter(void)
+{
+    char c = 0;
+
+    if (write(logWakeWrite, &c, 1) < 0) {
+        /* The pipe is full, so the writer is awake anyway */
+    }
+}
+
+static struct log_ring *
+LogGetRing(void)
+{
+    if (!__atomic_load_n(&logThreadRunning, __ATOMIC_ACQUIRE) ||
+        inSignalContext || logFatal || xorgLogSync)
+        return NULL;
+
+    if (pthread_equal(pthread_self(), logMainThread))
+        return &logRings[LOG_RING_MAIN];
+    if (in_input_thread())
+        return &logRings[LOG_RING_INPUT];
+
+    return NULL;
+}
+
+static Bool
+LogRingPut(struct log_ring *ring, const char *buf, size_t len, int flags,
+           size_t reserve)
+{
+    struct log_record rec;
+    size_t head, tail, size;
+
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    size = LOG_RECORD_SIZE(len);
+    if (size + reserve > LOG_RING_SIZE - (head - tail))
+        return FALSE;
+
+    rec.len = len;
+    rec.flags = flags;
+    rec.time = (flags & LOG_RECORD_STAMP) ? time(NULL) : 0;
+    LogRingCopyIn(ring, head, &rec, sizeof(rec));
+    LogRingCopyIn(ring, head + sizeof(rec), buf, len);
+
+    __atomic_store_n(&ring->head, head + size, __ATOMIC_SEQ_CST);
+
+    /* If the writer had emptied the ring, it may be asleep */
+    if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == head)
+        LogWakeWriter();
+
+    return TRUE;
+}
+
+/* Takes a token for a new message if the thread hasn't used them up */
+static Bool
+LogRateAllow(struct log_ring *ring)
+{
+    CARD32 now = GetTimeInMillis();
+    CARD32 elapsed = min(now - ring->token_time, 1000U * LOG_RATE_BURST);
+    unsigned int add = elapsed * LOG_RATE_PER_SEC / 1000;
+
+    if (add) {
+        ring->tokens = min(ring->tokens + add, (unsigned int) LOG_RATE_BURST);
+        ring->token_time = now;
+    }
+    if (!ring->tokens)
+        return FALSE;
+
+    ring->tokens--;
+    return TRUE;
+}
+
+static int
+LogDroppedMessage(char *buf, size_t size, unsigned int dropped)
+{
+    return snprintf(buf, size, "(WW) %u log messages dropped\n", dropped);
+}
+
+/*
+ * Queue a message for the writer thread.  Returns FALSE if it has to be
+ * written directly instead.  Messages that must not be dropped may use
+ * the reserve at the end of the ring, and aren't rate limited.  A count
+ * of the dropped messages is queued first, if we're at the start of a
+ * line.  The rest of a line whose start was dropped is dropped as well.
+ */
+static Bool
+LogQueueWrite(const char *buf, size_t len, int flags, Bool keep,
+              Bool line_start)
+{
+    struct log_ring *ring = LogGetRing();
+    size_t reserve = keep ? 0 : LOG_RING_RESERVE;
+
+    if (!ring || len > LOG_MSG_BUF_SIZE)
+        return FALSE;
+
+    if (line_start)
+        ring->skip_line = FALSE;
+    else if (ring->skip_line && !keep)
+        return TRUE;
+
+    if (line_start && !keep && !LogRateAllow(ring))
+        goto drop;
+
+    if (ring->dropped && line_start) {
+        char msg[64];
+        int n = LogDroppedMessage(msg, sizeof(msg), ring->dropped);
+        int notice_flags = logFileFd != -1 ?
+            LOG_RECORD_FILE | LOG_RECORD_STAMP : LOG_RECORD_STDERR;
+
+        if (LogRingPut(ring, msg, n, notice_flags, reserve))
+            ring->dropped = 0;
+    }
+
+    /* Nothing goes ahead of a count that didn't fit */
+    if ((!ring->dropped || !line_start) &&
+        LogRingPut(ring, buf, len, flags, reserve))
+        return TRUE;
+    if (keep)
+        return FALSE;
+
+drop:
+    ring->dropped++;
+    ring->skip_line = TRUE;
+    return TRUE;
+}
+
+static void
+LogWriteAll(int fd, const char *buf, size_t len)
+{
+    while (len) {
+        ssize_t ret = write(fd, buf, len);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buf += ret;
+        len -= ret;
+    }
+}
+
+struct log_output {
+    int fd;
+    size_t len;
+    char buf[16384];
+};
+
+static void
+LogOutputFlush(struct log_output *out)
+{
+    if (out->len && out->fd >= 0)
+        LogWriteAll(out->fd, out->buf, out->len);
+    out->len = 0;
+}
+
+static void
+LogOutputAppend(struct log_output *out, const char *buf, size_t len)
+{
+    if (out->len + len > sizeof(out->buf))
+        LogOutputFlush(out);
+    if (len > sizeof(out->buf)) {
+        if (out->fd >= 0)
+            LogWriteAll(out->fd, buf, len);
+        return;
+    }
+    memcpy(out->buf + out->len, buf, len);
+    out->len += len;
+}
+
+/*
+ * Write out everything that is queued.  Returns TRUE if there was
+ * anything to write.
+ */
+static Bool
+LogDrainRings(struct log_output *err, struct log_output *file)
+{
+    size_t heads[LOG_NUM_RINGS];
+    Bool busy = FALSE;
+    int i;
+
+    err->fd = 2;
+    file->fd = logFileFd;
+
+    for (i = 0; i < LOG_NUM_RINGS; i++) {
+        struct log_ring *ring = &logRings[i];
+        size_t tail = ring->tail;
+        char msg[LOG_MSG_BUF_SIZE + 32];
+
+        heads[i] = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+
+        while (tail != heads[i]) {
+            struct log_record rec;
+            size_t stamp = 0;
+
+            LogRingCopyOut(ring, tail, &rec, sizeof(rec));
+
+            if (rec.flags & LOG_RECORD_STAMP) {
+                struct tm tm;
+
+                localtime_r(&rec.time, &tm);
+                stamp = strftime(msg, 31, "[%Y-%m-%d %H:%M:%S] ", &tm);
+            }
+            LogRingCopyOut(ring, tail + sizeof(rec), msg + stamp, rec.len);
+
+            if (rec.flags & LOG_RECORD_STDERR)
+                LogOutputAppend(err, msg + stamp, rec.len);
+            if (rec.flags & LOG_RECORD_FILE)
+                LogOutputAppend(file, msg, stamp + rec.len);
+
+            tail += LOG_RECORD_SIZE(rec.len);
+            busy = TRUE;
+        }
+    }
+
+    LogOutputFlush(err);
+    LogOutputFlush(file);
+
+    /* Only give the space back once the messages are out, so that empty
+     * rings mean that everything has been written.
+     */
+    for (i = 0; i < LOG_NUM_RINGS; i++)
+        __atomic_store_n(&logRings[i].tail, heads[i], __ATOMIC_SEQ_CST);
+
+    return busy;
+}
+
+static void *
+LogWriterThread(void *arg)
+{
+    static struct log_output err, file;
+    sigset_t set;
+
+    /* Signals are for the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np (pthread_self(), "LogThread");
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np ("LogThread");
+#endif
+
+    for (;;) {
+        struct pollfd pfd = { .fd = logWakeRead, .events = POLLIN };
+        char c[64];
+
+        while (LogDrainRings(&err, &file))
+            ;
+
+        if (__atomic_load_n(&logThreadStop, __ATOMIC_ACQUIRE))
+            break;
+
+        if (poll(&pfd, 1, -1) > 0) {
+            while (read(logWakeRead, c, sizeof(c)) > 0)
+                ;
+        }
+    }
+
+    return NULL;
+}
+
+static Bool
+LogRingsEmpty(void)
+{
+    int i;
+
+    for (i = 0; i < LOG_NUM_RINGS; i++) {
+        if (__atomic_load_n(&logRings[i].tail, __ATOMIC_ACQUIRE) !=
+            __atomic_load_n(&logRings[i].head, __ATOMIC_ACQUIRE))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Wait a bit for the writer thread to write out what is queued, so
+ * that messages written directly come after it.  Only the main thread
+ * waits; the input thread and others mustn't stall on the log, so they
+ * just wake the writer. -- signal safe
+ */
+void
+LogFlush(void)
+{
+    int i;
+
+    if (!__atomic_load_n(&logThreadRunning, __ATOMIC_ACQUIRE))
+        return;
+
+    if (!pthread_equal(pthread_self(), logMainThread)) {
+        LogWakeWriter();
+        return;
+    }
+
+    for (i = 0; i < 1000 && !LogRingsEmpty(); i++) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+
+        LogWakeWriter();
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void
+LogStopThread(void)
+{
+    if (!__atomic_load_n(&logThreadRunning, __ATOMIC_ACQUIRE))
+        return;
+
+    __atomic_store_n(&logThreadRunning, FALSE, __ATOMIC_RELEASE);
+    __atomic_store_n(&logThreadStop, TRUE, __ATOMIC_RELEASE);
+    LogWakeWriter();
+    pthread_join(logThread, NULL);
+
+    close(logWakeRead);
+    close(logWakeWrite);
+    logWakeRead = logWakeWrite = -1;
+
+    /* Counts of messages dropped since the last queued one */
+    for (int i = 0; i < LOG_NUM_RINGS; i++) {
+        if (logRings[i].dropped) {
+            char msg[64];
+            int n = LogDroppedMessage(msg, sizeof(msg), logRings[i].dropped);
+
+            LogWriteAll(logFileFd != -1 ? logFileFd : 2, msg, n);
+            logRings[i].dropped = 0;
+        }
+    }
+}
+
+/* The child of a fork has no writer thread */
+static void
+LogForkChild(void)
+{
+    logThreadRunning = FALSE;
+}
+
+static void
+LogStartThread(void)
+{
+    static Bool registered;
+    int fds[2];
+
+    if (logThreadRunning)
+        return;
+
+    if (!logRings) {
+        logRings = calloc(LOG_NUM_RINGS, sizeof(*logRings));
+        if (!logRings)
+            return;
+        for (int i = 0; i < LOG_NUM_RINGS; i++) {
+            logRings[i].tokens = LOG_RATE_BURST;
+            logRings[i].token_time = GetTimeInMillis();
+        }
+    }
+
+    if (pipe(fds) < 0)
+        return;
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    logWakeRead = fds[0];
+    logWakeWrite = fds[1];
+
+    logMainThread = pthread_self();
+    logThreadStop = FALSE;
+    if (pthread_create(&logThread, NULL, LogWriterThread, NULL) != 0) {
+        close(logWakeRead);
+        close(logWakeWrite);
+        logWakeRead = logWakeWrite = -1;
+        return;
+    }
+
+    if (!registered) {
+        pthread_atfork(NULL, NULL, LogForkChild);
+        atexit(LogStopThread);
+        registered = TRUE;
+    }
+
+    __atomic_store_n(&logThreadRunning, TRUE, __ATOMIC_RELEASE);
+}
+
+#else /* INPUTTHREAD */
+
+static Bool LogQueueWrite(const char *buf, size_t len, int flags, Bool keep,
+                          Bool line_start) { return FALSE; }
+static Bool *LogLineState(void) { static Bool line_start = TRUE; return &line_start; }
+void LogFlush(void) {}
+static void LogStopThread(void) {}
+static void LogStartThread(void) {}
+
+#endif /* INPUTTHREAD */
+
 static void initSyslog(void) {
 #ifdef CONFIG_SYSLOG
     char buffer[4096];
@@ -263,6 +770,7 @@ LogInit(const char *fname, const char *backup)
         } else
             logFileName = LogFilePrep(fname, backup, display);
 
+        LogFlush();
         if ((logFileFd = open(logFileName, O_WRONLY | O_CREAT, S_IRUSR|S_IWUSR|S_IRGRP)) == -1)
             FatalError("Cannot open log file \"%s\": %s\n", logFileName, strerror(errno));
 
@@ -285,6 +793,7 @@ LogInit(const char *fname, const char *backup)
     needBuffer = FALSE;
 
     initSyslog();
+    LogStartThread();
     return logFileName;
 }
 
@@ -328,6 +837,7 @@ LogClose(enum ExitCode error)
                 "Server terminated %s (%d). Closing log file.\n",
                 (error == EXIT_NO_ERROR) ? "successfully" : "with error",
                 error);
+        LogStopThread();
         close(logFileFd);
         logFileFd = -1;
     }
@@ -578,13 +1088,34 @@ LogSyslogWrite(int verb, const char *buf, size_t len, Bool end_line) {
  * When attempting to call non-signal-safe functions, guard them with a check
  * of the inSignalContext global variable. */
 static void
-LogSWrite(int verb, const char *buf, size_t len, Bool end_line)
+LogSWrite(int verb, const char *buf, size_t len, Bool end_line, Bool keep)
 {
-    static Bool newline = TRUE;
+    Bool *newline = LogLineState();
     int ret;
 
     LogSyslogWrite(verb, buf, len, end_line);
 
+    if (!inSignalContext) {
+        int flags = 0;
+
+        if (verb < 0 || xorgLogVerbosity >= verb)
+            flags |= LOG_RECORD_STDERR;
+        if ((verb < 0 || xorgLogFileVerbosity >= verb) && logFileFd != -1) {
+            flags |= LOG_RECORD_FILE;
+            if (*newline)
+                flags |= LOG_RECORD_STAMP;
+        }
+        if (flags && LogQueueWrite(buf, len, flags, keep || verb < 0, *newline)) {
+            if (flags & LOG_RECORD_FILE)
+                *newline = end_line;
+            return;
+        }
+    }
+
+    /* Never wait in a signal handler or on the way out of a fatal error */
+    if (!inSignalContext && !logFatal)
+        LogFlush();
+
     if (verb < 0 || xorgLogVerbosity >= verb)
         ret = write(2, buf, len);
 
@@ -595,7 +1126,7 @@ LogSWrite(int verb, const char *buf, size_t len, Bool end_line)
                 doLogSync();
         }
         else if (!inSignalContext && logFileFd != -1) {
-            if (newline) {
+            if (*newline) {
                 time_t t = time(NULL);
                 struct tm tm;
                 char fmt_tm[32];
@@ -604,7 +1135,7 @@ LogSWrite(int verb, const char *buf, size_t len, Bool end_line)
                 strftime(fmt_tm, sizeof(fmt_tm) - 1, "[%Y-%m-%d %H:%M:%S] ", &tm);
                 write(logFileFd, fmt_tm, strlen(fmt_tm));
             }
-            newline = end_line;
+            *newline = end_line;
             write(logFileFd, buf, len);
             if (xorgLogSync)
                 doLogSync();
@@ -670,8 +1201,6 @@ LogMessageTypeVerbString(MessageType type, int verb)
     }
 }
 
-#define LOG_MSG_BUF_SIZE 1024
-
 static ssize_t prepMsgHdr(MessageType type, int verb, char *buf)
 {
     const char *type_str = LogMessageTypeVerbString(type, verb);
@@ -688,13 +1217,14 @@ static ssize_t prepMsgHdr(MessageType type, int verb, char *buf)
     return prefixLen;
 }
 
-static inline void writeLog(int verb, char *buf, int len)
+static inline void writeLog(MessageType type, int verb, char *buf, int len)
 {
     /* Force '\n' at end of truncated line */
     if (LOG_MSG_BUF_SIZE  - len == 1)
         buf[len - 1] = '\n';
 
-    LogSWrite(verb, buf, len, (buf[len - 1] == '\n'));
+    LogSWrite(verb, buf, len, (buf[len - 1] == '\n'),
+              type == X_ERROR || type == X_WARNING);
 }
 
 /* signal safe */
@@ -709,7 +1239,7 @@ LogVMessageVerb(MessageType type, int verb, const char *format, va_list args)
 
     len += vpnprintf(&buf[len], sizeof(buf) - len, format, args);
 
-    writeLog(verb, buf, len);
+    writeLog(type, verb, buf, len);
 }
 
 /* Log message with verbosity level specified. -- signal safe */
@@ -750,7 +1280,7 @@ LogVHdrMessageVerb(MessageType type, int verb, const char *msg_format,
     if (msg_format && sizeof(buf) - len > 1)
         len += vpnprintf(&buf[len], sizeof(buf) - len, msg_format, msg_args);
 
-    writeLog(verb, buf, len);
+    writeLog(type, verb, buf, len);
 }
 
 void
@@ -871,6 +1401,7 @@ FatalError(const char *f, ...)
     va_list args2;
     static Bool beenhere = FALSE;
 
+    logFatal = TRUE;
     if (beenhere)
         ErrorF("\nFatalError re-entered, aborting\n");
     else
@@ -40,6 +40,15 @@ void LogSetDisplay(void);
  */
 void LogClose(enum ExitCode error);
 
+/**
+ * @brief wait for queued log messages to be written
+ *
+ * Messages from the main and input threads are written out by a separate
+ * thread.  This waits (for a second at most) until all queued messages are
+ * in the log file.  Signal safe.
+ */
+void LogFlush(void);
+
 #ifdef DEBUG
 /**
  * @brief log debug messages (like errors) if symbol DEBUG is defined
@@ -22,16 +22,7 @@
 #include <dix-config.h>
 
 #include "present_priv.h"
-#include "list.h"
-
-static struct xorg_list fake_vblank_queue;
-
-typedef struct present_fake_vblank {
-    struct xorg_list            list;
-    uint64_t                    event_id;
-    OsTimerPtr                  timer;
-    ScreenPtr                   screen;
-} present_fake_vblank_rec, *present_fake_vblank_ptr;
+#include "present_timer_priv.h"
 
 int
 present_fake_get_ust_msc(ScreenPtr screen, uint64_t *ust, uint64_t *msc)
@@ -44,41 +35,34 @@ present_fake_get_ust_msc(ScreenPtr screen, uint64_t *ust, uint64_t *msc)
 }
 
 static void
-present_fake_notify(ScreenPtr screen, uint64_t event_id)
+present_fake_now(void *closure, uint64_t *ust, uint64_t *msc)
 {
-    uint64_t                    ust, msc;
+    present_fake_get_ust_msc(closure, ust, msc);
+}
 
-    present_fake_get_ust_msc(screen, &ust, &msc);
-    present_event_notify(event_id, ust, msc);
+static uint64_t
+present_fake_ust(void *closure, uint64_t msc)
+{
+    present_screen_priv_ptr     screen_priv = present_screen_priv(closure);
+
+    return msc * screen_priv->fake_interval;
 }
 
-static CARD32
-present_fake_do_timer(OsTimerPtr timer,
-                      CARD32 time,
-                      void *arg)
+static void
+present_fake_notify(ScreenPtr screen, uint64_t event_id)
 {
-    present_fake_vblank_ptr     fake_vblank = arg;
+    uint64_t                    ust, msc;
 
-    present_fake_notify(fake_vblank->screen, fake_vblank->event_id);
-    xorg_list_del(&fake_vblank->list);
-    TimerFree(fake_vblank->timer);
-    free(fake_vblank);
-    return 0;
+    present_fake_get_ust_msc(screen, &ust, &msc);
+    present_event_notify(event_id, ust, msc);
 }
 
 void
 present_fake_abort_vblank(ScreenPtr screen, uint64_t event_id, uint64_t msc)
 {
-    present_fake_vblank_ptr     fake_vblank, tmp;
-
-    xorg_list_for_each_entry_safe(fake_vblank, tmp, &fake_vblank_queue, list) {
-        if (fake_vblank->event_id == event_id) {
-            TimerFree(fake_vblank->timer); /* TimerFree will call TimerCancel() */
-            xorg_list_del(&fake_vblank->list);
-            free (fake_vblank);
-            break;
-        }
-    }
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+
+    present_timer_queue_abort(&screen_priv->fake_vblanks, event_id);
 }
 
 int
@@ -90,28 +74,13 @@ present_fake_queue_vblank(ScreenPtr     screen,
     uint64_t                    ust = msc * screen_priv->fake_interval;
     uint64_t                    now = GetTimeInMicros();
     INT32                       delay = ((int64_t) (ust - now)) / 1000;
-    present_fake_vblank_ptr     fake_vblank;
 
     if (delay <= 0) {
         present_fake_notify(screen, event_id);
         return Success;
     }
 
-    fake_vblank = calloc (1, sizeof (present_fake_vblank_rec));
-    if (!fake_vblank)
-        return BadAlloc;
-
-    fake_vblank->screen = screen;
-    fake_vblank->event_id = event_id;
-    fake_vblank->timer = TimerSet(NULL, 0, delay, present_fake_do_timer, fake_vblank);
-    if (!fake_vblank->timer) {
-        free(fake_vblank);
-        return BadAlloc;
-    }
-
-    xorg_list_add(&fake_vblank->list, &fake_vblank_queue);
-
-    return Success;
+    return present_timer_queue_add(&screen_priv->fake_vblanks, event_id, msc);
 }
 
 uint32_t FakeScreenFps = 0;
@@ -137,10 +106,14 @@ present_fake_screen_init(ScreenPtr screen)
             fake_fps = 60;
     }
     screen_priv->fake_interval = 1000000 / fake_fps;
+    present_timer_queue_init(&screen_priv->fake_vblanks,
+                             present_fake_now, present_fake_ust, screen);
 }
 
 void
-present_fake_queue_init(void)
+present_fake_screen_fini(ScreenPtr screen)
 {
-    xorg_list_init(&fake_vblank_queue);
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+
+    present_timer_queue_fini(&screen_priv->fake_vblanks);
 }
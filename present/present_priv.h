@@ -37,6 +37,7 @@
 #include <randrstr.h>
 #include <inttypes.h>
 #include "dri3.h"
+#include "present_timer_priv.h"
 
 #if 0
 #define DebugPresent(x) ErrorF x
@@ -65,7 +66,8 @@ struct present_notify {
 
 struct present_vblank {
     struct xorg_list    window_list;
-    struct xorg_list    event_queue;
+    struct xorg_list    event_queue;    /* on present_flip_queue */
+    struct xorg_list    event_hash;     /* waiting for event_id */
     ScreenPtr           screen;
     WindowPtr           window;
     PixmapPtr           pixmap;
@@ -84,7 +86,7 @@ struct present_vblank {
     present_fence_ptr   wait_fence;
     present_notify_ptr  notifies;
     int                 num_notifies;
-    Bool                queued;         /* on present_exec_queue */
+    Bool                queued;         /* waiting for an event, not flipping */
     Bool                flip;           /* planning on using flip */
     Bool                flip_ready;     /* wants to flip, but waiting for previous flip or unflip */
     Bool                sync_flip;      /* do flip synchronous to vblank */
@@ -170,6 +172,8 @@ struct present_screen_priv {
     uint64_t                    unflip_event_id;
 
     uint32_t                    fake_interval;
+    /* Pending fake vblanks */
+    present_timer_queue_rec     fake_vblanks;
 
     /* Currently active flipped pixmap and fence */
     RRCrtcPtr                   flip_crtc;
@@ -378,7 +382,7 @@ void
 present_fake_screen_init(ScreenPtr screen);
 
 void
-present_fake_queue_init(void);
+present_fake_screen_fini(ScreenPtr screen);
 
 /*
  * present_fence.c
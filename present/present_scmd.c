@@ -21,6 +21,7 @@
  */
 #include <dix-config.h>
 
+#include "composite/compositeext_priv.h"
 #include "randr/randrstr_priv.h"
 
 #include "present_priv.h"
@@ -37,12 +38,50 @@
 
 static uint64_t present_scmd_event_id;
 
-static struct xorg_list present_exec_queue;
+/*
+ * Every vblank waiting for an event from the driver is hashed by its
+ * event ID; those waiting to flip are on present_flip_queue as well.
+ * Event IDs are handed out sequentially, so the low bits make a
+ * good enough hash.
+ */
+#define PRESENT_EVENT_HASH_SIZE 256
+
+static struct xorg_list present_event_hash[PRESENT_EVENT_HASH_SIZE];
 static struct xorg_list present_flip_queue;
 
 static void
 present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc);
 
+static void
+present_event_hash_add(present_vblank_ptr vblank)
+{
+    xorg_list_del(&vblank->event_hash);
+    xorg_list_add(&vblank->event_hash,
+                  &present_event_hash[vblank->event_id % PRESENT_EVENT_HASH_SIZE]);
+}
+
+static present_vblank_ptr
+present_event_hash_find(uint64_t event_id)
+{
+    present_vblank_ptr  vblank;
+
+    xorg_list_for_each_entry(vblank,
+                             &present_event_hash[event_id % PRESENT_EVENT_HASH_SIZE],
+                             event_hash) {
+        if (vblank->event_id == event_id)
+            return vblank;
+    }
+    return NULL;
+}
+
+/* Stop waiting for any event */
+static void
+present_event_dequeue(present_vblank_ptr vblank)
+{
+    xorg_list_del(&vblank->event_queue);
+    xorg_list_del(&vblank->event_hash);
+}
+
 static inline PixmapPtr
 present_flip_pending_pixmap(ScreenPtr screen)
 {
@@ -57,6 +96,52 @@ present_flip_pending_pixmap(ScreenPtr screen)
     return screen_priv->flip_pending->pixmap;
 }
 
+/*
+ * A window can be flipped if it draws to the screen pixmap (or the one
+ * flipped in its place), or if Composite redirects it but would just copy
+ * it to the screen unchanged
+ */
+static Bool
+present_window_pixmap_flippable(WindowPtr window)
+{
+    ScreenPtr                   screen = window->drawable.pScreen;
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    PixmapPtr                   window_pixmap;
+
+    if (window->redirectDraw != RedirectDrawNone)
+        return CompositeCanScanoutWindow(window);
+
+    window_pixmap = screen->GetWindowPixmap(window);
+    return window_pixmap == screen->GetScreenPixmap(screen) ||
+        window_pixmap == screen_priv->flip_pixmap ||
+        window_pixmap == present_flip_pending_pixmap(screen);
+}
+
+/*
+ * Point the window at the flip pixmap.  Composite keeps the own pixmap of
+ * redirected windows aside until they are unflipped.
+ */
+static void
+present_flip_window_pixmap(WindowPtr window, PixmapPtr pixmap)
+{
+    if (window->redirectDraw != RedirectDrawNone)
+        CompositeSetScanoutPixmap(window, pixmap);
+    else
+        present_set_tree_pixmap(window, NULL, pixmap);
+}
+
+static void
+present_unflip_window_pixmap(WindowPtr window, PixmapPtr flip_pixmap,
+                             PixmapPtr screen_pixmap)
+{
+    ScreenPtr                   screen = window->drawable.pScreen;
+
+    if (window->redirectDraw == RedirectDrawNone)
+        present_set_tree_pixmap(window, flip_pixmap, screen_pixmap);
+    else if (screen->GetWindowPixmap(window) == flip_pixmap)
+        CompositeSetScanoutPixmap(window, NULL);
+}
+
 static Bool
 present_check_flip(RRCrtcPtr            crtc,
                    WindowPtr            window,
@@ -68,7 +153,6 @@ present_check_flip(RRCrtcPtr            crtc,
                    PresentFlipReason   *reason)
 {
     ScreenPtr                   screen = window->drawable.pScreen;
-    PixmapPtr                   window_pixmap;
     WindowPtr                   root = screen->root;
     present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
     PresentFlipReason           tmp_reason = PRESENT_FLIP_REASON_UNKNOWN;
@@ -113,11 +197,8 @@ present_check_flip(RRCrtcPtr            crtc,
         }
     }
 
-    /* Make sure the window hasn't been redirected with Composite */
-    window_pixmap = screen->GetWindowPixmap(window);
-    if (window_pixmap != screen->GetScreenPixmap(screen) &&
-        window_pixmap != screen_priv->flip_pixmap &&
-        window_pixmap != present_flip_pending_pixmap(screen))
+    /* Make sure the window draws straight to the screen */
+    if (!present_window_pixmap_flippable(window))
         return FALSE;
 
     /* Check for full-screen window */
@@ -313,7 +394,7 @@ present_restore_screen_pixmap(ScreenPtr screen)
      * 2D applications drawing to the wrong pixmap.
      */
     if (flip_window)
-        present_set_tree_pixmap(flip_window, flip_pixmap, screen_pixmap);
+        present_unflip_window_pixmap(flip_window, flip_pixmap, screen_pixmap);
     if (screen->root)
         present_set_tree_pixmap(screen->root, NULL, screen_pixmap);
 }
@@ -359,7 +440,7 @@ present_flip_notify(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
 
     present_flip_idle(screen);
 
-    xorg_list_del(&vblank->event_queue);
+    present_event_dequeue(vblank);
 
     /* Transfer reference for pixmap and fence from vblank to screen_priv */
     screen_priv->flip_crtc = vblank->crtc;
@@ -391,21 +472,13 @@ present_event_notify(uint64_t event_id, uint64_t ust, uint64_t msc)
     if (!event_id)
         return;
     DebugPresent(("\te %" PRIu64 " ust %" PRIu64 " msc %" PRIu64 "\n", event_id, ust, msc));
-    xorg_list_for_each_entry(vblank, &present_exec_queue, event_queue) {
-        int64_t match = event_id - vblank->event_id;
-        if (match == 0) {
+    vblank = present_event_hash_find(event_id);
+    if (vblank) {
+        if (vblank->queued)
             present_execute(vblank, ust, msc);
-            return;
-        }
-    }
-    xorg_list_for_each_entry(vblank, &present_flip_queue, event_queue) {
-        if (vblank->event_id == event_id) {
-            if (vblank->queued)
-                present_execute(vblank, ust, msc);
-            else
-                present_flip_notify(vblank, ust, msc);
-            return;
-        }
+        else
+            present_flip_notify(vblank, ust, msc);
+        return;
     }
 
     for (unsigned walkScreenIdx = 0; walkScreenIdx < screenInfo.numScreens; walkScreenIdx++) {
@@ -481,7 +554,6 @@ static Bool
 present_scmd_can_window_flip(WindowPtr window)
 {
     ScreenPtr                   screen = window->drawable.pScreen;
-    PixmapPtr                   window_pixmap;
     WindowPtr                   root = screen->root;
     present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
 
@@ -495,11 +567,8 @@ present_scmd_can_window_flip(WindowPtr window)
     if (!screen_priv->info->flip)
         return FALSE;
 
-    /* Make sure the window hasn't been redirected with Composite */
-    window_pixmap = screen->GetWindowPixmap(window);
-    if (window_pixmap != screen->GetScreenPixmap(screen) &&
-        window_pixmap != screen_priv->flip_pixmap &&
-        window_pixmap != present_flip_pending_pixmap(screen))
+    /* Make sure the window draws straight to the screen */
+    if (!present_window_pixmap_flippable(window))
         return FALSE;
 
     /* Check for full-screen window */
@@ -565,12 +634,13 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
                           screen_priv->flip_pending, screen_priv->unflip_event_id));
             xorg_list_del(&vblank->event_queue);
             xorg_list_append(&vblank->event_queue, &present_flip_queue);
+            present_event_hash_add(vblank);
             vblank->flip_ready = TRUE;
             return;
         }
     }
 
-    xorg_list_del(&vblank->event_queue);
+    present_event_dequeue(vblank);
     xorg_list_del(&vblank->window_list);
     vblank->queued = FALSE;
 
@@ -590,6 +660,7 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
             screen_priv->flip_pending = vblank;
 
             xorg_list_add(&vblank->event_queue, &present_flip_queue);
+            present_event_hash_add(vblank);
             /* Try to flip
              */
             if (present_flip(vblank->crtc, vblank->event_id, vblank->target_msc, vblank->pixmap, vblank->sync_flip)) {
@@ -600,10 +671,10 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
                  *  2) Set current flip window pixmap to the new pixmap
                  */
                 if (screen_priv->flip_window && screen_priv->flip_window != window)
-                    present_set_tree_pixmap(screen_priv->flip_window,
-                                            screen_priv->flip_pixmap,
-                                            (*screen->GetScreenPixmap)(screen));
-                present_set_tree_pixmap(vblank->window, NULL, vblank->pixmap);
+                    present_unflip_window_pixmap(screen_priv->flip_window,
+                                                 screen_priv->flip_pixmap,
+                                                 (*screen->GetScreenPixmap)(screen));
+                present_flip_window_pixmap(vblank->window, vblank->pixmap);
                 present_set_tree_pixmap(screen->root, NULL, vblank->pixmap);
 
                 /* Report update region as damaged
@@ -618,7 +689,7 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
                 return;
             }
 
-            xorg_list_del(&vblank->event_queue);
+            present_event_dequeue(vblank);
             /* Oops, flip failed. Clear the flip_pending field
               */
             screen_priv->flip_pending = NULL;
@@ -689,7 +760,7 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
         }
 
         if (vblank->queued) {
-            xorg_list_add(&vblank->event_queue, &present_exec_queue);
+            present_event_hash_add(vblank);
             xorg_list_append(&vblank->window_list,
                              &present_get_window_priv(window, TRUE)->vblank);
             return;
@@ -858,7 +929,7 @@ present_scmd_pixmap(WindowPtr window,
              (vblank->flip && vblank->sync_flip))
         vblank->exec_msc--;
 
-    xorg_list_append(&vblank->event_queue, &present_exec_queue);
+    present_event_hash_add(vblank);
     vblank->queued = TRUE;
     if (msc_is_after(vblank->exec_msc, crtc_msc)) {
         ret = present_queue_vblank(screen, window, target_crtc, vblank->event_id, vblank->exec_msc);
@@ -887,20 +958,10 @@ present_scmd_abort_vblank(ScreenPtr screen, WindowPtr window, RRCrtcPtr crtc, ui
         (*screen_priv->info->abort_vblank) (crtc, event_id, msc);
     }
 
-    xorg_list_for_each_entry(vblank, &present_exec_queue, event_queue) {
-        int64_t match = event_id - vblank->event_id;
-        if (match == 0) {
-            xorg_list_del(&vblank->event_queue);
-            vblank->queued = FALSE;
-            return;
-        }
-    }
-    xorg_list_for_each_entry(vblank, &present_flip_queue, event_queue) {
-        if (vblank->event_id == event_id) {
-            xorg_list_del(&vblank->event_queue);
-            vblank->queued = FALSE;
-            return;
-        }
+    vblank = present_event_hash_find(event_id);
+    if (vblank) {
+        present_event_dequeue(vblank);
+        vblank->queued = FALSE;
     }
 }
 
@@ -938,11 +999,46 @@ present_scmd_init_mode_hooks(present_screen_priv_ptr screen_priv)
     screen_priv->flip_destroy       =   &present_scmd_flip_destroy;
 }
 
+/*
+ * Composite took the window's own pixmap back while it was flipped, to
+ * name, reallocate or unredirect it.  Stop flipping the window, and copy
+ * the frames already queued for it instead of flipping them.
+ */
+static void
+present_scanout_restored(CallbackListPtr *pcbl, void *closure, void *data)
+{
+    WindowPtr                   window = data;
+    ScreenPtr                   screen = window->drawable.pScreen;
+    present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    present_window_priv_ptr     window_priv = present_window_priv(window);
+    present_vblank_ptr          vblank;
+
+    if (!screen_priv || !window_priv)
+        return;
+
+    if (screen_priv->flip_pending) {
+        if (screen_priv->flip_pending->window == window)
+            present_set_abort_flip(screen);
+    } else if (!screen_priv->unflip_event_id) {
+        if (screen_priv->flip_window == window)
+            present_unflip(screen);
+    }
+
+    xorg_list_for_each_entry(vblank, &window_priv->vblank, window_list) {
+        if (vblank->queued && vblank->flip) {
+            vblank->flip = FALSE;
+            if (vblank->sync_flip)
+                vblank->exec_msc = vblank->target_msc;
+        }
+    }
+}
+
 Bool
 present_init(void)
 {
-    xorg_list_init(&present_exec_queue);
+    for (int i = 0; i < PRESENT_EVENT_HASH_SIZE; i++)
+        xorg_list_init(&present_event_hash[i]);
     xorg_list_init(&present_flip_queue);
-    present_fake_queue_init();
-    return TRUE;
+    return AddCallback(&CompositeScanoutRestoreCallback,
+                       present_scanout_restored, NULL);
 }
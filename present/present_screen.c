@@ -65,6 +65,8 @@ static void present_close_screen(CallbackListPtr *pcbl, ScreenPtr screen, void *
     if (screen_priv->flip_destroy)
         screen_priv->flip_destroy(screen);
 
+    present_fake_screen_fini(screen);
+
     dixScreenUnhookClose(screen, present_close_screen);
     dixSetPrivate(&screen->devPrivates, &present_screen_private_key, NULL);
     free(screen_priv);
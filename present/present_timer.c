@@ -0,0 +1,171 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <dix-config.h>
+
+#include "present_priv.h"
+#include "present_timer_priv.h"
+
+typedef struct present_timer_event {
+    struct xorg_list            list;
+    uint64_t                    event_id;
+    uint64_t                    msc;
+} present_timer_event_rec, *present_timer_event_ptr;
+
+/*
+ * Milliseconds until the first queued event is due, or 0 if there's
+ * nothing left to wait for
+ */
+static CARD32
+present_timer_delay(present_timer_queue_ptr queue)
+{
+    present_timer_event_ptr     first;
+    int64_t                     delay;
+
+    if (xorg_list_is_empty(&queue->events))
+        return 0;
+
+    first = xorg_list_first_entry(&queue->events, present_timer_event_rec, list);
+    delay = (int64_t) (queue->ust(queue->closure, first->msc) -
+                       GetTimeInMicros());
+
+    return delay > 0 ? (delay + 999) / 1000 : 1;
+}
+
+static CARD32
+present_timer_fire(OsTimerPtr timer, CARD32 time, void *arg)
+{
+    present_timer_queue_ptr     queue = arg;
+    present_timer_event_ptr     event;
+    uint64_t                    ust, msc;
+
+    queue->now(queue->closure, &ust, &msc);
+
+    /* Notifying may queue or abort other events, so take them off the
+     * list one at a time
+     */
+    while (!xorg_list_is_empty(&queue->events)) {
+        event = xorg_list_first_entry(&queue->events,
+                                      present_timer_event_rec, list);
+        if (msc_is_after(event->msc, msc))
+            break;
+
+        xorg_list_del(&event->list);
+        present_event_notify(event->event_id, ust, msc);
+        free(event);
+    }
+
+    return present_timer_delay(queue);
+}
+
+void
+present_timer_queue_update(present_timer_queue_ptr queue)
+{
+    CARD32 delay = present_timer_delay(queue);
+
+    if (delay)
+        queue->timer = TimerSet(queue->timer, 0, delay,
+                                present_timer_fire, queue);
+    else
+        TimerCancel(queue->timer);
+}
+
+void
+present_timer_queue_init(present_timer_queue_ptr queue,
+                         present_timer_now_proc now,
+                         present_timer_ust_proc ust,
+                         void *closure)
+{
+    xorg_list_init(&queue->events);
+    queue->timer = NULL;
+    queue->now = now;
+    queue->ust = ust;
+    queue->closure = closure;
+}
+
+int
+present_timer_queue_add(present_timer_queue_ptr queue,
+                        uint64_t event_id, uint64_t msc)
+{
+    present_timer_event_ptr     event;
+    struct xorg_list            *pos;
+
+    event = calloc(1, sizeof(present_timer_event_rec));
+    if (!event)
+        return BadAlloc;
+
+    event->event_id = event_id;
+    event->msc = msc;
+
+    /* Most clients queue for the next few frames, so look for our place
+     * from the end of the list
+     */
+    for (pos = queue->events.prev; pos != &queue->events; pos = pos->prev) {
+        present_timer_event_ptr prev =
+            xorg_list_entry(pos, present_timer_event_rec, list);
+
+        if (!msc_is_after(prev->msc, msc))
+            break;
+    }
+    xorg_list_add(&event->list, pos);
+
+    if (event->list.prev == &queue->events) {
+        present_timer_queue_update(queue);
+        if (!queue->timer) {
+            xorg_list_del(&event->list);
+            free(event);
+            return BadAlloc;
+        }
+    }
+
+    return Success;
+}
+
+void
+present_timer_queue_abort(present_timer_queue_ptr queue, uint64_t event_id)
+{
+    present_timer_event_ptr     event;
+
+    xorg_list_for_each_entry(event, &queue->events, list) {
+        if (event->event_id == event_id) {
+            Bool first = event->list.prev == &queue->events;
+
+            xorg_list_del(&event->list);
+            free(event);
+            if (first)
+                present_timer_queue_update(queue);
+            return;
+        }
+    }
+}
+
+void
+present_timer_queue_fini(present_timer_queue_ptr queue)
+{
+    present_timer_event_ptr     event, tmp;
+
+    TimerFree(queue->timer);
+    queue->timer = NULL;
+
+    xorg_list_for_each_entry_safe(event, tmp, &queue->events, list) {
+        xorg_list_del(&event->list);
+        free(event);
+    }
+}
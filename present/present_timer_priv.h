@@ -0,0 +1,72 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef _PRESENT_TIMER_PRIV_H_
+#define _PRESENT_TIMER_PRIV_H_
+
+#include <stdint.h>
+
+#include "os.h"
+#include "list.h"
+
+/*
+ * Vblank events for a clock without a vblank interrupt, kept in MSC order
+ * with a single timer for the earliest one.  When it fires, every event
+ * that has come due is notified in one go.  Used by the fake vblanks and
+ * by DDXen with virtual CRTCs.
+ */
+
+/* Current UST and MSC of the clock */
+typedef void (*present_timer_now_proc)(void *closure,
+                                       uint64_t *ust, uint64_t *msc);
+
+/* UST at which the clock reaches msc */
+typedef uint64_t (*present_timer_ust_proc)(void *closure, uint64_t msc);
+
+typedef struct present_timer_queue {
+    struct xorg_list            events;
+    OsTimerPtr                  timer;
+    present_timer_now_proc      now;
+    present_timer_ust_proc      ust;
+    void                        *closure;
+} present_timer_queue_rec, *present_timer_queue_ptr;
+
+void
+present_timer_queue_init(present_timer_queue_ptr queue,
+                         present_timer_now_proc now,
+                         present_timer_ust_proc ust,
+                         void *closure);
+
+int
+present_timer_queue_add(present_timer_queue_ptr queue,
+                        uint64_t event_id, uint64_t msc);
+
+void
+present_timer_queue_abort(present_timer_queue_ptr queue, uint64_t event_id);
+
+/* The clock changed rate, reschedule the timer */
+void
+present_timer_queue_update(present_timer_queue_ptr queue);
+
+void
+present_timer_queue_fini(present_timer_queue_ptr queue);
+
+#endif /* _PRESENT_TIMER_PRIV_H_ */
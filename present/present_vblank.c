@@ -81,6 +81,7 @@ present_vblank_init(present_vblank_ptr vblank,
 
     xorg_list_append(&vblank->window_list, &window_priv->vblank);
     xorg_list_init(&vblank->event_queue);
+    xorg_list_init(&vblank->event_hash);
 
     vblank->screen = screen;
     vblank->window = window;
@@ -243,8 +244,9 @@ present_vblank_destroy(present_vblank_ptr vblank)
 {
     /* Remove vblank from window and screen lists */
     xorg_list_del(&vblank->window_list);
-    /* Also make sure vblank is removed from event queue (wnmd) */
+    /* Also make sure vblank is removed from the event queues */
     xorg_list_del(&vblank->event_queue);
+    xorg_list_del(&vblank->event_hash);
 
     DebugPresent(("\td %" PRIu64 " %p %" PRIu64 " %" PRIu64 ": %08" PRIx32 " -> %08" PRIx32 "\n",
                   vblank->event_id, vblank, vblank->exec_msc, vblank->target_msc,
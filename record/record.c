@@ -67,7 +67,7 @@ static RESTYPE RTContext;       /* internal resource type for Record contexts */
 /* How many bytes of protocol data to buffer in a context. Don't set to less
  * than 32.
  */
-#define REPLY_BUF_SIZE 1024
+#define REPLY_BUF_SIZE 8192
 
 /* Record Context structure */
 
@@ -82,6 +82,9 @@ typedef struct {
     int numBufBytes;            /* number of bytes in replyBuffer */
     char replyBuffer[REPLY_BUF_SIZE];   /* buffered recorded protocol */
     int inFlush;                /*  are we inside RecordFlushReplyBuffer */
+    XID cachedClient;           /* client of the last RCAP lookup */
+    struct _RecordClientsAndProtocolRec *pCachedRCAP;   /* and its RCAP */
+    unsigned int cacheSerial;   /* recordClientsSerial of the above */
 } RecordContextRec, *RecordContextPtr;
 
 /*  RecordMinorOpRec - to hold minor opcode selections for extension requests
@@ -120,11 +123,30 @@ typedef struct _RecordClientsAndProtocolRec {
     unsigned int clientStarted:1;       /* record new client connections? */
     unsigned int clientDied:1;  /* record client disconnections? */
     unsigned int clientIDsSeparatelyAllocated:1;        /* pClientIDs calloced? */
+    /* The sets above as bitmaps, so that recording a protocol element
+     * doesn't have to search them.  The minor opcode bitmaps are indexed
+     * by extension major opcode - 128 and only hold minor opcodes < 256.
+     */
+    CARD8 requestMajorOpBits[32];
+    CARD8 replyMajorOpBits[32];
+    CARD8 deviceEventBits[32];
+    CARD8 deliveredEventBits[32];
+    CARD8 errorBits[32];
+    CARD8 (*pRequestMinOpBits)[32];
+    CARD8 (*pReplyMinOpBits)[32];
 } RecordClientsAndProtocolRec, *RecordClientsAndProtocolPtr;
 
 /* how much bigger to make pRCAP->pClientIDs when reallocing */
 #define CLIENT_ARRAY_GROWTH_INCREMENT 4
 
+/* size of the minor opcode bitmaps of an RCAP */
+#define MINOR_OP_BITS_SIZE (128 * 32)
+
+/* bumped whenever any RCAP gains or loses clients, to invalidate the
+ * RCAP lookup caches of all contexts
+ */
+static unsigned int recordClientsSerial = 1;
+
 /* counts the total number of RCAPs belonging to enabled contexts. */
 static int numEnabledRCAPs;
 
@@ -436,6 +458,69 @@ RecordFindClientOnContext(RecordContextPtr pContext,
     return NULL;
 }                               /* RecordFindClientOnContext */
 
+/* RecordFindClientRCAP
+ *
+ * Arguments:
+ *	pContext is the context to search.
+ *	clientspec is the resource ID mask identifying the client to search
+ *	  for.
+ *
+ * Returns:
+ *	The RCAP on which clientspec was found, or NULL if not found on
+ *	any RCAP on the given context.
+ *
+ * Side Effects:
+ *	The result is cached on the context, since consecutive protocol
+ *	elements are usually from the same client.
+ */
+static RecordClientsAndProtocolPtr
+RecordFindClientRCAP(RecordContextPtr pContext, XID clientspec)
+{
+    if (pContext->cacheSerial != recordClientsSerial ||
+        pContext->cachedClient != clientspec) {
+        pContext->pCachedRCAP =
+            RecordFindClientOnContext(pContext, clientspec, NULL);
+        pContext->cachedClient = clientspec;
+        pContext->cacheSerial = recordClientsSerial;
+    }
+    return pContext->pCachedRCAP;
+}                               /* RecordFindClientRCAP */
+
+/* RecordIsMinorOpSelected
+ *
+ * Arguments:
+ *	pMinorOpInfo is the minor opcode selections of an RCAP.
+ *	pBits is the bitmap of the same selections.
+ *	majorop and minorop identify an extension request or reply.
+ *
+ * Returns:
+ *	Non-zero if minorop of extension majorop is selected.
+ *
+ * Side Effects: none.
+ */
+static int
+RecordIsMinorOpSelected(RecordMinorOpPtr pMinorOpInfo, CARD8 (*pBits)[32],
+                        int majorop, int minorop)
+{
+    int numMinOpInfo;
+
+    assert(pMinorOpInfo);
+    if (minorop < 256)
+        return BitIsOn(pBits[majorop - 128], minorop);
+
+    /* too large for the bitmap, search the sets */
+    numMinOpInfo = pMinorOpInfo->count;
+    pMinorOpInfo++;
+    assert(numMinOpInfo);
+    for (; numMinOpInfo; numMinOpInfo--, pMinorOpInfo++) {
+        if (majorop >= pMinorOpInfo->major.first &&
+            majorop <= pMinorOpInfo->major.last &&
+            RecordIsMemberOfSet(pMinorOpInfo->major.pMinOpSet, minorop))
+            return TRUE;
+    }
+    return FALSE;
+}                               /* RecordIsMinorOpSelected */
+
 /* RecordABigRequest
  *
  * Arguments:
@@ -514,45 +599,19 @@ RecordARequest(ClientPtr client)
     majorop = stuff->reqType;
     for (i = 0; i < numEnabledContexts; i++) {
         pContext = ppAllContexts[i];
-        pRCAP = RecordFindClientOnContext(pContext, client->clientAsMask, NULL);
-        if (pRCAP && pRCAP->pRequestMajorOpSet &&
-            RecordIsMemberOfSet(pRCAP->pRequestMajorOpSet, majorop)) {
-            if (majorop <= 127) {       /* core request */
-
-                if (client->req_len == 0)
-                    RecordABigRequest(pContext, client, stuff);
-                else
-                    RecordAProtocolElement(pContext, client, XRecordFromClient,
-                                           (void *) stuff,
-                                           client->req_len << 2, 0, 0);
-            }
-            else {              /* extension, check minor opcode */
-
-                int minorop = client->minorOp;
-                int numMinOpInfo;
-                RecordMinorOpPtr pMinorOpInfo = pRCAP->pRequestMinOpInfo;
-
-                assert(pMinorOpInfo);
-                numMinOpInfo = pMinorOpInfo->count;
-                pMinorOpInfo++;
-                assert(numMinOpInfo);
-                for (; numMinOpInfo; numMinOpInfo--, pMinorOpInfo++) {
-                    if (majorop >= pMinorOpInfo->major.first &&
-                        majorop <= pMinorOpInfo->major.last &&
-                        RecordIsMemberOfSet(pMinorOpInfo->major.pMinOpSet,
-                                            minorop)) {
-                        if (client->req_len == 0)
-                            RecordABigRequest(pContext, client, stuff);
-                        else
-                            RecordAProtocolElement(pContext, client,
-                                                   XRecordFromClient,
-                                                   (void *) stuff,
-                                                   client->req_len << 2, 0, 0);
-                        break;
-                    }
-                }               /* end for each minor op info */
-            }                   /* end extension request */
-        }                       /* end this RCAP wants this major opcode */
+        pRCAP = RecordFindClientRCAP(pContext, client->clientAsMask);
+        if (pRCAP && BitIsOn(pRCAP->requestMajorOpBits, majorop) &&
+            (majorop <= 127 ||  /* core request, or extension: check minor */
+             RecordIsMinorOpSelected(pRCAP->pRequestMinOpInfo,
+                                     pRCAP->pRequestMinOpBits,
+                                     majorop, client->minorOp))) {
+            if (client->req_len == 0)
+                RecordABigRequest(pContext, client, stuff);
+            else
+                RecordAProtocolElement(pContext, client, XRecordFromClient,
+                                       (void *) stuff,
+                                       client->req_len << 2, 0, 0);
+        }                       /* end this RCAP wants this request */
     }                           /* end for each context */
     pClientPriv = RecordClientPrivate(client);
     assert(pClientPriv);
@@ -589,7 +648,7 @@ RecordAReply(CallbackListPtr *pcbl, void *nulldata, void *calldata)
 
     for (eci = 0; eci < numEnabledContexts; eci++) {
         pContext = ppAllContexts[eci];
-        pRCAP = RecordFindClientOnContext(pContext, client->clientAsMask, NULL);
+        pRCAP = RecordFindClientRCAP(pContext, client->clientAsMask);
         if (pRCAP) {
             int majorop = client->majorOp;
 
@@ -601,42 +660,18 @@ RecordAReply(CallbackListPtr *pcbl, void *nulldata, void *calldata)
                 if (!pri->bytesRemaining)
                     pContext->continuedReply = 0;
             }
-            else if (pri->startOfReply && pRCAP->pReplyMajorOpSet &&
-                     RecordIsMemberOfSet(pRCAP->pReplyMajorOpSet, majorop)) {
-                if (majorop <= 127) {   /* core reply */
-                    RecordAProtocolElement(pContext, client, XRecordFromServer,
-                                           (void *) pri->replyData,
-                                           pri->dataLenBytes, 0,
-                                           pri->bytesRemaining);
-                    if (pri->bytesRemaining)
-                        pContext->continuedReply = 1;
-                }
-                else {          /* extension, check minor opcode */
-
-                    int minorop = client->minorOp;
-                    int numMinOpInfo;
-                    RecordMinorOpPtr pMinorOpInfo = pRCAP->pReplyMinOpInfo;
-
-                    assert(pMinorOpInfo);
-                    numMinOpInfo = pMinorOpInfo->count;
-                    pMinorOpInfo++;
-                    assert(numMinOpInfo);
-                    for (; numMinOpInfo; numMinOpInfo--, pMinorOpInfo++) {
-                        if (majorop >= pMinorOpInfo->major.first &&
-                            majorop <= pMinorOpInfo->major.last &&
-                            RecordIsMemberOfSet(pMinorOpInfo->major.pMinOpSet,
-                                                minorop)) {
-                            RecordAProtocolElement(pContext, client,
-                                                   XRecordFromServer,
-                                                   (void *) pri->replyData,
-                                                   pri->dataLenBytes, 0,
-                                                   pri->bytesRemaining);
-                            if (pri->bytesRemaining)
-                                pContext->continuedReply = 1;
-                            break;
-                        }
-                    }           /* end for each minor op info */
-                }               /* end extension reply */
+            else if (pri->startOfReply &&
+                     BitIsOn(pRCAP->replyMajorOpBits, majorop) &&
+                     (majorop <= 127 || /* core reply, or extension: check minor */
+                      RecordIsMinorOpSelected(pRCAP->pReplyMinOpInfo,
+                                              pRCAP->pReplyMinOpBits,
+                                              majorop, client->minorOp))) {
+                RecordAProtocolElement(pContext, client, XRecordFromServer,
+                                       (void *) pri->replyData,
+                                       pri->dataLenBytes, 0,
+                                       pri->bytesRemaining);
+                if (pri->bytesRemaining)
+                    pContext->continuedReply = 1;
             }                   /* end continued reply vs. start of reply */
         }                       /* end client is registered on this context */
     }                           /* end for each context */
@@ -669,8 +704,7 @@ RecordADeliveredEventOrError(CallbackListPtr *pcbl, void *nulldata,
 
     for (eci = 0; eci < numEnabledContexts; eci++) {
         pContext = ppAllContexts[eci];
-        pRCAP = RecordFindClientOnContext(pContext, pClient->clientAsMask,
-                                          NULL);
+        pRCAP = RecordFindClientRCAP(pContext, pClient->clientAsMask);
         if (pRCAP && (pRCAP->pDeliveredEventSet || pRCAP->pErrorSet)) {
             int ev;             /* event index */
             xEvent *pev = pei->events;
@@ -679,13 +713,12 @@ RecordADeliveredEventOrError(CallbackListPtr *pcbl, void *nulldata,
                 int recordit = 0;
 
                 if (pRCAP->pErrorSet) {
-                    recordit = RecordIsMemberOfSet(pRCAP->pErrorSet,
-                                                   ((xError *) (pev))->
-                                                   errorCode);
+                    recordit = BitIsOn(pRCAP->errorBits,
+                                       ((xError *) (pev))->errorCode);
                 }
                 else if (pRCAP->pDeliveredEventSet) {
-                    recordit = RecordIsMemberOfSet(pRCAP->pDeliveredEventSet,
-                                                   pev->u.u.type & 0177);
+                    recordit = BitIsOn(pRCAP->deliveredEventBits,
+                                       pev->u.u.type & 0177);
                 }
                 if (recordit) {
                     xEvent swappedEvent;
@@ -713,7 +746,7 @@ RecordSendProtocolEvents(RecordClientsAndProtocolPtr pRCAP,
     int ev;                     /* event index */
 
     for (ev = 0; ev < count; ev++, pev++) {
-        if (RecordIsMemberOfSet(pRCAP->pDeviceEventSet, pev->u.u.type & 0177)) {
+        if (BitIsOn(pRCAP->deviceEventBits, pev->u.u.type & 0177)) {
             xEvent swappedEvent;
             xEvent *pEvToRecord = pev;
 
@@ -1033,6 +1066,7 @@ RecordUninstallHooks(RecordClientsAndProtocolPtr pRCAP, XID oneclient)
 static void
 RecordDeleteClientFromRCAP(RecordClientsAndProtocolPtr pRCAP, int position)
 {
+    recordClientsSerial++;
     if (pRCAP->pContext->pRecordingClient)
         RecordUninstallHooks(pRCAP, pRCAP->pClientIDs[position]);
     if (position != pRCAP->numClients - 1)
@@ -1077,6 +1111,7 @@ RecordDeleteClientFromRCAP(RecordClientsAndProtocolPtr pRCAP, int position)
 static void
 RecordAddClientToRCAP(RecordClientsAndProtocolPtr pRCAP, XID clientspec)
 {
+    recordClientsSerial++;
     if (pRCAP->numClients == pRCAP->sizeClients) {
         if (pRCAP->clientIDsSeparatelyAllocated) {
             XID *pNewIDs =
@@ -1512,6 +1547,61 @@ RecordConvertRangesToIntervals(SetInfoPtr psi,
     return Success;
 }                               /* end RecordConvertRangesToIntervals */
 
+/* RecordSetToBits
+ *
+ * Arguments:
+ *	pSet is the set to convert, or NULL.
+ *	pBits is a bitmap of 256 bits.
+ *
+ * Returns: nothing.
+ *
+ * Side Effects:
+ *	The bits of all members of pSet below 256 are set in pBits.
+ */
+static void
+RecordSetToBits(RecordSetPtr pSet, CARD8 *pBits)
+{
+    RecordSetIteratePtr pIter = NULL;
+    RecordSetInterval interval;
+    int member;
+
+    if (!pSet)
+        return;
+
+    while ((pIter = RecordIterateSet(pSet, pIter, &interval))) {
+        for (member = interval.first;
+             member <= interval.last && member < 256; member++)
+            SetBit(pBits, member);
+    }
+}                               /* RecordSetToBits */
+
+/* RecordMinorOpInfoToBits
+ *
+ * Arguments:
+ *	pMinorOpInfo is the minor opcode selections of an RCAP.
+ *	pBits is an array of 128 bitmaps of 256 bits, one for each
+ *	  extension major opcode.
+ *
+ * Returns: nothing.
+ *
+ * Side Effects:
+ *	The minor opcodes below 256 selected for each extension major
+ *	opcode are set in its bitmap.
+ */
+static void
+RecordMinorOpInfoToBits(RecordMinorOpPtr pMinorOpInfo, CARD8 (*pBits)[32])
+{
+    int numMinOpInfo = pMinorOpInfo->count;
+    int majorop;
+
+    for (pMinorOpInfo++; numMinOpInfo; numMinOpInfo--, pMinorOpInfo++) {
+        for (majorop = max(pMinorOpInfo->major.first, 128);
+             majorop <= pMinorOpInfo->major.last; majorop++)
+            RecordSetToBits(pMinorOpInfo->major.pMinOpSet,
+                            pBits[majorop - 128]);
+    }
+}                               /* RecordMinorOpInfoToBits */
+
 #define offset_of(_structure, _field) \
     ((char *)(& (_structure . _field)) - (char *)(&_structure))
 
@@ -1547,6 +1637,8 @@ RecordRegisterClients(RecordContextPtr pContext, ClientPtr client,
     int nExtRepSets = 0;
     int extReqSetsOffset = 0;
     int extRepSetsOffset = 0;
+    int extReqBitsOffset = 0;
+    int extRepBitsOffset = 0;
     SetInfoPtr pExtReqSets, pExtRepSets;
     int clientListOffset;
     XID *pCanonClients;
@@ -1672,11 +1764,15 @@ RecordRegisterClients(RecordContextPtr pContext, ClientPtr client,
         pad = RecordPadAlign(totRCAPsize, sizeof(RecordSetPtr));
         extReqSetsOffset = totRCAPsize + pad;
         totRCAPsize += pad + (nExtReqSets + 1) * sizeof(RecordMinorOpRec);
+        extReqBitsOffset = totRCAPsize;
+        totRCAPsize += MINOR_OP_BITS_SIZE;
     }
     if (nExtRepSets) {
         pad = RecordPadAlign(totRCAPsize, sizeof(RecordSetPtr));
         extRepSetsOffset = totRCAPsize + pad;
         totRCAPsize += pad + (nExtRepSets + 1) * sizeof(RecordMinorOpRec);
+        extRepBitsOffset = totRCAPsize;
+        totRCAPsize += MINOR_OP_BITS_SIZE;
     }
 
     for (i = 0; i < maxSets; i++) {
@@ -1771,6 +1867,9 @@ RecordRegisterClients(RecordContextPtr pContext, ClientPtr client,
                                                 pExtReqSets->offset),
                                 pExtReqSets->size);
         }
+        pRCAP->pRequestMinOpBits = (void *) ((char *) pRCAP + extReqBitsOffset);
+        RecordMinorOpInfoToBits(pRCAP->pRequestMinOpInfo,
+                                pRCAP->pRequestMinOpBits);
     }
     else
         pRCAP->pRequestMinOpInfo = NULL;
@@ -1789,10 +1888,19 @@ RecordRegisterClients(RecordContextPtr pContext, ClientPtr client,
                                                 pExtRepSets->offset),
                                 pExtRepSets->size);
         }
+        pRCAP->pReplyMinOpBits = (void *) ((char *) pRCAP + extRepBitsOffset);
+        RecordMinorOpInfoToBits(pRCAP->pReplyMinOpInfo,
+                                pRCAP->pReplyMinOpBits);
     }
     else
         pRCAP->pReplyMinOpInfo = NULL;
 
+    RecordSetToBits(pRCAP->pRequestMajorOpSet, pRCAP->requestMajorOpBits);
+    RecordSetToBits(pRCAP->pReplyMajorOpSet, pRCAP->replyMajorOpBits);
+    RecordSetToBits(pRCAP->pDeviceEventSet, pRCAP->deviceEventBits);
+    RecordSetToBits(pRCAP->pDeliveredEventSet, pRCAP->deliveredEventBits);
+    RecordSetToBits(pRCAP->pErrorSet, pRCAP->errorBits);
+
     pRCAP->clientStarted = clientStarted;
     pRCAP->clientDied = clientDied;
 
@@ -1800,6 +1908,7 @@ RecordRegisterClients(RecordContextPtr pContext, ClientPtr client,
 
     pRCAP->pNextRCAP = pContext->pListOfRCAP;
     pContext->pListOfRCAP = pRCAP;
+    recordClientsSerial++;
 
     if (pContext->pRecordingClient)     /* context enabled */
         RecordInstallHooks(pRCAP, 0);
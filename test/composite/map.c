@@ -0,0 +1,127 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Maps an automatically redirected window with a background pixel that
+ * has a child with background None.  Nothing paints the child when it's
+ * mapped, so it must show what was underneath it, the contents of the
+ * redirected window's parent, just like without redirection.  The rest of
+ * the window must show its own background.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <xcb/xcb.h>
+#include <xcb/composite.h>
+
+#define PARENT_BACKGROUND 0x00ff00
+#define BACKGROUND 0x0000ff
+#define SIZE 100
+
+static uint32_t
+get_pixel(xcb_connection_t *c, xcb_drawable_t d, int x, int y)
+{
+    xcb_get_image_reply_t *reply;
+    uint32_t pixel;
+
+    reply = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              d, x, y, 1, 1, ~0),
+                                NULL);
+    assert(reply);
+    assert(xcb_get_image_data_length(reply) == sizeof(uint32_t));
+    pixel = *(uint32_t *) xcb_get_image_data(reply) & 0x00ffffff;
+    free(reply);
+
+    return pixel;
+}
+
+int main(void)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_t *screen;
+    xcb_window_t parent, window, child;
+    uint32_t value;
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect\n");
+        exit(1);
+    }
+
+    ext = xcb_get_extension_data(c, &xcb_composite_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "No Composite extension\n");
+        exit(77);
+    }
+    free(xcb_composite_query_version_reply(c,
+                                           xcb_composite_query_version(c, 0, 4),
+                                           NULL));
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "Needs a depth 24 root window\n");
+        exit(77);
+    }
+
+    parent = xcb_generate_id(c);
+    value = PARENT_BACKGROUND;
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, parent, screen->root,
+                      0, 0, 2 * SIZE, 2 * SIZE, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      XCB_CW_BACK_PIXEL, &value);
+    xcb_map_window(c, parent);
+
+    window = xcb_generate_id(c);
+    value = BACKGROUND;
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, parent,
+                      SIZE / 2, SIZE / 2, SIZE, SIZE, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      XCB_CW_BACK_PIXEL, &value);
+
+    child = xcb_generate_id(c);
+    value = XCB_BACK_PIXMAP_NONE;
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, child, window,
+                      0, 0, SIZE / 2, SIZE / 2, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      XCB_CW_BACK_PIXMAP, &value);
+    xcb_map_window(c, child);
+
+    xcb_composite_redirect_window(c, window, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    xcb_map_window(c, window);
+
+    if (get_pixel(c, child, 1, 1) != PARENT_BACKGROUND) {
+        fprintf(stderr, "Background None child doesn't show the parent\n");
+        exit(1);
+    }
+    assert(get_pixel(c, window, SIZE - 1, SIZE - 1) == BACKGROUND);
+    assert(get_pixel(c, screen->root, SIZE / 2 + 1, SIZE / 2 + 1) ==
+           PARENT_BACKGROUND);
+
+    xcb_disconnect(c);
+    exit(0);
+}
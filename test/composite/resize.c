@@ -0,0 +1,180 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Resizes an automatically redirected window back and forth, checking
+ * after every step that the contents kept by its bit gravity survived and
+ * that newly exposed parts show its background.  A pixmap named for the
+ * window must keep its size when the window is resized afterwards.
+ * Growing a window whose child has background None must not show what
+ * was drawn there before it shrank.
+ *
+ * Usage: composite-resize
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <xcb/composite.h>
+
+#include "xcb-tests.h"
+
+#define BACKGROUND 0x0000ff
+#define FOREGROUND 0xff0000
+#define BASE_SIZE 100
+/* Up to 60 pixels larger and back down, in steps of 3 */
+#define STEPS 40
+
+static void
+get_size(xcb_connection_t *c, xcb_drawable_t d, int *w, int *h)
+{
+    xcb_get_geometry_reply_t *reply;
+
+    reply = xcb_get_geometry_reply(c, xcb_get_geometry(c, d), NULL);
+    assert(reply);
+    *w = reply->width;
+    *h = reply->height;
+    free(reply);
+}
+
+static void
+resize(xcb_connection_t *c, xcb_window_t window, int size)
+{
+    uint32_t values[] = { size, size };
+
+    xcb_configure_window(c, window,
+                         XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+                         values);
+}
+
+/*
+ * A child with background None paints nothing when exposed, so when its
+ * parent grows, the new part must come from a fresh copy of the screen,
+ * not from what the reused pixmap held before
+ */
+static void
+check_child_background_none(xcb_connection_t *c, xcb_screen_t *screen,
+                            xcb_gcontext_t gc)
+{
+    xcb_window_t parent = xcb_generate_id(c), child = xcb_generate_id(c);
+    uint32_t values[] = { BACKGROUND, XCB_GRAVITY_NORTH_WEST };
+    xcb_rectangle_t all = { 0, 0, 2 * BASE_SIZE, 2 * BASE_SIZE };
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, parent, screen->root,
+                      300, 10, BASE_SIZE + 50, BASE_SIZE + 50, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      XCB_CW_BACK_PIXEL | XCB_CW_BIT_GRAVITY, values);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, child, parent,
+                      0, 0, 2 * BASE_SIZE, 2 * BASE_SIZE, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      0, NULL);
+    xcb_composite_redirect_window(c, parent, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    xcb_map_window(c, child);
+    xcb_map_window(c, parent);
+
+    xcb_poly_fill_rectangle(c, child, gc, 1, &all);
+    assert(test_get_pixel(c, parent, BASE_SIZE + 30, BASE_SIZE + 30) ==
+           FOREGROUND);
+
+    /* Small enough steps to keep the same pixmap when shrinking */
+    resize(c, parent, BASE_SIZE + 10);
+    resize(c, parent, BASE_SIZE + 50);
+    if (test_get_pixel(c, parent, BASE_SIZE + 30, BASE_SIZE + 30) ==
+        FOREGROUND) {
+        fprintf(stderr, "Stale contents under a child with background None\n");
+        exit(1);
+    }
+    assert(test_get_pixel(c, parent, 0, 0) == FOREGROUND);
+
+    xcb_destroy_window(c, parent);
+}
+
+int main(void)
+{
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_window_t window;
+    xcb_pixmap_t pixmap;
+    xcb_gcontext_t gc;
+    xcb_rectangle_t rect = { 0, 0, BASE_SIZE / 2, BASE_SIZE / 2 };
+    uint32_t values[2];
+    int size = BASE_SIZE, w, h;
+
+    test_require_extension(c, &xcb_composite_id, "Composite");
+    free(xcb_composite_query_version_reply(c,
+                                           xcb_composite_query_version(c, 0, 4),
+                                           NULL));
+    test_require_depth24(screen);
+
+    window = xcb_generate_id(c);
+    values[0] = BACKGROUND;
+    values[1] = XCB_GRAVITY_NORTH_WEST;
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      10, 10, size, size, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual,
+                      XCB_CW_BACK_PIXEL | XCB_CW_BIT_GRAVITY, values);
+    xcb_composite_redirect_window(c, window, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    xcb_map_window(c, window);
+
+    gc = xcb_generate_id(c);
+    values[0] = FOREGROUND;
+    xcb_create_gc(c, gc, window, XCB_GC_FOREGROUND, values);
+    xcb_poly_fill_rectangle(c, window, gc, 1, &rect);
+
+    assert(test_get_pixel(c, window, 0, 0) == FOREGROUND);
+    assert(test_get_pixel(c, window, size - 1, size - 1) == BACKGROUND);
+
+    for (int i = 0; i < STEPS; i++) {
+        /* Up and down in small steps, like an interactive resize */
+        size = BASE_SIZE + 3 * (i < STEPS / 2 ? i : STEPS - i);
+        resize(c, window, size);
+
+        if (test_get_pixel(c, window, rect.width - 1, rect.height - 1) != FOREGROUND) {
+            fprintf(stderr, "Contents lost resizing to %d\n", size);
+            exit(1);
+        }
+        if (test_get_pixel(c, window, size - 1, size - 1) != BACKGROUND) {
+            fprintf(stderr, "Exposed area not painted resizing to %d\n", size);
+            exit(1);
+        }
+    }
+
+    pixmap = xcb_generate_id(c);
+    xcb_composite_name_window_pixmap(c, window, pixmap);
+    get_size(c, pixmap, &w, &h);
+    assert(w == size && h == size);
+
+    resize(c, window, size + 5);
+    get_size(c, pixmap, &w, &h);
+    assert(w == size && h == size);
+    assert(test_get_pixel(c, pixmap, 0, 0) == FOREGROUND);
+    assert(test_get_pixel(c, window, size + 4, size + 4) == BACKGROUND);
+
+    resize(c, window, size - 5);
+    get_size(c, pixmap, &w, &h);
+    assert(w == size && h == size);
+
+    check_child_background_none(c, screen, gc);
+
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -345,6 +345,126 @@ fixes_pointer_barrier_clamp_test(void)
     assert(cy == barrier.y1);
 }
 
+static void
+fixes_pointer_barrier_index_test(void)
+{
+    const int num_barriers = 1000;
+    const int num_motions = 10000;
+    struct PointerBarrierIndex index = { 0 };
+    struct PointerBarrier *barriers;
+    CARD64 start, elapsed_index, elapsed_linear;
+    int i, j;
+
+    barriers = calloc(num_barriers, sizeof(*barriers));
+    assert(barriers);
+
+    srand(0x1234);
+
+    /* mix of vertical and horizontal barriers spread over a large area */
+    for (i = 0; i < num_barriers; i++) {
+        struct PointerBarrier *b = &barriers[i];
+        int v = rand() % 8192;
+        int lo = rand() % 8000;
+
+        if (i % 2) {
+            b->x1 = b->x2 = v;
+            b->y1 = lo;
+            b->y2 = lo + rand() % 500;
+        }
+        else {
+            b->y1 = b->y2 = v;
+            b->x1 = lo;
+            b->x2 = lo + rand() % 500;
+            if (b->x1 == b->x2)
+                b->x2++;
+        }
+        if (b->y1 == b->y2 && b->x1 == b->x2)
+            b->y2++;
+        b->directions = 0;
+        assert(barrier_index_insert(&index, b));
+    }
+
+    assert(index.num_vertical + index.num_horizontal == num_barriers);
+
+    /* the index must find exactly the barriers a linear scan finds */
+    for (j = 0; j < num_motions; j++) {
+        int x1 = rand() % 8192, y1 = rand() % 8192;
+        int x2 = x1 + rand() % 64 - 32, y2 = y1 + rand() % 64 - 32;
+        int dir = barrier_get_direction(x1, y1, x2, y2);
+        int nlinear = 0, nindex = 0;
+        double distance;
+
+        for (i = 0; i < num_barriers; i++) {
+            if (barrier_is_blocking_direction(&barriers[i], dir) &&
+                barrier_is_blocking(&barriers[i], x1, y1, x2, y2, &distance))
+                nlinear++;
+        }
+
+        if (dir & (BarrierPositiveX | BarrierNegativeX)) {
+            struct PointerBarrier **candidates;
+            int n = barrier_index_lookup(&index, TRUE, x1, x2, &candidates);
+
+            for (i = 0; i < n; i++) {
+                assert(candidates[i]->x1 == candidates[i]->x2);
+                if (barrier_is_blocking_direction(candidates[i], dir) &&
+                    barrier_is_blocking(candidates[i], x1, y1, x2, y2, &distance))
+                    nindex++;
+            }
+        }
+        if (dir & (BarrierPositiveY | BarrierNegativeY)) {
+            struct PointerBarrier **candidates;
+            int n = barrier_index_lookup(&index, FALSE, y1, y2, &candidates);
+
+            for (i = 0; i < n; i++) {
+                assert(candidates[i]->y1 == candidates[i]->y2);
+                if (barrier_is_blocking_direction(candidates[i], dir) &&
+                    barrier_is_blocking(candidates[i], x1, y1, x2, y2, &distance))
+                    nindex++;
+            }
+        }
+
+        assert(nindex == nlinear);
+    }
+
+    /* per-motion cost of candidate lookup vs. testing every barrier */
+    start = GetTimeInMicros();
+    for (j = 0; j < num_motions; j++) {
+        struct PointerBarrier **candidates;
+        int x1 = (j * 37) % 8192, y1 = (j * 53) % 8192;
+
+        barrier_index_lookup(&index, TRUE, x1, x1 + 16, &candidates);
+        barrier_index_lookup(&index, FALSE, y1, y1 + 16, &candidates);
+    }
+    elapsed_index = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (j = 0; j < num_motions; j++) {
+        int x1 = (j * 37) % 8192, y1 = (j * 53) % 8192;
+        double distance;
+
+        for (i = 0; i < num_barriers; i++)
+            barrier_is_blocking(&barriers[i], x1, y1, x1 + 16, y1 + 16,
+                                &distance);
+    }
+    elapsed_linear = GetTimeInMicros() - start;
+
+    dbg("%d barriers: %.3fus/motion indexed, %.3fus/motion linear\n",
+        num_barriers,
+        (double)elapsed_index / num_motions,
+        (double)elapsed_linear / num_motions);
+
+    /* removal keeps the remaining barriers sorted and findable */
+    for (i = 0; i < num_barriers; i += 2)
+        barrier_index_remove(&index, &barriers[i]);
+    assert(index.num_horizontal == 0);
+    assert(index.num_vertical == num_barriers / 2);
+    for (i = 1; i < index.num_vertical; i++)
+        assert(index.vertical[i - 1]->x1 <= index.vertical[i]->x1);
+
+    barrier_index_fini(&index);
+    free(barriers);
+}
+
 const testfunc_t*
 fixes_test(void)
 {
@@ -352,6 +472,7 @@ fixes_test(void)
         fixes_pointer_barriers_test,
         fixes_pointer_barrier_direction_test,
         fixes_pointer_barrier_clamp_test,
+        fixes_pointer_barrier_index_test,
         NULL,
     };
 
@@ -0,0 +1,188 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Checks that font listings answered from the server's listing cache
+ * are the ones the font path would give: a listing asked for again is
+ * the same, a listing with a smaller maximum doesn't cut a later full
+ * one short, a narrower pattern gets its own answer, and setting the
+ * font path drops what was cached for the old one.
+ *
+ * Usage: fonts-list
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include "xcb-tests.h"
+
+#define MAX_NAMES 10000
+#define BUILTINS "built-ins"
+/* libXfont's built-in fonts: fixed and cursor, and their aliases */
+#define BUILTINS_MAX_NAMES 8
+
+static xcb_list_fonts_reply_t *
+list_fonts(xcb_connection_t *c, const char *pattern, int max_names)
+{
+    xcb_list_fonts_reply_t *reply;
+
+    reply = xcb_list_fonts_reply(c, xcb_list_fonts(c, max_names,
+                                                   strlen(pattern), pattern),
+                                 NULL);
+    assert(reply);
+    return reply;
+}
+
+static int
+same_names(xcb_list_fonts_reply_t *a, xcb_list_fonts_reply_t *b)
+{
+    int length = xcb_list_fonts_sizeof(a) - sizeof(*a);
+
+    return a->names_len == b->names_len &&
+        (int) (xcb_list_fonts_sizeof(b) - sizeof(*b)) == length &&
+        !memcmp(a + 1, b + 1, length);
+}
+
+static int
+has_name(xcb_list_fonts_reply_t *list, const xcb_str_t *name)
+{
+    for (xcb_str_iterator_t it = xcb_list_fonts_names_iterator(list);
+         it.rem; xcb_str_next(&it)) {
+        if (xcb_str_name_length(it.data) == xcb_str_name_length(name) &&
+            !strncasecmp(xcb_str_name(it.data), xcb_str_name(name),
+                         xcb_str_name_length(name)))
+            return 1;
+    }
+    return 0;
+}
+
+/* Returns a checksum of all the replies, and the number of fonts */
+static unsigned long
+list_fonts_with_info(xcb_connection_t *c, int max_names, int *count)
+{
+    xcb_list_fonts_with_info_cookie_t cookie;
+    xcb_list_fonts_with_info_reply_t *reply;
+    unsigned long sum = 0;
+
+    cookie = xcb_list_fonts_with_info(c, max_names, 1, "*");
+    *count = 0;
+    while ((reply = xcb_list_fonts_with_info_reply(c, cookie, NULL))) {
+        const unsigned char *bytes = (const unsigned char *) reply;
+        int length = 32 + reply->length * 4;
+
+        if (!reply->name_len) {
+            free(reply);
+            break;
+        }
+
+        /* Skip the header, down to the sequence number */
+        for (int i = 4; i < length; i++)
+            sum = sum * 31 + bytes[i];
+        (*count)++;
+        free(reply);
+    }
+
+    return sum;
+}
+
+int main(void)
+{
+    xcb_connection_t *c = test_connect(NULL);
+    xcb_list_fonts_reply_t *all, *again, *fixed;
+    xcb_get_font_path_reply_t *path;
+    xcb_generic_error_t *error;
+    char builtins_path[1 + sizeof(BUILTINS)];
+    unsigned long sum;
+    int count, count_again;
+
+    all = list_fonts(c, "*", MAX_NAMES);
+    sum = list_fonts_with_info(c, MAX_NAMES, &count);
+    if (!all->names_len || !count) {
+        fprintf(stderr, "No fonts to list\n");
+        exit(77);
+    }
+    assert(count == all->names_len);
+
+    /* Asked again, from the cache */
+    again = list_fonts(c, "*", MAX_NAMES);
+    assert(same_names(all, again));
+    free(again);
+    assert(list_fonts_with_info(c, MAX_NAMES, &count_again) == sum);
+    assert(count_again == count);
+
+    /* A smaller maximum is its own listing */
+    again = list_fonts(c, "*", 1);
+    assert(again->names_len == 1);
+    assert(has_name(all, xcb_list_fonts_names_iterator(again).data));
+    free(again);
+    list_fonts_with_info(c, 1, &count_again);
+    assert(count_again == 1);
+
+    again = list_fonts(c, "*", MAX_NAMES);
+    assert(same_names(all, again));
+    free(again);
+    assert(list_fonts_with_info(c, MAX_NAMES, &count_again) == sum);
+    assert(count_again == count);
+
+    /* So is a narrower pattern */
+    fixed = list_fonts(c, "fixed", MAX_NAMES);
+    assert(fixed->names_len <= all->names_len);
+    for (xcb_str_iterator_t it = xcb_list_fonts_names_iterator(fixed);
+         it.rem; xcb_str_next(&it))
+        assert(has_name(all, it.data));
+    free(fixed);
+
+    /* Setting the font path drops the listings of the old one */
+    path = xcb_get_font_path_reply(c, xcb_get_font_path(c), NULL);
+    assert(path);
+    builtins_path[0] = strlen(BUILTINS);
+    memcpy(builtins_path + 1, BUILTINS, strlen(BUILTINS));
+    error = xcb_request_check(c, xcb_set_font_path_checked(c, 1,
+        (const xcb_str_t *) builtins_path));
+    free(error);
+    if (!error) {
+        xcb_list_fonts_reply_t *builtins;
+
+        builtins = list_fonts(c, "*", MAX_NAMES);
+        assert(builtins->names_len &&
+               builtins->names_len <= BUILTINS_MAX_NAMES);
+        for (xcb_str_iterator_t it = xcb_list_fonts_names_iterator(builtins);
+             it.rem; xcb_str_next(&it))
+            assert(has_name(all, it.data));
+        free(builtins);
+    }
+
+    xcb_set_font_path(c, path->path_len,
+                      xcb_get_font_path_path_iterator(path).data);
+    free(path);
+
+    again = list_fonts(c, "*", MAX_NAMES);
+    assert(same_names(all, again));
+    free(again);
+    assert(list_fonts_with_info(c, MAX_NAMES, &count_again) == sum);
+    assert(count_again == count);
+
+    free(all);
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,176 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Short-lived pixmap churn, the way compositing managers and toolkits
+ * create shadows, masks and offscreen buffers: each iteration creates a
+ * pixmap of one of a few sizes, draws into it, copies it out and frees
+ * it again, so glamor keeps recycling FBOs from its pool.  A recycled
+ * FBO must come back cleared, also when the new pixmap is a little
+ * smaller than the old one, and must never be handed to a pixmap of
+ * another depth.
+ *
+ * With --benchmark, churns that many pixmaps and prints the rate.
+ *
+ * Usage: glamor-churn [--benchmark iterations]
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include "xcb-tests.h"
+
+static const struct {
+    uint16_t width, height;
+} sizes[] = {
+    { 32, 32 }, { 64, 24 }, { 128, 128 }, { 300, 20 }, { 256, 256 },
+};
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* Creates a pixmap and fills it with @color */
+static xcb_pixmap_t
+create_filled(xcb_connection_t *c, xcb_screen_t *screen, xcb_gcontext_t gc,
+              uint16_t w, uint16_t h, uint32_t color)
+{
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_rectangle_t rect = { 0, 0, w, h };
+
+    xcb_create_pixmap(c, 24, pixmap, screen->root, w, h);
+    xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &color);
+    xcb_poly_fill_rectangle(c, pixmap, gc, 1, &rect);
+    return pixmap;
+}
+
+static void
+check_depth(xcb_connection_t *c, xcb_drawable_t d, int depth)
+{
+    xcb_get_geometry_reply_t *reply;
+
+    reply = xcb_get_geometry_reply(c, xcb_get_geometry(c, d), NULL);
+    assert(reply);
+    assert(reply->depth == depth);
+    free(reply);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = test_benchmark_count(argc, argv);
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_pixmap_t target, pixmap;
+    xcb_get_image_reply_t *image;
+    xcb_gcontext_t gc;
+    double start, elapsed;
+
+    test_require_depth24(screen);
+
+    target = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, target, screen->root, 256, 256);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, target, 0, NULL);
+
+    if (iterations) {
+        start = test_now();
+        for (int i = 0; i < iterations; i++) {
+            uint16_t w = sizes[i % ARRAY_SIZE(sizes)].width;
+            uint16_t h = sizes[i % ARRAY_SIZE(sizes)].height;
+
+            pixmap = create_filled(c, screen, gc, w, h, 0x00102030 + i);
+            xcb_copy_area(c, pixmap, target, gc, 0, 0, 0, 0, w, h);
+            xcb_free_pixmap(c, pixmap);
+        }
+        test_sync(c);
+        elapsed = test_now() - start;
+        printf("%d pixmaps in %.3fs: %.0f pixmaps/s\n",
+               iterations, elapsed, elapsed > 0 ? iterations / elapsed : 0);
+        xcb_disconnect(c);
+        exit(0);
+    }
+
+    /* Every size comes back from the pool cleared */
+    for (int i = 0; i < 4 * ARRAY_SIZE(sizes); i++) {
+        uint16_t w = sizes[i % ARRAY_SIZE(sizes)].width;
+        uint16_t h = sizes[i % ARRAY_SIZE(sizes)].height;
+
+        pixmap = create_filled(c, screen, gc, w, h, 0x00102030 + i);
+        assert(test_get_pixel(c, pixmap, w - 1, h - 1) ==
+               0x00102030 + (uint32_t) i);
+        xcb_copy_area(c, pixmap, target, gc, 0, 0, 0, 0, w, h);
+        xcb_free_pixmap(c, pixmap);
+
+        pixmap = xcb_generate_id(c);
+        xcb_create_pixmap(c, 24, pixmap, screen->root, w, h);
+        if (test_get_pixel(c, pixmap, w - 1, h - 1) != 0) {
+            fprintf(stderr, "Recycled %dx%d pixmap not cleared\n", w, h);
+            exit(1);
+        }
+        xcb_free_pixmap(c, pixmap);
+    }
+    assert(test_get_pixel(c, target, 0, 0) ==
+           0x00102030 + 4 * ARRAY_SIZE(sizes) - 1);
+
+    /* Sizes are rounded up in the pool, a smaller pixmap of the same
+     * bucket must still see none of the old contents
+     */
+    pixmap = create_filled(c, screen, gc, 64, 64, 0xffffff);
+    xcb_free_pixmap(c, pixmap);
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, pixmap, screen->root, 50, 40);
+    image = xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                 pixmap, 0, 0, 50, 40, ~0),
+                                NULL);
+    assert(image);
+    assert(xcb_get_image_data_length(image) == 50 * 40 * sizeof(uint32_t));
+    for (int p = 0; p < 50 * 40; p++) {
+        uint32_t pixel;
+
+        memcpy(&pixel, xcb_get_image_data(image) + p * sizeof(pixel),
+               sizeof(pixel));
+        if (pixel & 0x00ffffff) {
+            fprintf(stderr, "Old contents at %d,%d of a smaller pixmap\n",
+                    p % 50, p / 50);
+            exit(1);
+        }
+    }
+    free(image);
+    xcb_free_pixmap(c, pixmap);
+
+    /* Pixmaps of another depth don't get a depth 24 FBO */
+    pixmap = create_filled(c, screen, gc, 128, 128, 0xffffff);
+    xcb_free_pixmap(c, pixmap);
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 8, pixmap, screen->root, 128, 128);
+    check_depth(c, pixmap, 8);
+    image = xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                 pixmap, 127, 127, 1, 1, ~0),
+                                NULL);
+    assert(image);
+    assert(image->depth == 8);
+    assert(xcb_get_image_data(image)[0] == 0);
+    free(image);
+    xcb_free_pixmap(c, pixmap);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,205 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * PutImage and GetImage through a glamor pixmap, on both sides of the
+ * size limits where glamor switches to the streaming upload buffer and to
+ * asynchronous readbacks: images are uploaded in large strips and small
+ * blocks, and read back whole, as an offset rectangle, as a small
+ * rectangle, and by two clients at once.  Every readback is checked.
+ *
+ * With --benchmark, round trips the whole pixmap that many times and
+ * prints the throughput of both directions.
+ *
+ * Usage: glamor-putget [--benchmark iterations]
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include "xcb-tests.h"
+
+#define WIDTH 512
+#define HEIGHT 512
+/* Keep each PutImage below the core request size limit; 128 KiB strips
+ * go through the upload buffer, 8x8 blocks are passed directly.
+ */
+#define STRIP 64
+#define BLOCK 8
+
+static uint32_t bits[WIDTH * HEIGHT];
+
+static void
+put_strips(xcb_connection_t *c, xcb_pixmap_t pixmap, xcb_gcontext_t gc)
+{
+    for (int y = 0; y < HEIGHT; y += STRIP) {
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc,
+                      WIDTH, STRIP, 0, y, 0, 24,
+                      WIDTH * STRIP * sizeof(uint32_t),
+                      (const uint8_t *) (bits + y * WIDTH));
+    }
+}
+
+static void
+put_block(xcb_connection_t *c, xcb_pixmap_t pixmap, xcb_gcontext_t gc,
+          int x, int y)
+{
+    uint32_t block[BLOCK * BLOCK];
+
+    for (int i = 0; i < BLOCK * BLOCK; i++)
+        block[i] = bits[(y + i / BLOCK) * WIDTH + x + i % BLOCK];
+    xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc, BLOCK, BLOCK,
+                  x, y, 0, 24, sizeof(block), (const uint8_t *) block);
+}
+
+static xcb_get_image_cookie_t
+get_image(xcb_connection_t *c, xcb_pixmap_t pixmap,
+          int x, int y, int w, int h)
+{
+    return xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, x, y, w, h, ~0);
+}
+
+static void
+check_image(xcb_connection_t *c, xcb_get_image_cookie_t cookie,
+            int x, int y, int w, int h)
+{
+    xcb_get_image_reply_t *reply = xcb_get_image_reply(c, cookie, NULL);
+    const uint32_t *data;
+
+    assert(reply);
+    assert(reply->depth == 24);
+    assert(xcb_get_image_data_length(reply) == w * h * sizeof(uint32_t));
+
+    data = (const uint32_t *) xcb_get_image_data(reply);
+    for (int p = 0; p < w * h; p++) {
+        uint32_t expected = bits[(y + p / w) * WIDTH + x + p % w];
+
+        if ((data[p] & 0x00ffffff) != expected) {
+            fprintf(stderr, "%dx%d+%d+%d: mismatch at %d,%d: expected 0x%06x, got 0x%08x\n",
+                    w, h, x, y, x + p % w, y + p / w, expected, data[p]);
+            exit(1);
+        }
+    }
+    free(reply);
+}
+
+static void
+fill_bits(int seed)
+{
+    for (int p = 0; p < WIDTH * HEIGHT; p++)
+        bits[p] = (p * 2654435761u + seed * 40503u) & 0x00ffffff;
+}
+
+static void
+benchmark(xcb_connection_t *c, xcb_pixmap_t pixmap, xcb_gcontext_t gc,
+          int iterations)
+{
+    double put_time = 0, get_time = 0, start, mb;
+
+    for (int i = 0; i < iterations; i++) {
+        fill_bits(i);
+
+        start = test_now();
+        put_strips(c, pixmap, gc);
+        test_sync(c);
+        put_time += test_now() - start;
+
+        start = test_now();
+        check_image(c, get_image(c, pixmap, 0, 0, WIDTH, HEIGHT),
+                    0, 0, WIDTH, HEIGHT);
+        get_time += test_now() - start;
+    }
+
+    mb = (double) iterations * WIDTH * HEIGHT * sizeof(uint32_t) / (1024 * 1024);
+    printf("PutImage: %.1f MiB/s\n", put_time > 0 ? mb / put_time : 0);
+    printf("GetImage: %.1f MiB/s\n", get_time > 0 ? mb / get_time : 0);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = test_benchmark_count(argc, argv);
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_connection_t *other;
+    xcb_get_image_cookie_t cookie, other_cookie;
+    xcb_pixmap_t pixmap;
+    xcb_gcontext_t gc;
+
+    test_require_depth24(screen);
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, pixmap, screen->root, WIDTH, HEIGHT);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, pixmap, 0, NULL);
+
+    if (iterations) {
+        benchmark(c, pixmap, gc, iterations);
+        xcb_disconnect(c);
+        exit(0);
+    }
+
+    /* Large uploads, then small ones on top at odd positions */
+    fill_bits(0);
+    put_strips(c, pixmap, gc);
+    fill_bits(1);
+    for (int i = 0; i < 64; i++)
+        put_block(c, pixmap, gc, (i * 37) % (WIDTH - BLOCK),
+                  (i * 91) % (HEIGHT - BLOCK));
+    fill_bits(0);
+    for (int i = 0; i < 64; i++)
+        put_block(c, pixmap, gc, (i * 37) % (WIDTH - BLOCK),
+                  (i * 91) % (HEIGHT - BLOCK));
+
+    /* Read back asynchronously: whole, and offset into the pixmap */
+    check_image(c, get_image(c, pixmap, 0, 0, WIDTH, HEIGHT),
+                0, 0, WIDTH, HEIGHT);
+    check_image(c, get_image(c, pixmap, 13, 7, 300, 200), 13, 7, 300, 200);
+
+    /* Read back synchronously */
+    check_image(c, get_image(c, pixmap, 100, 50, 16, 16), 100, 50, 16, 16);
+
+    /* Two clients waiting for readbacks of the same pixmap at once,
+     * with a request queued behind each
+     */
+    other = test_connect(NULL);
+    cookie = get_image(c, pixmap, 0, 0, WIDTH, HEIGHT);
+    other_cookie = get_image(other, pixmap, 0, HEIGHT / 2, WIDTH, HEIGHT / 2);
+    xcb_flush(c);
+    xcb_flush(other);
+    test_sync(other);
+    check_image(other, other_cookie, 0, HEIGHT / 2, WIDTH, HEIGHT / 2);
+    check_image(c, cookie, 0, 0, WIDTH, HEIGHT);
+
+    /* A client going away with its readback still pending */
+    get_image(other, pixmap, 0, 0, WIDTH, HEIGHT);
+    xcb_disconnect(other);
+
+    /* Uploads after readbacks land where they should */
+    fill_bits(2);
+    put_strips(c, pixmap, gc);
+    check_image(c, get_image(c, pixmap, 0, 0, WIDTH, HEIGHT),
+                0, 0, WIDTH, HEIGHT);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+    exit(0);
+}
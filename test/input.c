@@ -38,6 +38,7 @@
 #include "dix/exevents_priv.h"
 #include "dix/input_priv.h"
 #include "dix/inpututils_priv.h"
+#include "dix/ptrveloc_priv.h"
 #include "mi/mi_priv.h"
 #include "os/fmt.h"
 
@@ -1928,6 +1929,166 @@ dix_enqueue_events(void)
     inputInfo.devices = NULL;
 }
 
+/**
+ * Reference velocity estimate: every tracker accumulates the motion since
+ * its creation, as the tracking code did before trackers stored their
+ * position. Directions are taken from the real trackers.
+ */
+struct ref_tracker {
+    double dx, dy;
+    int time;
+    int dir;
+};
+
+static double
+ref_query_trackers(DeviceVelocityPtr vel, struct ref_tracker *tracker,
+                   int cur, int cur_t)
+{
+    int offset, dir = 0xff;
+    double initial_velocity = 0, result = 0;
+    double velocity_factor = vel->corr_mul * vel->const_acceleration;
+
+    for (offset = 1; offset < vel->num_tracker; offset++) {
+        struct ref_tracker *t =
+            &tracker[(vel->num_tracker + cur - offset) % vel->num_tracker];
+        int age_ms = cur_t - t->time;
+        double tracker_velocity = 0;
+
+        if (age_ms >= vel->reset_time || age_ms < 0)
+            break;
+
+        dir &= t->dir;
+        if (dir == 0)
+            break;
+
+        if (age_ms > 0)
+            tracker_velocity = sqrt(t->dx * t->dx + t->dy * t->dy) / age_ms;
+        tracker_velocity *= velocity_factor;
+
+        if ((initial_velocity == 0 || offset <= vel->initial_range) &&
+            tracker_velocity != 0) {
+            result = initial_velocity = tracker_velocity;
+        }
+        else if (initial_velocity != 0 && tracker_velocity != 0) {
+            double velocity_diff = fabs(initial_velocity - tracker_velocity);
+
+            if (velocity_diff > vel->max_diff &&
+                velocity_diff / (initial_velocity + tracker_velocity) >=
+                vel->max_rel_diff)
+                break;
+            result = tracker_velocity;
+        }
+    }
+
+    return result;
+}
+
+static void
+replay_motion_trace(const double (*trace)[3], int nevents)
+{
+    const int ntracker = 16;
+    DeviceVelocityRec vel = { 0 };
+    struct ref_tracker ref[16] = { 0 };
+    int ref_cur = 0;
+    int i, n;
+
+    vel.corr_mul = 10.0;
+    vel.const_acceleration = 1.0;
+    vel.reset_time = 300;
+    vel.max_rel_diff = 0.2;
+    vel.max_diff = 1.0;
+    vel.initial_range = 2;
+    InitTrackers(&vel, ntracker);
+
+    for (i = 0; i < nevents; i++) {
+        double dx = trace[i][0], dy = trace[i][1];
+        int time = trace[i][2];
+        double expected;
+
+        ProcessVelocityData2D(&vel, dx, dy, time);
+
+        for (n = 0; n < ntracker; n++) {
+            ref[n].dx += dx;
+            ref[n].dy += dy;
+        }
+        ref_cur = (ref_cur + 1) % ntracker;
+        ref[ref_cur].dx = 0;
+        ref[ref_cur].dy = 0;
+        ref[ref_cur].time = time;
+        ref[ref_cur].dir = vel.tracker[vel.cur_tracker].dir;
+
+        assert(vel.cur_tracker == ref_cur);
+
+        expected = ref_query_trackers(&vel, ref, ref_cur, time);
+        assert(fabs(vel.velocity - expected) <= 1e-9 * fmax(1.0, expected));
+    }
+
+    free(vel.tracker);
+}
+
+static void
+dix_ptraccel_replay(void)
+{
+    /* dx, dy, time in ms: a recorded flick to the upper right, a pause,
+     * a slow correction back and a few jittery single-mickey moves */
+    static const double recorded[][3] = {
+        { 1, 0, 1000 }, { 2, -1, 1008 }, { 4, -1, 1016 }, { 7, -3, 1024 },
+        { 11, -4, 1032 }, { 15, -6, 1040 }, { 18, -7, 1048 },
+        { 19, -8, 1056 }, { 17, -7, 1064 }, { 12, -5, 1072 },
+        { 8, -3, 1080 }, { 4, -2, 1088 }, { 2, -1, 1096 }, { 1, 0, 1104 },
+        { -1, 0, 1600 }, { -1, 1, 1608 }, { -2, 1, 1616 }, { -2, 1, 1624 },
+        { -3, 1, 1632 }, { -2, 0, 1640 }, { -1, 0, 1648 }, { 0, 1, 1656 },
+        { 1, 0, 1664 }, { 0, -1, 1672 }, { -1, 0, 1680 }, { 0, 1, 1688 },
+        { 0.5, 0.25, 1696 }, { 0.75, -0.25, 1704 }, { 1.5, 0, 1704 },
+        { 3, 3, 1712 }, { 6, 6, 1720 }, { 12, 12, 1728 }, { 24, 24, 1736 },
+    };
+    double (*synthetic)[3];
+    const int nsynthetic = 50000;
+    int i;
+
+    replay_motion_trace(recorded, ARRAY_SIZE(recorded));
+
+    /* long, fast, fractional motion in one direction to push the
+     * accumulated position well past the rebasing limit */
+    synthetic = calloc(nsynthetic, sizeof(*synthetic));
+    assert(synthetic);
+    for (i = 0; i < nsynthetic; i++) {
+        synthetic[i][0] = 7.3 + (i % 7) * 0.1;
+        synthetic[i][1] = (i % 50 < 25) ? 1.7 : -1.3;
+        synthetic[i][2] = 5000 + i * 4 + (i % 3);
+    }
+    replay_motion_trace((const double (*)[3]) synthetic, nsynthetic);
+    free(synthetic);
+}
+
+static double
+dix_ptraccel_test_profile(DeviceIntPtr dev, DeviceVelocityPtr vel,
+                          double velocity, double threshold, double acc)
+{
+    return 1.0;
+}
+
+static void
+dix_ptraccel_register_profile(void)
+{
+    int numbers[AccelProfileRegisteredMax];
+    int i, number;
+
+    for (i = 0; i < AccelProfileRegisteredMax; i++) {
+        assert(RegisterAccelerationProfile(dix_ptraccel_test_profile,
+                                           &numbers[i]));
+        assert(numbers[i] == AccelProfileRegisteredFirst + i);
+    }
+    assert(!RegisterAccelerationProfile(dix_ptraccel_test_profile, &number));
+
+    UnregisterAccelerationProfile(numbers[3]);
+    assert(RegisterAccelerationProfile(dix_ptraccel_test_profile, &number));
+    assert(number == numbers[3]);
+
+    for (i = 0; i < AccelProfileRegisteredMax; i++)
+        UnregisterAccelerationProfile(numbers[i]);
+}
+
 const testfunc_t*
 input_test(void)
 {
@@ -1951,6 +2112,8 @@ input_test(void)
         dix_get_master,
         input_option_test,
         mieq_test,
+        dix_ptraccel_replay,
+        dix_ptraccel_register_profile,
         NULL,
     };
 
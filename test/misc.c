@@ -29,6 +29,7 @@
 #include <stdint.h>
 
 #include "dix/input_priv.h"
+#include "dix/reqstats_priv.h"
 #include "os/fmt.h"
 
 #include "misc.h"
@@ -225,6 +226,53 @@ bswap_test(void)
     assert(result_64 == expect_64);
 }
 
+static void
+dix_request_stats(void)
+{
+    ClientRec client = { 0 };
+    CARD64 count, usecs, p50, p99;
+    int i;
+
+    client.index = 1;
+    client.majorOp = X_GetGeometry;
+
+    /* 0us, 97 times 3us and twice 1ms */
+    dixRequestStatsAdd(&client, 0);
+    for (i = 0; i < 97; i++)
+        dixRequestStatsAdd(&client, 3);
+    dixRequestStatsAdd(&client, 1000);
+    dixRequestStatsAdd(&client, 1000);
+
+    assert(dixGetRequestStats(X_GetGeometry, 0, &count, &usecs, &p50, &p99));
+    assert(count == 100);
+    assert(usecs == 97 * 3 + 2 * 1000);
+    assert(p50 == 4);
+    assert(p99 == 1024);
+
+    /* Extension requests are counted per minor opcode */
+    client.majorOp = EXTENSION_BASE;
+    client.minorOp = 5;
+    dixRequestStatsAdd(&client, 7);
+    assert(dixGetRequestStats(EXTENSION_BASE, 5, &count, &usecs, &p50, &p99));
+    assert(count == 1 && usecs == 7 && p50 == 8 && p99 == 8);
+    assert(!dixGetRequestStats(EXTENSION_BASE, 4, &count, &usecs, &p50, &p99));
+    assert(!dixGetRequestStats(X_GetGeometry, 1, &count, &usecs, &p50, &p99));
+
+    /* and per client by major opcode */
+    assert(dixGetClientRequestStats(&client, X_GetGeometry, &count, &usecs));
+    assert(count == 100);
+    assert(dixGetClientRequestStats(&client, EXTENSION_BASE, &count, &usecs));
+    assert(count == 1 && usecs == 7);
+    assert(!dixGetClientRequestStats(&client, X_QueryTree, &count, &usecs));
+
+    dixRequestStatsClientGone(&client);
+    assert(!dixGetClientRequestStats(&client, X_GetGeometry, &count, &usecs));
+    assert(dixGetRequestStats(X_GetGeometry, 0, &count, &usecs, &p50, &p99));
+
+    dixResetRequestStats();
+    assert(!dixGetRequestStats(X_GetGeometry, 0, &count, &usecs, &p50, &p99));
+}
+
 const testfunc_t*
 misc_test(void)
 {
@@ -233,6 +281,7 @@ misc_test(void)
         dix_update_desktop_dimensions,
         dix_request_size_checks,
         bswap_test,
+        dix_request_stats,
         NULL,
     };
     return testfuncs;
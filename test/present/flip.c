@@ -0,0 +1,218 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Presents a full-screen window every frame on Xvfb's virtual CRTC, which
+ * should flip rather than copy, and checks that the frames complete on
+ * vblanks in order.  With "--refresh <hz>", the UST of every completion
+ * must also be on the vblank grid of that rate.
+ *
+ * With "redirect", the window is automatically redirected with Composite
+ * first, which must not keep it from flipping either.  With "name", the
+ * window pixmap is also named halfway through, while a frame is flipped.
+ * The following frames must be copied, and the named pixmap must hold
+ * each of them.
+ *
+ * With --benchmark, presents that many frames and prints the time per
+ * frame, for frame pacing.
+ *
+ * Usage: present-flip [--benchmark frames] [--refresh hz] [redirect|name]
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <xcb/composite.h>
+#include <xcb/present.h>
+
+#include "xcb-tests.h"
+
+#define FRAMES 60
+
+static uint8_t present_opcode;
+
+static xcb_present_complete_notify_event_t *
+wait_for_complete(xcb_connection_t *c)
+{
+    for (;;) {
+        xcb_generic_event_t *ev = xcb_wait_for_event(c);
+        xcb_ge_generic_event_t *ge = (xcb_ge_generic_event_t *) ev;
+
+        if (!ev) {
+            fprintf(stderr, "Connection lost waiting for events\n");
+            exit(1);
+        }
+        if (ev->response_type == 0) {
+            fprintf(stderr, "Unexpected error %d\n",
+                    ((xcb_generic_error_t *) ev)->error_code);
+            exit(1);
+        }
+        if ((ev->response_type & 0x7f) == XCB_GE_GENERIC &&
+            ge->extension == present_opcode &&
+            ge->event_type == XCB_PRESENT_EVENT_COMPLETE_NOTIFY)
+            return (xcb_present_complete_notify_event_t *) ev;
+        free(ev);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int benchmark = test_benchmark_count(argc, argv);
+    int frames = benchmark ? benchmark : FRAMES;
+    int name = 0, redirect = 0, refresh = 0;
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_window_t window;
+    xcb_pixmap_t pixmaps[2], named = XCB_NONE;
+    static const uint32_t colors[2] = { 0x204080, 0x806040 };
+    uint32_t values[] = { 1 };
+    xcb_gcontext_t gc;
+    int named_frame = frames / 2;
+    uint64_t first_ust = 0, first_msc = 0, last_msc = 0;
+    int flips = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "name"))
+            name = redirect = 1;
+        else if (!strcmp(argv[i], "redirect"))
+            redirect = 1;
+        else if (!strcmp(argv[i], "--refresh") && i + 1 < argc)
+            refresh = atoi(argv[++i]);
+    }
+
+    present_opcode = test_require_extension(c, &xcb_present_id,
+                                            "Present")->major_opcode;
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, screen->width_in_pixels, screen->height_in_pixels,
+                      0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_present_select_input(c, xcb_generate_id(c), window,
+                             XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+
+    if (redirect) {
+        test_require_extension(c, &xcb_composite_id, "Composite");
+        free(xcb_composite_query_version_reply(c,
+                                               xcb_composite_query_version(c, 0, 4),
+                                               NULL));
+        xcb_composite_redirect_window(c, window,
+                                      XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    }
+
+    xcb_map_window(c, window);
+
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, window, 0, NULL);
+    for (int i = 0; i < 2; i++) {
+        xcb_rectangle_t rect = { 0, 0, screen->width_in_pixels,
+                                 screen->height_in_pixels };
+
+        pixmaps[i] = xcb_generate_id(c);
+        xcb_create_pixmap(c, screen->root_depth, pixmaps[i], window,
+                          screen->width_in_pixels, screen->height_in_pixels);
+        xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &colors[i]);
+        xcb_poly_fill_rectangle(c, pixmaps[i], gc, 1, &rect);
+    }
+
+    for (int frame = 0; frame < frames; frame++) {
+        xcb_present_complete_notify_event_t *complete;
+
+        xcb_present_pixmap(c, window, pixmaps[frame & 1], frame, 0, 0, 0, 0,
+                           0, 0, 0, XCB_PRESENT_OPTION_NONE, 0, 1, 0, 0, NULL);
+        xcb_flush(c);
+
+        complete = wait_for_complete(c);
+        assert(complete->kind == XCB_PRESENT_COMPLETE_KIND_PIXMAP);
+        assert(complete->serial == frame);
+
+        if (complete->mode == XCB_PRESENT_COMPLETE_MODE_FLIP)
+            flips++;
+
+        if (named) {
+            /* The named pixmap keeps receiving the window contents */
+            uint32_t pixel = test_get_pixel(c, named, 0, 0);
+
+            if (pixel != colors[frame & 1]) {
+                fprintf(stderr, "Named pixmap holds %06x after frame %d, "
+                        "not %06x\n", pixel, frame, colors[frame & 1]);
+                exit(1);
+            }
+
+            if (complete->mode == XCB_PRESENT_COMPLETE_MODE_FLIP) {
+                fprintf(stderr, "Frame %d flipped over a named pixmap\n", frame);
+                exit(1);
+            }
+        } else if (name && frame == named_frame) {
+            if (complete->mode != XCB_PRESENT_COMPLETE_MODE_FLIP) {
+                fprintf(stderr, "Frame %d wasn't flipped\n", frame);
+                exit(1);
+            }
+            named = xcb_generate_id(c);
+            xcb_composite_name_window_pixmap(c, window, named);
+        }
+
+        if (frame == 0) {
+            first_ust = complete->ust;
+            first_msc = complete->msc;
+        } else if (complete->msc <= last_msc) {
+            fprintf(stderr, "Frame %d completed at MSC %llu, after %llu\n",
+                    frame, (unsigned long long) complete->msc,
+                    (unsigned long long) last_msc);
+            exit(1);
+        }
+        last_msc = complete->msc;
+
+        /* Xvfb's vblanks are exact multiples of the frame time */
+        if (refresh && frame > 0) {
+            double interval = (double) (complete->ust - first_ust) /
+                (complete->msc - first_msc);
+
+            if (interval < 1e6 / refresh - 2 || interval > 1e6 / refresh + 2) {
+                fprintf(stderr, "Frame %d: %.1f us per vblank, expected %.1f\n",
+                        frame, interval, 1e6 / refresh);
+                exit(1);
+            }
+        }
+
+        if (benchmark && frame == frames - 1 && frames > 1) {
+            printf("%d frames, %d flips, %.3f ms and %.2f vblanks per frame\n",
+                   frames, flips,
+                   (complete->ust - first_ust) / 1000.0 / (frames - 1),
+                   (double) (last_msc - first_msc) / (frames - 1));
+        }
+        free(complete);
+    }
+
+    if (flips == 0) {
+        fprintf(stderr, "No frame was flipped\n");
+        exit(1);
+    }
+
+    /* Unflips back to the screen pixmap */
+    xcb_destroy_window(c, window);
+    test_sync(c);
+    assert(!xcb_connection_has_error(c));
+
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,203 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Presents a full-screen window every frame and switches the mode of its
+ * CRTC back and forth through RandR while a presentation is still pending.
+ * Every modeset must succeed, and every frame must still complete, once
+ * and in order.
+ *
+ * Usage: present-modeset
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <xcb/present.h>
+#include <xcb/randr.h>
+
+#include "xcb-tests.h"
+
+#define FRAMES 60
+
+static uint8_t present_opcode;
+
+static xcb_present_complete_notify_event_t *
+wait_for_complete(xcb_connection_t *c)
+{
+    for (;;) {
+        xcb_generic_event_t *ev = xcb_wait_for_event(c);
+        xcb_ge_generic_event_t *ge = (xcb_ge_generic_event_t *) ev;
+
+        if (!ev) {
+            fprintf(stderr, "Connection lost waiting for events\n");
+            exit(1);
+        }
+        if (ev->response_type == 0) {
+            fprintf(stderr, "Unexpected error %d\n",
+                    ((xcb_generic_error_t *) ev)->error_code);
+            exit(1);
+        }
+        if ((ev->response_type & 0x7f) == XCB_GE_GENERIC &&
+            ge->extension == present_opcode &&
+            ge->event_type == XCB_PRESENT_EVENT_COMPLETE_NOTIFY)
+            return (xcb_present_complete_notify_event_t *) ev;
+        free(ev);
+    }
+}
+
+int main(void)
+{
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_randr_get_screen_resources_current_reply_t *res;
+    xcb_randr_get_crtc_info_reply_t *crtc_info = NULL;
+    xcb_randr_get_output_info_reply_t *output_info;
+    xcb_randr_mode_info_t *modes;
+    xcb_randr_crtc_t crtc = 0;
+    xcb_randr_mode_t mode[2];
+    xcb_randr_output_t *outputs;
+    xcb_timestamp_t timestamp;
+    xcb_window_t window;
+    xcb_pixmap_t pixmaps[2];
+    uint32_t values[] = { 1 };
+    int num_modes, modesets = 0;
+
+    present_opcode = test_require_extension(c, &xcb_present_id,
+                                            "Present")->major_opcode;
+    test_require_extension(c, &xcb_randr_id, "RandR");
+    free(xcb_randr_query_version_reply(c, xcb_randr_query_version(c, 1, 2),
+                                       NULL));
+
+    /* The first active CRTC, and another mode of its first output that
+     * fits the screen
+     */
+    res = xcb_randr_get_screen_resources_current_reply(c,
+              xcb_randr_get_screen_resources_current(c, screen->root), NULL);
+    assert(res);
+    modes = xcb_randr_get_screen_resources_current_modes(res);
+    num_modes = xcb_randr_get_screen_resources_current_modes_length(res);
+
+    for (int i = 0; i < res->num_crtcs; i++) {
+        crtc = xcb_randr_get_screen_resources_current_crtcs(res)[i];
+        crtc_info = xcb_randr_get_crtc_info_reply(c,
+                        xcb_randr_get_crtc_info(c, crtc,
+                                                res->config_timestamp), NULL);
+        assert(crtc_info);
+        if (crtc_info->mode && crtc_info->num_outputs)
+            break;
+        free(crtc_info);
+        crtc_info = NULL;
+    }
+    if (!crtc_info) {
+        fprintf(stderr, "No active CRTC\n");
+        exit(77);
+    }
+    outputs = xcb_randr_get_crtc_info_outputs(crtc_info);
+
+    output_info = xcb_randr_get_output_info_reply(c,
+                      xcb_randr_get_output_info(c, outputs[0],
+                                                res->config_timestamp), NULL);
+    assert(output_info);
+
+    mode[0] = crtc_info->mode;
+    mode[1] = 0;
+    for (int i = 0; i < output_info->num_modes && !mode[1]; i++) {
+        xcb_randr_mode_t id = xcb_randr_get_output_info_modes(output_info)[i];
+
+        if (id == mode[0])
+            continue;
+        for (int j = 0; j < num_modes; j++) {
+            if (modes[j].id == id &&
+                modes[j].width <= screen->width_in_pixels &&
+                modes[j].height <= screen->height_in_pixels)
+                mode[1] = id;
+        }
+    }
+    free(output_info);
+    if (!mode[1]) {
+        fprintf(stderr, "No second mode to switch to\n");
+        exit(77);
+    }
+    timestamp = crtc_info->timestamp;
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, screen->width_in_pixels, screen->height_in_pixels,
+                      0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_present_select_input(c, xcb_generate_id(c), window,
+                             XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+    xcb_map_window(c, window);
+
+    for (int i = 0; i < 2; i++) {
+        pixmaps[i] = xcb_generate_id(c);
+        xcb_create_pixmap(c, screen->root_depth, pixmaps[i], window,
+                          screen->width_in_pixels, screen->height_in_pixels);
+    }
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        xcb_present_complete_notify_event_t *complete;
+
+        xcb_present_pixmap(c, window, pixmaps[frame & 1], frame, 0, 0, 0, 0,
+                           0, 0, 0, XCB_PRESENT_OPTION_NONE, 0, 1, 0, 0, NULL);
+
+        /* Switch modes while this frame is still pending */
+        if (frame % 10 == 5) {
+            xcb_randr_set_crtc_config_reply_t *set;
+
+            set = xcb_randr_set_crtc_config_reply(c,
+                      xcb_randr_set_crtc_config(c, crtc, timestamp,
+                                                res->config_timestamp,
+                                                crtc_info->x, crtc_info->y,
+                                                mode[++modesets & 1],
+                                                crtc_info->rotation,
+                                                crtc_info->num_outputs,
+                                                outputs), NULL);
+            assert(set);
+            if (set->status != XCB_RANDR_SET_CONFIG_SUCCESS) {
+                fprintf(stderr, "Modeset %d failed with status %d\n",
+                        modesets, set->status);
+                exit(1);
+            }
+            timestamp = set->timestamp;
+            free(set);
+        }
+        xcb_flush(c);
+
+        complete = wait_for_complete(c);
+        assert(complete->kind == XCB_PRESENT_COMPLETE_KIND_PIXMAP);
+        if (complete->serial != frame) {
+            fprintf(stderr, "Frame %d completed as %u\n", frame,
+                    complete->serial);
+            exit(1);
+        }
+        free(complete);
+    }
+
+    assert(modesets == FRAMES / 10);
+
+    free(crtc_info);
+    free(res);
+    xcb_disconnect(c);
+    exit(0);
+}
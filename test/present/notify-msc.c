@@ -0,0 +1,173 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Queues PresentNotifyMSC requests from many windows at different rates,
+ * which Xvfb completes from its virtual vblanks (or from the fake vblank
+ * timer with -fakescreenfps), and checks that every one of them completes
+ * once, in order and not before its target MSC.
+ * Another window with requests far in the future is destroyed in the
+ * middle, which must abort those without disturbing the others.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <xcb/xcb.h>
+#include <xcb/present.h>
+
+#define NUM_WINDOWS 16
+#define NUM_NOTIFIES 10
+
+static uint8_t present_opcode;
+
+static xcb_window_t
+create_window(xcb_connection_t *c, xcb_screen_t *screen)
+{
+    xcb_window_t window = xcb_generate_id(c);
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, 16, 16, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual, 0, NULL);
+    xcb_present_select_input(c, xcb_generate_id(c), window,
+                             XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+    return window;
+}
+
+static xcb_present_complete_notify_event_t *
+wait_for_complete(xcb_connection_t *c)
+{
+    for (;;) {
+        xcb_generic_event_t *ev = xcb_wait_for_event(c);
+        xcb_ge_generic_event_t *ge = (xcb_ge_generic_event_t *) ev;
+
+        if (!ev) {
+            fprintf(stderr, "Connection lost waiting for events\n");
+            exit(1);
+        }
+        if (ev->response_type == 0) {
+            fprintf(stderr, "Unexpected error %d\n",
+                    ((xcb_generic_error_t *) ev)->error_code);
+            exit(1);
+        }
+        if ((ev->response_type & 0x7f) == XCB_GE_GENERIC &&
+            ge->extension == present_opcode &&
+            ge->event_type == XCB_PRESENT_EVENT_COMPLETE_NOTIFY)
+            return (xcb_present_complete_notify_event_t *) ev;
+        free(ev);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    const xcb_query_extension_reply_t *ext;
+    xcb_present_query_version_reply_t *version;
+    xcb_present_complete_notify_event_t *complete;
+    xcb_window_t windows[NUM_WINDOWS], victim;
+    uint64_t target[NUM_WINDOWS][NUM_NOTIFIES];
+    int next[NUM_WINDOWS] = { 0 };
+    uint64_t base;
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect\n");
+        exit(1);
+    }
+
+    ext = xcb_get_extension_data(c, &xcb_present_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "No Present extension\n");
+        exit(77);
+    }
+    present_opcode = ext->major_opcode;
+
+    version = xcb_present_query_version_reply(c,
+                                              xcb_present_query_version(c, 1, 0),
+                                              NULL);
+    assert(version);
+    free(version);
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    victim = create_window(c, screen);
+    for (int i = 0; i < NUM_WINDOWS; i++)
+        windows[i] = create_window(c, screen);
+
+    /* Find out where the MSC is now */
+    xcb_present_notify_msc(c, victim, 0, 0, 0, 0);
+    xcb_flush(c);
+    complete = wait_for_complete(c);
+    base = complete->msc;
+    free(complete);
+
+    /* Interleave the requests from all windows, with each window asking
+     * for a different interval
+     */
+    for (int j = 0; j < NUM_NOTIFIES; j++) {
+        for (int i = 0; i < NUM_WINDOWS; i++) {
+            target[i][j] = base + 2 + (uint64_t) (j + 1) * (i % 5 + 1);
+            xcb_present_notify_msc(c, windows[i], (i << 8) | j,
+                                   target[i][j], 0, 0);
+        }
+        xcb_present_notify_msc(c, victim, 0xffff, base + 100000 + j, 0, 0);
+    }
+
+    xcb_destroy_window(c, victim);
+    xcb_flush(c);
+
+    for (int n = 0; n < NUM_WINDOWS * NUM_NOTIFIES; n++) {
+        int i, j;
+
+        complete = wait_for_complete(c);
+        i = complete->serial >> 8;
+        j = complete->serial & 0xff;
+
+        if (complete->serial == 0xffff) {
+            fprintf(stderr, "Aborted notify completed\n");
+            exit(1);
+        }
+        assert(complete->kind == XCB_PRESENT_COMPLETE_KIND_NOTIFY_MSC);
+        assert(i < NUM_WINDOWS && complete->window == windows[i]);
+
+        if (j != next[i]) {
+            fprintf(stderr, "Window %d: got notify %d, expected %d\n",
+                    i, j, next[i]);
+            exit(1);
+        }
+        if (complete->msc < target[i][j]) {
+            fprintf(stderr, "Window %d: notify %d completed at %llu, before %llu\n",
+                    i, j, (unsigned long long) complete->msc,
+                    (unsigned long long) target[i][j]);
+            exit(1);
+        }
+        next[i]++;
+        free(complete);
+    }
+
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    assert(!xcb_connection_has_error(c));
+
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,203 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Records the requests and replies of one client, selecting a single core
+ * request and reply and a single minor opcode of an extension, while that
+ * client also sends requests that aren't selected.  Only the selected
+ * protocol must come out of the recording, in order.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/xc_misc.h>
+#include <xcb/record.h>
+
+/* Categories of recorded protocol, from the RECORD spec */
+#define CATEGORY_FROM_SERVER    0
+#define CATEGORY_FROM_CLIENT    1
+#define CATEGORY_START_OF_DATA  4
+#define CATEGORY_END_OF_DATA    5
+
+#define GET_INPUT_FOCUS         43
+#define XC_MISC_GET_VERSION     0
+
+static xcb_connection_t *
+connect_or_die(void)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect\n");
+        exit(1);
+    }
+    return c;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *ctrl = connect_or_die();
+    xcb_connection_t *data = connect_or_die();
+    xcb_connection_t *recorded = connect_or_die();
+    const xcb_query_extension_reply_t *ext;
+    xcb_record_client_spec_t spec;
+    xcb_record_range_t range;
+    xcb_record_context_t context;
+    xcb_record_enable_context_cookie_t cookie;
+    xcb_record_enable_context_reply_t *reply;
+    xcb_generic_error_t *error;
+    xcb_window_t root;
+    uint8_t expected_requests[][2] = {
+        { GET_INPUT_FOCUS, 0 },
+        { 0, XC_MISC_GET_VERSION },
+        { GET_INPUT_FOCUS, 0 },
+    };
+    int num_requests = 0, num_replies = 0;
+    uint8_t xc_misc_opcode;
+
+    ext = xcb_get_extension_data(ctrl, &xcb_record_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "No RECORD extension\n");
+        exit(77);
+    }
+    free(xcb_record_query_version_reply(ctrl,
+                                        xcb_record_query_version(ctrl, 1, 13),
+                                        NULL));
+
+    ext = xcb_get_extension_data(recorded, &xcb_xc_misc_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "No XC-MISC extension\n");
+        exit(77);
+    }
+    xc_misc_opcode = ext->major_opcode;
+    expected_requests[1][0] = xc_misc_opcode;
+
+    memset(&range, 0, sizeof(range));
+    range.core_requests.first = range.core_requests.last = GET_INPUT_FOCUS;
+    range.core_replies.first = range.core_replies.last = GET_INPUT_FOCUS;
+    range.ext_requests.major.first = xc_misc_opcode;
+    range.ext_requests.major.last = xc_misc_opcode;
+    range.ext_requests.minor.first = XC_MISC_GET_VERSION;
+    range.ext_requests.minor.last = XC_MISC_GET_VERSION;
+    spec = xcb_get_setup(recorded)->resource_id_base;
+    root = xcb_setup_roots_iterator(xcb_get_setup(recorded)).data->root;
+
+    context = xcb_generate_id(ctrl);
+    error = xcb_request_check(ctrl,
+                              xcb_record_create_context_checked(ctrl, context,
+                                                                0, 1, 1,
+                                                                &spec, &range));
+    assert(!error);
+
+    /* Wait until recording has started */
+    cookie = xcb_record_enable_context(data, context);
+    reply = xcb_record_enable_context_reply(data, cookie, NULL);
+    assert(reply && reply->category == CATEGORY_START_OF_DATA);
+    free(reply);
+
+    /* Requests that aren't selected are interleaved with those that are */
+    xcb_no_operation(recorded);
+    free(xcb_get_input_focus_reply(recorded, xcb_get_input_focus(recorded),
+                                   NULL));
+    free(xcb_xc_misc_get_xid_range_reply(recorded,
+                                         xcb_xc_misc_get_xid_range(recorded),
+                                         NULL));
+    free(xcb_xc_misc_get_version_reply(recorded,
+                                       xcb_xc_misc_get_version(recorded, 1, 1),
+                                       NULL));
+    free(xcb_get_geometry_reply(recorded, xcb_get_geometry(recorded, root),
+                                NULL));
+    free(xcb_get_input_focus_reply(recorded, xcb_get_input_focus(recorded),
+                                   NULL));
+
+    xcb_record_disable_context(ctrl, context);
+    xcb_flush(ctrl);
+
+    for (;;) {
+        const uint8_t *p, *end;
+
+        reply = xcb_record_enable_context_reply(data, cookie, NULL);
+        assert(reply);
+        if (reply->category == CATEGORY_END_OF_DATA) {
+            free(reply);
+            break;
+        }
+
+        assert(reply->xid_base == spec);
+        assert(!reply->client_swapped);
+        p = xcb_record_enable_context_data(reply);
+        end = p + xcb_record_enable_context_data_length(reply);
+
+        while (p < end) {
+            if (reply->category == CATEGORY_FROM_CLIENT) {
+                uint16_t length;
+
+                /* Not swapped, so in our byte order */
+                memcpy(&length, p + 2, sizeof(length));
+
+                if (num_requests == 3 ||
+                    p[0] != expected_requests[num_requests][0] ||
+                    (p[0] == xc_misc_opcode &&
+                     p[1] != expected_requests[num_requests][1])) {
+                    fprintf(stderr, "Unexpected request %d.%d recorded\n",
+                            p[0], p[1]);
+                    exit(1);
+                }
+                num_requests++;
+                assert(length > 0);
+                p += length * 4;
+            } else {
+                const xcb_get_input_focus_reply_t *focus = (const void *) p;
+
+                assert(reply->category == CATEGORY_FROM_SERVER);
+                assert(focus->response_type == XCB_REPLY);
+                assert(focus->length == 0);
+                num_replies++;
+                p += sizeof(*focus);
+            }
+        }
+        assert(p == end);
+        free(reply);
+    }
+
+    if (num_requests != 3 || num_replies != 2) {
+        fprintf(stderr, "Recorded %d requests and %d replies, expected 3 and 2\n",
+                num_requests, num_replies);
+        exit(1);
+    }
+
+    xcb_record_free_context(ctrl, context);
+    free(xcb_get_input_focus_reply(ctrl, xcb_get_input_focus(ctrl), NULL));
+    assert(!xcb_connection_has_error(ctrl));
+
+    xcb_disconnect(recorded);
+    xcb_disconnect(data);
+    xcb_disconnect(ctrl);
+    exit(0);
+}
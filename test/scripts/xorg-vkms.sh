@@ -0,0 +1,54 @@
+#!/bin/sh
+
+# Runs a test client against Xorg with the modesetting driver on a vkms
+# (virtual KMS) device, so that modesetting's page flip and vblank paths
+# run without real hardware.  Skips unless a vkms device can be opened,
+# e.g. after "modprobe vkms".  Xorg only takes -config and -modulepath
+# paths like these when run as root.
+#
+# Usage: xorg-vkms.sh simple-xinit Xorg modulepath client [args...]
+
+simple_xinit=$1
+xorg=$2
+modulepath=$3
+shift 3
+
+card=
+for dev in /sys/class/drm/card[0-9]*; do
+    driver=$(readlink "$dev/device/driver" 2>/dev/null)
+    if test "${driver##*/}" = vkms; then
+        card=/dev/dri/${dev##*/}
+        break
+    fi
+done
+
+if test -z "$card" || ! test -r "$card" -a -w "$card"; then
+    echo "No vkms device available" >&2
+    exit 77
+fi
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/xorg.conf" <<EOF
+Section "ServerFlags"
+    Option "AutoAddDevices" "false"
+    Option "AutoAddGPU" "false"
+EndSection
+
+Section "Device"
+    Identifier "vkms"
+    Driver "modesetting"
+    Option "kmsdev" "$card"
+EndSection
+EOF
+
+"$simple_xinit" "$@" -- "$xorg" -config "$dir/xorg.conf" \
+    -modulepath "$modulepath" -logfile "$dir/Xorg.log" \
+    -noreset -novtswitch -sharevts
+status=$?
+
+if test $status -ne 0 -a $status -ne 77; then
+    cat "$dir/Xorg.log" >&2
+fi
+exit $status
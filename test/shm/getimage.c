@@ -0,0 +1,192 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Captures a pixmap through MIT-SHM like a screen recorder would, while
+ * the server may fetch the image asynchronously (glamor does): every
+ * frame is fetched with ShmGetImage into a shared segment and checked,
+ * with a request queued behind each capture that must be answered after
+ * it.  Parts of the pixmap are captured to an offset in the segment.  A
+ * capture must also survive its client going away and its pixmap being
+ * freed by another client before the image is ready.
+ *
+ * Usage: shm-getimage
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <xcb/shm.h>
+
+#include "xcb-tests.h"
+
+#define WIDTH 512
+#define HEIGHT 256
+#define FRAMES 10
+/* Keep each PutImage below the core request size limit */
+#define STRIP 32
+
+static uint32_t
+pixel(int frame, int x, int y)
+{
+    return ((x * 2654435761u) ^ (y + frame) * 40503u) & 0x00ffffff;
+}
+
+static void
+draw_frame(xcb_connection_t *c, xcb_pixmap_t pixmap, xcb_gcontext_t gc,
+           int frame)
+{
+    static uint32_t strip[WIDTH * STRIP];
+
+    for (int y = 0; y < HEIGHT; y += STRIP) {
+        for (int i = 0; i < WIDTH * STRIP; i++)
+            strip[i] = pixel(frame, i % WIDTH, y + i / WIDTH);
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc,
+                      WIDTH, STRIP, 0, y, 0, 24,
+                      WIDTH * STRIP * sizeof(uint32_t),
+                      (const uint8_t *) strip);
+    }
+}
+
+/* Captures w x h at x,y of the pixmap to @offset in the segment */
+static void
+capture(xcb_connection_t *c, xcb_pixmap_t pixmap, xcb_shm_seg_t seg,
+        const uint32_t *bits, int frame, int x, int y, int w, int h,
+        uint32_t offset)
+{
+    xcb_shm_get_image_cookie_t cookie;
+    xcb_shm_get_image_reply_t *reply;
+    xcb_get_input_focus_cookie_t focus;
+    xcb_get_input_focus_reply_t *focus_reply;
+
+    cookie = xcb_shm_get_image(c, pixmap, x, y, w, h, ~0,
+                               XCB_IMAGE_FORMAT_Z_PIXMAP, seg, offset);
+    focus = xcb_get_input_focus(c);
+
+    /* Replies come in request order, so the one queued behind the
+     * capture can only arrive once the image is in the segment
+     */
+    focus_reply = xcb_get_input_focus_reply(c, focus, NULL);
+    assert(focus_reply);
+    free(focus_reply);
+    reply = xcb_shm_get_image_reply(c, cookie, NULL);
+    assert(reply);
+    assert(reply->depth == 24);
+    assert(reply->size == w * h * sizeof(uint32_t));
+    free(reply);
+
+    bits += offset / sizeof(uint32_t);
+    for (int j = 0; j < h; j++) {
+        for (int i = 0; i < w; i++) {
+            uint32_t got = bits[j * w + i] & 0x00ffffff;
+
+            if (got != pixel(frame, x + i, y + j)) {
+                fprintf(stderr, "Frame %d, %dx%d+%d+%d: mismatch at %d,%d: expected 0x%06x, got 0x%06x\n",
+                        frame, w, h, x, y, x + i, y + j,
+                        pixel(frame, x + i, y + j), got);
+                exit(1);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_connection_t *other;
+    xcb_generic_error_t *error;
+    xcb_shm_get_image_reply_t *reply;
+    xcb_shm_get_image_cookie_t cookie;
+    xcb_pixmap_t pixmap;
+    xcb_gcontext_t gc;
+    xcb_shm_seg_t seg, other_seg;
+    uint32_t *bits;
+    int shmid;
+
+    test_require_extension(c, &xcb_shm_id, "MIT-SHM");
+    test_require_depth24(screen);
+
+    shmid = shmget(IPC_PRIVATE, 2 * WIDTH * HEIGHT * sizeof(uint32_t),
+                   IPC_CREAT | 0600);
+    if (shmid < 0) {
+        fprintf(stderr, "No shared memory\n");
+        exit(77);
+    }
+    bits = shmat(shmid, NULL, 0);
+    assert(bits != (void *) -1);
+
+    seg = xcb_generate_id(c);
+    error = xcb_request_check(c, xcb_shm_attach_checked(c, seg, shmid, 0));
+    shmctl(shmid, IPC_RMID, NULL);
+    if (error) {
+        fprintf(stderr, "Server can't attach the segment\n");
+        exit(77);
+    }
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, pixmap, screen->root, WIDTH, HEIGHT);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, pixmap, 0, NULL);
+
+    for (int f = 0; f < FRAMES; f++) {
+        draw_frame(c, pixmap, gc, f);
+        capture(c, pixmap, seg, bits, f, 0, 0, WIDTH, HEIGHT,
+                (f & 1) * WIDTH * HEIGHT * sizeof(uint32_t));
+        capture(c, pixmap, seg, bits, f, 37, 11, 400, 200,
+                WIDTH * HEIGHT * sizeof(uint32_t));
+    }
+
+    /* A client going away while its capture is pending.  Linux lets the
+     * server attach the segment again after it has been removed.
+     */
+    other = test_connect(NULL);
+    other_seg = xcb_generate_id(other);
+    xcb_shm_attach(other, other_seg, shmid, 0);
+    xcb_shm_get_image(other, pixmap, 0, 0, WIDTH, HEIGHT, ~0,
+                      XCB_IMAGE_FORMAT_Z_PIXMAP, other_seg, 0);
+    xcb_flush(other);
+    xcb_disconnect(other);
+
+    /* The pixmap going away while a capture is pending: either the
+     * capture finishes first, or it fails with BadDrawable
+     */
+    other = test_connect(NULL);
+    cookie = xcb_shm_get_image(c, pixmap, 0, 0, WIDTH, HEIGHT, ~0,
+                               XCB_IMAGE_FORMAT_Z_PIXMAP, seg, 0);
+    xcb_flush(c);
+    xcb_free_pixmap(other, pixmap);
+    test_sync(other);
+    xcb_disconnect(other);
+    reply = xcb_shm_get_image_reply(c, cookie, &error);
+    assert(reply || (error && error->error_code == XCB_DRAWABLE));
+    free(reply);
+    free(error);
+
+    test_sync(c);
+    assert(!xcb_connection_has_error(c));
+    shmdt(bits);
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,192 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Plays a "video" through MIT-SHM: frames are written into a shared
+ * segment holding two of them and the middle of each is put into a
+ * window, like a player cropping its frames.  The server keeps a pixmap
+ * header over the segment between puts, so every frame is read back and
+ * checked: frames rewritten in place, frames alternating between two
+ * offsets, and frames of another size in the same segment must all show
+ * up as they are in the segment at the time of the put.
+ *
+ * With --benchmark, plays that many frames and prints the frame rate.
+ *
+ * Usage: shm-putimage [--benchmark frames]
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <xcb/shm.h>
+
+#include "xcb-tests.h"
+
+#define WIDTH 640
+#define HEIGHT 360
+#define BORDER 8
+#define FRAME_SIZE (WIDTH * HEIGHT * sizeof(uint32_t))
+
+static uint32_t
+pixel(int frame, int x, int y)
+{
+    return ((x + frame) * 2654435761u ^ (y * 40503u)) & 0x00ffffff;
+}
+
+/* Writes a frame of w x h into the segment at @offset, puts its middle
+ * into the window
+ */
+static void
+put_frame(xcb_connection_t *c, xcb_window_t window, xcb_gcontext_t gc,
+          xcb_shm_seg_t seg, uint32_t *bits, int frame,
+          int w, int h, uint32_t offset)
+{
+    uint32_t *dst = bits + offset / sizeof(uint32_t);
+
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            dst[y * w + x] = pixel(frame, x, y);
+
+    xcb_shm_put_image(c, window, gc, w, h, BORDER, BORDER,
+                      w - 2 * BORDER, h - 2 * BORDER, 0, 0,
+                      24, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, seg, offset);
+
+    /* Wait for the server to be done with the segment */
+    test_sync(c);
+}
+
+static void
+check_frame(xcb_connection_t *c, xcb_window_t window, int frame, int w, int h)
+{
+    xcb_get_image_reply_t *image;
+    const uint32_t *data;
+
+    image = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              window, 0, 0,
+                                              w - 2 * BORDER, h - 2 * BORDER,
+                                              ~0),
+                                NULL);
+    assert(image);
+    data = (const uint32_t *) xcb_get_image_data(image);
+    for (int y = 0; y < h - 2 * BORDER; y++) {
+        for (int x = 0; x < w - 2 * BORDER; x++) {
+            uint32_t expected = pixel(frame, x + BORDER, y + BORDER);
+            uint32_t got = data[y * (w - 2 * BORDER) + x] & 0x00ffffff;
+
+            if (got != expected) {
+                fprintf(stderr, "Frame %d (%dx%d): mismatch at %d,%d: expected 0x%06x, got 0x%06x\n",
+                        frame, w, h, x, y, expected, got);
+                exit(1);
+            }
+        }
+    }
+    free(image);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = test_benchmark_count(argc, argv);
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_generic_error_t *error;
+    xcb_window_t window;
+    xcb_gcontext_t gc;
+    xcb_shm_seg_t seg;
+    uint32_t *bits;
+    double start, elapsed;
+    int shmid, f = 0;
+
+    test_require_extension(c, &xcb_shm_id, "MIT-SHM");
+    test_require_depth24(screen);
+
+    shmid = shmget(IPC_PRIVATE, 2 * FRAME_SIZE, IPC_CREAT | 0600);
+    if (shmid < 0) {
+        fprintf(stderr, "No shared memory\n");
+        exit(77);
+    }
+    bits = shmat(shmid, NULL, 0);
+    assert(bits != (void *) -1);
+
+    seg = xcb_generate_id(c);
+    error = xcb_request_check(c, xcb_shm_attach_checked(c, seg, shmid, 0));
+    shmctl(shmid, IPC_RMID, NULL);
+    if (error) {
+        fprintf(stderr, "Server can't attach the segment\n");
+        exit(77);
+    }
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, 24, window, screen->root, 0, 0,
+                      WIDTH - 2 * BORDER, HEIGHT - 2 * BORDER, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      0, NULL);
+    xcb_map_window(c, window);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, window, 0, NULL);
+
+    if (frames) {
+        start = test_now();
+        for (f = 0; f < frames; f++)
+            put_frame(c, window, gc, seg, bits, f, WIDTH, HEIGHT,
+                      (f & 1) * FRAME_SIZE);
+        elapsed = test_now() - start;
+        check_frame(c, window, frames - 1, WIDTH, HEIGHT);
+        printf("ShmPutImage: %.1f frames/s\n",
+               elapsed > 0 ? frames / elapsed : 0);
+        xcb_disconnect(c);
+        exit(0);
+    }
+
+    /* Rewritten in place */
+    for (; f < 3; f++) {
+        put_frame(c, window, gc, seg, bits, f, WIDTH, HEIGHT, 0);
+        check_frame(c, window, f, WIDTH, HEIGHT);
+    }
+
+    /* Alternating between the two halves of the segment */
+    for (; f < 7; f++) {
+        put_frame(c, window, gc, seg, bits, f, WIDTH, HEIGHT,
+                  (f & 1) * FRAME_SIZE);
+        check_frame(c, window, f, WIDTH, HEIGHT);
+    }
+
+    /* Smaller frames from the same segment, and back */
+    for (; f < 10; f++) {
+        put_frame(c, window, gc, seg, bits, f, WIDTH / 2, HEIGHT / 2,
+                  FRAME_SIZE);
+        check_frame(c, window, f, WIDTH / 2, HEIGHT / 2);
+    }
+    put_frame(c, window, gc, seg, bits, f, WIDTH, HEIGHT, FRAME_SIZE);
+    check_frame(c, window, f, WIDTH, HEIGHT);
+
+    /* Detaching drops the header with the segment */
+    xcb_shm_detach(c, seg);
+    test_sync(c);
+    assert(!xcb_connection_has_error(c));
+
+    shmdt(bits);
+    xcb_disconnect(c);
+    exit(0);
+}
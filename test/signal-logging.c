@@ -28,6 +28,12 @@
 
 #include <stdint.h>
 #include <unistd.h>
+#if INPUTTHREAD
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
+#endif
 
 #include "os/fmt.h"
 #include "os/log_priv.h"
@@ -194,6 +200,7 @@ static void logging_format(void)
     free(fname);
 
 #define read_log_msg(msg) do {                                  \
+        LogFlush();                                             \
         msg = fgets(read_buf, sizeof(read_buf), f);             \
         assert(msg != NULL);                                   \
         msg = strchr(read_buf, ']');                            \
@@ -237,6 +244,7 @@ static void logging_format(void)
     read_log_msg(logmsg);
     assert(strstr(logmsg, "BUG") != NULL);
     LogMessageVerb(X_ERROR, 1, "\n");
+    LogFlush();
     fseek(f, 0, SEEK_END);
 
     /* string substitution */
@@ -249,6 +257,7 @@ static void logging_format(void)
     read_log_msg(logmsg);
     assert(strcmp(logmsg, "(EE) ") == 0);
     LogMessageVerb(X_ERROR, 1, "\n");
+    LogFlush();
     fseek(f, 0, SEEK_END);
 
     /* %hld is bogus */
@@ -256,6 +265,7 @@ static void logging_format(void)
     read_log_msg(logmsg);
     assert(strstr(logmsg, "BUG") != NULL);
     LogMessageVerb(X_ERROR, 1, "\n");
+    LogFlush();
     fseek(f, 0, SEEK_END);
 
     /* number substitution */
@@ -407,6 +417,123 @@ static void logging_format(void)
 
 #undef read_log_msg
 }
+
+#if INPUTTHREAD
+struct log_reader {
+    int fd;
+    char *buf;
+    size_t len;
+    size_t size;
+};
+
+static void *
+read_log(void *arg)
+{
+    struct log_reader *reader = arg;
+    ssize_t n;
+
+    do {
+        if (reader->size - reader->len < 4096) {
+            reader->size += 65536;
+            reader->buf = realloc(reader->buf, reader->size);
+            assert(reader->buf);
+        }
+        n = read(reader->fd, reader->buf + reader->len,
+                 reader->size - reader->len - 1);
+        assert(n >= 0);
+        reader->len += n;
+    } while (n > 0);
+
+    reader->buf[reader->len] = '\0';
+    return NULL;
+}
+
+/*
+ * Log to a fifo that isn't read until the ring has overflowed.  Info
+ * messages are dropped, by the full ring or by the rate limit, errors and
+ * warnings are not, the number of
+ * dropped messages is logged where they would have been and everything
+ * else comes out in order.
+ */
+static void logging_ring_full(void)
+{
+    const char *log_file_path = "/tmp/Xorg-logging-ring-test.log";
+    const int count = 50000, errors = 16;
+    struct log_reader reader = { 0 };
+    pthread_t thread;
+    char *line, *end;
+    int i, seq = 0, last = -1, seen = 0, errors_seen = 0;
+    unsigned int dropped = 0;
+
+    xorgLogVerbosity = -1;
+
+    unlink(log_file_path);
+    assert(mkfifo(log_file_path, S_IRUSR | S_IWUSR) == 0);
+
+    /* Open the reading end first so that LogInit() doesn't block.  A
+     * backup suffix keeps it from removing the fifo.
+     */
+    reader.fd = open(log_file_path, O_RDONLY | O_NONBLOCK);
+    assert(reader.fd >= 0);
+    free((char *) LogInit(log_file_path, ".old"));
+
+    for (i = 0; i < count; i++)
+        LogMessageVerb(X_INFO, 1, "message %d\n", seq++);
+    for (i = 0; i < errors; i++)
+        LogMessageVerb(i & 1 ? X_WARNING : X_ERROR, 1, "message %d\n", seq++);
+    for (i = 0; i < count; i++)
+        LogMessageVerb(X_INFO, 1, "message %d\n", seq++);
+
+    fcntl(reader.fd, F_SETFL, 0);
+    assert(pthread_create(&thread, NULL, read_log, &reader) == 0);
+
+    /* Once the ring is empty and the rate limit has let up, the next
+     * message goes in again
+     */
+    LogFlush();
+    nanosleep(&(struct timespec) { .tv_nsec = 10000000 }, NULL);
+    LogMessageVerb(X_INFO, 1, "message %d\n", seq++);
+
+    LogClose(EXIT_NO_ERROR);
+    pthread_join(thread, NULL);
+    close(reader.fd);
+    unlink(log_file_path);
+
+    for (line = reader.buf; *line; line = end + 1) {
+        char *msg;
+        unsigned int n;
+        int m;
+
+        end = strchr(line, '\n');
+        assert(end);
+        *end = '\0';
+
+        msg = strchr(line, ']');
+        assert(msg);
+        msg += 2; /* advance past [time.stamp] */
+
+        if (sscanf(msg, "(WW) %u log messages dropped", &n) == 1) {
+            /* Counts are only logged in front of a message */
+            assert(n > 0);
+            dropped += n;
+        }
+        else if (sscanf(msg, "(%*2c) message %d", &m) == 1) {
+            assert(m > last);
+            assert(m - seen == (int) dropped);
+            last = m;
+            seen++;
+            if (m >= count && m < count + errors)
+                errors_seen++;
+        }
+    }
+    free(reader.buf);
+
+    assert(dropped > 0);
+    assert(errors_seen == errors);
+    assert(seen + dropped == seq);
+    assert(last == seq - 1);
+}
+#endif
 #pragma GCC diagnostic pop /* "-Wformat-security" */
 
 const testfunc_t*
@@ -415,6 +542,9 @@ signal_logging_test(void)
     static const testfunc_t testfuncs[] = {
         number_formatting,
         logging_format,
+#if INPUTTHREAD
+        logging_ring_full,
+#endif
         NULL,
     };
     return testfuncs;
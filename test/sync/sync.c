@@ -22,6 +22,7 @@
  */
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -285,6 +286,207 @@ test_change_alarm_delta(xcb_connection_t *c)
     }
 }
 
+struct alarm_model {
+    xcb_sync_alarm_t id;
+    uint32_t test_type;
+    int64_t test_value;
+    int64_t delta;
+    bool active;
+    bool destroyed;
+    int events;
+    int expected_events;
+};
+
+static bool
+alarm_model_check(const struct alarm_model *a, int64_t oldval, int64_t newval)
+{
+    switch (a->test_type) {
+    case XCB_SYNC_TESTTYPE_POSITIVE_TRANSITION:
+        return oldval < a->test_value && newval >= a->test_value;
+    case XCB_SYNC_TESTTYPE_NEGATIVE_TRANSITION:
+        return oldval > a->test_value && newval <= a->test_value;
+    case XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON:
+        return newval >= a->test_value;
+    default:
+        return newval <= a->test_value;
+    }
+}
+
+/* What the server is supposed to do with each alarm on a counter change */
+static void
+alarm_model_change_counter(struct alarm_model *alarms, int num_alarms,
+                           int64_t oldval, int64_t newval)
+{
+    for (int i = 0; i < num_alarms; i++) {
+        struct alarm_model *a = &alarms[i];
+
+        if (a->destroyed || !a->active ||
+            !alarm_model_check(a, oldval, newval))
+            continue;
+
+        a->expected_events++;
+        if (a->delta == 0 &&
+            (a->test_type == XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON ||
+             a->test_type == XCB_SYNC_TESTTYPE_NEGATIVE_COMPARISON)) {
+            a->active = false;
+            continue;
+        }
+
+        do {
+            a->test_value += a->delta;
+        } while (alarm_model_check(a, newval, newval));
+    }
+}
+
+static int
+alarm_model_compare(const void *a, const void *b)
+{
+    const struct alarm_model *alarm_a = a, *alarm_b = b;
+
+    return (alarm_a->id > alarm_b->id) - (alarm_a->id < alarm_b->id);
+}
+
+/* Puts thousands of alarms of every test type on one counter, moves the
+ * counter up and down across their thresholds and checks that every alarm
+ * fired exactly as often as it should, and ended up with the right test
+ * value and state.
+ */
+static void
+test_many_alarms(xcb_connection_t *c, const xcb_query_extension_reply_t *ext)
+{
+#define ALARMS_PER_TYPE 1000
+    static struct alarm_model alarms[4 * ALARMS_PER_TYPE];
+    const int num_alarms = ARRAY_SIZE(alarms);
+    xcb_sync_counter_t counter = xcb_generate_id(c);
+    xcb_sync_query_alarm_cookie_t *queries;
+    xcb_generic_event_t *ev;
+    int64_t value = 0;
+    static const int steps[] = { 7, -5, 11, -13, 3 };
+
+    xcb_sync_create_counter(c, counter, sync_value(0));
+
+    for (int i = 0; i < num_alarms; i++) {
+        struct alarm_model *a = &alarms[i];
+        int n = i / 4 + 1;
+        uint32_t mask = XCB_SYNC_CA_COUNTER | XCB_SYNC_CA_VALUE_TYPE |
+            XCB_SYNC_CA_VALUE | XCB_SYNC_CA_TEST_TYPE | XCB_SYNC_CA_DELTA;
+
+        a->id = xcb_generate_id(c);
+        a->test_type = i % 4;
+        a->active = true;
+        switch (a->test_type) {
+        case XCB_SYNC_TESTTYPE_POSITIVE_TRANSITION:
+            a->test_value = n;
+            a->delta = n % 3;
+            break;
+        case XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON:
+            a->test_value = n;
+            a->delta = n % 2;
+            break;
+        case XCB_SYNC_TESTTYPE_NEGATIVE_TRANSITION:
+            a->test_value = -n;
+            a->delta = -(n % 3);
+            break;
+        case XCB_SYNC_TESTTYPE_NEGATIVE_COMPARISON:
+            a->test_value = -n;
+            a->delta = -(n % 2);
+            break;
+        }
+
+        uint32_t values[] = {
+            counter,
+            XCB_SYNC_VALUETYPE_ABSOLUTE,
+            a->test_value >> 32, a->test_value,
+            a->test_type,
+            a->delta >> 32, a->delta,
+        };
+        xcb_sync_create_alarm(c, a->id, mask, values);
+    }
+
+    /* sweep the counter over all thresholds a couple of times */
+    for (int s = 0; s < ARRAY_SIZE(steps); s++) {
+        int64_t target = steps[s] > 0 ? ALARMS_PER_TYPE + 10 :
+                                         -ALARMS_PER_TYPE - 10;
+
+        while (steps[s] > 0 ? value < target : value > target) {
+            int64_t oldval = value;
+
+            value += steps[s];
+            xcb_sync_set_counter(c, counter, sync_value(value));
+            alarm_model_change_counter(alarms, num_alarms, oldval, value);
+        }
+
+        /* and remove some of them in between */
+        for (int i = s; i < num_alarms; i += 7) {
+            if (alarms[i].destroyed)
+                continue;
+            xcb_sync_destroy_alarm(c, alarms[i].id);
+            alarms[i].destroyed = true;
+        }
+    }
+
+    queries = calloc(num_alarms, sizeof(*queries));
+    for (int i = 0; i < num_alarms; i++) {
+        if (!alarms[i].destroyed)
+            queries[i] = xcb_sync_query_alarm(c, alarms[i].id);
+    }
+
+    for (int i = 0; i < num_alarms; i++) {
+        struct alarm_model *a = &alarms[i];
+        xcb_sync_query_alarm_reply_t *reply;
+
+        if (a->destroyed)
+            continue;
+
+        reply = xcb_sync_query_alarm_reply(c, queries[i], NULL);
+        if (pack_sync_value(reply->trigger.wait_value) != a->test_value ||
+            (reply->state == XCB_SYNC_ALARMSTATE_ACTIVE) != a->active) {
+            fprintf(stderr, "Alarm %d (test type %d) has value %lld, "
+                    "state %d, expected %lld, %s\n",
+                    i, a->test_type,
+                    (long long)pack_sync_value(reply->trigger.wait_value),
+                    reply->state, (long long)a->test_value,
+                    a->active ? "active" : "inactive");
+            exit(1);
+        }
+        free(reply);
+    }
+    free(queries);
+
+    /* all events came before the replies */
+    qsort(alarms, num_alarms, sizeof(alarms[0]), alarm_model_compare);
+    while ((ev = xcb_poll_for_event(c))) {
+        if ((ev->response_type & 0x7f) ==
+            ext->first_event + XCB_SYNC_ALARM_NOTIFY) {
+            xcb_sync_alarm_notify_event_t *notify =
+                (xcb_sync_alarm_notify_event_t *) ev;
+            struct alarm_model key = { .id = notify->alarm }, *a;
+
+            a = bsearch(&key, alarms, num_alarms, sizeof(alarms[0]),
+                        alarm_model_compare);
+            assert(a);
+            if (notify->state != XCB_SYNC_ALARMSTATE_DESTROYED)
+                a->events++;
+        }
+        free(ev);
+    }
+
+    for (int i = 0; i < num_alarms; i++) {
+        if (alarms[i].events != alarms[i].expected_events) {
+            fprintf(stderr, "Alarm 0x%x (test type %d) fired %d times, "
+                    "expected %d\n", alarms[i].id, alarms[i].test_type,
+                    alarms[i].events, alarms[i].expected_events);
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < num_alarms; i++) {
+        if (!alarms[i].destroyed)
+            xcb_sync_destroy_alarm(c, alarms[i].id);
+    }
+    xcb_sync_destroy_counter(c, counter);
+}
+
 int main(int argc, char **argv)
 {
     int screen;
@@ -302,6 +504,7 @@ int main(int argc, char **argv)
     test_change_counter_overflow(c);
     test_change_alarm_value(c);
     test_change_alarm_delta(c);
+    test_many_alarms(c, ext);
 
     xcb_disconnect(c);
     exit(0);
@@ -184,6 +184,159 @@ xkb_set_get_rules_test(void)
     XkbFreeRMLVOSet(&rmlvo_backup, FALSE);
 }
 
+static int
+xkb_level_linear(XkbKeyTypePtr type, unsigned int mods)
+{
+    mods &= type->mods.mask;
+    for (int i = 0; i < type->map_count; i++) {
+        if (type->map[i].active && type->map[i].mods.mask == mods)
+            return type->map[i].level;
+    }
+    return 0;
+}
+
+/**
+ * Compile the key type levels of a keymap and compare them against
+ * walking the key types for every modifier state, then replay a long key
+ * stream through both.
+ *
+ * Result: the compiled levels match and follow key type changes after
+ * XkbInvalidateKeyTypeLevels().
+ */
+static void
+xkb_key_type_level_test(void)
+{
+    XkbKTMapEntryRec two_level[] = {
+        { .active = TRUE, .level = 1, .mods = { .mask = ShiftMask } },
+    };
+    XkbKTMapEntryRec alphabetic[] = {
+        { .active = TRUE, .level = 1, .mods = { .mask = ShiftMask } },
+        { .active = FALSE, .level = 1, .mods = { .mask = LockMask } },
+    };
+    XkbKTMapEntryRec four_level[] = {
+        { .active = TRUE, .level = 1, .mods = { .mask = ShiftMask } },
+        { .active = TRUE, .level = 2, .mods = { .mask = Mod5Mask } },
+        { .active = TRUE, .level = 3, .mods = { .mask = ShiftMask | Mod5Mask } },
+    };
+    XkbKeyTypeRec types[] = {
+        { .num_levels = 1 },
+        { .num_levels = 2, .mods = { .mask = ShiftMask },
+          .map_count = ARRAY_SIZE(two_level), .map = two_level },
+        { .num_levels = 2, .mods = { .mask = ShiftMask | LockMask },
+          .map_count = ARRAY_SIZE(alphabetic), .map = alphabetic },
+        { .num_levels = 4, .mods = { .mask = ShiftMask | Mod5Mask },
+          .map_count = ARRAY_SIZE(four_level), .map = four_level },
+    };
+    XkbClientMapRec map = { .num_types = ARRAY_SIZE(types), .types = types };
+    XkbDescRec desc = { .map = &map };
+    XkbSrvInfoRec xkbi = { .desc = &desc };
+    XkbKeyTypeRec other;
+    const int num_events = 1000000;
+    CARD32 start, elapsed_compiled, elapsed_linear;
+    int sum_compiled = 0, sum_linear = 0;
+
+    for (int t = 0; t < ARRAY_SIZE(types); t++) {
+        for (int mods = 0; mods < 256; mods++)
+            assert(XkbKeyTypeLevel(&xkbi, &types[t], mods) ==
+                   xkb_level_linear(&types[t], mods));
+    }
+    assert(xkbi.typeLevels);
+    assert(xkbi.nTypeLevels == ARRAY_SIZE(types));
+
+    /* a key type that isn't part of the keymap is still looked up */
+    other = types[3];
+    assert(XkbKeyTypeLevel(&xkbi, &other, ShiftMask | Mod5Mask) == 3);
+
+    start = GetTimeInMicros();
+    for (int i = 0; i < num_events; i++)
+        sum_compiled += XkbKeyTypeLevel(&xkbi, &types[i % ARRAY_SIZE(types)],
+                                        (i * 7) & 0xff);
+    elapsed_compiled = GetTimeInMicros() - start;
+
+    start = GetTimeInMicros();
+    for (int i = 0; i < num_events; i++)
+        sum_linear += xkb_level_linear(&types[i % ARRAY_SIZE(types)],
+                                       (i * 7) & 0xff);
+    elapsed_linear = GetTimeInMicros() - start;
+
+    assert(sum_compiled == sum_linear);
+    dbg("%d key events: %.3fus/event compiled, %.3fus/event linear\n",
+        num_events,
+        (double)elapsed_compiled / num_events,
+        (double)elapsed_linear / num_events);
+
+    /* a changed key type needs an explicit invalidation */
+    four_level[2].level = 2;
+    XkbInvalidateKeyTypeLevels(&xkbi);
+    assert(!xkbi.typeLevels);
+    assert(XkbKeyTypeLevel(&xkbi, &types[3], ShiftMask | Mod5Mask) == 2);
+
+    XkbInvalidateKeyTypeLevels(&xkbi);
+}
+
+/**
+ * Switch a slave device's keymap to its master the way CopyKeyClass()
+ * does, after the slave's controls were changed without an XKB notify,
+ * the way drivers set the repeat rate.
+ *
+ * Result: devices sharing a keymap skip the copy, a direct change to the
+ * controls is still copied to the master.
+ */
+static void
+xkb_copy_device_keymap_test(void)
+{
+    XkbControlsRec slave_ctrls = { .enabled_ctrls = XkbRepeatKeysMask,
+                                   .repeat_delay = 660,
+                                   .repeat_interval = 40 };
+    XkbControlsRec master_ctrls = slave_ctrls;
+    XkbDescRec slave_desc = { .ctrls = &slave_ctrls, .min_key_code = 8,
+                              .max_key_code = 255 };
+    XkbDescRec master_desc = { .ctrls = &master_ctrls, .min_key_code = 8,
+                               .max_key_code = 255 };
+    XkbSrvInfoRec slave_xkbi = { .desc = &slave_desc };
+    XkbSrvInfoRec master_xkbi = { .desc = &master_desc };
+    KeyClassRec slave_key = { .xkbInfo = &slave_xkbi };
+    KeyClassRec master_key = { .xkbInfo = &master_xkbi };
+    DeviceIntRec slave = { .id = 8, .key = &slave_key };
+    DeviceIntRec master = { .id = 3, .key = &master_key };
+    CARD32 serial;
+
+    slave_xkbi.device = &slave;
+    master_xkbi.device = &master;
+
+    /* devices initialized from the same keymap */
+    serial = XkbNewKeymapSerial();
+    slave_xkbi.keymapSerial = serial;
+    master_xkbi.keymapSerial = serial;
+
+    assert(XkbCopyDeviceKeymap(&master, &slave));
+    assert(master_xkbi.keymapSerial == serial);
+
+    /* a driver sets the repeat rate directly, no notify, no new serial */
+    slave_ctrls.repeat_delay = 250;
+    slave_ctrls.repeat_interval = 33;
+    assert(slave_xkbi.keymapSerial == serial);
+
+    assert(XkbCopyDeviceKeymap(&master, &slave));
+    assert(master_ctrls.repeat_delay == 250);
+    assert(master_ctrls.repeat_interval == 33);
+    assert(slave_xkbi.keymapSerial != 0);
+    assert(master_xkbi.keymapSerial == slave_xkbi.keymapSerial);
+
+    /* a control changed through the xkb helpers resets the serial */
+    serial = slave_xkbi.keymapSerial;
+    XkbSetRepeatKeys(&slave, -1, FALSE);
+    assert(slave_xkbi.keymapSerial != serial);
+    assert(XkbCopyDeviceKeymap(&master, &slave));
+    assert(!(master_ctrls.enabled_ctrls & XkbRepeatKeysMask));
+    assert(master_xkbi.keymapSerial == slave_xkbi.keymapSerial);
+
+    /* and the next switch is a no-op again */
+    serial = master_xkbi.keymapSerial;
+    assert(XkbCopyDeviceKeymap(&master, &slave));
+    assert(master_xkbi.keymapSerial == serial);
+}
+
 const testfunc_t*
 xkb_test(void)
 {
@@ -191,6 +344,8 @@ xkb_test(void)
         xkb_set_get_rules_test,
         xkb_get_rules_test,
         xkb_set_rules_test,
+        xkb_key_type_level_test,
+        xkb_copy_device_keymap_test,
         NULL,
     };
     return testfuncs;
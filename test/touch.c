@@ -307,6 +307,129 @@ touch_init(void)
     free_device(&dev);
 }
 
+static int replayed_events;
+static double replayed_x, replayed_y;
+
+static void
+touch_count_replay(InternalEvent *ev, DeviceIntPtr dev)
+{
+    DeviceEvent *event = &ev->device_event;
+
+    assert(event->flags & TOUCH_REPLAYING);
+    assert(replayed_events == 0 ? event->type == ET_TouchBegin
+                                : event->type == ET_TouchUpdate);
+    assert(BitIsOn(event->valuators.mask, 0));
+    assert(event->valuators.data[0] >= replayed_x);
+
+    replayed_x = event->valuators.data[0];
+    if (BitIsOn(event->valuators.mask, 1))
+        replayed_y = event->valuators.data[1];
+    replayed_events++;
+}
+
+static void
+touch_multitouch_storage(void)
+{
+    DeviceIntRec dev;
+    SpriteInfoRec sprite;
+    ScreenRec screen;
+    Atom labels[2] = { 0 };
+    TouchPointInfoPtr touches[10];
+    void *listeners[10], *history[10];
+    int num_touches;
+    const int sourceid = 999; /* not a device, so no DCCE on replay */
+    const int updates = 300;
+
+    screenInfo.screens[0] = &screen;
+
+    memset(&dev, 0, sizeof(dev));
+    dev.type = MASTER_POINTER;  /* claim it's a master to stop ptracccel */
+    dev.name = XNFstrdup("test device");
+    dev.id = 2;
+    dev.public.processInputProc = touch_count_replay;
+
+    InitValuatorClassDeviceStruct(&dev, 2, labels, 10, Absolute);
+    InitTouchClassDeviceStruct(&dev, 1, XIDirectTouch, 2);
+
+    memset(&sprite, 0, sizeof(sprite));
+    dev.spriteInfo = &sprite;
+
+    /* the first cycle grows the touch array to fit all touches */
+    for (int i = 0; i < ARRAY_SIZE(touches); i++) {
+        touches[i] = TouchBeginTouch(&dev, sourceid, 100 + i, FALSE);
+        assert(touches[i]);
+    }
+    num_touches = dev.touch->num_touches;
+    assert(num_touches >= ARRAY_SIZE(touches));
+    for (int i = 0; i < ARRAY_SIZE(touches); i++)
+        TouchEndTouch(&dev, TouchFindByClientID(&dev, 100 + i));
+
+    for (int cycle = 0; cycle < 50; cycle++) {
+        for (int i = 0; i < ARRAY_SIZE(touches); i++) {
+            TouchPointInfoPtr ti;
+            DeviceEvent ev;
+
+            ti = TouchBeginTouch(&dev, sourceid, 1000 * cycle + i, FALSE);
+            assert(ti);
+            assert(TouchEventHistoryAllocate(ti));
+
+            if (cycle == 0) {
+                listeners[i] = ti->listeners;
+                history[i] = ti->history;
+            }
+            else {
+                /* touch points are reused, without reallocating */
+                assert(ti->listeners == listeners[ti - dev.touch->touches]);
+                assert(ti->history == history[ti - dev.touch->touches]);
+            }
+
+            memset(&ev, 0, sizeof(ev));
+            ev.header = ET_Internal;
+            ev.length = sizeof(ev);
+            ev.type = ET_TouchBegin;
+            ev.deviceid = dev.id;
+            ev.sourceid = sourceid;
+            ev.touchid = ti->client_id;
+            SetBit(ev.valuators.mask, 0);
+            SetBit(ev.valuators.mask, 1);
+            ev.valuators.data[0] = i;
+            ev.valuators.data[1] = cycle;
+            TouchEventHistoryPush(ti, &ev);
+
+            ev.type = ET_TouchUpdate;
+            for (int j = 1; j <= updates; j++) {
+                ev.time = j;
+                ev.valuators.data[0] = i + j;
+                /* y only changes every other event */
+                if (j % 2) {
+                    SetBit(ev.valuators.mask, 1);
+                    ev.valuators.data[1] = cycle + j;
+                }
+                else
+                    ClearBit(ev.valuators.mask, 1);
+                TouchEventHistoryPush(ti, &ev);
+            }
+
+            replayed_events = 0;
+            replayed_x = -1;
+            replayed_y = -1;
+            TouchEventHistoryReplay(ti, &dev, 0);
+            /* the history is capped, the most recent state is kept */
+            assert(replayed_events > 1);
+            assert(replayed_events <= updates + 1);
+            assert(replayed_x == i + updates);
+            assert(replayed_y == cycle + updates - 1);
+        }
+
+        for (int i = 0; i < ARRAY_SIZE(touches); i++)
+            TouchEndTouch(&dev, TouchFindByClientID(&dev, 1000 * cycle + i));
+    }
+
+    assert(dev.touch->num_touches == num_touches);
+
+    free_device(&dev);
+}
+
 const testfunc_t*
 touch_test(void)
 {
@@ -316,6 +439,7 @@ touch_test(void)
         touch_begin_ddxtouch,
         touch_init,
         touch_begin_touch,
+        touch_multitouch_storage,
         NULL,
     };
     return testfuncs;
@@ -0,0 +1,125 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Helpers for the X client tests that simple-xinit runs against a
+ * server.  A test that can't run on the server it got exits with 77,
+ * which meson reports as skipped.
+ *
+ * Tests that double as benchmarks take "--benchmark <count>" and only
+ * time their loop then.
+ */
+
+#ifndef XCB_TESTS_H
+#define XCB_TESTS_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+static inline double
+test_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Returns the count after --benchmark, or 0 when run as a test */
+static inline int
+test_benchmark_count(int argc, char **argv)
+{
+    for (int i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "--benchmark"))
+            return atoi(argv[i + 1]);
+    }
+    return 0;
+}
+
+static inline xcb_connection_t *
+test_connect(xcb_screen_t **screen)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect\n");
+        exit(1);
+    }
+    if (screen)
+        *screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    return c;
+}
+
+static inline const xcb_query_extension_reply_t *
+test_require_extension(xcb_connection_t *c, xcb_extension_t *ext,
+                       const char *name)
+{
+    const xcb_query_extension_reply_t *reply = xcb_get_extension_data(c, ext);
+
+    if (!reply || !reply->present) {
+        fprintf(stderr, "No %s extension\n", name);
+        exit(77);
+    }
+    return reply;
+}
+
+static inline void
+test_require_depth24(xcb_screen_t *screen)
+{
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "Needs a depth 24 root window\n");
+        exit(77);
+    }
+}
+
+/* Waits until the server has processed everything sent so far */
+static inline void
+test_sync(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+/* Reads back one pixel of a depth 24 drawable */
+static inline uint32_t
+test_get_pixel(xcb_connection_t *c, xcb_drawable_t d, int x, int y)
+{
+    xcb_get_image_reply_t *reply;
+    uint32_t pixel;
+
+    reply = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              d, x, y, 1, 1, ~0),
+                                NULL);
+    assert(reply);
+    assert(xcb_get_image_data_length(reply) == sizeof(uint32_t));
+    memcpy(&pixel, xcb_get_image_data(reply), sizeof(pixel));
+    free(reply);
+
+    return pixel & 0x00ffffff;
+}
+
+#endif /* XCB_TESTS_H */
@@ -0,0 +1,270 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Draws with Xinerama on four side-by-side screens: rectangles and images
+ * into windows within one screen and across screen edges, into windows
+ * moved to another screen, and onto the root window, and checks what
+ * every screen shows.  Drawing errors must still be reported when the
+ * window isn't on the first screen, and a font shift in PolyText must
+ * change the font of the GC on every screen, not just the ones the
+ * window is on.
+ *
+ * With --benchmark, fills that many rectangles in a window on a single
+ * screen and prints the rate.
+ *
+ * Usage: xinerama-fill [--benchmark iterations]
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include "xcb-tests.h"
+
+/* Matches the -screen arguments in meson.build */
+#define SCREEN_WIDTH 320
+#define SCREEN_HEIGHT 240
+#define NUM_SCREENS 4
+
+static xcb_window_t
+create_window(xcb_connection_t *c, xcb_screen_t *screen,
+              int x, int y, int width, int height)
+{
+    xcb_window_t window = xcb_generate_id(c);
+    uint32_t values[] = { 1 };
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      x, y, width, height, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual, XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_map_window(c, window);
+    return window;
+}
+
+static xcb_gcontext_t
+create_gc(xcb_connection_t *c, xcb_drawable_t drawable, uint32_t pixel)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    uint32_t values[] = { pixel, 0 };
+
+    xcb_create_gc(c, gc, drawable,
+                  XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES, values);
+    return gc;
+}
+
+static void
+fill(xcb_connection_t *c, xcb_drawable_t drawable, xcb_gcontext_t gc,
+     int x, int y, int width, int height)
+{
+    xcb_rectangle_t rect = { x, y, width, height };
+
+    xcb_poly_fill_rectangle(c, drawable, gc, 1, &rect);
+}
+
+/* Checks the pixel at root coordinates x,y */
+static void
+check_pixel(xcb_connection_t *c, xcb_screen_t *screen, int x, int y,
+            uint32_t expected)
+{
+    uint32_t pixel = test_get_pixel(c, screen->root, x, y);
+
+    if (pixel != expected) {
+        fprintf(stderr, "Pixel at %d,%d is 0x%06x, expected 0x%06x\n",
+                x, y, pixel, expected);
+        exit(1);
+    }
+}
+
+static xcb_font_t
+open_font(xcb_connection_t *c, const char *name)
+{
+    xcb_font_t font = xcb_generate_id(c);
+
+    xcb_open_font(c, font, strlen(name), name);
+    return font;
+}
+
+/* Fetches the contents of a window */
+static xcb_get_image_reply_t *
+get_window(xcb_connection_t *c, xcb_window_t window, int width, int height)
+{
+    xcb_get_image_reply_t *reply;
+
+    reply = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              window, 0, 0, width, height, ~0),
+                                NULL);
+    assert(reply);
+    return reply;
+}
+
+/*
+ * Shifts the font of a GC with PolyText8 in a window on one screen, then
+ * draws with it on another and compares with a GC that has the new font
+ * set directly.
+ */
+static void
+check_font_shift(xcb_connection_t *c, xcb_screen_t *screen,
+                 xcb_window_t elsewhere)
+{
+    xcb_font_t fixed = open_font(c, "fixed"), cursor = open_font(c, "cursor");
+    xcb_gcontext_t shifted = xcb_generate_id(c), reference = xcb_generate_id(c);
+    xcb_gcontext_t black = create_gc(c, screen->root, 0x000000);
+    xcb_window_t text, expected;
+    xcb_get_image_reply_t *got, *want;
+    const uint8_t shift[] = {
+        255, cursor >> 24, cursor >> 16, cursor >> 8, cursor,
+    };
+    int length;
+
+    xcb_create_gc(c, shifted, screen->root,
+                  XCB_GC_FOREGROUND | XCB_GC_BACKGROUND | XCB_GC_FONT,
+                  (uint32_t[]) { 0xffffff, 0x000000, fixed });
+    xcb_create_gc(c, reference, screen->root,
+                  XCB_GC_FOREGROUND | XCB_GC_BACKGROUND | XCB_GC_FONT,
+                  (uint32_t[]) { 0xffffff, 0x000000, cursor });
+
+    xcb_poly_text_8(c, elsewhere, shifted, 0, 0, sizeof(shift), shift);
+
+    /* Both on the second screen */
+    text = create_window(c, screen, SCREEN_WIDTH + 10, 10, 100, 40);
+    expected = create_window(c, screen, SCREEN_WIDTH + 10, 60, 100, 40);
+    fill(c, text, black, 0, 0, 100, 40);
+    fill(c, expected, black, 0, 0, 100, 40);
+    xcb_image_text_8(c, 2, text, shifted, 10, 30, "AB");
+    xcb_image_text_8(c, 2, expected, reference, 10, 30, "AB");
+
+    got = get_window(c, text, 100, 40);
+    want = get_window(c, expected, 100, 40);
+    length = xcb_get_image_data_length(want);
+    assert(xcb_get_image_data_length(got) == length);
+    if (memcmp(xcb_get_image_data(got), xcb_get_image_data(want), length)) {
+        fprintf(stderr, "Font shift on the third screen didn't reach the second\n");
+        exit(1);
+    }
+    free(got);
+    free(want);
+
+    xcb_free_gc(c, shifted);
+    xcb_free_gc(c, reference);
+    xcb_free_gc(c, black);
+    xcb_close_font(c, fixed);
+    xcb_close_font(c, cursor);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = test_benchmark_count(argc, argv);
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_window_t single, spanning, cover, child;
+    xcb_gcontext_t red, green, blue, mono_gc;
+    xcb_pixmap_t mono;
+    xcb_generic_error_t *error;
+    uint32_t image[16 * 16];
+    double start, elapsed;
+
+    if (screen->width_in_pixels != SCREEN_WIDTH * NUM_SCREENS ||
+        screen->root_depth != 24) {
+        fprintf(stderr, "Needs %d screens of %dx%d at depth 24 with Xinerama\n",
+                NUM_SCREENS, SCREEN_WIDTH, SCREEN_HEIGHT);
+        exit(77);
+    }
+
+    red = create_gc(c, screen->root, 0xff0000);
+    blue = create_gc(c, screen->root, 0x0000ff);
+
+    if (iterations) {
+        single = create_window(c, screen, 2 * SCREEN_WIDTH + 10, 10, 100, 100);
+        start = test_now();
+        for (int i = 0; i < iterations; i++)
+            fill(c, single, (i & 1) ? red : blue, i % 90, i % 90, 10, 10);
+        test_sync(c);
+        elapsed = test_now() - start;
+        printf("PolyFillRectangle on one screen: %.0f requests/s\n",
+               elapsed > 0 ? iterations / elapsed : 0);
+        xcb_disconnect(c);
+        exit(0);
+    }
+
+    green = create_gc(c, screen->root, 0x00ff00);
+
+    /* Within the third screen, and across the first and second ones */
+    single = create_window(c, screen, 2 * SCREEN_WIDTH + 10, 10, 100, 100);
+    spanning = create_window(c, screen, SCREEN_WIDTH - 50, 120, 100, 100);
+
+    fill(c, single, red, 0, 0, 100, 100);
+    fill(c, spanning, green, 0, 0, 100, 100);
+    check_pixel(c, screen, 2 * SCREEN_WIDTH + 10, 10, 0xff0000);
+    check_pixel(c, screen, 2 * SCREEN_WIDTH + 109, 109, 0xff0000);
+    check_pixel(c, screen, SCREEN_WIDTH - 50, 120, 0x00ff00);
+    check_pixel(c, screen, SCREEN_WIDTH + 49, 219, 0x00ff00);
+
+    /* Images across a screen edge */
+    for (int i = 0; i < 16 * 16; i++)
+        image[i] = 0x0000ff;
+    xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, spanning, blue, 16, 16,
+                  42, 0, 0, 24, sizeof(image), (const uint8_t *) image);
+    check_pixel(c, screen, SCREEN_WIDTH - 8, 120, 0x0000ff);
+    check_pixel(c, screen, SCREEN_WIDTH + 7, 135, 0x0000ff);
+    check_pixel(c, screen, SCREEN_WIDTH + 8, 135, 0x00ff00);
+
+    /* Rectangles on the root window, on the last screen only */
+    fill(c, screen->root, blue, 3 * SCREEN_WIDTH + 10, 200, 20, 20);
+    check_pixel(c, screen, 3 * SCREEN_WIDTH + 10, 200, 0x0000ff);
+    check_pixel(c, screen, 3 * SCREEN_WIDTH + 29, 219, 0x0000ff);
+
+    /* Parts of the window that are covered on its screen stay as they are */
+    cover = create_window(c, screen, 2 * SCREEN_WIDTH, 0, 60, 60);
+    fill(c, cover, blue, 0, 0, 60, 60);
+    fill(c, single, green, 0, 0, 100, 100);
+    check_pixel(c, screen, 2 * SCREEN_WIDTH + 20, 20, 0x0000ff);
+    check_pixel(c, screen, 2 * SCREEN_WIDTH + 60, 60, 0x00ff00);
+
+    /* Screens are tracked as windows move, children with their parent */
+    child = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, child, spanning, 60, 60, 20, 20,
+                      0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      0, NULL);
+    xcb_map_window(c, child);
+    xcb_configure_window(c, spanning,
+                         XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_STACK_MODE,
+                         (uint32_t[]) { 3 * SCREEN_WIDTH + 100,
+                                        XCB_STACK_MODE_ABOVE });
+    fill(c, child, red, 0, 0, 20, 20);
+    check_pixel(c, screen, 3 * SCREEN_WIDTH + 165, 185, 0xff0000);
+
+    /* A GC of the wrong depth still fails with the window off screen 0 */
+    mono = xcb_generate_id(c);
+    xcb_create_pixmap(c, 1, mono, screen->root, 1, 1);
+    mono_gc = create_gc(c, mono, 1);
+    error = xcb_request_check(c,
+                              xcb_poly_fill_rectangle_checked(c, single, mono_gc, 1,
+                                                              &(xcb_rectangle_t) { 0, 0, 10, 10 }));
+    assert(error && error->error_code == XCB_MATCH);
+    free(error);
+
+    check_font_shift(c, screen, single);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,166 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Creates and frees pixmaps and windows, checking that the resource
+ * counts reported by XResQueryClientResources and the bytes reported by
+ * XResQueryClientPixmapBytes follow, and that XResQueryResourceBytes
+ * reports all of them.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <xcb/res.h>
+
+#include "xcb-tests.h"
+
+#define NUM_PIXMAPS 50
+#define NUM_WINDOWS 20
+#define PIXMAP_SIZE 16
+#define PIXMAP_BYTES (PIXMAP_SIZE * PIXMAP_SIZE * 4)
+
+static xcb_atom_t
+intern(xcb_connection_t *c, const char *name)
+{
+    xcb_intern_atom_reply_t *reply;
+    xcb_atom_t atom;
+
+    reply = xcb_intern_atom_reply(c, xcb_intern_atom(c, 0, strlen(name), name),
+                                  NULL);
+    assert(reply);
+    atom = reply->atom;
+    free(reply);
+
+    return atom;
+}
+
+static uint32_t
+count_type(xcb_connection_t *c, uint32_t xid, xcb_atom_t type)
+{
+    xcb_res_query_client_resources_reply_t *reply;
+    xcb_res_type_iterator_t it;
+    uint32_t count = 0;
+
+    reply = xcb_res_query_client_resources_reply(c,
+                                                 xcb_res_query_client_resources(c, xid),
+                                                 NULL);
+    assert(reply);
+    for (it = xcb_res_query_client_resources_types_iterator(reply); it.rem;
+         xcb_res_type_next(&it)) {
+        if (it.data->resource_type == type)
+            count = it.data->count;
+    }
+    free(reply);
+
+    return count;
+}
+
+static uint64_t
+pixmap_bytes(xcb_connection_t *c, uint32_t xid)
+{
+    xcb_res_query_client_pixmap_bytes_reply_t *reply;
+    uint64_t bytes;
+
+    reply = xcb_res_query_client_pixmap_bytes_reply(c,
+                                                    xcb_res_query_client_pixmap_bytes(c, xid),
+                                                    NULL);
+    assert(reply);
+    bytes = reply->bytes | (uint64_t) reply->bytes_overflow << 32;
+    free(reply);
+
+    return bytes;
+}
+
+int main(void)
+{
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_atom_t pixmap_type, window_type;
+    xcb_pixmap_t pixmaps[NUM_PIXMAPS];
+    xcb_window_t windows[NUM_WINDOWS];
+    xcb_res_query_resource_bytes_reply_t *bytes;
+    xcb_res_resource_id_spec_t spec;
+    uint32_t xid, base_pixmaps, base_windows;
+    uint64_t base_bytes;
+
+    test_require_extension(c, &xcb_res_id, "X-Resource");
+    test_require_depth24(screen);
+    free(xcb_res_query_version_reply(c, xcb_res_query_version(c, 1, 2), NULL));
+
+    xid = xcb_get_setup(c)->resource_id_base;
+    pixmap_type = intern(c, "PIXMAP");
+    window_type = intern(c, "WINDOW");
+
+    base_pixmaps = count_type(c, xid, pixmap_type);
+    base_windows = count_type(c, xid, window_type);
+    base_bytes = pixmap_bytes(c, xid);
+
+    for (int i = 0; i < NUM_PIXMAPS; i++) {
+        pixmaps[i] = xcb_generate_id(c);
+        xcb_create_pixmap(c, screen->root_depth, pixmaps[i], screen->root,
+                          PIXMAP_SIZE, PIXMAP_SIZE);
+    }
+    for (int i = 0; i < NUM_WINDOWS; i++) {
+        windows[i] = xcb_generate_id(c);
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, windows[i], screen->root,
+                          0, 0, 16, 16, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                          screen->root_visual, 0, NULL);
+    }
+
+    assert(count_type(c, xid, pixmap_type) == base_pixmaps + NUM_PIXMAPS);
+    assert(count_type(c, xid, window_type) == base_windows + NUM_WINDOWS);
+    assert(pixmap_bytes(c, xid) == base_bytes + NUM_PIXMAPS * PIXMAP_BYTES);
+
+    /* All of the client's resources, each with its size */
+    spec.resource = 0;
+    spec.type = XCB_NONE;
+    bytes = xcb_res_query_resource_bytes_reply(c,
+                                               xcb_res_query_resource_bytes(c, xid,
+                                                                            1, &spec),
+                                               NULL);
+    assert(bytes);
+    assert(bytes->num_sizes >= NUM_PIXMAPS + NUM_WINDOWS);
+    free(bytes);
+
+    for (int i = 0; i < NUM_PIXMAPS; i += 2)
+        xcb_free_pixmap(c, pixmaps[i]);
+    for (int i = 0; i < NUM_WINDOWS; i += 2)
+        xcb_destroy_window(c, windows[i]);
+
+    assert(count_type(c, xid, pixmap_type) == base_pixmaps + NUM_PIXMAPS / 2);
+    assert(count_type(c, xid, window_type) == base_windows + NUM_WINDOWS / 2);
+    assert(pixmap_bytes(c, xid) ==
+           base_bytes + NUM_PIXMAPS / 2 * PIXMAP_BYTES);
+
+    for (int i = 1; i < NUM_PIXMAPS; i += 2)
+        xcb_free_pixmap(c, pixmaps[i]);
+    for (int i = 1; i < NUM_WINDOWS; i += 2)
+        xcb_destroy_window(c, windows[i]);
+
+    assert(count_type(c, xid, pixmap_type) == base_pixmaps);
+    assert(count_type(c, xid, window_type) == base_windows);
+    assert(pixmap_bytes(c, xid) == base_bytes);
+
+    xcb_disconnect(c);
+    exit(0);
+}
@@ -0,0 +1,200 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file
+ *
+ * Drives the pointer and keyboard through XTEST the way UI automation
+ * does: a stream of fake motion, button and key events sent without
+ * waiting for the server in between.  Every button press must be
+ * delivered at the position the motion before it moved the pointer to,
+ * right after a motion event for that position, even when the server
+ * skips the motion in between.  The pointer must end up where the last
+ * motion put it and no button or key may be left down.
+ *
+ * With --benchmark, sends that many events and prints how many per
+ * second the server took.
+ *
+ * Usage: xtest-fake-input [--benchmark events]
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <xcb/xtest.h>
+
+#include "xcb-tests.h"
+
+#define CLICKS 64
+
+static void
+fake(xcb_connection_t *c, uint8_t type, uint8_t detail, xcb_window_t root,
+     int x, int y)
+{
+    xcb_test_fake_input(c, type, detail, XCB_CURRENT_TIME, root, x, y, 0);
+}
+
+static void
+check_idle(xcb_connection_t *c, xcb_screen_t *screen, xcb_keycode_t keycode,
+           int x, int y)
+{
+    xcb_query_pointer_reply_t *pointer;
+    xcb_query_keymap_reply_t *keymap;
+
+    pointer = xcb_query_pointer_reply(c, xcb_query_pointer(c, screen->root),
+                                      NULL);
+    assert(pointer);
+    if (pointer->root_x != x || pointer->root_y != y) {
+        fprintf(stderr, "Pointer at %d,%d, expected %d,%d\n",
+                pointer->root_x, pointer->root_y, x, y);
+        exit(1);
+    }
+    assert(!(pointer->mask & XCB_KEY_BUT_MASK_BUTTON_1));
+    free(pointer);
+
+    keymap = xcb_query_keymap_reply(c, xcb_query_keymap(c), NULL);
+    assert(keymap);
+    assert(!(keymap->keys[keycode / 8] & (1 << (keycode % 8))));
+    free(keymap);
+}
+
+static void
+benchmark(xcb_connection_t *c, xcb_screen_t *screen, xcb_keycode_t keycode,
+          int events)
+{
+    int x = 0, y = 0, sent = 0;
+    double start, elapsed;
+
+    start = test_now();
+    for (int i = 0; sent < events; i++) {
+        x = (i * 7) % screen->width_in_pixels;
+        y = (i * 13) % screen->height_in_pixels;
+        fake(c, XCB_MOTION_NOTIFY, 0, screen->root, x, y);
+        sent++;
+
+        /* Mix in a click and a key stroke now and then */
+        if (i % 16 == 0) {
+            fake(c, XCB_BUTTON_PRESS, 1, XCB_NONE, 0, 0);
+            fake(c, XCB_BUTTON_RELEASE, 1, XCB_NONE, 0, 0);
+            fake(c, XCB_KEY_PRESS, keycode, XCB_NONE, 0, 0);
+            fake(c, XCB_KEY_RELEASE, keycode, XCB_NONE, 0, 0);
+            sent += 4;
+        }
+    }
+    test_sync(c);
+    elapsed = test_now() - start;
+
+    check_idle(c, screen, keycode, x, y);
+    printf("XTEST: %.0f events/s\n", elapsed > 0 ? sent / elapsed : 0);
+}
+
+int main(int argc, char **argv)
+{
+    int events = test_benchmark_count(argc, argv);
+    xcb_screen_t *screen;
+    xcb_connection_t *c = test_connect(&screen);
+    xcb_generic_event_t *ev;
+    xcb_window_t window;
+    xcb_keycode_t keycode;
+    uint32_t values[2];
+    int x = 0, y = 0, presses = 0, motions = 0;
+    int motion_x = -1, motion_y = -1;
+
+    test_require_extension(c, &xcb_test_id, "XTEST");
+    keycode = xcb_get_setup(c)->min_keycode;
+
+    if (events) {
+        benchmark(c, screen, keycode, events);
+        xcb_disconnect(c);
+        exit(0);
+    }
+
+    /* A window over the whole screen gets every press */
+    window = xcb_generate_id(c);
+    values[0] = 1;
+    values[1] = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_POINTER_MOTION;
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root, 0, 0,
+                      screen->width_in_pixels, screen->height_in_pixels, 0,
+                      XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT,
+                      XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK, values);
+    xcb_map_window(c, window);
+    test_sync(c);
+
+    /* Several motions between clicks, all sent in one go; each click
+     * must land where the last motion before it left the pointer
+     */
+    for (int i = 0; i < CLICKS; i++) {
+        for (int j = 0; j <= i % 4; j++) {
+            x = (i * 37 + j * 5) % screen->width_in_pixels;
+            y = (i * 23 + j * 11) % screen->height_in_pixels;
+            fake(c, XCB_MOTION_NOTIFY, 0, screen->root, x, y);
+        }
+        fake(c, XCB_BUTTON_PRESS, 1, XCB_NONE, 0, 0);
+        fake(c, XCB_BUTTON_RELEASE, 1, XCB_NONE, 0, 0);
+        if (i % 8 == 0) {
+            fake(c, XCB_KEY_PRESS, keycode, XCB_NONE, 0, 0);
+            fake(c, XCB_KEY_RELEASE, keycode, XCB_NONE, 0, 0);
+        }
+    }
+    test_sync(c);
+
+    while ((ev = xcb_poll_for_event(c))) {
+        xcb_button_press_event_t *press = (xcb_button_press_event_t *) ev;
+        int i = presses, j = i % 4;
+
+        assert(press->event == window);
+        if ((ev->response_type & ~0x80) == XCB_MOTION_NOTIFY) {
+            xcb_motion_notify_event_t *motion = (xcb_motion_notify_event_t *) ev;
+
+            motion_x = motion->root_x;
+            motion_y = motion->root_y;
+            motions++;
+            free(ev);
+            continue;
+        }
+
+        assert((ev->response_type & ~0x80) == XCB_BUTTON_PRESS);
+        if (motion_x != press->root_x || motion_y != press->root_y) {
+            fprintf(stderr, "Click %d at %d,%d, last motion to %d,%d\n", i,
+                    press->root_x, press->root_y, motion_x, motion_y);
+            exit(1);
+        }
+        if (press->root_x != (i * 37 + j * 5) % screen->width_in_pixels ||
+            press->root_y != (i * 23 + j * 11) % screen->height_in_pixels) {
+            fprintf(stderr, "Click %d at %d,%d, expected %d,%d\n", i,
+                    press->root_x, press->root_y,
+                    (i * 37 + j * 5) % screen->width_in_pixels,
+                    (i * 23 + j * 11) % screen->height_in_pixels);
+            exit(1);
+        }
+        presses++;
+        free(ev);
+    }
+    if (presses != CLICKS) {
+        fprintf(stderr, "Got %d clicks, expected %d\n", presses, CLICKS);
+        exit(1);
+    }
+    assert(motions >= CLICKS);
+
+    check_idle(c, screen, keycode, x, y);
+
+    xcb_disconnect(c);
+    exit(0);
+}
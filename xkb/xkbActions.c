@@ -39,6 +39,7 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include "dix/dixgrabs_priv.h"
 #include "dix/input_priv.h"
 #include "dix/inpututils_priv.h"
+#include "dix/reqstats_priv.h"
 #include "mi/mi_priv.h"
 #include "mi/mipointer_priv.h"
 #include "xkb/xkbsrv_priv.h"
@@ -143,18 +144,8 @@ XkbGetKeyAction(XkbSrvInfoPtr xkbi, XkbStatePtr xkbState, CARD8 key)
         col += (effectiveGroup * XkbKeyGroupsWidth(xkb, key));
 
     type = XkbKeyKeyType(xkb, key, effectiveGroup);
-    if (type->map != NULL) {
-        register unsigned i, mods;
-        register XkbKTMapEntryPtr entry;
-
-        mods = xkbState->mods & type->mods.mask;
-        for (entry = type->map, i = 0; i < type->map_count; i++, entry++) {
-            if ((entry->active) && (entry->mods.mask == mods)) {
-                col += entry->level;
-                break;
-            }
-        }
-    }
+    if (type->map != NULL)
+        col += XkbKeyTypeLevel(xkbi, type, xkbState->mods);
     if (pActs[col].any.type == XkbSA_NoAction)
         return pActs[col];
     fake = _FixUpAction(xkb, &pActs[col]);
@@ -1032,6 +1023,9 @@ XkbHandlePrivate(DeviceIntPtr dev, KeyCode keycode, XkbAction *pAction)
             LogMessage(X_INFO, "Printing window tree\n");
             PrintWindowTree();
         }
+        else if (strcasecmp(msgbuf, "prreqs") == 0) {
+            dixPrintRequestStats();
+        }
     }
 
     return XkbDDXPrivate(dev, keycode, pAction);
@@ -167,6 +167,9 @@ XkbSendNewKeyboardNotify(DeviceIntPtr kbd, xkbNewKeyboardNotify * pNKN)
     Time time = GetTimeInMillis();
     CARD16 changed = pNKN->changed;
 
+    XkbInvalidateKeyTypeLevels(kbd->key->xkbInfo);
+    XkbKeymapChanged(kbd->key->xkbInfo);
+
     pNKN->type = XkbEventCode + XkbEventBase;
     pNKN->xkbType = XkbNewKeyboardNotify;
 
@@ -268,6 +271,9 @@ XkbSendMapNotify(DeviceIntPtr kbd, xkbMapNotify * pMN)
     CARD16 changed = pMN->changed;
     XkbSrvInfoPtr xkbi = kbd->key->xkbInfo;
 
+    XkbInvalidateKeyTypeLevels(xkbi);
+    XkbKeymapChanged(xkbi);
+
     pMN->minKeyCode = xkbi->desc->min_key_code;
     pMN->maxKeyCode = xkbi->desc->max_key_code;
     pMN->type = XkbEventCode + XkbEventBase;
@@ -384,10 +390,14 @@ XkbSendControlsNotify(DeviceIntPtr kbd, xkbControlsNotify * pCN)
     XkbInterestPtr interest;
     Time time = 0;
 
-    interest = kbd->xkb_interest;
-    if (!interest || !kbd->key || !kbd->key->xkbInfo)
+    if (!kbd->key || !kbd->key->xkbInfo)
         return;
     xkbi = kbd->key->xkbInfo;
+    XkbKeymapChanged(xkbi);
+
+    interest = kbd->xkb_interest;
+    if (!interest)
+        return;
 
     initialized = 0;
     enabledControls = xkbi->desc->ctrls->enabled_ctrls;
@@ -430,6 +440,9 @@ XkbSendIndicatorNotify(DeviceIntPtr kbd, int xkbType, xkbIndicatorNotify * pEv)
     Time time = 0;
     CARD32 state, changed;
 
+    if (xkbType == XkbIndicatorMapNotify && kbd->key && kbd->key->xkbInfo)
+        XkbKeymapChanged(kbd->key->xkbInfo);
+
     interest = kbd->xkb_interest;
     if (!interest)
         return;
@@ -600,6 +613,9 @@ XkbSendNamesNotify(DeviceIntPtr kbd, xkbNamesNotify * pEv)
     CARD16 changed, changedVirtualMods;
     CARD32 changedIndicators;
 
+    if (kbd->key && kbd->key->xkbInfo)
+        XkbKeymapChanged(kbd->key->xkbInfo);
+
     interest = kbd->xkb_interest;
     if (!interest)
         return;
@@ -646,6 +662,9 @@ XkbSendCompatMapNotify(DeviceIntPtr kbd, xkbCompatMapNotify * pEv)
     Time time = 0;
     CARD16 firstSI = 0, nSI = 0, nTotalSI = 0;
 
+    if (kbd->key && kbd->key->xkbInfo)
+        XkbKeymapChanged(kbd->key->xkbInfo);
+
     interest = kbd->xkb_interest;
     if (!interest)
         return;
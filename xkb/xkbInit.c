@@ -97,7 +97,18 @@ static char *XkbLayoutUsed = NULL;
 static char *XkbVariantUsed = NULL;
 static char *XkbOptionsUsed = NULL;
 
-static XkbDescPtr xkb_cached_map = NULL;
+/* Compiled keymaps by RMLVO, most recently used first. Hotplugged devices
+ * usually use one of a few layouts, this saves the xkbcomp round trip for
+ * all of them. */
+#define XKB_KEYMAP_CACHE_SIZE 4
+
+typedef struct _XkbCachedKeymap {
+    XkbRMLVOSet rmlvo;
+    XkbDescPtr xkb;
+    CARD32 serial;              /* see XkbSrvInfoRec::keymapSerial */
+} XkbCachedKeymapRec, *XkbCachedKeymapPtr;
+
+static XkbCachedKeymapRec xkb_cached_maps[XKB_KEYMAP_CACHE_SIZE];
 
 static Bool XkbWantRulesProp = XKB_DFLT_RULES_PROP;
 
@@ -287,26 +298,75 @@ XkbDeleteRulesDflts(void)
     free(XkbOptionsDflt);
     XkbOptionsDflt = NULL;
 
-    XkbFreeKeyboard(xkb_cached_map, XkbAllComponentsMask, TRUE);
-    xkb_cached_map = NULL;
+    for (int i = 0; i < XKB_KEYMAP_CACHE_SIZE; i++) {
+        XkbCachedKeymapPtr cached = &xkb_cached_maps[i];
+
+        XkbFreeRMLVOSet(&cached->rmlvo, FALSE);
+        XkbFreeKeyboard(cached->xkb, XkbAllComponentsMask, TRUE);
+        memset(cached, 0, sizeof(*cached));
+    }
 }
 
 #define DIFFERS(a, b) (strcmp((a) ? (a) : "", (b) ? (b) : "") != 0)
 
 static Bool
-XkbCompareUsedRMLVO(XkbRMLVOSet * rmlvo)
+XkbCompareRMLVO(XkbRMLVOSet * a, XkbRMLVOSet * b)
 {
-    if (DIFFERS(rmlvo->rules, XkbRulesUsed) ||
-        DIFFERS(rmlvo->model, XkbModelUsed) ||
-        DIFFERS(rmlvo->layout, XkbLayoutUsed) ||
-        DIFFERS(rmlvo->variant, XkbVariantUsed) ||
-        DIFFERS(rmlvo->options, XkbOptionsUsed))
+    if (DIFFERS(a->rules, b->rules) ||
+        DIFFERS(a->model, b->model) ||
+        DIFFERS(a->layout, b->layout) ||
+        DIFFERS(a->variant, b->variant) ||
+        DIFFERS(a->options, b->options))
         return FALSE;
     return TRUE;
 }
 
 #undef DIFFERS
 
+/**
+ * Find the compiled keymap for the given RMLVO, compiling and caching it
+ * if needed. The returned entry is moved to the front of the cache and
+ * stays valid until the next call.
+ */
+static XkbCachedKeymapPtr
+XkbGetCachedKeymap(DeviceIntPtr dev, XkbRMLVOSet * rmlvo)
+{
+    XkbCachedKeymapRec found = { { NULL } };
+    int i;
+
+    for (i = 0; i < XKB_KEYMAP_CACHE_SIZE && xkb_cached_maps[i].xkb; i++) {
+        if (XkbCompareRMLVO(&xkb_cached_maps[i].rmlvo, rmlvo)) {
+            LogMessageVerb(X_INFO, 4, "XKB: Reusing cached keymap\n");
+            found = xkb_cached_maps[i];
+            break;
+        }
+    }
+
+    if (!found.xkb) {
+        found.xkb = XkbCompileKeymap(dev, rmlvo);
+        if (!found.xkb)
+            return NULL;
+
+        found.rmlvo.rules = Xstrdup(rmlvo->rules);
+        found.rmlvo.model = Xstrdup(rmlvo->model);
+        found.rmlvo.layout = Xstrdup(rmlvo->layout);
+        found.rmlvo.variant = Xstrdup(rmlvo->variant);
+        found.rmlvo.options = Xstrdup(rmlvo->options);
+        found.serial = XkbNewKeymapSerial();
+
+        /* evict the least recently used keymap */
+        i = XKB_KEYMAP_CACHE_SIZE - 1;
+        XkbFreeRMLVOSet(&xkb_cached_maps[i].rmlvo, FALSE);
+        XkbFreeKeyboard(xkb_cached_maps[i].xkb, XkbAllComponentsMask, TRUE);
+    }
+
+    memmove(&xkb_cached_maps[1], &xkb_cached_maps[0],
+            i * sizeof(xkb_cached_maps[0]));
+    xkb_cached_maps[0] = found;
+
+    return &xkb_cached_maps[0];
+}
+
 /***====================================================================***/
 
 #include "xkbDflts.h"
@@ -518,6 +578,9 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
     XkbChangesRec changes;
     XkbEventCauseRec cause;
     XkbRMLVOSet rmlvo_dflts = { NULL };
+    XkbDescPtr compiled = NULL;
+    XkbDescPtr uncached = NULL;
+    CARD32 serial = 0;
 
     BUG_RETURN_VAL(dev == NULL, FALSE);
     BUG_RETURN_VAL(dev->key != NULL, FALSE);
@@ -552,23 +615,23 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
     }
     dev->key->xkbInfo = xkbi;
 
-    if (xkb_cached_map && (keymap || (rmlvo && !XkbCompareUsedRMLVO(rmlvo)))) {
-        XkbFreeKeyboard(xkb_cached_map, XkbAllComponentsMask, TRUE);
-        xkb_cached_map = NULL;
-    }
+    if (rmlvo) {
+        XkbCachedKeymapPtr cached = XkbGetCachedKeymap(dev, rmlvo);
 
-    if (xkb_cached_map)
-        LogMessageVerb(X_INFO, 4, "XKB: Reusing cached keymap\n");
+        if (cached) {
+            compiled = cached->xkb;
+            serial = cached->serial;
+        }
+    }
     else {
-        if (rmlvo)
-            xkb_cached_map = XkbCompileKeymap(dev, rmlvo);
-        else
-            xkb_cached_map = XkbCompileKeymapFromString(dev, keymap, keymap_length);
+        /* keymaps from strings are one-offs, don't cache them */
+        uncached = XkbCompileKeymapFromString(dev, keymap, keymap_length);
+        compiled = uncached;
+    }
 
-        if (!xkb_cached_map) {
-            ErrorF("XKB: Failed to compile keymap\n");
-            goto unwind_info;
-        }
+    if (!compiled) {
+        ErrorF("XKB: Failed to compile keymap\n");
+        goto unwind_info;
     }
 
     xkb = XkbAllocKeyboard();
@@ -577,14 +640,17 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
         goto unwind_info;
     }
 
-    if (!XkbCopyKeymap(xkb, xkb_cached_map)) {
+    if (!XkbCopyKeymap(xkb, compiled)) {
         ErrorF("XKB: Failed to copy keymap\n");
         goto unwind_desc;
     }
-    xkb->defined = xkb_cached_map->defined;
-    xkb->flags = xkb_cached_map->flags;
-    xkb->device_spec = xkb_cached_map->device_spec;
+    xkb->defined = compiled->defined;
+    xkb->flags = compiled->flags;
+    xkb->device_spec = compiled->device_spec;
     xkbi->desc = xkb;
+    /* devices initialized from the same compiled keymap share it until one
+     * of them changes, see XkbCopyDeviceKeymap() */
+    xkbi->keymapSerial = serial;
 
     if (xkb->min_key_code == 0)
         xkb->min_key_code = 8;
@@ -640,12 +706,14 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
         XkbSetRulesUsed(rmlvo);
     }
     XkbFreeRMLVOSet(&rmlvo_dflts, FALSE);
+    XkbFreeKeyboard(uncached, XkbAllComponentsMask, TRUE);
 
     return TRUE;
 
  unwind_desc:
     XkbFreeKeyboard(xkb, 0, TRUE);
  unwind_info:
+    XkbFreeKeyboard(uncached, XkbAllComponentsMask, TRUE);
     free(xkbi);
     dev->key->xkbInfo = NULL;
  unwind_kbdfeed:
@@ -714,6 +782,7 @@ XkbFreeInfo(XkbSrvInfoPtr xkbi)
         TimerFree(xkbi->beepTimer);
         xkbi->beepTimer = NULL;
     }
+    XkbInvalidateKeyTypeLevels(xkbi);
     if (xkbi->desc) {
         XkbFreeKeyboard(xkbi->desc, XkbAllComponentsMask, TRUE);
         xkbi->desc = NULL;
@@ -528,6 +528,7 @@ XkbSetRepeatKeys(DeviceIntPtr pXDev, int key, int onoff)
         XkbControlsRec old;
 
         old = *ctrls;
+        XkbKeymapChanged(pXDev->key->xkbInfo);
 
         if (key == -1) {        /* global autorepeat setting changed */
             if (onoff)
@@ -559,6 +560,8 @@ XkbApplyMappingChange(DeviceIntPtr kbd, KeySymsPtr map, KeyCode first_key,
     memset(&changes, 0, sizeof(changes));
     memset(&cause, 0, sizeof(cause));
 
+    XkbKeymapChanged(kbd->key->xkbInfo);
+
     if (map && first_key && num_keys) {
         check = 0;
         XkbSetCauseCoreReq(&cause, X_ChangeKeyboardMapping, client);
@@ -774,6 +777,7 @@ XkbEnableDisableControls(XkbSrvInfoPtr xkbi,
     ctrls->enabled_ctrls |= (change & newValues);
     if (old == ctrls->enabled_ctrls)
         return FALSE;
+    XkbKeymapChanged(xkbi);
     if (cause != NULL) {
         xkbControlsNotify cn;
 
@@ -2051,10 +2055,148 @@ XkbDeviceApplyKeymap(DeviceIntPtr dst, XkbDescPtr desc)
     return ret;
 }
 
+/**
+ * Return a new keymap serial, see XkbSrvInfoRec::keymapSerial.
+ */
+CARD32
+XkbNewKeymapSerial(void)
+{
+    static CARD32 serial;
+
+    if (++serial == 0)
+        serial++;
+    return serial;
+}
+
+/**
+ * The keymap of this device was modified and is no longer the same as
+ * the keymap of the devices it was shared with. The notify paths call
+ * this, anything that modifies xkbi->desc without sending a notify must
+ * call it directly.
+ */
+void
+XkbKeymapChanged(XkbSrvInfoPtr xkbi)
+{
+    xkbi->keymapSerial = 0;
+}
+
+/**
+ * Copy the keymap of src to dst. If both already share the same keymap,
+ * e.g. because they were initialized from the same compiled keymap or
+ * the keymap was copied before and neither changed since, this is a no-op
+ * and no XkbNewKeyboardNotify is sent.
+ *
+ * Drivers set controls like the repeat rate directly, so the controls are
+ * compared too and a mismatch falls back to a full copy. The controls are
+ * always copied as a whole, so their padding matches as well.
+ */
 Bool
 XkbCopyDeviceKeymap(DeviceIntPtr dst, DeviceIntPtr src)
 {
-    return XkbDeviceApplyKeymap(dst, src->key->xkbInfo->desc);
+    XkbSrvInfoPtr src_xkbi = src->key->xkbInfo;
+    XkbDescPtr src_desc = src_xkbi->desc;
+    XkbDescPtr dst_desc;
+
+    if (!dst->key)
+        return FALSE;
+
+    dst_desc = dst->key->xkbInfo->desc;
+    if (src_xkbi->keymapSerial != 0 &&
+        src_xkbi->keymapSerial == dst->key->xkbInfo->keymapSerial &&
+        src_desc->ctrls && dst_desc->ctrls &&
+        memcmp(src_desc->ctrls, dst_desc->ctrls, sizeof(XkbControlsRec)) == 0)
+        return TRUE;
+
+    if (!XkbDeviceApplyKeymap(dst, src_xkbi->desc))
+        return FALSE;
+
+    if (src_xkbi->keymapSerial == 0)
+        src_xkbi->keymapSerial = XkbNewKeymapSerial();
+    dst->key->xkbInfo->keymapSerial = src_xkbi->keymapSerial;
+
+    return TRUE;
+}
+
+/* one entry per combination of real modifiers */
+#define XKB_NUM_MOD_STATES (1 << XkbNumModifiers)
+
+static int
+_XkbKeyTypeLevel(XkbKeyTypePtr type, unsigned int mods)
+{
+    XkbKTMapEntryPtr entry;
+    int i;
+
+    mods &= type->mods.mask;
+    for (entry = type->map, i = 0; entry && i < type->map_count; i++, entry++) {
+        if (entry->active && entry->mods.mask == mods)
+            return entry->level;
+    }
+    return 0;
+}
+
+static Bool
+XkbCompileKeyTypeLevels(XkbSrvInfoPtr xkbi)
+{
+    XkbClientMapPtr map = xkbi->desc->map;
+    CARD8 *levels;
+
+    XkbInvalidateKeyTypeLevels(xkbi);
+
+    if (!map || !map->types || map->num_types == 0)
+        return FALSE;
+
+    levels = calloc(map->num_types, XKB_NUM_MOD_STATES);
+    if (!levels)
+        return FALSE;
+
+    for (int t = 0; t < map->num_types; t++) {
+        CARD8 *row = &levels[t * XKB_NUM_MOD_STATES];
+
+        for (int mods = 0; mods < XKB_NUM_MOD_STATES; mods++)
+            row[mods] = _XkbKeyTypeLevel(&map->types[t], mods);
+    }
+
+    xkbi->typeLevels = levels;
+    xkbi->nTypeLevels = map->num_types;
+    return TRUE;
+}
+
+/**
+ * Return the shift level of the given key type for the modifier state.
+ *
+ * The levels of all key types are compiled into a lookup table on first
+ * use, so this does not walk the type's map entries on every key event.
+ * The table must be discarded with XkbInvalidateKeyTypeLevels() whenever
+ * the key types change, this happens in XkbSendMapNotify() and
+ * XkbSendNewKeyboardNotify().
+ */
+int
+XkbKeyTypeLevel(XkbSrvInfoPtr xkbi, XkbKeyTypePtr type, unsigned int mods)
+{
+    XkbClientMapPtr map = xkbi->desc->map;
+    ptrdiff_t ndx;
+
+    if (!xkbi->typeLevels || xkbi->nTypeLevels != map->num_types)
+        XkbCompileKeyTypeLevels(xkbi);
+
+    ndx = type - map->types;
+    if (!xkbi->typeLevels || ndx < 0 || ndx >= xkbi->nTypeLevels)
+        return _XkbKeyTypeLevel(type, mods);
+
+    mods &= type->mods.mask & (XKB_NUM_MOD_STATES - 1);
+    return xkbi->typeLevels[ndx * XKB_NUM_MOD_STATES + mods];
+}
+
+/**
+ * Discard the compiled key type levels, they will be recompiled on the
+ * next key event.
+ */
+void
+XkbInvalidateKeyTypeLevels(XkbSrvInfoPtr xkbi)
+{
+    free(xkbi->typeLevels);
+    xkbi->typeLevels = NULL;
+    xkbi->nTypeLevels = 0;
 }
 
 int
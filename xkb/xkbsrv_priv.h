@@ -166,6 +166,10 @@ XkbGeometryPtr XkbLookupNamedGeometry(DeviceIntPtr dev, Atom name, Bool *shouldF
 void XkbConvertCase(KeySym sym, KeySym *lower, KeySym *upper);
 int XkbChangeKeycodeRange(XkbDescPtr xkb, int minKC, int maxKC, XkbChangesPtr changes);
 void XkbFreeInfo(XkbSrvInfoPtr xkbi);
+int XkbKeyTypeLevel(XkbSrvInfoPtr xkbi, XkbKeyTypePtr type, unsigned int mods);
+void XkbInvalidateKeyTypeLevels(XkbSrvInfoPtr xkbi);
+CARD32 XkbNewKeymapSerial(void);
+void XkbKeymapChanged(XkbSrvInfoPtr xkbi);
 int XkbChangeTypesOfKey(XkbDescPtr xkb, int key, int nGroups, unsigned int groups,
                         int *newTypesIn, XkbMapChangesPtr changes);
 int XkbKeyTypesForCoreSymbols(XkbDescPtr xkb, int map_width, KeySym *core_syms,